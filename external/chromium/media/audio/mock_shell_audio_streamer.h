@@ -12,6 +12,7 @@ class MockShellAudioStream : public ShellAudioStream {
   MOCK_CONST_METHOD0(PauseRequested, bool ());
   MOCK_METHOD2(PullFrames, bool (uint32_t*, uint32_t*));
   MOCK_METHOD1(ConsumeFrames, void (uint32_t));
+  MOCK_METHOD2(GetReadableRegion, uint32_t (uint32_t, uint32_t*));
   MOCK_CONST_METHOD0(GetAudioParameters, const AudioParameters& ());
   MOCK_METHOD0(GetAudioBus, AudioBus* ());
 
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/audio/shell_audio_frame_ring.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace media {
+
+using base::subtle::Acquire_Load;
+using base::subtle::Atomic32;
+using base::subtle::NoBarrier_AtomicIncrement;
+using base::subtle::NoBarrier_Load;
+using base::subtle::NoBarrier_Store;
+using base::subtle::Release_Store;
+
+ShellAudioFrameRing::ShellAudioFrameRing()
+    : capacity_(0)
+    , write_cursor_(0)
+    , read_cursor_(0)
+    , overflow_count_(0)
+    , underflow_count_(0) {
+}
+
+void ShellAudioFrameRing::Reset(uint32 capacity) {
+  DCHECK_LT(capacity, 1U << 30);
+  capacity_ = capacity;
+  NoBarrier_Store(&write_cursor_, 0);
+  Release_Store(&read_cursor_, 0);
+}
+
+uint32 ShellAudioFrameRing::frames_buffered() const {
+  uint32 read_cursor = Acquire_Load(&read_cursor_);
+  uint32 write_cursor = Acquire_Load(&write_cursor_);
+  return Distance(read_cursor, write_cursor);
+}
+
+uint32 ShellAudioFrameRing::frames_free() const {
+  return capacity_ - frames_buffered();
+}
+
+uint32 ShellAudioFrameRing::GetWritableRegion(uint32* offset) const {
+  DCHECK(offset);
+  uint32 write_cursor = NoBarrier_Load(&write_cursor_);
+  // Acquire pairs with the consumer's CommitRead(), so the consumer is done
+  // with the frames before they are handed out again.
+  uint32 read_cursor = Acquire_Load(&read_cursor_);
+  *offset = ToOffset(write_cursor);
+  uint32 free_frames = capacity_ - Distance(read_cursor, write_cursor);
+  return std::min(free_frames, capacity_ - *offset);
+}
+
+void ShellAudioFrameRing::CommitWrite(uint32 frames) {
+  uint32 write_cursor = NoBarrier_Load(&write_cursor_);
+  uint32 free_frames =
+      capacity_ - Distance(Acquire_Load(&read_cursor_), write_cursor);
+  if (frames > free_frames) {
+    NoBarrier_AtomicIncrement(&overflow_count_, 1);
+    frames = free_frames;
+  }
+  Release_Store(&write_cursor_, Advance(write_cursor, frames));
+}
+
+uint32 ShellAudioFrameRing::GetReadableRegion(uint32 skip_frames,
+                                              uint32* offset) const {
+  DCHECK(offset);
+  uint32 read_cursor = NoBarrier_Load(&read_cursor_);
+  // Acquire pairs with the producer's CommitWrite(), so the frames are
+  // visible before they are read.
+  uint32 buffered_frames = Distance(read_cursor, Acquire_Load(&write_cursor_));
+  skip_frames = std::min(skip_frames, buffered_frames);
+  *offset = ToOffset(Advance(read_cursor, skip_frames));
+  return std::min(buffered_frames - skip_frames, capacity_ - *offset);
+}
+
+uint32 ShellAudioFrameRing::read_offset() const {
+  return ToOffset(Acquire_Load(&read_cursor_));
+}
+
+void ShellAudioFrameRing::CommitRead(uint32 frames) {
+  uint32 read_cursor = NoBarrier_Load(&read_cursor_);
+  uint32 buffered_frames = Distance(read_cursor, Acquire_Load(&write_cursor_));
+  if (frames > buffered_frames) {
+    NoBarrier_AtomicIncrement(&underflow_count_, 1);
+    frames = buffered_frames;
+  }
+  Release_Store(&read_cursor_, Advance(read_cursor, frames));
+}
+
+uint32 ShellAudioFrameRing::overflow_count() const {
+  return NoBarrier_Load(&overflow_count_);
+}
+
+uint32 ShellAudioFrameRing::underflow_count() const {
+  return NoBarrier_Load(&underflow_count_);
+}
+
+uint32 ShellAudioFrameRing::Advance(uint32 cursor, uint32 frames) const {
+  DCHECK_LE(frames, capacity_);
+  cursor += frames;
+  return cursor >= 2 * capacity_ ? cursor - 2 * capacity_ : cursor;
+}
+
+uint32 ShellAudioFrameRing::Distance(uint32 from, uint32 to) const {
+  return to >= from ? to - from : to + 2 * capacity_ - from;
+}
+
+uint32 ShellAudioFrameRing::ToOffset(uint32 cursor) const {
+  return cursor >= capacity_ ? cursor - capacity_ : cursor;
+}
+
+}  // namespace media
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_AUDIO_SHELL_AUDIO_FRAME_RING_H_
+#define MEDIA_AUDIO_SHELL_AUDIO_FRAME_RING_H_
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+// Tracks which frames of a ring buffer of audio frames are filled, for one
+// producer thread and one consumer thread, without locks.  The ring doesn't
+// own the frames; it hands out offsets into a buffer owned by its user.
+//
+// The producer writes frames into the region returned by GetWritableRegion()
+// and then publishes them with CommitWrite().  The consumer reads published
+// frames in place through GetReadableRegion() and then frees them with
+// CommitRead().  The cursors are stored with release semantics and loaded
+// with acquire semantics, so frames written before CommitWrite() are visible
+// to the consumer, and frames are not overwritten until the consumer has
+// called CommitRead() on them.
+class MEDIA_EXPORT ShellAudioFrameRing {
+ public:
+  ShellAudioFrameRing();
+
+  // Empties the ring and sets its capacity in frames.  Neither the producer
+  // nor the consumer may be using the ring at the same time.
+  void Reset(uint32 capacity);
+  uint32 capacity() const { return capacity_; }
+
+  // Number of frames published by the producer and not yet consumed.  This
+  // may be called on either thread.
+  uint32 frames_buffered() const;
+  // Number of frames the producer may write.  This may be called on either
+  // thread.
+  uint32 frames_free() const;
+
+  // Producer side.  Returns the number of frames that may be written in one
+  // contiguous run, and sets |offset| to the frame it starts at.
+  uint32 GetWritableRegion(uint32* offset) const;
+  // Publishes |frames| frames written at the start of the writable region.
+  // Committing more than frames_free() counts as an overflow and only the
+  // free frames are published.
+  void CommitWrite(uint32 frames);
+
+  // Consumer side.  Returns the number of published frames that may be read
+  // in one contiguous run starting |skip_frames| after the oldest frame, and
+  // sets |offset| to the frame it starts at.
+  uint32 GetReadableRegion(uint32 skip_frames, uint32* offset) const;
+  // Offset of the oldest published frame.
+  uint32 read_offset() const;
+  // Frees the |frames| oldest frames.  Consuming more than frames_buffered()
+  // counts as an underflow and only the buffered frames are freed.
+  void CommitRead(uint32 frames);
+
+  // Number of times the producer or the consumer went past the other one
+  // since the ring was constructed.
+  uint32 overflow_count() const;
+  uint32 underflow_count() const;
+
+ private:
+  // The cursors run over [0, 2 * capacity_) so that a full ring can be told
+  // apart from an empty one.
+  uint32 Advance(uint32 cursor, uint32 frames) const;
+  uint32 Distance(uint32 from, uint32 to) const;
+  uint32 ToOffset(uint32 cursor) const;
+
+  uint32 capacity_;
+  // Written only by the producer.
+  base::subtle::Atomic32 write_cursor_;
+  // Written only by the consumer.
+  base::subtle::Atomic32 read_cursor_;
+
+  base::subtle::Atomic32 overflow_count_;
+  base::subtle::Atomic32 underflow_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShellAudioFrameRing);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_AUDIO_SHELL_AUDIO_FRAME_RING_H_
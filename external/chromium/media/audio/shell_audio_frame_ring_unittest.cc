@@ -0,0 +1,163 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/audio/shell_audio_frame_ring.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/threading/platform_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+TEST(ShellAudioFrameRingTest, WriteAndRead) {
+  ShellAudioFrameRing ring;
+  ring.Reset(100);
+  EXPECT_EQ(0u, ring.frames_buffered());
+  EXPECT_EQ(100u, ring.frames_free());
+
+  uint32 offset;
+  EXPECT_EQ(100u, ring.GetWritableRegion(&offset));
+  EXPECT_EQ(0u, offset);
+  EXPECT_EQ(0u, ring.GetReadableRegion(0, &offset));
+
+  ring.CommitWrite(30);
+  EXPECT_EQ(30u, ring.frames_buffered());
+  EXPECT_EQ(70u, ring.GetWritableRegion(&offset));
+  EXPECT_EQ(30u, offset);
+  EXPECT_EQ(30u, ring.GetReadableRegion(0, &offset));
+  EXPECT_EQ(0u, offset);
+  EXPECT_EQ(20u, ring.GetReadableRegion(10, &offset));
+  EXPECT_EQ(10u, offset);
+
+  ring.CommitRead(30);
+  EXPECT_EQ(0u, ring.frames_buffered());
+  EXPECT_EQ(30u, ring.read_offset());
+  EXPECT_EQ(0u, ring.overflow_count());
+  EXPECT_EQ(0u, ring.underflow_count());
+}
+
+TEST(ShellAudioFrameRingTest, RegionsStopAtTheEnd) {
+  ShellAudioFrameRing ring;
+  ring.Reset(100);
+  ring.CommitWrite(80);
+  ring.CommitRead(60);
+
+  // The 80 free frames are split between [80, 100) and [0, 60).
+  uint32 offset;
+  EXPECT_EQ(80u, ring.frames_free());
+  EXPECT_EQ(20u, ring.GetWritableRegion(&offset));
+  EXPECT_EQ(80u, offset);
+  ring.CommitWrite(20);
+  EXPECT_EQ(60u, ring.GetWritableRegion(&offset));
+  EXPECT_EQ(0u, offset);
+  ring.CommitWrite(60);
+  EXPECT_EQ(0u, ring.GetWritableRegion(&offset));
+
+  // A full ring is not mistaken for an empty one.
+  EXPECT_EQ(100u, ring.frames_buffered());
+  EXPECT_EQ(40u, ring.GetReadableRegion(0, &offset));
+  EXPECT_EQ(60u, offset);
+  EXPECT_EQ(60u, ring.GetReadableRegion(40, &offset));
+  EXPECT_EQ(0u, offset);
+  ring.CommitRead(100);
+  EXPECT_EQ(0u, ring.frames_buffered());
+  EXPECT_EQ(60u, ring.read_offset());
+}
+
+TEST(ShellAudioFrameRingTest, OverflowAndUnderflow) {
+  ShellAudioFrameRing ring;
+  ring.Reset(100);
+  ring.CommitWrite(60);
+  ring.CommitWrite(60);
+  EXPECT_EQ(1u, ring.overflow_count());
+  EXPECT_EQ(100u, ring.frames_buffered());
+
+  ring.CommitRead(70);
+  ring.CommitRead(70);
+  EXPECT_EQ(1u, ring.underflow_count());
+  EXPECT_EQ(0u, ring.frames_buffered());
+
+  ring.Reset(50);
+  EXPECT_EQ(50u, ring.frames_free());
+  EXPECT_EQ(0u, ring.read_offset());
+}
+
+namespace {
+
+const uint32 kRingSize = 1000;
+const uint32 kFramesToTransfer = 1000000;
+
+// Writes an increasing sequence into the ring in irregular chunks.
+class Producer : public base::PlatformThread::Delegate {
+ public:
+  Producer(ShellAudioFrameRing* ring, uint32* buffer)
+      : ring_(ring), buffer_(buffer) {}
+
+  virtual void ThreadMain() OVERRIDE {
+    uint32 next = 0;
+    uint32 chunk = 1;
+    while (next < kFramesToTransfer) {
+      uint32 offset;
+      uint32 frames = std::min(ring_->GetWritableRegion(&offset), chunk);
+      frames = std::min(frames, kFramesToTransfer - next);
+      for (uint32 i = 0; i < frames; ++i)
+        buffer_[offset + i] = next++;
+      ring_->CommitWrite(frames);
+      chunk = chunk % 97 + 1;
+      if (!frames)
+        base::PlatformThread::YieldCurrentThread();
+    }
+  }
+
+ private:
+  ShellAudioFrameRing* ring_;
+  uint32* buffer_;
+};
+
+}  // namespace
+
+TEST(ShellAudioFrameRingTest, ProducerAndConsumerThreads) {
+  ShellAudioFrameRing ring;
+  ring.Reset(kRingSize);
+  std::vector<uint32> buffer(kRingSize);
+  Producer producer(&ring, &buffer[0]);
+  base::PlatformThreadHandle handle;
+  ASSERT_TRUE(base::PlatformThread::Create(0, &producer, &handle));
+
+  uint32 expected = 0;
+  uint32 chunk = 1;
+  bool in_order = true;
+  while (expected < kFramesToTransfer) {
+    uint32 offset;
+    uint32 frames = std::min(ring.GetReadableRegion(0, &offset), chunk);
+    for (uint32 i = 0; i < frames; ++i)
+      in_order &= buffer[offset + i] == expected++;
+    ring.CommitRead(frames);
+    chunk = chunk % 89 + 1;
+    if (!frames)
+      base::PlatformThread::YieldCurrentThread();
+  }
+  base::PlatformThread::Join(handle);
+
+  EXPECT_TRUE(in_order);
+  EXPECT_EQ(0u, ring.frames_buffered());
+  EXPECT_EQ(0u, ring.overflow_count());
+  EXPECT_EQ(0u, ring.underflow_count());
+}
+
+}  // namespace media
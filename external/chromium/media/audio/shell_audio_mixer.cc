@@ -0,0 +1,258 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/audio/shell_audio_mixer.h"
+
+#include <algorithm>
+
+#include "base/bind.h"
+#include "base/debug/trace_event.h"
+#include "base/logging.h"
+#include "base/stl_util.h"
+#include "media/audio/audio_parameters.h"
+#include "media/base/audio_bus.h"
+#include "media/base/multi_channel_resampler.h"
+#include "media/base/vector_math.h"
+
+namespace media {
+
+namespace {
+
+// The mix is built in chunks of this many frames, so the buffers can be
+// allocated up front.
+const int kMaxFramesPerMix = 1024;
+
+}  // namespace
+
+struct ShellAudioMixer::Client {
+  explicit Client(ShellAudioStream* stream)
+      : stream(stream)
+      , volume(1.0f)
+      , playing(false)
+      , frames_pending(0)
+      , frames_played(0) {}
+
+  ShellAudioStream* stream;
+  float volume;
+  // The stream converted to planar float, at the output sample rate.
+  scoped_ptr<AudioBus> input_bus;
+  // Only set when the stream's sample rate differs from the output's.
+  scoped_ptr<MultiChannelResampler> resampler;
+  double io_sample_rate_ratio;
+  // Whether the stream was playing when it last pulled.
+  bool playing;
+  // Number of frames read from the stream but not yet consumed.
+  uint32 frames_pending;
+  // Fraction of a stream frame played but not yet consumed.
+  double frames_played;
+};
+
+ShellAudioMixer::ShellAudioMixer(
+    const ShellAudioStreamer::Config& stream_config, int output_channels,
+    int output_sample_rate)
+    : stream_config_(stream_config)
+    , output_channels_(output_channels)
+    , output_sample_rate_(output_sample_rate)
+    , mix_bus_(AudioBus::Create(output_channels, kMaxFramesPerMix)) {
+}
+
+ShellAudioMixer::~ShellAudioMixer() {
+  DCHECK(clients_.empty());
+  STLDeleteValues(&clients_);
+}
+
+void ShellAudioMixer::AddStream(ShellAudioStream* stream) {
+  TRACE_EVENT0("media_stack", "ShellAudioMixer::AddStream()");
+  const AudioParameters& params = stream->GetAudioParameters();
+  DCHECK(params.bits_per_sample() == 16 || params.bits_per_sample() == 32);
+
+  Client* client = new Client(stream);
+  client->input_bus = AudioBus::Create(params.channels(), kMaxFramesPerMix);
+  client->io_sample_rate_ratio =
+      static_cast<double>(params.sample_rate()) / output_sample_rate_;
+  if (params.sample_rate() != output_sample_rate_) {
+    client->resampler.reset(new MultiChannelResampler(
+        params.channels(), client->io_sample_rate_ratio,
+        base::Bind(&ShellAudioMixer::ProvideInput, base::Unretained(this),
+                   client)));
+  }
+
+  base::AutoLock lock(lock_);
+  DCHECK(clients_.find(stream) == clients_.end());
+  clients_[stream] = client;
+}
+
+void ShellAudioMixer::RemoveStream(ShellAudioStream* stream) {
+  TRACE_EVENT0("media_stack", "ShellAudioMixer::RemoveStream()");
+  Client* client = NULL;
+  {
+    base::AutoLock lock(lock_);
+    ClientMap::iterator it = clients_.find(stream);
+    if (it == clients_.end())
+      return;
+    client = it->second;
+    clients_.erase(it);
+  }
+  delete client;
+}
+
+bool ShellAudioMixer::HasStream(ShellAudioStream* stream) const {
+  base::AutoLock lock(lock_);
+  return clients_.find(stream) != clients_.end();
+}
+
+bool ShellAudioMixer::SetVolume(ShellAudioStream* stream, double volume) {
+  base::AutoLock lock(lock_);
+  ClientMap::iterator it = clients_.find(stream);
+  if (it == clients_.end())
+    return false;
+  it->second->volume = static_cast<float>(std::max(volume, 0.0));
+  return true;
+}
+
+bool ShellAudioMixer::empty() const {
+  base::AutoLock lock(lock_);
+  return clients_.empty();
+}
+
+bool ShellAudioMixer::Mix(int frames, float* dest) {
+  TRACE_EVENT0("media_stack", "ShellAudioMixer::Mix()");
+  base::AutoLock lock(lock_);
+
+  bool playing = false;
+  for (ClientMap::iterator it = clients_.begin(); it != clients_.end(); ++it) {
+    Client* client = it->second;
+    client->playing = client->stream->PullFrames(NULL, NULL);
+    playing |= client->playing;
+  }
+
+  int frames_mixed = 0;
+  while (frames_mixed < frames) {
+    int frames_to_mix = std::min(frames - frames_mixed, kMaxFramesPerMix);
+    mix_bus_->ZeroFramesPartial(0, frames_to_mix);
+    for (ClientMap::iterator it = clients_.begin(); it != clients_.end();
+         ++it) {
+      if (it->second->playing)
+        MixClient(it->second, frames_to_mix);
+    }
+    mix_bus_->ToInterleavedFloat(frames_to_mix, 0, 0,
+                                 dest + frames_mixed * output_channels_);
+    frames_mixed += frames_to_mix;
+  }
+  return playing;
+}
+
+void ShellAudioMixer::OnFramesPlayed(int frames) {
+  base::AutoLock lock(lock_);
+  for (ClientMap::iterator it = clients_.begin(); it != clients_.end(); ++it) {
+    Client* client = it->second;
+    client->frames_played += frames * client->io_sample_rate_ratio;
+    uint32 frames_consumed = static_cast<uint32>(client->frames_played);
+    if (frames_consumed > client->frames_pending) {
+      // Output played while the stream was paused or starved doesn't come
+      // from the stream.
+      frames_consumed = client->frames_pending;
+      client->frames_played = 0;
+    } else {
+      client->frames_played -= frames_consumed;
+    }
+    if (frames_consumed) {
+      client->stream->ConsumeFrames(frames_consumed);
+      client->frames_pending -= frames_consumed;
+    }
+  }
+}
+
+void ShellAudioMixer::MixClient(Client* client, int frames) {
+  AudioBus* input_bus = client->input_bus.get();
+  if (client->resampler)
+    client->resampler->Resample(input_bus, frames);
+  else
+    ReadInput(client, frames, input_bus);
+
+  // Mono is played on every output channel, other layouts are folded onto
+  // the output channels in order.
+  for (int i = 0; i < input_bus->channels(); ++i) {
+    if (input_bus->channels() == 1) {
+      for (int j = 0; j < output_channels_; ++j) {
+        vector_math::FMAC(input_bus->channel(0), client->volume, frames,
+                          mix_bus_->channel(j));
+      }
+    } else {
+      vector_math::FMAC(input_bus->channel(i), client->volume, frames,
+                        mix_bus_->channel(i % output_channels_));
+    }
+  }
+}
+
+void ShellAudioMixer::ReadInput(Client* client, int frames, AudioBus* dest) {
+  int frames_read = 0;
+  while (frames_read < frames) {
+    uint32 offset;
+    int frames_to_read = std::min<uint32>(
+        client->stream->GetReadableRegion(client->frames_pending, &offset),
+        frames - frames_read);
+    if (!frames_to_read)
+      break;
+    ConvertFrames(client, offset, frames_to_read, dest, frames_read);
+    frames_read += frames_to_read;
+    client->frames_pending += frames_to_read;
+  }
+  if (frames_read < frames)
+    dest->ZeroFramesPartial(frames_read, frames - frames_read);
+}
+
+void ShellAudioMixer::ProvideInput(Client* client, int frame_delay,
+                                   AudioBus* dest) {
+  ReadInput(client, dest->frames(), dest);
+}
+
+void ShellAudioMixer::ConvertFrames(Client* client, uint32 offset, int frames,
+                                    AudioBus* dest, int dest_offset) {
+  const AudioBus* source = client->stream->GetAudioBus();
+  const AudioParameters& params = client->stream->GetAudioParameters();
+  const int channels = params.channels();
+  const int bytes_per_sample = params.bits_per_sample() / 8;
+
+  if (stream_config_.interleaved()) {
+    const uint8* data = reinterpret_cast<const uint8*>(source->channel(0)) +
+                        offset * channels * bytes_per_sample;
+    if (bytes_per_sample == sizeof(float)) {
+      dest->FromInterleavedFloat(reinterpret_cast<const float*>(data), frames,
+                                 dest_offset);
+    } else {
+      dest->FromInterleavedPartial(data, dest_offset, frames,
+                                   bytes_per_sample);
+    }
+    return;
+  }
+
+  for (int i = 0; i < channels; ++i) {
+    const uint8* data = reinterpret_cast<const uint8*>(source->channel(i)) +
+                        offset * bytes_per_sample;
+    float* dest_data = dest->channel(i) + dest_offset;
+    if (bytes_per_sample == sizeof(float)) {
+      memcpy(dest_data, data, frames * sizeof(float));
+    } else {
+      DCHECK_EQ(bytes_per_sample, static_cast<int>(sizeof(int16)));
+      const int16* samples = reinterpret_cast<const int16*>(data);
+      for (int j = 0; j < frames; ++j)
+        dest_data[j] = samples[j] * (1.0f / 32768);
+    }
+  }
+}
+
+}  // namespace media
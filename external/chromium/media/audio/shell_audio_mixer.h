@@ -0,0 +1,95 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_AUDIO_SHELL_AUDIO_MIXER_H_
+#define MEDIA_AUDIO_SHELL_AUDIO_MIXER_H_
+
+#include <map>
+
+#include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "media/audio/shell_audio_streamer.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+class AudioBus;
+
+// Mixes any number of ShellAudioStreams into a single output, so a streamer
+// can play all of them through one hardware stream.  Each stream is converted
+// from the format described by the streamer's Config to planar float,
+// resampled to the output sample rate, scaled by its volume and added to the
+// mix.
+//
+// Mix() and OnFramesPlayed() are called on the thread feeding the hardware.
+// The other methods may be called on any thread.
+class MEDIA_EXPORT ShellAudioMixer {
+ public:
+  // |stream_config| describes the audio buses of the streams.
+  ShellAudioMixer(const ShellAudioStreamer::Config& stream_config,
+                  int output_channels, int output_sample_rate);
+  ~ShellAudioMixer();
+
+  void AddStream(ShellAudioStream* stream);
+  void RemoveStream(ShellAudioStream* stream);
+  bool HasStream(ShellAudioStream* stream) const;
+  bool SetVolume(ShellAudioStream* stream, double volume);
+  bool empty() const;
+
+  int output_channels() const { return output_channels_; }
+  int output_sample_rate() const { return output_sample_rate_; }
+
+  // Lets every stream pull data from its renderer, and mixes |frames| frames
+  // of the streams that are playing into |dest| as interleaved floats.
+  // |frames| may be 0 to only let the streams pull.  Returns whether any
+  // stream is playing.
+  bool Mix(int frames, float* dest);
+
+  // Tells the streams that |frames| frames of output have been played, so
+  // the frames they were mixed from can be released.
+  void OnFramesPlayed(int frames);
+
+ private:
+  struct Client;
+  typedef std::map<ShellAudioStream*, Client*> ClientMap;
+
+  // Mixes up to kMaxFramesPerMix frames of |client| into mix_bus_.
+  void MixClient(Client* client, int frames);
+  // Fills the first |frames| frames of |dest| with the next frames of
+  // |client|'s stream, converted to planar float, padding it with silence if
+  // the stream runs out.
+  void ReadInput(Client* client, int frames, AudioBus* dest);
+  // MultiChannelResampler::ReadCB for |client|.
+  void ProvideInput(Client* client, int frame_delay, AudioBus* dest);
+  // Converts |frames| frames at |offset| in |client|'s audio bus into |dest|
+  // at |dest_offset|.
+  void ConvertFrames(Client* client, uint32 offset, int frames, AudioBus* dest,
+                     int dest_offset);
+
+  const ShellAudioStreamer::Config stream_config_;
+  const int output_channels_;
+  const int output_sample_rate_;
+
+  mutable base::Lock lock_;
+  ClientMap clients_;
+  scoped_ptr<AudioBus> mix_bus_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShellAudioMixer);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_AUDIO_SHELL_AUDIO_MIXER_H_
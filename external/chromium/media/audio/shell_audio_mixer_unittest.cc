@@ -0,0 +1,222 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/audio/shell_audio_mixer.h"
+
+#include <vector>
+
+#include "media/audio/audio_parameters.h"
+#include "media/audio/shell_audio_frame_ring.h"
+#include "media/base/audio_bus.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+namespace {
+
+typedef ShellAudioStreamer::Config Config;
+
+const int kOutputSampleRate = 48000;
+const int kOutputChannels = 2;
+const uint32 kSinkFrames = 16384;
+
+Config CreateConfig(Config::StorageMode storage_mode, int bytes_per_sample) {
+  return Config(storage_mode, kSinkFrames / 2, kSinkFrames,
+                kOutputChannels, bytes_per_sample, kOutputSampleRate);
+}
+
+// A stream that plays a constant value from a ring buffer laid out as
+// described by the Config, like ShellAudioSink does.
+class FakeStream : public ShellAudioStream {
+ public:
+  FakeStream(const Config& config, int channels, int bytes_per_sample,
+             int sample_rate, float value)
+      : config_(config),
+        params_(AudioParameters::AUDIO_PCM_LINEAR,
+                channels == 1 ? CHANNEL_LAYOUT_MONO : CHANNEL_LAYOUT_STEREO,
+                sample_rate, bytes_per_sample * 8, 1024),
+        value_(value),
+        playing_(true),
+        frames_consumed_(0) {
+    int bus_frames = kSinkFrames * bytes_per_sample / sizeof(float);
+    if (config.interleaved())
+      audio_bus_ = AudioBus::Create(1, bus_frames * channels);
+    else
+      audio_bus_ = AudioBus::Create(channels, bus_frames);
+    ring_.Reset(kSinkFrames);
+  }
+
+  virtual bool PauseRequested() const OVERRIDE { return !playing_; }
+
+  virtual bool PullFrames(uint32_t* offset_in_frame,
+                          uint32_t* total_frames) OVERRIDE {
+    uint32 offset;
+    uint32 frames;
+    while ((frames = ring_.GetWritableRegion(&offset)) != 0) {
+      for (uint32 i = 0; i < frames; ++i)
+        WriteFrame(offset + i);
+      ring_.CommitWrite(frames);
+    }
+    return playing_;
+  }
+
+  virtual void ConsumeFrames(uint32_t frame_played) OVERRIDE {
+    ring_.CommitRead(frame_played);
+    frames_consumed_ += frame_played;
+  }
+
+  virtual uint32_t GetReadableRegion(uint32_t skip_frames,
+                                     uint32_t* offset_in_frame) OVERRIDE {
+    return ring_.GetReadableRegion(skip_frames, offset_in_frame);
+  }
+
+  virtual const AudioParameters& GetAudioParameters() const OVERRIDE {
+    return params_;
+  }
+
+  virtual AudioBus* GetAudioBus() OVERRIDE { return audio_bus_.get(); }
+
+  void set_playing(bool playing) { playing_ = playing; }
+  uint32 frames_consumed() const { return frames_consumed_; }
+
+ private:
+  void WriteFrame(uint32 frame) {
+    int channels = params_.channels();
+    for (int i = 0; i < channels; ++i) {
+      uint8* data = reinterpret_cast<uint8*>(
+          audio_bus_->channel(config_.interleaved() ? 0 : i));
+      uint32 index = config_.interleaved() ? frame * channels + i : frame;
+      if (params_.bits_per_sample() == 32)
+        reinterpret_cast<float*>(data)[index] = value_;
+      else
+        reinterpret_cast<int16*>(data)[index] = value_ * 32768;
+    }
+  }
+
+  Config config_;
+  AudioParameters params_;
+  scoped_ptr<AudioBus> audio_bus_;
+  ShellAudioFrameRing ring_;
+  float value_;
+  bool playing_;
+  uint32 frames_consumed_;
+};
+
+// Stands in for the hardware: plays the mixer's output into a buffer.
+class NullOutput {
+ public:
+  explicit NullOutput(ShellAudioMixer* mixer) : mixer_(mixer) {}
+
+  // Mixes and plays |frames| frames, and returns whether any stream played.
+  bool Play(int frames) {
+    std::vector<float> buffer(frames * mixer_->output_channels());
+    bool playing = mixer_->Mix(frames, &buffer[0]);
+    mixer_->OnFramesPlayed(frames);
+    samples_.insert(samples_.end(), buffer.begin(), buffer.end());
+    return playing;
+  }
+
+  const std::vector<float>& samples() const { return samples_; }
+
+ private:
+  ShellAudioMixer* mixer_;
+  std::vector<float> samples_;
+};
+
+}  // namespace
+
+TEST(ShellAudioMixerTest, MixesStreamsWithVolume) {
+  Config config = CreateConfig(Config::INTERLEAVED, sizeof(float));
+  ShellAudioMixer mixer(config, kOutputChannels, kOutputSampleRate);
+  FakeStream stereo(config, 2, sizeof(float), kOutputSampleRate, 0.25f);
+  FakeStream mono(config, 1, sizeof(float), kOutputSampleRate, 0.5f);
+  mixer.AddStream(&stereo);
+  mixer.AddStream(&mono);
+  EXPECT_TRUE(mixer.SetVolume(&mono, 0.5));
+
+  NullOutput output(&mixer);
+  EXPECT_TRUE(output.Play(3000));
+  ASSERT_EQ(3000 * kOutputChannels, output.samples().size());
+  for (size_t i = 0; i < output.samples().size(); ++i)
+    ASSERT_FLOAT_EQ(0.5f, output.samples()[i]) << i;
+  EXPECT_EQ(3000, stereo.frames_consumed());
+  EXPECT_EQ(3000, mono.frames_consumed());
+
+  mixer.RemoveStream(&stereo);
+  mixer.RemoveStream(&mono);
+  EXPECT_TRUE(mixer.empty());
+}
+
+TEST(ShellAudioMixerTest, PausedStreamsAreSilent) {
+  Config config = CreateConfig(Config::INTERLEAVED, sizeof(float));
+  ShellAudioMixer mixer(config, kOutputChannels, kOutputSampleRate);
+  FakeStream stream(config, 2, sizeof(float), kOutputSampleRate, 0.25f);
+  mixer.AddStream(&stream);
+  EXPECT_TRUE(mixer.HasStream(&stream));
+
+  NullOutput output(&mixer);
+  stream.set_playing(false);
+  EXPECT_FALSE(output.Play(1000));
+  EXPECT_EQ(0, stream.frames_consumed());
+  for (size_t i = 0; i < output.samples().size(); ++i)
+    ASSERT_EQ(0, output.samples()[i]) << i;
+
+  stream.set_playing(true);
+  EXPECT_TRUE(output.Play(1000));
+  EXPECT_EQ(1000, stream.frames_consumed());
+  EXPECT_FLOAT_EQ(0.25f, output.samples().back());
+
+  mixer.RemoveStream(&stream);
+  EXPECT_FALSE(mixer.HasStream(&stream));
+}
+
+TEST(ShellAudioMixerTest, ConvertsPlanarInt16) {
+  Config config = CreateConfig(Config::PLANAR, sizeof(int16));
+  ShellAudioMixer mixer(config, kOutputChannels, kOutputSampleRate);
+  FakeStream stream(config, 2, sizeof(int16), kOutputSampleRate, 0.5f);
+  mixer.AddStream(&stream);
+
+  NullOutput output(&mixer);
+  EXPECT_TRUE(output.Play(2000));
+  for (size_t i = 0; i < output.samples().size(); ++i)
+    ASSERT_FLOAT_EQ(0.5f, output.samples()[i]) << i;
+
+  mixer.RemoveStream(&stream);
+}
+
+TEST(ShellAudioMixerTest, ResamplesToOutputRate) {
+  Config config = CreateConfig(Config::INTERLEAVED, sizeof(float));
+  ShellAudioMixer mixer(config, kOutputChannels, kOutputSampleRate);
+  FakeStream stream(config, 1, sizeof(float), kOutputSampleRate / 2, 0.5f);
+  mixer.AddStream(&stream);
+
+  NullOutput output(&mixer);
+  const int kFrames = 9600;
+  EXPECT_TRUE(output.Play(kFrames));
+  // The resampler reads ahead of its output, but only the frames that have
+  // been played are consumed.
+  EXPECT_EQ(kFrames / 2, stream.frames_consumed());
+
+  // Skip the resampler's initial delay.
+  for (size_t i = output.samples().size() / 2; i < output.samples().size();
+       ++i) {
+    ASSERT_NEAR(0.5f, output.samples()[i], 0.01f) << i;
+  }
+
+  mixer.RemoveStream(&stream);
+}
+
+}  // namespace media
@@ -16,6 +16,8 @@
 
 #include "media/audio/shell_audio_sink.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 #include "base/debug/trace_event.h"
 #include "base/logging.h"
@@ -60,7 +62,6 @@ ShellAudioSink::ShellAudioSink(ShellAudioStreamer* audio_streamer)
     , pause_requested_(true)
     , rebuffering_(true)
     , rebuffer_num_frames_(0)
-    , render_frame_cursor_(0)
     , output_frame_cursor_(0)
     , clock_bias_frames_(0)
     , audio_streamer_(audio_streamer) {
@@ -96,6 +97,7 @@ void ShellAudioSink::Initialize(const AudioParameters& params,
   rebuffer_num_frames_ =
       streamer_config_.initial_rebuffering_frames_per_channel();
   renderer_audio_bus_ = AudioBus::CreateWrapper(audio_bus_->channels());
+  frame_ring_.Reset(settings_.per_channel_frames(audio_bus_.get()));
 }
 
 void ShellAudioSink::Start() {
@@ -117,7 +119,12 @@ void ShellAudioSink::Stop() {
     audio_streamer_->RemoveStream(this);
     pause_requested_ = true;
     rebuffering_ = true;
-    render_frame_cursor_ = 0;
+    DLOG_IF(WARNING, frame_ring_.overflow_count() ||
+                     frame_ring_.underflow_count())
+        << "sink buffer overflowed " << frame_ring_.overflow_count()
+        << " times and underflowed " << frame_ring_.underflow_count()
+        << " times";
+    frame_ring_.Reset(frame_ring_.capacity());
     output_frame_cursor_ = 0;
   }
 }
@@ -131,7 +138,7 @@ void ShellAudioSink::Pause(bool flush) {
     // remove and re-add the stream to flush
     audio_streamer_->RemoveStream(this);
     rebuffering_ = true;
-    render_frame_cursor_ = 0;
+    frame_ring_.Reset(frame_ring_.capacity());
     output_frame_cursor_ = 0;
     audio_streamer_->AddStream(this);
   }
@@ -187,9 +194,8 @@ bool ShellAudioSink::PullFrames(uint32_t* offset_in_frame,
   if (!offset_in_frame) offset_in_frame = &dummy_offset_in_frame;
   if (!total_frames) total_frames = &dummy_total_frames;
 
-  *total_frames = render_frame_cursor_ - output_frame_cursor_;
-  uint32 free_frames =
-      settings_.per_channel_frames(audio_bus_.get()) - *total_frames;
+  *total_frames = frame_ring_.frames_buffered();
+  uint32 free_frames = frame_ring_.capacity() - *total_frames;
   // Number of ms of buffered playback remaining
   uint32_t buffered_time =
       (*total_frames * 1000 / audio_parameters_.sample_rate());
@@ -206,7 +212,7 @@ bool ShellAudioSink::PullFrames(uint32_t* offset_in_frame,
       // resampler. Check if it is possible to move the resample into the
       // streamer.
       // DCHECK_EQ(frames_rendered, mp4::AAC::kSamplesPerFrame);
-      render_frame_cursor_ += frames_rendered;
+      frame_ring_.CommitWrite(frames_rendered);
       *total_frames += frames_rendered;
       free_frames -= frames_rendered;
     }
@@ -237,13 +243,11 @@ bool ShellAudioSink::PullFrames(uint32_t* offset_in_frame,
       UPDATE_MEDIA_STATISTICS(STAT_TYPE_AUDIO_UNDERFLOW, 0);
     }
   }
-  *offset_in_frame =
-      output_frame_cursor_ % settings_.per_channel_frames(audio_bus_.get());
+  *offset_in_frame = frame_ring_.read_offset();
   return !PauseRequested();
 #else
   rebuffering_ = true;
-  *offset_in_frame =
-      output_frame_cursor_ % settings_.per_channel_frames(audio_bus_.get());
+  *offset_in_frame = frame_ring_.read_offset();
   if (pause_requested_) {
     return false;
   }
@@ -261,10 +265,15 @@ void ShellAudioSink::ConsumeFrames(uint32_t frame_played) {
     // advance our output cursor by the number of frames we're returning
     // update audio clock, used for jitter calculations
     output_frame_cursor_ += frame_played;
-    DCHECK_LE(output_frame_cursor_, render_frame_cursor_);
+    frame_ring_.CommitRead(frame_played);
   }
 }
 
+uint32_t ShellAudioSink::GetReadableRegion(uint32_t skip_frames,
+                                           uint32_t* offset_in_frame) {
+  return frame_ring_.GetReadableRegion(skip_frames, offset_in_frame);
+}
+
 AudioBus* ShellAudioSink::GetAudioBus() {
   return audio_bus_.get();
 }
@@ -280,15 +289,12 @@ void ShellAudioSink::SetClockBiasMs(int64 time_ms) {
 }
 
 void ShellAudioSink::SetupRenderAudioBus() {
-  // check for buffer wraparound, hopefully rare
-  int render_frame_position =
-      render_frame_cursor_ % settings_.per_channel_frames(audio_bus_.get());
-  int requested_frames = mp4::AAC::kSamplesPerFrame;
-  if (render_frame_position + requested_frames >
-      settings_.per_channel_frames(audio_bus_.get())) {
-    requested_frames =
-        settings_.per_channel_frames(audio_bus_.get()) - render_frame_position;
-  }
+  // the writable region stops at the end of the buffer, so the renderer may
+  // get less than a full frame when the ring wraps around
+  uint32 render_frame_position;
+  int requested_frames = std::min<uint32>(
+      mp4::AAC::kSamplesPerFrame,
+      frame_ring_.GetWritableRegion(&render_frame_position));
   // calculate the offset into the buffer where we'd like to store these data
   if (streamer_config_.interleaved()) {
     uint8* channel_data = reinterpret_cast<uint8*>(audio_bus_->channel(0));
@@ -19,6 +19,7 @@
 
 #include "base/threading/thread.h"
 #include "media/base/audio_renderer_sink.h"
+#include "media/audio/shell_audio_frame_ring.h"
 #include "media/audio/shell_audio_streamer.h"
 #include "media/base/shell_buffer_factory.h"
 
@@ -74,6 +75,8 @@ class MEDIA_EXPORT ShellAudioSink
   virtual bool PullFrames(uint32_t* offset_in_frame,
                           uint32_t* total_frames) OVERRIDE;
   virtual void ConsumeFrames(uint32_t frame_played) OVERRIDE;
+  virtual uint32_t GetReadableRegion(uint32_t skip_frames,
+                                     uint32_t* offset_in_frame) OVERRIDE;
   virtual const AudioParameters& GetAudioParameters() const OVERRIDE;
   virtual AudioBus* GetAudioBus() OVERRIDE;
 
@@ -101,10 +104,12 @@ class MEDIA_EXPORT ShellAudioSink
   // Number of frames to rebuffer before calling SinkFull
   int rebuffer_num_frames_;
 
-  // number of samples have been loaded into audio_bus from the Renderer
-  // (and may have been played and since been overwritten by newer samples)
-  uint64_t render_frame_cursor_;
-  // advanced by ConsumeSamples() as the Streamer reports playback advancing
+  // Tracks the frames of audio_bus_ between the Renderer, which fills them
+  // in PullFrames(), and the Streamer, which reads them and then frees them
+  // in ConsumeFrames().  The two may run on different threads.
+  ShellAudioFrameRing frame_ring_;
+  // Number of frames played, advanced by ConsumeFrames().  Only used by the
+  // Streamer.
   uint64_t output_frame_cursor_;
 
   // For jitter logging we only keep track of rendered frames, so if we
@@ -36,6 +36,13 @@ class ShellAudioStream {
   // this to calculate the time elapsed. The stream shouldn't pull any data
   // in this function, PullFrames is the only point to pull data.
   virtual void ConsumeFrames(uint32_t frame_played) = 0;
+  // Returns the number of frames in the audio bus that can be read in one
+  // contiguous run, starting `skip_frames` after the oldest frame that hasn't
+  // been consumed, and sets `offset_in_frame` to the frame it starts at.  The
+  // streamer can pass the frames to the hardware straight from the audio bus.
+  // Like PullFrames, this is LATENCY-SENSITIVE.
+  virtual uint32_t GetReadableRegion(uint32_t skip_frames,
+                                     uint32_t* offset_in_frame) = 0;
   // Get the AudioParameters for this stream
   virtual const AudioParameters& GetAudioParameters() const = 0;
   // Get the internal buffer of this audio stream as an AudioBus.
@@ -30,6 +30,8 @@ class MockShellDataSourceReader : public ShellDataSourceReader {
   MOCK_METHOD1(SetDataSource, void(scoped_refptr<DataSource>));
   MOCK_METHOD1(SetErrorCallback, void(base::Closure));
   MOCK_METHOD3(BlockingRead, int(int64, int, uint8*));
+  MOCK_METHOD4(AsyncRead, bool(int64, int, uint8*, const AsyncReadCB&));
+  MOCK_METHOD2(ReadAhead, void(int64, int));
   MOCK_METHOD0(FileSize, int64());
   MOCK_METHOD0(AbortPendingReadIfAny, void());
 };
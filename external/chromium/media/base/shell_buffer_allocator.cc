@@ -0,0 +1,485 @@
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/base/shell_buffer_allocator.h"
+
+#include "base/logging.h"
+
+namespace {
+
+// index of the least significant set bit, x must be non-zero
+inline int FindFirstSet(uint32 x) {
+  DCHECK(x);
+#if defined(__GNUC__)
+  return __builtin_ctz(x);
+#else
+  int i = 0;
+  while (!(x & 1)) {
+    x >>= 1;
+    ++i;
+  }
+  return i;
+#endif
+}
+
+// index of the most significant set bit, x must be non-zero
+inline int FindLastSet(uint32 x) {
+  DCHECK(x);
+#if defined(__GNUC__)
+  return 31 - __builtin_clz(x);
+#else
+  int i = 0;
+  while (x >>= 1) {
+    ++i;
+  }
+  return i;
+#endif
+}
+
+}  // namespace
+
+namespace media {
+
+const size_t ShellBufferAllocator::kGranuleSize;
+const size_t ShellBufferAllocator::kSlabSize;
+const size_t ShellBufferAllocator::kMinSlabObjectSize;
+const int ShellBufferAllocator::kSlabClassCount;
+const uint32 ShellBufferAllocator::kNone;
+
+ShellBufferAllocator::ShellBufferAllocator(uint8* pool,
+                                           size_t pool_size,
+                                           size_t alignment)
+    : pool_(pool)
+    , granule_count_(static_cast<uint32>(pool_size / kGranuleSize))
+    , allocation_count_(0)
+    , fl_bitmap_(0)
+    , largest_free_(0)
+    , largest_free_count_(0)
+    , largest_free_valid_(true) {
+  DCHECK(pool_);
+  DCHECK_EQ(alignment & (alignment - 1), 0U);
+  DCHECK_LE(alignment, kGranuleSize);
+  DCHECK_EQ(reinterpret_cast<uintptr_t>(pool_) % alignment, 0U);
+  if (pool_size % kGranuleSize) {
+    DLOG(WARNING) << "ignoring " << pool_size % kGranuleSize
+                  << " bytes at end of media pool";
+  }
+
+  for (int fl = 0; fl < kFLCount; ++fl) {
+    sl_bitmap_[fl] = 0;
+    for (int sl = 0; sl < kSLCount; ++sl) {
+      free_heads_[fl][sl] = kNone;
+    }
+  }
+
+  block_size_.resize(granule_count_, 0);
+  block_prev_phys_.resize(granule_count_, kNone);
+  block_flags_.resize(granule_count_, 0);
+  block_next_.resize(granule_count_, kNone);
+  block_prev_.resize(granule_count_, kNone);
+  granule_slab_.resize(granule_count_, kNone);
+  slab_class_.resize(granule_count_, 0);
+  slab_free_count_.resize(granule_count_, 0);
+  slab_unused_.resize(granule_count_, 0);
+  slab_free_head_.resize(granule_count_, kNone);
+
+  for (int i = 0; i < kSlabClassCount; ++i) {
+    size_t size = kMinSlabObjectSize << i;
+    size = ((size + alignment - 1) / alignment) * alignment;
+    slab_object_size_[i] = size;
+    slab_object_count_[i] = static_cast<uint32>(kSlabSize / size);
+    partial_slabs_[i] = kNone;
+  }
+
+  // the whole pool starts out as one free block
+  if (granule_count_) {
+    block_size_[0] = granule_count_;
+    block_flags_[0] = kBlockFree;
+    InsertFreeBlock(0);
+  }
+}
+
+ShellBufferAllocator::~ShellBufferAllocator() {
+}
+
+uint8* ShellBufferAllocator::Allocate(size_t size) {
+  if (size == 0) {
+    return NULL;
+  }
+  uint8* p = NULL;
+  int slab_class = SlabClassForSize(size);
+  if (slab_class >= 0) {
+    p = AllocateFromSlab(slab_class);
+  } else {
+    size_t count = (size + kGranuleSize - 1) / kGranuleSize;
+    if (count <= granule_count_) {
+      uint32 block = AllocateGranules(static_cast<uint32>(count));
+      if (block != kNone) {
+        p = GranuleAddress(block);
+      }
+    }
+  }
+  if (p) {
+    ++allocation_count_;
+  }
+  return p;
+}
+
+void ShellBufferAllocator::Free(uint8* p) {
+  DCHECK_GE(p, pool_);
+  uint32 granule = GranuleIndex(p);
+  DCHECK_LT(granule, granule_count_);
+  DCHECK_GT(allocation_count_, 0U);
+  --allocation_count_;
+  uint32 slab = granule_slab_[granule];
+  if (slab != kNone) {
+    FreeToSlab(slab, p);
+    return;
+  }
+  DCHECK_EQ(p, GranuleAddress(granule)) << "freeing unallocated address";
+  DCHECK(!(block_flags_[granule] & kBlockFree)) << "double free";
+  FreeGranules(granule);
+}
+
+bool ShellBufferAllocator::CanAllocate(size_t size) const {
+  if (size == 0) {
+    return false;
+  }
+  uint32 count;
+  int slab_class = SlabClassForSize(size);
+  if (slab_class >= 0) {
+    if (partial_slabs_[slab_class] != kNone) {
+      return true;
+    }
+    count = static_cast<uint32>(kSlabSize / kGranuleSize);
+  } else {
+    size_t granules = (size + kGranuleSize - 1) / kGranuleSize;
+    if (granules > granule_count_) {
+      return false;
+    }
+    count = static_cast<uint32>(granules);
+  }
+  return FindFreeBlock(count) != kNone;
+}
+
+size_t ShellBufferAllocator::GetAllocationSize(const uint8* p) const {
+  uint32 granule = GranuleIndex(p);
+  DCHECK_LT(granule, granule_count_);
+  uint32 slab = granule_slab_[granule];
+  if (slab != kNone) {
+    return slab_object_size_[slab_class_[slab]];
+  }
+  return block_size_[granule] * kGranuleSize;
+}
+
+size_t ShellBufferAllocator::GetLargestFreeSpace() const {
+  if (!largest_free_valid_) {
+    // The largest free block is in the highest non-empty list, but that list
+    // covers a range of sizes so we have to look at every block in it.
+    largest_free_ = 0;
+    largest_free_count_ = 0;
+    if (fl_bitmap_) {
+      int fl = FindLastSet(fl_bitmap_);
+      int sl = FindLastSet(sl_bitmap_[fl]);
+      for (uint32 block = free_heads_[fl][sl]; block != kNone;
+           block = block_next_[block]) {
+        if (block_size_[block] > largest_free_) {
+          largest_free_ = block_size_[block];
+          largest_free_count_ = 1;
+        } else if (block_size_[block] == largest_free_) {
+          ++largest_free_count_;
+        }
+      }
+    }
+    largest_free_valid_ = true;
+  }
+  return largest_free_ * kGranuleSize;
+}
+
+// static
+void ShellBufferAllocator::MappingInsert(uint32 count, int* fl, int* sl) {
+  if (count < static_cast<uint32>(kSLCount)) {
+    *fl = 0;
+    *sl = count;
+  } else {
+    int last_set = FindLastSet(count);
+    *fl = last_set - kSLBits + 1;
+    *sl = (count >> (last_set - kSLBits)) ^ kSLCount;
+  }
+}
+
+// static
+void ShellBufferAllocator::MappingSearch(uint32 count, int* fl, int* sl) {
+  // round up to the next list so that any block in it is large enough
+  if (count >= static_cast<uint32>(kSLCount)) {
+    uint32 round = (1 << (FindLastSet(count) - kSLBits)) - 1;
+    if (count <= kNone - round) {
+      count += round;
+    }
+  }
+  MappingInsert(count, fl, sl);
+}
+
+uint32 ShellBufferAllocator::FindFreeBlock(uint32 count) const {
+  int fl, sl;
+  MappingSearch(count, &fl, &sl);
+  if (fl < kFLCount) {
+    uint32 sl_map = sl_bitmap_[fl] & (~0u << sl);
+    if (!sl_map) {
+      uint32 fl_map = fl + 1 < kFLCount ? fl_bitmap_ & (~0u << (fl + 1)) : 0;
+      if (fl_map) {
+        fl = FindFirstSet(fl_map);
+        sl_map = sl_bitmap_[fl];
+      }
+    }
+    if (sl_map) {
+      return free_heads_[fl][FindFirstSet(sl_map)];
+    }
+  }
+  // Rounding up can skip a list that holds a block big enough for us. Rather
+  // than fail we look through that one list.
+  MappingInsert(count, &fl, &sl);
+  for (uint32 block = free_heads_[fl][sl]; block != kNone;
+       block = block_next_[block]) {
+    if (block_size_[block] >= count) {
+      return block;
+    }
+  }
+  return kNone;
+}
+
+void ShellBufferAllocator::InsertFreeBlock(uint32 block) {
+  int fl, sl;
+  MappingInsert(block_size_[block], &fl, &sl);
+  uint32 head = free_heads_[fl][sl];
+  block_prev_[block] = kNone;
+  block_next_[block] = head;
+  if (head != kNone) {
+    block_prev_[head] = block;
+  }
+  free_heads_[fl][sl] = block;
+  fl_bitmap_ |= 1 << fl;
+  sl_bitmap_[fl] |= 1 << sl;
+  if (largest_free_valid_) {
+    if (block_size_[block] > largest_free_) {
+      largest_free_ = block_size_[block];
+      largest_free_count_ = 1;
+    } else if (block_size_[block] == largest_free_) {
+      ++largest_free_count_;
+    }
+  }
+}
+
+void ShellBufferAllocator::RemoveFreeBlock(uint32 block) {
+  int fl, sl;
+  MappingInsert(block_size_[block], &fl, &sl);
+  // Once the last block of the largest size is gone, finding the next
+  // largest is left to the next GetLargestFreeSpace().
+  if (largest_free_valid_ && block_size_[block] == largest_free_) {
+    DCHECK_GT(largest_free_count_, 0U);
+    if (--largest_free_count_ == 0) {
+      largest_free_valid_ = false;
+    }
+  }
+  uint32 next = block_next_[block];
+  uint32 prev = block_prev_[block];
+  if (next != kNone) {
+    block_prev_[next] = prev;
+  }
+  if (prev != kNone) {
+    block_next_[prev] = next;
+  } else {
+    DCHECK_EQ(free_heads_[fl][sl], block);
+    free_heads_[fl][sl] = next;
+    if (next == kNone) {
+      sl_bitmap_[fl] &= ~(1 << sl);
+      if (!sl_bitmap_[fl]) {
+        fl_bitmap_ &= ~(1 << fl);
+      }
+    }
+  }
+  block_next_[block] = kNone;
+  block_prev_[block] = kNone;
+}
+
+uint32 ShellBufferAllocator::AllocateGranules(uint32 count) {
+  uint32 block = FindFreeBlock(count);
+  if (block == kNone) {
+    return kNone;
+  }
+  RemoveFreeBlock(block);
+  uint32 block_size = block_size_[block];
+  DCHECK_GE(block_size, count);
+  // return the tail of the block to the free lists
+  if (block_size > count) {
+    uint32 remainder = block + count;
+    block_size_[remainder] = block_size - count;
+    block_prev_phys_[remainder] = block;
+    block_flags_[remainder] = kBlockFree;
+    uint32 next_phys = block + block_size;
+    if (next_phys < granule_count_) {
+      block_prev_phys_[next_phys] = remainder;
+    }
+    InsertFreeBlock(remainder);
+    block_size_[block] = count;
+  }
+  block_flags_[block] = 0;
+  return block;
+}
+
+void ShellBufferAllocator::FreeGranules(uint32 block) {
+  // merge with the following block if it's free
+  uint32 next_phys = block + block_size_[block];
+  if (next_phys < granule_count_ && (block_flags_[next_phys] & kBlockFree)) {
+    RemoveFreeBlock(next_phys);
+    block_size_[block] += block_size_[next_phys];
+    block_flags_[next_phys] = 0;
+  }
+  // and with the preceding block if it's free
+  uint32 prev_phys = block_prev_phys_[block];
+  if (prev_phys != kNone && (block_flags_[prev_phys] & kBlockFree)) {
+    RemoveFreeBlock(prev_phys);
+    block_size_[prev_phys] += block_size_[block];
+    block_flags_[block] = 0;
+    block = prev_phys;
+  }
+  next_phys = block + block_size_[block];
+  if (next_phys < granule_count_) {
+    block_prev_phys_[next_phys] = block;
+  }
+  block_flags_[block] = kBlockFree;
+  InsertFreeBlock(block);
+}
+
+int ShellBufferAllocator::SlabClassForSize(size_t size) const {
+  for (int i = 0; i < kSlabClassCount; ++i) {
+    if (size <= slab_object_size_[i]) {
+      // don't bother with classes that fit only one object in a slab
+      return slab_object_count_[i] > 1 ? i : -1;
+    }
+  }
+  return -1;
+}
+
+uint8* ShellBufferAllocator::AllocateFromSlab(int slab_class) {
+  uint32 slab = partial_slabs_[slab_class];
+  if (slab == kNone) {
+    uint32 slab_granules = static_cast<uint32>(kSlabSize / kGranuleSize);
+    slab = AllocateGranules(slab_granules);
+    if (slab == kNone) {
+      return NULL;
+    }
+    block_flags_[slab] = kBlockSlab;
+    slab_class_[slab] = slab_class;
+    slab_free_count_[slab] = slab_object_count_[slab_class];
+    slab_unused_[slab] = slab_object_count_[slab_class];
+    slab_free_head_[slab] = kNone;
+    for (uint32 i = 0; i < slab_granules; ++i) {
+      granule_slab_[slab + i] = slab;
+    }
+    LinkSlab(slab);
+  }
+
+  size_t object_size = slab_object_size_[slab_class];
+  uint8* slab_address = GranuleAddress(slab);
+  uint32 object = slab_free_head_[slab];
+  if (object != kNone) {
+    slab_free_head_[slab] =
+        *reinterpret_cast<uint32*>(slab_address + object * object_size);
+  } else {
+    DCHECK_GT(slab_unused_[slab], 0);
+    object = slab_object_count_[slab_class] - slab_unused_[slab];
+    --slab_unused_[slab];
+  }
+  DCHECK_GT(slab_free_count_[slab], 0);
+  if (--slab_free_count_[slab] == 0) {
+    UnlinkSlab(slab);
+  }
+  return slab_address + object * object_size;
+}
+
+void ShellBufferAllocator::FreeToSlab(uint32 slab, uint8* p) {
+  int slab_class = slab_class_[slab];
+  size_t object_size = slab_object_size_[slab_class];
+  size_t offset = p - GranuleAddress(slab);
+  DCHECK_EQ(offset % object_size, 0U) << "freeing unallocated address";
+  uint32 object = static_cast<uint32>(offset / object_size);
+  DCHECK(!IsFreeSlabObject(slab, object)) << "double free";
+
+  *reinterpret_cast<uint32*>(p) = slab_free_head_[slab];
+  slab_free_head_[slab] = object;
+  if (slab_free_count_[slab]++ == 0) {
+    LinkSlab(slab);
+  }
+
+  // Return empty slabs to the TLSF allocator right away, so that a slab left
+  // behind in the middle of the pool can't pin down the memory around it.
+  if (slab_free_count_[slab] == slab_object_count_[slab_class]) {
+    UnlinkSlab(slab);
+    uint32 slab_granules = static_cast<uint32>(kSlabSize / kGranuleSize);
+    for (uint32 i = 0; i < slab_granules; ++i) {
+      granule_slab_[slab + i] = kNone;
+    }
+    FreeGranules(slab);
+  }
+}
+
+bool ShellBufferAllocator::IsFreeSlabObject(uint32 slab,
+                                            uint32 object) const {
+  int slab_class = slab_class_[slab];
+  if (object >= slab_object_count_[slab_class] - slab_unused_[slab]) {
+    return true;
+  }
+  size_t object_size = slab_object_size_[slab_class];
+  const uint8* slab_address = GranuleAddress(slab);
+  for (uint32 free_object = slab_free_head_[slab]; free_object != kNone;
+       free_object = *reinterpret_cast<const uint32*>(
+           slab_address + free_object * object_size)) {
+    if (free_object == object) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ShellBufferAllocator::LinkSlab(uint32 slab) {
+  int slab_class = slab_class_[slab];
+  uint32 head = partial_slabs_[slab_class];
+  block_prev_[slab] = kNone;
+  block_next_[slab] = head;
+  if (head != kNone) {
+    block_prev_[head] = slab;
+  }
+  partial_slabs_[slab_class] = slab;
+}
+
+void ShellBufferAllocator::UnlinkSlab(uint32 slab) {
+  uint32 next = block_next_[slab];
+  uint32 prev = block_prev_[slab];
+  if (next != kNone) {
+    block_prev_[next] = prev;
+  }
+  if (prev != kNone) {
+    block_next_[prev] = next;
+  } else {
+    DCHECK_EQ(partial_slabs_[slab_class_[slab]], slab);
+    partial_slabs_[slab_class_[slab]] = next;
+  }
+  block_next_[slab] = kNone;
+  block_prev_[slab] = kNone;
+}
+
+}  // namespace media
@@ -0,0 +1,155 @@
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_BASE_SHELL_BUFFER_ALLOCATOR_H_
+#define MEDIA_BASE_SHELL_BUFFER_ALLOCATOR_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+// Carves up the media memory pool on behalf of ShellBufferFactory.
+//
+// Small allocations, which are mostly audio AUs of near-uniform size, are
+// served from slabs of equally-sized objects, one set of slabs per size class.
+// Everything else comes from a two-level segregated fit (TLSF) allocator,
+// which finds a free block and coalesces freed blocks with their neighbors in
+// constant time, and whose good-fit policy keeps fragmentation low over long
+// sessions. The TLSF allocator works in granules of kGranuleSize bytes and the
+// slabs themselves are allocated from it.
+//
+// All bookkeeping lives either in arrays sized at construction or, for the
+// slab free lists, in the free objects themselves, so neither allocation nor
+// free touch the heap. This class is not thread safe, ShellBufferFactory
+// serializes access to it with its own lock.
+class MEDIA_EXPORT ShellBufferAllocator {
+ public:
+  static const size_t kGranuleSize = 4 * 1024;
+  static const size_t kSlabSize = 64 * 1024;
+  static const size_t kMinSlabObjectSize = 256;
+  static const int kSlabClassCount = 8;
+
+  // All addresses returned are aligned to |alignment|, which must be a power
+  // of two no larger than kGranuleSize, as must be |pool|.
+  ShellBufferAllocator(uint8* pool, size_t pool_size, size_t alignment);
+  ~ShellBufferAllocator();
+
+  // Returns NULL if there is currently no room for an allocation of |size|.
+  uint8* Allocate(size_t size);
+  // |p| must have been returned by Allocate() and not yet freed.
+  void Free(uint8* p);
+  // Returns true if Allocate(size) would currently succeed.
+  bool CanAllocate(size_t size) const;
+
+  // Returns the number of bytes reserved for the allocation at |p|.
+  size_t GetAllocationSize(const uint8* p) const;
+  // Returns the size of the largest allocation that could be made right now.
+  // This is usually a cached value, the free list holding the largest blocks
+  // is only searched again after the last block of that size was allocated
+  // from.
+  size_t GetLargestFreeSpace() const;
+  size_t GetAllocationCount() const { return allocation_count_; }
+
+ private:
+  static const uint32 kNone = 0xffffffff;
+  // Second level of the TLSF index splits each power of two range in to
+  // 2^kSLBits lists.
+  static const int kSLBits = 3;
+  static const int kSLCount = 1 << kSLBits;
+  static const int kFLCount = 32;
+
+  // ==== TLSF, all sizes and addresses in granules
+  uint32 AllocateGranules(uint32 count);
+  void FreeGranules(uint32 block);
+  // Returns the head of a free list with blocks of at least |count| granules,
+  // or kNone.
+  uint32 FindFreeBlock(uint32 count) const;
+  void InsertFreeBlock(uint32 block);
+  void RemoveFreeBlock(uint32 block);
+  static void MappingInsert(uint32 count, int* fl, int* sl);
+  static void MappingSearch(uint32 count, int* fl, int* sl);
+
+  // ==== slabs
+  // Returns the slab class for size, or -1 if it's too large for a slab.
+  int SlabClassForSize(size_t size) const;
+  uint8* AllocateFromSlab(int slab_class);
+  void FreeToSlab(uint32 slab, uint8* p);
+  // Returns true if |object| of |slab| is on its free list or was never
+  // handed out. Walks the free list, so it's only meant for DCHECKs.
+  bool IsFreeSlabObject(uint32 slab, uint32 object) const;
+  void LinkSlab(uint32 slab);
+  void UnlinkSlab(uint32 slab);
+
+  uint8* GranuleAddress(uint32 granule) const {
+    return pool_ + (static_cast<size_t>(granule) * kGranuleSize);
+  }
+  uint32 GranuleIndex(const uint8* p) const {
+    return static_cast<uint32>((p - pool_) / kGranuleSize);
+  }
+
+  uint8* pool_;
+  uint32 granule_count_;
+  size_t allocation_count_;
+
+  // TLSF free list heads and the bitmaps of which ones are non-empty.
+  uint32 fl_bitmap_;
+  uint32 sl_bitmap_[kFLCount];
+  uint32 free_heads_[kFLCount][kSLCount];
+  // Size in granules of the largest free block and how many free blocks
+  // have that size, only meaningful while largest_free_valid_ is set.
+  // Inserting a free block keeps them up to date, removing the last block of
+  // that size invalidates them.
+  mutable uint32 largest_free_;
+  mutable uint32 largest_free_count_;
+  mutable bool largest_free_valid_;
+
+  // Per-granule arrays, only meaningful at the first granule of a block.
+  enum BlockFlags {
+    kBlockFree = 1 << 0,
+    kBlockSlab = 1 << 1,
+  };
+  std::vector<uint32> block_size_;
+  std::vector<uint32> block_prev_phys_;
+  std::vector<uint8> block_flags_;
+  // Doubly-linked list pointers: the TLSF free list for free blocks, or the
+  // list of partially full slabs of the same class for slabs.
+  std::vector<uint32> block_next_;
+  std::vector<uint32> block_prev_;
+  // For every granule within a slab, the first granule of that slab.
+  std::vector<uint32> granule_slab_;
+
+  // Per-slab state, indexed by first granule of the slab. Free objects form
+  // a singly linked list threaded through the first 4 bytes of each object,
+  // and objects never handed out yet are claimed from slab_unused_.
+  std::vector<uint8> slab_class_;
+  std::vector<uint16> slab_free_count_;
+  std::vector<uint16> slab_unused_;
+  std::vector<uint32> slab_free_head_;
+
+  size_t slab_object_size_[kSlabClassCount];
+  uint32 slab_object_count_[kSlabClassCount];
+  // head of the list of slabs of each class with at least one free object
+  uint32 partial_slabs_[kSlabClassCount];
+
+  DISALLOW_COPY_AND_ASSIGN(ShellBufferAllocator);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_BASE_SHELL_BUFFER_ALLOCATOR_H_
@@ -0,0 +1,237 @@
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/base/shell_buffer_allocator.h"
+
+#include <malloc.h>  // for memalign
+#include <stdlib.h>
+
+#include <iterator>
+#include <map>
+
+#include "base/logging.h"
+#include "base/memory/scoped_ptr.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const size_t kPoolSize = 16 * 1024 * 1024;
+static const size_t kAlignment = 16;
+
+class ShellBufferAllocatorTest : public testing::Test {
+ protected:
+  ShellBufferAllocatorTest() {
+    pool_ = static_cast<uint8*>(memalign(kAlignment, kPoolSize));
+    allocator_.reset(new ShellBufferAllocator(pool_, kPoolSize, kAlignment));
+  }
+
+  virtual ~ShellBufferAllocatorTest() {
+    allocator_.reset();
+    free(pool_);
+  }
+
+  // allocate and check the new allocation against all live allocations
+  uint8* AllocateAndCheck(size_t size) {
+    bool can_allocate = allocator_->CanAllocate(size);
+    uint8* p = allocator_->Allocate(size);
+    EXPECT_EQ(can_allocate, p != NULL);
+    if (!p) {
+      return NULL;
+    }
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % kAlignment, 0U);
+    EXPECT_GE(p, pool_);
+    EXPECT_LE(p + size, pool_ + kPoolSize);
+    EXPECT_GE(allocator_->GetAllocationSize(p), size);
+    AllocMap::iterator next = live_.lower_bound(p);
+    if (next != live_.end()) {
+      EXPECT_LE(p + size, next->first);
+    }
+    if (next != live_.begin()) {
+      --next;
+      EXPECT_LE(next->first + next->second, p);
+    }
+    live_[p] = size;
+    return p;
+  }
+
+  // The cached largest free block must be one we can allocate, and nothing
+  // a granule larger may fit. Sizes that small slabs could serve are skipped.
+  void CheckLargestFreeSpace() {
+    size_t largest = allocator_->GetLargestFreeSpace();
+    if (largest) {
+      EXPECT_TRUE(allocator_->CanAllocate(largest));
+    }
+    if (largest >= ShellBufferAllocator::kSlabSize / 2) {
+      EXPECT_FALSE(allocator_->CanAllocate(
+          largest + ShellBufferAllocator::kGranuleSize));
+    }
+  }
+
+  void Free(uint8* p) {
+    live_.erase(p);
+    allocator_->Free(p);
+  }
+
+  void FreeAll() {
+    for (AllocMap::iterator it = live_.begin(); it != live_.end(); ++it) {
+      allocator_->Free(it->first);
+    }
+    live_.clear();
+  }
+
+  typedef std::map<uint8*, size_t> AllocMap;
+  AllocMap live_;
+  uint8* pool_;
+  scoped_ptr<ShellBufferAllocator> allocator_;
+};
+
+TEST_F(ShellBufferAllocatorTest, EmptyPoolIsOneFreeBlock) {
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), kPoolSize);
+  EXPECT_EQ(allocator_->GetAllocationCount(), 0U);
+  EXPECT_FALSE(allocator_->CanAllocate(0));
+  EXPECT_FALSE(allocator_->CanAllocate(kPoolSize + 1));
+  EXPECT_TRUE(allocator_->CanAllocate(kPoolSize));
+}
+
+TEST_F(ShellBufferAllocatorTest, WholePool) {
+  uint8* p = AllocateAndCheck(kPoolSize);
+  ASSERT_TRUE(p);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 0U);
+  EXPECT_FALSE(allocator_->Allocate(1));
+  Free(p);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), kPoolSize);
+}
+
+TEST_F(ShellBufferAllocatorTest, SmallAllocationsShareSlabs) {
+  // a full slab worth of audio-sized allocations takes one slab from the pool
+  size_t count = ShellBufferAllocator::kSlabSize / 512;
+  for (size_t i = 0; i < count; ++i) {
+    ASSERT_TRUE(AllocateAndCheck(400 + i % 100));
+  }
+  EXPECT_EQ(allocator_->GetAllocationCount(), count);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(),
+            kPoolSize - ShellBufferAllocator::kSlabSize);
+  FreeAll();
+  // the empty slab is handed back
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), kPoolSize);
+}
+
+TEST_F(ShellBufferAllocatorTest, NeighborsCoalesce) {
+  uint8* a = AllocateAndCheck(100 * 1024);
+  uint8* b = AllocateAndCheck(200 * 1024);
+  uint8* c = AllocateAndCheck(300 * 1024);
+  ASSERT_TRUE(a && b && c);
+  Free(a);
+  Free(c);
+  Free(b);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), kPoolSize);
+  EXPECT_EQ(allocator_->GetAllocationCount(), 0U);
+}
+
+TEST_F(ShellBufferAllocatorTest, RandomMixedSizes) {
+  srand(0x5eed);
+  for (int i = 0; i < 200000; ++i) {
+    if (live_.empty() || (live_.size() < 500 && rand() % 2)) {
+      // mostly audio-sized allocations with some large video frames
+      size_t size = rand() % 3 ? 100 + rand() % 700 : 1000 + rand() % 300000;
+      AllocateAndCheck(size);
+    } else {
+      AllocMap::iterator it = live_.begin();
+      std::advance(it, rand() % live_.size());
+      Free(it->first);
+    }
+    if (i % 100 == 0) {
+      CheckLargestFreeSpace();
+    }
+  }
+  EXPECT_EQ(allocator_->GetAllocationCount(), live_.size());
+  FreeAll();
+  EXPECT_EQ(allocator_->GetAllocationCount(), 0U);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), kPoolSize);
+}
+
+TEST_F(ShellBufferAllocatorTest, LargestFreeSpaceFollowsTheLargestBlock) {
+  const size_t kBlock = 1024 * 1024;
+  // Three free blocks of 1, 2 and 3MB separated by allocations, then the rest
+  // of the pool.
+  uint8* a = AllocateAndCheck(kBlock);
+  uint8* fence_a = AllocateAndCheck(kBlock);
+  uint8* b = AllocateAndCheck(2 * kBlock);
+  uint8* fence_b = AllocateAndCheck(kBlock);
+  uint8* c = AllocateAndCheck(3 * kBlock);
+  uint8* rest = AllocateAndCheck(kPoolSize - 8 * kBlock);
+  ASSERT_TRUE(a && fence_a && b && fence_b && c && rest);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 0U);
+  Free(b);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 2 * kBlock);
+  Free(a);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 2 * kBlock);
+  Free(c);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 3 * kBlock);
+
+  // Allocating from the largest block leaves the next largest one.
+  uint8* from_c = AllocateAndCheck(3 * kBlock);
+  ASSERT_EQ(from_c, c);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 2 * kBlock);
+  uint8* from_b = AllocateAndCheck(kBlock + 1);
+  ASSERT_EQ(from_b, b);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), kBlock);
+  CheckLargestFreeSpace();
+
+  // Freeing a neighbor grows the free block it merges with.
+  Free(fence_a);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 2 * kBlock);
+  CheckLargestFreeSpace();
+}
+
+TEST_F(ShellBufferAllocatorTest, LargestFreeSpaceCountsBlocksOfThatSize) {
+  const size_t kBlock = 1024 * 1024;
+  // Two free 2MB blocks and a 1MB one, with the rest of the pool in use.
+  uint8* a = AllocateAndCheck(2 * kBlock);
+  uint8* fence_a = AllocateAndCheck(kBlock);
+  uint8* b = AllocateAndCheck(2 * kBlock);
+  uint8* fence_b = AllocateAndCheck(kBlock);
+  uint8* c = AllocateAndCheck(kBlock);
+  uint8* rest = AllocateAndCheck(kPoolSize - 7 * kBlock);
+  ASSERT_TRUE(a && fence_a && b && fence_b && c && rest);
+  Free(a);
+  Free(b);
+  Free(c);
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 2 * kBlock);
+
+  // Taking one of the two leaves the other.
+  ASSERT_TRUE(AllocateAndCheck(2 * kBlock));
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), 2 * kBlock);
+  ASSERT_TRUE(AllocateAndCheck(2 * kBlock));
+  EXPECT_EQ(allocator_->GetLargestFreeSpace(), kBlock);
+  CheckLargestFreeSpace();
+}
+
+#if GTEST_HAS_DEATH_TEST
+TEST_F(ShellBufferAllocatorTest, SlabDoubleFree) {
+  uint8* first = AllocateAndCheck(ShellBufferAllocator::kMinSlabObjectSize);
+  uint8* second = AllocateAndCheck(ShellBufferAllocator::kMinSlabObjectSize);
+  ASSERT_TRUE(first && second);
+  Free(first);
+  EXPECT_DEBUG_DEATH(allocator_->Free(first), "double free");
+  // An object of the slab that was never handed out.
+  EXPECT_DEBUG_DEATH(
+      allocator_->Free(second + ShellBufferAllocator::kMinSlabObjectSize),
+      "double free");
+}
+#endif
+
+}  // namespace media
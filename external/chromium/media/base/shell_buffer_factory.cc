@@ -25,17 +25,6 @@
 #include "media/base/shell_media_platform.h"
 #include "media/base/shell_media_statistics.h"
 
-namespace {
-
-// Returns the provided size aligned to kShellBufferAlignment.
-static inline size_t SizeAlign(size_t size) {
-  size_t align =
-      media::ShellMediaPlatform::Instance()->GetShellBufferSpaceAlignment();
-  return ((size + align - 1) / align) * align;
-}
-
-}  // namespace
-
 namespace media {
 
 // ==== ShellScopedArray =======================================================
@@ -70,6 +59,19 @@ scoped_refptr<ShellBuffer> ShellBuffer::CreateEOSBuffer(
  return eos;
 }
 
+// static
+scoped_refptr<ShellBuffer> ShellBuffer::CreateSlice(
+    const scoped_refptr<ShellBuffer>& region, size_t offset, size_t size) {
+  DCHECK(region);
+  DCHECK(!region->IsEndOfStream());
+  DCHECK(!region->region_) << "slices of slices are not supported";
+  CHECK_LE(offset + size, static_cast<size_t>(region->GetAllocatedSize()));
+  scoped_refptr<ShellBuffer> slice =
+      new ShellBuffer(region->GetWritableData() + offset, size);
+  slice->region_ = region;
+  return slice;
+}
+
 void ShellBuffer::ShrinkTo(int size) {
   CHECK_LE(size, GetAllocatedSize());
   size_ = size;
@@ -90,8 +92,9 @@ ShellBuffer::ShellBuffer(uint8* reusable_buffer,
 }
 
 ShellBuffer::~ShellBuffer() {
-  // recycle our buffer
-  if (buffer_) {
+  // recycle our buffer, unless it is a slice of a region buffer, in which case
+  // the memory is recycled when the region is.
+  if (buffer_ && !region_) {
     TRACE_EVENT1("media_stack", "ShellBuffer::~ShellBuffer()",
                  "timestamp", GetTimestamp().InMicroseconds());
     DCHECK_NE(buffer_factory_, (ShellBufferFactory*)NULL);
@@ -122,6 +125,12 @@ void ShellBuffer::SetBuffer(uint8* reusable_buffer) {
 
 scoped_refptr<ShellBufferFactory> ShellBufferFactory::instance_ = NULL;
 
+// static
+size_t ShellBufferFactory::SizeAlign(size_t size) {
+  size_t align = ShellMediaPlatform::Instance()->GetShellBufferSpaceAlignment();
+  return ((size + align - 1) / align) * align;
+}
+
 // static
 void ShellBufferFactory::Initialize() {
   // safe to call multiple times
@@ -151,11 +160,12 @@ bool ShellBufferFactory::AllocateBuffer(
     base::AutoLock lock(lock_);
     // We only service requests directly if there's no callbacks pending and
     // we can accommodate a buffer of the requested size
-    uint8* shell_buffer_bytes;
-    if (pending_allocs_.size() == 0 &&
-        aligned_size <= LargestFreeSpace_Locked()) {
-      instant_buffer = new ShellBuffer(AllocateLockAcquired(aligned_size),
-                                       size);
+    uint8* shell_buffer_bytes = NULL;
+    if (pending_allocs_.size() == 0) {
+      shell_buffer_bytes = AllocateLockAcquired(aligned_size);
+    }
+    if (shell_buffer_bytes) {
+      instant_buffer = new ShellBuffer(shell_buffer_bytes, size);
       TRACE_EVENT0("media_stack",
                    "ShellBufferFactory::AllocateBuffer() finished allocation.");
       DCHECK(!instant_buffer->IsEndOfStream());
@@ -177,7 +187,12 @@ bool ShellBufferFactory::AllocateBuffer(
 
 bool ShellBufferFactory::HasRoomForBufferNow(size_t size) {
   base::AutoLock lock(lock_);
-  return (SizeAlign(size) <= LargestFreeSpace_Locked());
+  return allocator_.CanAllocate(SizeAlign(size));
+}
+
+size_t ShellBufferFactory::GetLargestFreeSpace() {
+  base::AutoLock lock(lock_);
+  return LargestFreeSpace_Locked();
 }
 
 scoped_refptr<ShellBuffer> ShellBufferFactory::AllocateBufferNow(size_t size) {
@@ -192,13 +207,13 @@ scoped_refptr<ShellBuffer> ShellBufferFactory::AllocateBufferNow(size_t size) {
   }
   size_t aligned_size = SizeAlign(size);
   base::AutoLock lock(lock_);
-  if (aligned_size > LargestFreeSpace_Locked()) {
+  uint8* bytes = AllocateLockAcquired(aligned_size);
+  if (!bytes) {
     TRACE_EVENT0("media_stack",
         "ShellBufferFactory::AllocateBufferNow() failed as size is too large.");
     return NULL;
   }
-  scoped_refptr<ShellBuffer> buffer =
-      new ShellBuffer(AllocateLockAcquired(aligned_size), size);
+  scoped_refptr<ShellBuffer> buffer = new ShellBuffer(bytes, size);
   TRACE_EVENT0("media_stack",
                "ShellBufferFactory::AllocateBufferNow() finished allocation.");
   DCHECK(!buffer->IsEndOfStream());
@@ -212,10 +227,7 @@ uint8* ShellBufferFactory::AllocateNow(size_t size) {
   // we skip to the head of the line for these allocations, if there's
   // room we allocate it.
   base::AutoLock lock(lock_);
-  if (aligned_size <= LargestFreeSpace_Locked()) {
-    bytes = AllocateLockAcquired(aligned_size);
-    DCHECK(bytes);
-  }
+  bytes = AllocateLockAcquired(aligned_size);
 
   if (!bytes) {
     DLOG(ERROR) << base::StringPrintf("Failed to allocate %d bytes!",
@@ -290,74 +302,20 @@ void ShellBufferFactory::Reclaim(uint8* p) {
   // Reclaim() on a NULL buffer is a no-op, don't even acquire the lock.
   if (p) {
     base::AutoLock lock(lock_);
-    AllocMap::iterator p_it = allocs_.find(p);
-    // sanity-check that this offset is indeed in the map
-    if (p_it == allocs_.end()) {
+    // sanity-check that this address is indeed within our pool
+    if (p < buffer_ ||
+        p >= buffer_ +
+            ShellMediaPlatform::Instance()->GetShellBufferSpaceSize()) {
       NOTREACHED();
       return;
     }
 #if defined(_DEBUG)
     // scribble recycled memory in debug builds with 0xef
-    memset(p, 0xef, p_it->second);
+    memset(p, 0xef, allocator_.GetAllocationSize(p));
 #endif
-    // We need to remove this address,size pair from the alloc map, but before
-    // doing so, we examine to the left (lower address) and right (higher addy)
-    // to see if there are holes there that can be merged into this hole.
-    AllocMap::iterator alloc_left = p_it;
-    uint8* hole_addr = NULL;
-    size_t left_hole_size = 0;
-    if (alloc_left != allocs_.begin()) {
-      // decrement to point to the previous alloc in the alloc map
-      alloc_left--;
-      // if there is a hole before this alloc we are freeing, it will start at
-      // the end of the left allocation and will end at the freed alloc
-      hole_addr = alloc_left->first + alloc_left->second;
-      left_hole_size = p - hole_addr;
-    } else {
-      // this was the first alloc in the map, so if there's a hole it will start
-      // at buffer_ and will have size as distance of this alloc from buffer_
-      hole_addr = buffer_;
-      left_hole_size = p - buffer_;
-    }
-    // if there was a hole to our left we must find the size,addr pair with
-    // value of the address of that hole, to replace it with an expanded hole
-    // welded to the memory we are reclaiming.
-    if (left_hole_size) {
-      FillHole_Locked(left_hole_size, hole_addr);
-    } else {
-      // in the case of a contiguous allocation to the left, meaning no hole,
-      // hole_addr should point at the buffer being freed
-      DCHECK_EQ(hole_addr, p);
-    }
-    // now we check the allocation to our right, to see if there was a hole there
-    // that we could also erase
-    AllocMap::iterator alloc_right = p_it;
-    alloc_right++;
-    size_t right_hole_size = 0;
-    uint8* right_hole_addr = p_it->first + p_it->second;
-    // this could have been the last allocation in the map
-    if (alloc_right != allocs_.end()) {
-      // size of right hole is distance between start of the next alloc and
-      // end of this alloc.
-      right_hole_size = alloc_right->first - right_hole_addr;
-    } else {
-      // size of right hole is distance between end of the whole buffer_ and
-      // the end of this alloc
-      right_hole_size = buffer_ +
-          ShellMediaPlatform::Instance()->GetShellBufferSpaceSize() -
-          right_hole_addr;
-    }
-    // if there was a hole to our right we remove it from the map and add its
-    // size to the final hole
-    if (right_hole_size) {
-      FillHole_Locked(right_hole_size, right_hole_addr);
-    }
-    // create a hole potentially merging left and right holes if there
-    holes_.insert(
-        std::make_pair(left_hole_size + p_it->second + right_hole_size,
-                       hole_addr));
-    // finally remove freed buffer from the allocs map
-    allocs_.erase(p_it);
+    allocator_.Free(p);
+    UPDATE_MEDIA_STATISTICS(STAT_TYPE_LARGEST_FREE_SHELL_BUFFER,
+                            LargestFreeSpace_Locked());
 
     // Try to service a blocking array request if there is one, and it hasn't
     // already been serviced. If we can't service it then we won't allocate any
@@ -400,28 +358,10 @@ void ShellBufferFactory::Reclaim(uint8* p) {
   }
 }
 
-void ShellBufferFactory::FillHole_Locked(size_t size, uint8* address) {
-  lock_.AssertAcquired();
-  // do the linear search for holes of this size
-  std::pair<HoleMap::iterator, HoleMap::iterator> hole_range;
-  hole_range = holes_.equal_range(size);
-  HoleMap::iterator hole = hole_range.first;
-  for (; hole != hole_range.second; ++hole) {
-    if (hole->second == address) {
-      break;
-    }
-  }
-  DCHECK_EQ(hole->second, address);
-  holes_.erase(hole);
-}
-
 size_t ShellBufferFactory::LargestFreeSpace_Locked() const {
   // should have acquired the lock already
   lock_.AssertAcquired();
-  if (holes_.empty())
-    return 0;
-
-  return holes_.rbegin()->first;
+  return allocator_.GetLargestFreeSpace();
 }
 
 uint8* ShellBufferFactory::AllocateLockAcquired(size_t aligned_size) {
@@ -430,35 +370,15 @@ uint8* ShellBufferFactory::AllocateLockAcquired(size_t aligned_size) {
   // and should have aligned the size already
   DCHECK_EQ(aligned_size %
             ShellMediaPlatform::Instance()->GetShellBufferSpaceAlignment(), 0);
-  // Quick check that we have a reasonable expectation of fitting this size.
-  if (aligned_size > LargestFreeSpace_Locked()) {
-    return NULL;
-  }
-  // lower_bound() will return the first element >= aligned_size
-  HoleMap::iterator best_fit_hole = holes_.lower_bound(aligned_size);
-  // since we already checked that there is a hole that this can fit in, this
-  // search should have returned a result
-  if (best_fit_hole == holes_.end()) {
-    NOTREACHED();
+  uint8* bytes = allocator_.Allocate(aligned_size);
+  if (!bytes) {
     return NULL;
   }
-  // copy out values from iterator
-  uint8* best_fit_ptr = best_fit_hole->second;
-  size_t best_fit_size = best_fit_hole->first;
-  // erase hole from map
-  holes_.erase(best_fit_hole);
-  // if allocating this will create a smaller hole, insert it in to the map
-  if (best_fit_size > aligned_size) {
-    holes_.insert(
-        std::make_pair(best_fit_size - aligned_size,
-                       best_fit_ptr + aligned_size));
-  }
-  // add this allocation to our map
-  allocs_.insert(std::make_pair(best_fit_ptr, aligned_size));
+  // The largest free block is cached by the allocator, so this is cheap.
   UPDATE_MEDIA_STATISTICS(STAT_TYPE_LARGEST_FREE_SHELL_BUFFER,
                           LargestFreeSpace_Locked());
   UPDATE_MEDIA_STATISTICS(STAT_TYPE_ALLOCATED_SHELL_BUFFER_SIZE, aligned_size);
-  return best_fit_ptr;
+  return bytes;
 }
 
 // static
@@ -467,23 +387,23 @@ void ShellBufferFactory::Terminate() {
 }
 
 ShellBufferFactory::ShellBufferFactory()
-    : array_allocation_event_(false, false)
+    : buffer_(ShellMediaPlatform::Instance()->GetShellBufferSpace())
+    , allocator_(buffer_,
+                 ShellMediaPlatform::Instance()->GetShellBufferSpaceSize(),
+                 ShellMediaPlatform::Instance()->GetShellBufferSpaceAlignment())
+    , array_allocation_event_(false, false)
     , array_requested_size_(0)
     , array_allocation_(NULL) {
-  buffer_ = ShellMediaPlatform::Instance()->GetShellBufferSpace();
-  // save the entirety of the available memory as a hole
-  holes_.insert(std::make_pair(
-      ShellMediaPlatform::Instance()->GetShellBufferSpaceSize(), buffer_));
 }
 
 // Will be called when all ShellBuffers have been deleted AND instance_ has
 // been set to NULL.
 ShellBufferFactory::~ShellBufferFactory() {
-  // should be nothing remaining in the alloc_ map
-  if (allocs_.size()) {
+  // should be no allocations remaining
+  if (allocator_.GetAllocationCount()) {
     DLOG(WARNING) << base::StringPrintf(
         "%d unfreed allocs on termination now pointing at invalid memory!",
-        static_cast<int>(allocs_.size()));
+        static_cast<int>(allocator_.GetAllocationCount()));
   }
   // and no outstanding array requests
   DCHECK_EQ(array_requested_size_, 0);
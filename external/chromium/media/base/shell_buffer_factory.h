@@ -18,7 +18,6 @@
 #define MEDIA_BASE_SHELL_BUFFER_FACTORY_H_
 
 #include <list>
-#include <map>
 
 #include "base/callback.h"
 #include "base/memory/ref_counted.h"
@@ -26,6 +25,7 @@
 #include "base/synchronization/waitable_event.h"
 #include "lb_shell/lb_shell_constants.h"
 #include "media/base/buffers.h"
+#include "media/base/shell_buffer_allocator.h"
 
 namespace media {
 
@@ -66,6 +66,14 @@ class MEDIA_EXPORT ShellBuffer : public Buffer {
   static scoped_refptr<ShellBuffer> CreateEOSBuffer(
       base::TimeDelta timestamp);
 
+  // Create a ShellBuffer that refers to |size| bytes starting |offset| bytes
+  // in to the memory of |region|. The slice keeps |region| alive, so the
+  // memory of the region is only returned to the ShellBufferFactory once the
+  // region and all of its slices have been released. Used by the demuxer to
+  // download several AUs with a single allocation.
+  static scoped_refptr<ShellBuffer> CreateSlice(
+      const scoped_refptr<ShellBuffer>& region, size_t offset, size_t size);
+
   // Buffer implementation.
   virtual const uint8* GetData() const OVERRIDE { return buffer_; }
   // Data size can be less than allocated size after ShrinkTo is called.
@@ -100,6 +108,8 @@ class MEDIA_EXPORT ShellBuffer : public Buffer {
   size_t size_;
   size_t allocated_size_;
   scoped_refptr<ShellBufferFactory> buffer_factory_;
+  // non-NULL if this buffer is a slice of another buffer, which owns memory.
+  scoped_refptr<ShellBuffer> region_;
   scoped_ptr<DecryptConfig> decrypt_config_;
   bool is_decrypted_;
 
@@ -120,6 +130,10 @@ class MEDIA_EXPORT ShellBufferFactory
     return instance_;
   }
 
+  // Returns the provided size aligned to the ShellBuffer alignment, which is
+  // how much of the pool a buffer of that size takes.
+  static size_t SizeAlign(size_t size);
+
   typedef base::Callback<void(scoped_refptr<ShellBuffer>)> AllocCB;
   // Returns false if the allocator will never be able to allocate a buffer
   // of the requested size. Note that if memory is currently available this
@@ -128,6 +142,8 @@ class MEDIA_EXPORT ShellBufferFactory
   // Returns true if a ShellBuffer of this size could be allocated without
   // waiting for some other buffer to be released.
   bool HasRoomForBufferNow(size_t size);
+  // Returns the size of the largest buffer that could be allocated now.
+  size_t GetLargestFreeSpace();
   // This function tries to allocate a ShellBuffer immediately. It returns NULL
   // on failure.
   scoped_refptr<ShellBuffer> AllocateBufferNow(size_t size);
@@ -155,9 +171,6 @@ class MEDIA_EXPORT ShellBufferFactory
   ~ShellBufferFactory();
   uint8* AllocateLockAcquired(size_t aligned_size);
   size_t LargestFreeSpace_Locked() const;
-  // given a size and an address, search the holes_ map for the specific
-  // instance of this pair and remove it from the map.
-  void FillHole_Locked(size_t size, uint8* address);
 
   static scoped_refptr<ShellBufferFactory> instance_;
   uint8* buffer_;
@@ -165,13 +178,8 @@ class MEDIA_EXPORT ShellBufferFactory
   // protects all following members.
   base::Lock lock_;
 
-  // sorted map of pointers within buffer_ to sizes occupied at that offset.
-  typedef std::map<uint8*, size_t> AllocMap;
-  AllocMap allocs_;
-  // sorted map of size of free spaces => pointer to that space. As there
-  // can be multiple instances of holes of the same size, it's a multimap.
-  typedef std::multimap<size_t, uint8*> HoleMap;
-  HoleMap holes_;
+  // carves buffer_ in to allocations, see ShellBufferAllocator.
+  ShellBufferAllocator allocator_;
 
   // queue of pending buffer allocation requests and their sizes
   typedef std::list<std::pair<AllocCB,
@@ -18,15 +18,40 @@
 
 #include <limits.h>  // for ULLONG_MAX
 
+#include <algorithm>
+
+#include "base/debug/trace_event.h"
+
 namespace media {
 
 const int ShellDataSourceReader::kReadError = DataSource::kReadError;
+const int ShellDataSourceReader::kMaxPendingReads;
+const int ShellDataSourceReader::kReadAheadBlockCount;
+const int ShellDataSourceReader::kReadAheadBlockSize;
+
+ShellDataSourceReader::ReadAheadBlock::ReadAheadBlock()
+    : position(0)
+    , size(0)
+    , pending(false)
+    , last_use(0) {
+}
+
+ShellDataSourceReader::ReadRequest::ReadRequest()
+    : position(0)
+    , size(0)
+    , data(NULL)
+    , bytes_read(0)
+    , block(NULL) {
+}
 
 ShellDataSourceReader::ShellDataSourceReader()
     : blocking_read_event_(false, false)
+    , last_bytes_read_(0)
+    , last_read_end_(-1)
     , file_size_(-1)
     , read_has_failed_(false)
-    , last_bytes_read_(0) {
+    , read_in_flight_(false)
+    , read_ahead_clock_(0) {
   blocking_read_cb_ = base::Bind(&ShellDataSourceReader::BlockingReadCompleted,
                                  this);
 }
@@ -41,58 +66,179 @@ void ShellDataSourceReader::SetDataSource(
 
 // currently only single-threaded reads supported
 int ShellDataSourceReader::BlockingRead(int64 position, int size, uint8 *data) {
-  // read failures are unrecoverable, all subsequent reads will also fail
-  if (read_has_failed_) {
-    return kReadError;
-  }
+  bool sequential = (position == last_read_end_);
+  int total_bytes_read = 0;
+  {
+    base::AutoLock auto_lock(lock_);
+    // read failures are unrecoverable, all subsequent reads will also fail
+    if (read_has_failed_) {
+      return kReadError;
+    }
 
-  // check bounds of read at or past EOF
-  if (file_size_ >= 0 && position >= file_size_) {
-    return 0;
-  }
+    // check bounds of read at or past EOF
+    if (file_size_ >= 0 && position >= file_size_) {
+      return 0;
+    }
 
-  int total_bytes_read = 0;
-  while (size > 0) {
-    data_source_->Read(position,
-                       size,
-                       data,
-                       blocking_read_cb_);
+    total_bytes_read = CopyFromReadAhead_Locked(position, size, data);
+    if (total_bytes_read < size) {
+      ReadRequest request;
+      request.position = position + total_bytes_read;
+      request.size = size - total_bytes_read;
+      request.data = data + total_bytes_read;
+      request.read_cb = blocking_read_cb_;
+      QueueRead_Locked(request, true);
+    }
+  }
 
+  if (total_bytes_read < size) {
+    TRACE_EVENT1("media_stack", "ShellDataSourceReader::BlockingRead()",
+                 "size", size - total_bytes_read);
+    IssueNextRead();
     // wait for callback on read completion
     blocking_read_event_.Wait();
 
-    if (last_bytes_read_ == DataSource::kReadError) {
+    DCHECK_LE(last_bytes_read_, size - total_bytes_read);
+    if (last_bytes_read_ == DataSource::kReadError ||
+        last_bytes_read_ > size - total_bytes_read) {
       // make all future reads fail
+      base::AutoLock auto_lock(lock_);
       read_has_failed_ = true;
       return kReadError;
     }
+    total_bytes_read += last_bytes_read_;
+  }
 
-    DCHECK_LE(last_bytes_read_, size);
-    if (last_bytes_read_ > size) {
-      // make all future reads fail
-      read_has_failed_ = true;
-      return kReadError;
+  last_read_end_ = position + total_bytes_read;
+  // Sequential access, like atom parsing or AU downloads within a run of
+  // chunks, is likely to continue, so start downloading what follows while
+  // the caller processes this read.
+  if (sequential && total_bytes_read == size) {
+    ReadAhead(last_read_end_, kReadAheadBlockSize);
+  }
+
+  return total_bytes_read;
+}
+
+bool ShellDataSourceReader::AsyncRead(int64 position,
+                                      int size,
+                                      uint8* data,
+                                      const AsyncReadCB& read_cb) {
+  DCHECK(!read_cb.is_null());
+  int result = 0;
+  bool queued = false;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (read_has_failed_) {
+      result = kReadError;
+    } else if (size > 0 && (file_size_ < 0 || position < file_size_)) {
+      result = CopyFromReadAhead_Locked(position, size, data);
+      if (result < size) {
+        if (static_cast<int>(pending_reads_.size()) >= kMaxPendingReads) {
+          return false;
+        }
+        ReadRequest request;
+        request.position = position + result;
+        request.size = size - result;
+        request.data = data + result;
+        request.bytes_read = result;
+        request.read_cb = read_cb;
+        QueueRead_Locked(request, false);
+        queued = true;
+      }
     }
+  }
 
-    // Avoid entering an endless loop here.
-    if (last_bytes_read_ == 0)
-      break;
+  if (queued) {
+    IssueNextRead();
+  } else {
+    read_cb.Run(result);
+  }
+  return true;
+}
 
-    total_bytes_read += last_bytes_read_;
-    position += last_bytes_read_;
-    size -= last_bytes_read_;
-    data += last_bytes_read_;
+void ShellDataSourceReader::ReadAhead(int64 position, int size) {
+  if (!data_source_ || position < 0) {
+    return;
   }
 
-  return total_bytes_read;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (read_has_failed_) {
+      return;
+    }
+    if (file_size_ >= 0) {
+      if (position >= file_size_) {
+        return;
+      }
+      size = static_cast<int>(
+          std::min(static_cast<int64>(size), file_size_ - position));
+    }
+    size = std::min(size, kReadAheadBlockSize);
+    if (size <= 0 ||
+        static_cast<int>(pending_reads_.size()) >= kMaxPendingReads ||
+        IsRangeCached_Locked(position, size)) {
+      return;
+    }
+    // replace the least recently used block that isn't being downloaded
+    ReadAheadBlock* block = NULL;
+    for (int i = 0; i < kReadAheadBlockCount; ++i) {
+      ReadAheadBlock* candidate = &read_ahead_blocks_[i];
+      if (!candidate->pending &&
+          (!block || candidate->last_use < block->last_use)) {
+        block = candidate;
+      }
+    }
+    if (!block) {
+      return;
+    }
+    if (!block->data) {
+      block->data.reset(new uint8[kReadAheadBlockSize]);
+    }
+    block->position = position;
+    block->size = 0;
+    block->pending = true;
+    block->last_use = ++read_ahead_clock_;
+
+    ReadRequest request;
+    request.position = position;
+    request.size = size;
+    request.data = block->data.get();
+    request.block = block;
+    QueueRead_Locked(request, false);
+  }
+
+  IssueNextRead();
 }
 
 void ShellDataSourceReader::Stop(const base::Closure& callback) {
+  ReadQueue cancelled_reads;
+  {
+    base::AutoLock auto_lock(lock_);
+    // subsequent reads should report as failure
+    read_has_failed_ = true;
+    // The in flight read, if any, stays at the front of the queue to receive
+    // the DataSource callback, but its callback is run now.
+    ReadQueue::iterator first_queued = pending_reads_.begin();
+    if (read_in_flight_ && first_queued != pending_reads_.end()) {
+      cancelled_reads.push_back(*first_queued);
+      first_queued->read_cb.Reset();
+      ++first_queued;
+    }
+    cancelled_reads.insert(cancelled_reads.end(), first_queued,
+                           pending_reads_.end());
+    pending_reads_.erase(first_queued, pending_reads_.end());
+    for (int i = 0; i < kReadAheadBlockCount; ++i) {
+      read_ahead_blocks_[i].size = 0;
+    }
+  }
   // 0 signals EOS or stop on unblock
-  last_bytes_read_ = 0;
-  blocking_read_event_.Signal();
-  // subsequent reads should report as failure
-  read_has_failed_ = true;
+  for (ReadQueue::iterator it = cancelled_reads.begin();
+       it != cancelled_reads.end(); ++it) {
+    if (!it->read_cb.is_null()) {
+      it->read_cb.Run(0);
+    }
+  }
   blocking_read_cb_.Reset();
   if (data_source_) {
     // stop the data source, it can call the callback
@@ -106,12 +252,187 @@ void ShellDataSourceReader::BlockingReadCompleted(int bytes_read) {
   blocking_read_event_.Signal();
 }
 
+void ShellDataSourceReader::QueueRead_Locked(const ReadRequest& request,
+                                             bool is_blocking) {
+  lock_.AssertAcquired();
+  if (!is_blocking) {
+    pending_reads_.push_back(request);
+    return;
+  }
+  // skip the in flight read, if any, and any queued blocking or async reads
+  ReadQueue::iterator it = pending_reads_.begin();
+  if (read_in_flight_ && it != pending_reads_.end()) {
+    ++it;
+  }
+  while (it != pending_reads_.end() && !it->block) {
+    ++it;
+  }
+  pending_reads_.insert(it, request);
+}
+
+void ShellDataSourceReader::IssueNextRead() {
+  ReadQueue completed_reads;
+  int64 position = 0;
+  int size = 0;
+  uint8* data = NULL;
+  bool issue_read = false;
+  {
+    base::AutoLock auto_lock(lock_);
+    while (!read_in_flight_ && !pending_reads_.empty()) {
+      ReadRequest& request = pending_reads_.front();
+      if (read_has_failed_) {
+        request.bytes_read = kReadError;
+      } else if (!request.block) {
+        // an earlier read-ahead may have completed while this was queued
+        int bytes_copied = CopyFromReadAhead_Locked(request.position,
+                                                    request.size,
+                                                    request.data);
+        request.position += bytes_copied;
+        request.size -= bytes_copied;
+        request.data += bytes_copied;
+        request.bytes_read += bytes_copied;
+      }
+      if (request.bytes_read == kReadError || request.size == 0) {
+        if (request.block) {
+          request.block->pending = false;
+        }
+        completed_reads.push_back(request);
+        pending_reads_.pop_front();
+        continue;
+      }
+      read_in_flight_ = true;
+      issue_read = true;
+      position = request.position;
+      size = request.size;
+      data = request.data;
+    }
+  }
+
+  for (ReadQueue::iterator it = completed_reads.begin();
+       it != completed_reads.end(); ++it) {
+    if (!it->read_cb.is_null()) {
+      it->read_cb.Run(it->bytes_read);
+    }
+  }
+
+  if (issue_read) {
+    data_source_->Read(position, size, data,
+        base::Bind(&ShellDataSourceReader::ReadCompleted, this));
+  }
+}
+
+void ShellDataSourceReader::ReadCompleted(int bytes_read) {
+  ReadRequest completed_read;
+  int64 position = 0;
+  int size = 0;
+  uint8* data = NULL;
+  bool issue_read = false;
+  {
+    base::AutoLock auto_lock(lock_);
+    DCHECK(read_in_flight_);
+    DCHECK(!pending_reads_.empty());
+    ReadRequest& request = pending_reads_.front();
+    if (bytes_read == DataSource::kReadError || bytes_read > request.size) {
+      DCHECK_LE(bytes_read, request.size);
+      // make all future reads fail
+      read_has_failed_ = true;
+      request.bytes_read = kReadError;
+    } else {
+      request.position += bytes_read;
+      request.size -= bytes_read;
+      request.data += bytes_read;
+      request.bytes_read += bytes_read;
+    }
+    // A read of 0 bytes is EOS, stop there to avoid an endless loop.
+    if (request.bytes_read != kReadError && request.size > 0 &&
+        bytes_read > 0 && !read_has_failed_) {
+      issue_read = true;
+      position = request.position;
+      size = request.size;
+      data = request.data;
+    } else {
+      if (request.block) {
+        request.block->pending = false;
+        request.block->size =
+            request.bytes_read == kReadError ? 0 : request.bytes_read;
+      }
+      completed_read = request;
+      pending_reads_.pop_front();
+      read_in_flight_ = false;
+    }
+  }
+
+  if (issue_read) {
+    data_source_->Read(position, size, data,
+        base::Bind(&ShellDataSourceReader::ReadCompleted, this));
+    return;
+  }
+
+  if (!completed_read.read_cb.is_null()) {
+    completed_read.read_cb.Run(completed_read.bytes_read);
+  }
+  IssueNextRead();
+}
+
+int ShellDataSourceReader::CopyFromReadAhead_Locked(int64 position,
+                                                    int size,
+                                                    uint8* data) {
+  lock_.AssertAcquired();
+  int bytes_copied = 0;
+  // the range may span the end of one block and the start of the next, so
+  // keep looking until no block contains the next byte we need.
+  bool found = true;
+  while (found && bytes_copied < size) {
+    found = false;
+    for (int i = 0; i < kReadAheadBlockCount; ++i) {
+      ReadAheadBlock& block = read_ahead_blocks_[i];
+      if (block.pending || block.size == 0 || position < block.position ||
+          position >= block.position + block.size) {
+        continue;
+      }
+      int block_offset = static_cast<int>(position - block.position);
+      int bytes = std::min(size - bytes_copied, block.size - block_offset);
+      memcpy(data, block.data.get() + block_offset, bytes);
+      block.last_use = ++read_ahead_clock_;
+      position += bytes;
+      data += bytes;
+      bytes_copied += bytes;
+      found = true;
+      break;
+    }
+  }
+  return bytes_copied;
+}
+
+bool ShellDataSourceReader::IsRangeCached_Locked(int64 position,
+                                                 int size) const {
+  lock_.AssertAcquired();
+  for (int i = 0; i < kReadAheadBlockCount; ++i) {
+    const ReadAheadBlock& block = read_ahead_blocks_[i];
+    // a pending block will hold its whole range once it completes
+    int64 block_end = block.position +
+        (block.pending ? kReadAheadBlockSize : block.size);
+    if (position >= block.position && position < block_end) {
+      return true;
+    }
+  }
+  return false;
+}
+
 int64 ShellDataSourceReader::FileSize() {
-  if (file_size_ == -1) {
-    if (!data_source_->GetSize(&file_size_)) {
-      file_size_ = -1;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (file_size_ != -1) {
+      return file_size_;
     }
   }
+  // The DataSource may block, so it is asked without holding lock_.
+  int64 file_size = -1;
+  if (!data_source_->GetSize(&file_size)) {
+    file_size = -1;
+  }
+  base::AutoLock auto_lock(lock_);
+  file_size_ = file_size;
   return file_size_;
 }
 
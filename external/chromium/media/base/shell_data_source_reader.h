@@ -17,11 +17,14 @@
 #ifndef MEDIA_BASE_SHELL_DATA_SOURCE_READER_H_
 #define MEDIA_BASE_SHELL_DATA_SOURCE_READER_H_
 
+#include <deque>
+
 #include "base/bind.h"
 #include "base/callback.h"
 #include "base/message_loop.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
 #include "base/synchronization/waitable_event.h"
 #include "media/base/data_source.h"
 
@@ -30,13 +33,28 @@ namespace media {
 // Allows sharing of a DataSource object between multiple objects on a single
 // thread, and exposes a simple BlockingRead() method to block the thread until
 // data is available or error. To avoid circular smart pointer references this
-// object is also the sole owner of a pointer to DataSource.  If we want to add
-// asynchronous reading to this object it will need its own thread and a
-// callback queue.
+// object is also the sole owner of a pointer to DataSource.
+//
+// Reads may also be queued asynchronously with AsyncRead(), and ranges of the
+// stream that are expected to be read soon may be downloaded in to a small
+// read-ahead cache with ReadAhead(), so that network latency on the next
+// BlockingRead() overlaps with the processing of the last one. The DataSource
+// only supports one outstanding read, so all reads are issued to it one at a
+// time in FIFO order, with blocking reads queued ahead of any read-ahead that
+// has not yet been issued.
 class ShellDataSourceReader
   : public base::RefCountedThreadSafe<ShellDataSourceReader> {
  public:
   static const int kReadError;
+  // Maximum number of asynchronous reads, including read-ahead, that may be
+  // queued at once. Blocking reads are not subject to this limit.
+  static const int kMaxPendingReads = 4;
+  // The read-ahead cache holds this many blocks of at most this size.
+  static const int kReadAheadBlockCount = 3;
+  static const int kReadAheadBlockSize = 64 * 1024;
+
+  // Called with the number of bytes read or kReadError on error.
+  typedef base::Callback<void(int)> AsyncReadCB;
 
   ShellDataSourceReader();
   virtual void SetDataSource(scoped_refptr<DataSource> data_source);
@@ -46,6 +64,19 @@ class ShellDataSourceReader
   // Currently only single-threaded support.
   virtual int BlockingRead(int64 position, int size, uint8* data);
 
+  // Queue a read of size bytes at position in to data, which must remain
+  // valid until read_cb is called. read_cb is called on the DataSource thread,
+  // or synchronously if the range was already in the read-ahead cache.
+  // Returns false without queuing the read if kMaxPendingReads reads are
+  // already pending.
+  virtual bool AsyncRead(int64 position, int size, uint8* data,
+                         const AsyncReadCB& read_cb);
+
+  // Hint that the provided range of the stream will be read soon. Downloads
+  // up to kReadAheadBlockSize bytes of it in to the read-ahead cache, unless
+  // the range is already cached or too many reads are pending.
+  virtual void ReadAhead(int64 position, int size);
+
   // returns size of file in bytes, or -1 if file size not known. If error will
   // retry getting file size on subsequent calls to FileSize().
   virtual int64 FileSize();
@@ -59,15 +90,57 @@ class ShellDataSourceReader
   // blocking read callback
   virtual void BlockingReadCompleted(int bytes_read);
 
+  struct ReadAheadBlock {
+    ReadAheadBlock();
+    int64 position;
+    int size;       // number of valid bytes once ready
+    bool pending;   // a read in to this block is queued or in flight
+    uint32 last_use;
+    scoped_array<uint8> data;
+  };
+
+  struct ReadRequest {
+    ReadRequest();
+    int64 position;  // these three advance as partial reads complete
+    int size;
+    uint8* data;
+    int bytes_read;
+    AsyncReadCB read_cb;
+    ReadAheadBlock* block;  // non-NULL for read-ahead requests
+  };
+  typedef std::deque<ReadRequest> ReadQueue;
+
+  // Add a request to the queue, blocking requests skip ahead of queued
+  // read-ahead requests.
+  void QueueRead_Locked(const ReadRequest& request, bool is_blocking);
+  // Issue the request at the front of the queue to the DataSource if there is
+  // no read in flight, completing any requests that can be served entirely
+  // from the read-ahead cache along the way. Must be called without lock_.
+  void IssueNextRead();
+  // DataSource read callback for the request at the front of the queue.
+  void ReadCompleted(int bytes_read);
+  // Copy as much of the front of the range as is in the read-ahead cache in to
+  // data, returns the number of bytes copied.
+  int CopyFromReadAhead_Locked(int64 position, int size, uint8* data);
+  bool IsRangeCached_Locked(int64 position, int size) const;
+
   scoped_refptr<DataSource> data_source_;
   base::WaitableEvent blocking_read_event_;
+  AsyncReadCB blocking_read_cb_;
+  int last_bytes_read_;  // protected implicitly by blocking_read_event_
+  // end of the last blocking read, used to detect sequential access.
+  int64 last_read_end_;
+
+  // protects all following members.
+  base::Lock lock_;
   int64 file_size_;
   bool read_has_failed_;
-  DataSource::ReadCB blocking_read_cb_;
-  int last_bytes_read_;  // protected implicitly by blocking_read_event_
+  ReadQueue pending_reads_;
+  bool read_in_flight_;
+  ReadAheadBlock read_ahead_blocks_[kReadAheadBlockCount];
+  uint32 read_ahead_clock_;
 };
 
-
 }  // namespace media
 
 #endif  // MEDIA_BASE_SHELL_DATA_SOURCE_READER_H_
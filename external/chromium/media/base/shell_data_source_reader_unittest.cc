@@ -0,0 +1,329 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/base/shell_data_source_reader.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/callback.h"
+#include "media/base/data_source.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+namespace {
+
+const int kFileSize = 256 * 1024;
+
+// Serves reads of a file whose byte at position i is (i & 0xff). Reads either
+// complete as they are issued, or wait in a queue until the test completes
+// them, so the test can look at what the reader has issued in the meantime.
+class FakeDataSource : public DataSource {
+ public:
+  struct PendingRead {
+    int64 position;
+    int size;
+    uint8* data;
+    ReadCB read_cb;
+  };
+
+  FakeDataSource()
+      : complete_reads_at_once_(true)
+      , stopped_(false) {
+  }
+
+  void set_complete_reads_at_once(bool at_once) {
+    complete_reads_at_once_ = at_once;
+  }
+  const std::vector<int64>& read_positions() const { return read_positions_; }
+  size_t pending_read_count() const { return pending_reads_.size(); }
+  bool stopped() const { return stopped_; }
+
+  // Completes the oldest pending read with all of its bytes, or with |error|
+  // if it isn't 0.
+  void CompleteRead(int error) {
+    ASSERT_FALSE(pending_reads_.empty());
+    PendingRead read = pending_reads_.front();
+    pending_reads_.pop_front();
+    Serve(read, error);
+  }
+
+  // DataSource implementation.
+  virtual void Read(int64 position, int size, uint8* data,
+                    const ReadCB& read_cb) OVERRIDE {
+    read_positions_.push_back(position);
+    PendingRead read = { position, size, data, read_cb };
+    if (complete_reads_at_once_) {
+      Serve(read, 0);
+    } else {
+      pending_reads_.push_back(read);
+    }
+  }
+  virtual void Stop(const base::Closure& callback) OVERRIDE {
+    stopped_ = true;
+    callback.Run();
+  }
+  virtual bool GetSize(int64* size_out) OVERRIDE {
+    *size_out = kFileSize;
+    return true;
+  }
+  virtual bool IsStreaming() OVERRIDE { return false; }
+  virtual void SetBitrate(int bitrate) OVERRIDE {}
+
+ private:
+  virtual ~FakeDataSource() {}
+
+  void Serve(const PendingRead& read, int error) {
+    if (error) {
+      read.read_cb.Run(error);
+      return;
+    }
+    int size = static_cast<int>(
+        std::min(static_cast<int64>(read.size), kFileSize - read.position));
+    for (int i = 0; i < size; ++i) {
+      read.data[i] = static_cast<uint8>((read.position + i) & 0xff);
+    }
+    read.read_cb.Run(size);
+  }
+
+  bool complete_reads_at_once_;
+  bool stopped_;
+  std::vector<int64> read_positions_;
+  std::deque<PendingRead> pending_reads_;
+};
+
+class ReadResult {
+ public:
+  ReadResult() : bytes_read_(0), calls_(0) {}
+
+  ShellDataSourceReader::AsyncReadCB Callback() {
+    return base::Bind(&ReadResult::OnRead, base::Unretained(this));
+  }
+  void OnRead(int bytes_read) {
+    bytes_read_ = bytes_read;
+    ++calls_;
+  }
+
+  int bytes_read() const { return bytes_read_; }
+  int calls() const { return calls_; }
+
+ private:
+  int bytes_read_;
+  int calls_;
+};
+
+void OnStopped(bool* stopped) {
+  *stopped = true;
+}
+
+bool HoldsFileBytes(const uint8* data, int64 position, int size) {
+  for (int i = 0; i < size; ++i) {
+    if (data[i] != static_cast<uint8>((position + i) & 0xff))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+class ShellDataSourceReaderTest : public testing::Test {
+ protected:
+  ShellDataSourceReaderTest()
+      : data_source_(new FakeDataSource)
+      , reader_(new ShellDataSourceReader) {
+    reader_->SetDataSource(data_source_);
+  }
+
+  virtual ~ShellDataSourceReaderTest() {
+    bool stopped = false;
+    reader_->Stop(base::Bind(&OnStopped, &stopped));
+    EXPECT_TRUE(stopped);
+  }
+
+  scoped_refptr<FakeDataSource> data_source_;
+  scoped_refptr<ShellDataSourceReader> reader_;
+};
+
+TEST_F(ShellDataSourceReaderTest, AsyncReadsAreIssuedOneAtATimeInOrder) {
+  data_source_->set_complete_reads_at_once(false);
+  uint8 first[100];
+  uint8 second[100];
+  ReadResult first_result;
+  ReadResult second_result;
+  EXPECT_TRUE(reader_->AsyncRead(1000, 100, first, first_result.Callback()));
+  EXPECT_TRUE(reader_->AsyncRead(5000, 100, second, second_result.Callback()));
+  // The DataSource only supports one read at a time.
+  EXPECT_EQ(1U, data_source_->pending_read_count());
+
+  data_source_->CompleteRead(0);
+  EXPECT_EQ(1, first_result.calls());
+  EXPECT_EQ(100, first_result.bytes_read());
+  EXPECT_TRUE(HoldsFileBytes(first, 1000, 100));
+  EXPECT_EQ(0, second_result.calls());
+  EXPECT_EQ(1U, data_source_->pending_read_count());
+
+  data_source_->CompleteRead(0);
+  EXPECT_EQ(1, second_result.calls());
+  EXPECT_EQ(100, second_result.bytes_read());
+  EXPECT_TRUE(HoldsFileBytes(second, 5000, 100));
+
+  ASSERT_EQ(2U, data_source_->read_positions().size());
+  EXPECT_EQ(1000, data_source_->read_positions()[0]);
+  EXPECT_EQ(5000, data_source_->read_positions()[1]);
+}
+
+TEST_F(ShellDataSourceReaderTest, AsyncReadQueueIsBounded) {
+  data_source_->set_complete_reads_at_once(false);
+  uint8 data[ShellDataSourceReader::kMaxPendingReads + 1][10];
+  ReadResult results[ShellDataSourceReader::kMaxPendingReads + 1];
+  for (int i = 0; i < ShellDataSourceReader::kMaxPendingReads; ++i) {
+    EXPECT_TRUE(reader_->AsyncRead(i * 10, 10, data[i],
+                                   results[i].Callback()));
+  }
+  const int last = ShellDataSourceReader::kMaxPendingReads;
+  EXPECT_FALSE(reader_->AsyncRead(last * 10, 10, data[last],
+                                  results[last].Callback()));
+
+  // Once a read completes there is room again.
+  data_source_->CompleteRead(0);
+  EXPECT_TRUE(reader_->AsyncRead(last * 10, 10, data[last],
+                                 results[last].Callback()));
+  while (data_source_->pending_read_count() > 0) {
+    data_source_->CompleteRead(0);
+  }
+  for (int i = 0; i <= last; ++i) {
+    EXPECT_EQ(1, results[i].calls());
+    EXPECT_EQ(10, results[i].bytes_read());
+    EXPECT_TRUE(HoldsFileBytes(data[i], i * 10, 10));
+  }
+}
+
+TEST_F(ShellDataSourceReaderTest, ReadAheadServesLaterReads) {
+  data_source_->set_complete_reads_at_once(false);
+  reader_->ReadAhead(2000, 1000);
+  ASSERT_EQ(1U, data_source_->pending_read_count());
+  data_source_->CompleteRead(0);
+
+  // Served from the read-ahead cache, without a read or waiting.
+  uint8 data[100];
+  ReadResult result;
+  EXPECT_TRUE(reader_->AsyncRead(2500, 100, data, result.Callback()));
+  EXPECT_EQ(1, result.calls());
+  EXPECT_EQ(100, result.bytes_read());
+  EXPECT_TRUE(HoldsFileBytes(data, 2500, 100));
+  EXPECT_EQ(1U, data_source_->read_positions().size());
+
+  // A read that runs past the cached range reads only the rest.
+  EXPECT_TRUE(reader_->AsyncRead(2900, 200, data, result.Callback()));
+  ASSERT_EQ(2U, data_source_->read_positions().size());
+  EXPECT_EQ(3000, data_source_->read_positions()[1]);
+  data_source_->CompleteRead(0);
+  EXPECT_EQ(2, result.calls());
+  EXPECT_EQ(200, result.bytes_read());
+  EXPECT_TRUE(HoldsFileBytes(data, 2900, 200));
+}
+
+TEST_F(ShellDataSourceReaderTest, SequentialBlockingReadsReadAhead) {
+  uint8 data[100];
+  EXPECT_EQ(100, reader_->BlockingRead(0, 100, data));
+  EXPECT_EQ(1U, data_source_->read_positions().size());
+  EXPECT_EQ(100, reader_->BlockingRead(100, 100, data));
+  // The second read was sequential, so what follows it was read ahead.
+  ASSERT_EQ(3U, data_source_->read_positions().size());
+  EXPECT_EQ(200, data_source_->read_positions()[2]);
+
+  // The third read is served from the read-ahead block, which already holds
+  // what follows it, so nothing more is read.
+  EXPECT_EQ(100, reader_->BlockingRead(200, 100, data));
+  EXPECT_TRUE(HoldsFileBytes(data, 200, 100));
+  EXPECT_EQ(3U, data_source_->read_positions().size());
+
+  // Reading the end of the block reads ahead past it.
+  const int64 block_end = 200 + ShellDataSourceReader::kReadAheadBlockSize;
+  std::vector<uint8> rest(block_end - 300);
+  EXPECT_EQ(static_cast<int>(rest.size()),
+            reader_->BlockingRead(300, rest.size(), &rest[0]));
+  EXPECT_TRUE(HoldsFileBytes(&rest[0], 300, rest.size()));
+  ASSERT_EQ(4U, data_source_->read_positions().size());
+  EXPECT_EQ(block_end, data_source_->read_positions()[3]);
+}
+
+TEST_F(ShellDataSourceReaderTest, ReadsAtEndOfFileReturnNothing) {
+  EXPECT_EQ(kFileSize, reader_->FileSize());
+  uint8 data[100];
+  ReadResult result;
+  EXPECT_TRUE(reader_->AsyncRead(kFileSize, 100, data, result.Callback()));
+  EXPECT_EQ(1, result.calls());
+  EXPECT_EQ(0, result.bytes_read());
+  EXPECT_EQ(0, reader_->BlockingRead(kFileSize, 100, data));
+  reader_->ReadAhead(kFileSize, 100);
+  EXPECT_TRUE(data_source_->read_positions().empty());
+}
+
+TEST_F(ShellDataSourceReaderTest, ReadErrorFailsLaterReads) {
+  data_source_->set_complete_reads_at_once(false);
+  uint8 data[100];
+  ReadResult result;
+  EXPECT_TRUE(reader_->AsyncRead(0, 100, data, result.Callback()));
+  data_source_->CompleteRead(DataSource::kReadError);
+  EXPECT_EQ(1, result.calls());
+  EXPECT_EQ(ShellDataSourceReader::kReadError, result.bytes_read());
+
+  EXPECT_TRUE(reader_->AsyncRead(0, 100, data, result.Callback()));
+  EXPECT_EQ(2, result.calls());
+  EXPECT_EQ(ShellDataSourceReader::kReadError, result.bytes_read());
+  EXPECT_EQ(ShellDataSourceReader::kReadError,
+            reader_->BlockingRead(0, 100, data));
+  EXPECT_EQ(1U, data_source_->read_positions().size());
+}
+
+TEST_F(ShellDataSourceReaderTest, StopCancelsPendingReads) {
+  data_source_->set_complete_reads_at_once(false);
+  uint8 first[100];
+  uint8 second[100];
+  ReadResult first_result;
+  ReadResult second_result;
+  EXPECT_TRUE(reader_->AsyncRead(0, 100, first, first_result.Callback()));
+  EXPECT_TRUE(reader_->AsyncRead(500, 100, second, second_result.Callback()));
+  reader_->ReadAhead(1000, 100);
+
+  bool stopped = false;
+  reader_->Stop(base::Bind(&OnStopped, &stopped));
+  EXPECT_TRUE(stopped);
+  EXPECT_TRUE(data_source_->stopped());
+  // Both reads end at once, with nothing read.
+  EXPECT_EQ(1, first_result.calls());
+  EXPECT_EQ(0, first_result.bytes_read());
+  EXPECT_EQ(1, second_result.calls());
+  EXPECT_EQ(0, second_result.bytes_read());
+
+  // The read that was in flight finishing later runs no callback again, and
+  // issues none of the cancelled reads.
+  data_source_->CompleteRead(0);
+  EXPECT_EQ(1, first_result.calls());
+  EXPECT_EQ(1U, data_source_->read_positions().size());
+
+  // Reads after Stop() fail.
+  ReadResult late_result;
+  EXPECT_TRUE(reader_->AsyncRead(0, 100, first, late_result.Callback()));
+  EXPECT_EQ(1, late_result.calls());
+  EXPECT_EQ(ShellDataSourceReader::kReadError, late_result.bytes_read());
+}
+
+}  // namespace media
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/base/shell_media_histogram.h"
+
+#include <math.h>
+
+#include "base/bits.h"
+#include "base/logging.h"
+
+namespace media {
+
+namespace {
+
+int Log2Floor(uint64 value) {
+  if (value >> 32)
+    return 32 + base::bits::Log2Floor(static_cast<uint32>(value >> 32));
+  return base::bits::Log2Floor(static_cast<uint32>(value));
+}
+
+}  // namespace
+
+ShellMediaHistogram::ShellMediaHistogram() {
+  Reset();
+}
+
+void ShellMediaHistogram::Reset() {
+  for (int i = 0; i < kBuckets; ++i)
+    base::subtle::NoBarrier_Store(&buckets_[i], 0);
+}
+
+int64 ShellMediaHistogram::GetCount() const {
+  int64 count = 0;
+  for (int i = 0; i < kBuckets; ++i)
+    count += base::subtle::NoBarrier_Load(&buckets_[i]);
+  return count;
+}
+
+int64 ShellMediaHistogram::GetPercentile(double percentile) const {
+  DCHECK_GE(percentile, 0);
+  DCHECK_LE(percentile, 100);
+
+  // Take a copy so the buckets walked agree with the count.
+  base::subtle::Atomic32 buckets[kBuckets];
+  int64 count = 0;
+  for (int i = 0; i < kBuckets; ++i) {
+    buckets[i] = base::subtle::NoBarrier_Load(&buckets_[i]);
+    count += buckets[i];
+  }
+  if (count == 0)
+    return 0;
+
+  int64 rank = static_cast<int64>(ceil(count * percentile / 100));
+  if (rank < 1)
+    rank = 1;
+  for (int i = 0; i < kBuckets; ++i) {
+    rank -= buckets[i];
+    if (rank <= 0) {
+      // Report the middle of the bucket.
+      int64 min = GetBucketMin(i);
+      int64 width = i + 1 < kBuckets ? GetBucketMin(i + 1) - min : 1;
+      return min + (width - 1) / 2;
+    }
+  }
+  NOTREACHED();
+  return 0;
+}
+
+// static
+int ShellMediaHistogram::GetBucket(int64 value) {
+  if (value < kSubBuckets)
+    return value < 0 ? 0 : static_cast<int>(value);
+  int log = Log2Floor(static_cast<uint64>(value));
+  if (log >= kMaxBits)
+    return kBuckets - 1;
+  // The bits below the leading one pick the linear bucket within the power
+  // of two range.
+  int shift = log - kSubBucketBits;
+  return (shift + 1) * kSubBuckets +
+         static_cast<int>((value >> shift) & (kSubBuckets - 1));
+}
+
+// static
+int64 ShellMediaHistogram::GetBucketMin(int bucket) {
+  DCHECK_GE(bucket, 0);
+  DCHECK_LT(bucket, kBuckets);
+  if (bucket < kSubBuckets)
+    return bucket;
+  int shift = bucket / kSubBuckets - 1;
+  return static_cast<int64>(kSubBuckets + bucket % kSubBuckets) << shift;
+}
+
+}  // namespace media
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_BASE_SHELL_MEDIA_HISTOGRAM_H_
+#define MEDIA_BASE_SHELL_MEDIA_HISTOGRAM_H_
+
+#include "base/atomicops.h"
+#include "base/basictypes.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+// A log-linear histogram of non-negative values that can be recorded to from
+// any thread without locking.  Each power of two range is split into
+// kSubBuckets linear buckets, so a percentile read back from the histogram is
+// within 1 / kSubBuckets of the recorded value.  Values below kSubBuckets are
+// kept exactly, negative values are counted as 0 and values of 2^kMaxBits or
+// more are counted in the last bucket.
+class MEDIA_EXPORT ShellMediaHistogram {
+ public:
+  enum {
+    kSubBucketBits = 3,
+    kSubBuckets = 1 << kSubBucketBits,
+    kMaxBits = 40,
+    kBuckets = (kMaxBits - kSubBucketBits + 1) * kSubBuckets
+  };
+
+  ShellMediaHistogram();
+
+  void Record(int64 value) {
+    base::subtle::NoBarrier_AtomicIncrement(&buckets_[GetBucket(value)], 1);
+  }
+
+  // Clears the histogram.  Samples recorded concurrently may be lost.
+  void Reset();
+
+  // Returns the number of samples recorded.
+  int64 GetCount() const;
+  // Returns the value below which |percentile| percent of the samples fall,
+  // or 0 when nothing has been recorded.
+  int64 GetPercentile(double percentile) const;
+
+  static int GetBucket(int64 value);
+  // Returns the smallest value counted in |bucket|.
+  static int64 GetBucketMin(int bucket);
+
+ private:
+  base::subtle::Atomic32 buckets_[kBuckets];
+
+  DISALLOW_COPY_AND_ASSIGN(ShellMediaHistogram);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_BASE_SHELL_MEDIA_HISTOGRAM_H_
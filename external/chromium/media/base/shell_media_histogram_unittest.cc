@@ -0,0 +1,72 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/base/shell_media_histogram.h"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+TEST(ShellMediaHistogramTest, BucketsAreContiguous) {
+  for (int i = 0; i < ShellMediaHistogram::kSubBuckets * 2; ++i)
+    EXPECT_EQ(i, ShellMediaHistogram::GetBucket(i));
+
+  for (int i = 1; i < ShellMediaHistogram::kBuckets; ++i) {
+    int64 min = ShellMediaHistogram::GetBucketMin(i);
+    EXPECT_GT(min, ShellMediaHistogram::GetBucketMin(i - 1));
+    EXPECT_EQ(i, ShellMediaHistogram::GetBucket(min));
+    EXPECT_EQ(i - 1, ShellMediaHistogram::GetBucket(min - 1));
+  }
+
+  EXPECT_EQ(0, ShellMediaHistogram::GetBucket(-5));
+  EXPECT_EQ(ShellMediaHistogram::kBuckets - 1,
+            ShellMediaHistogram::GetBucket(kint64max));
+}
+
+TEST(ShellMediaHistogramTest, SmallValuesAreExact) {
+  ShellMediaHistogram histogram;
+  EXPECT_EQ(0, histogram.GetCount());
+  EXPECT_EQ(0, histogram.GetPercentile(50));
+
+  for (int i = 0; i < 90; ++i)
+    histogram.Record(1);
+  for (int i = 0; i < 10; ++i)
+    histogram.Record(5);
+  EXPECT_EQ(100, histogram.GetCount());
+  EXPECT_EQ(1, histogram.GetPercentile(50));
+  EXPECT_EQ(1, histogram.GetPercentile(90));
+  EXPECT_EQ(5, histogram.GetPercentile(91));
+  EXPECT_EQ(5, histogram.GetPercentile(100));
+}
+
+TEST(ShellMediaHistogramTest, PercentilesAreWithinBucketPrecision) {
+  ShellMediaHistogram histogram;
+  for (int64 i = 1; i <= 100000; ++i)
+    histogram.Record(i);
+
+  const double kPercentiles[] = { 50, 95, 99 };
+  for (size_t i = 0; i < arraysize(kPercentiles); ++i) {
+    double expected = kPercentiles[i] * 1000;
+    EXPECT_NEAR(expected, histogram.GetPercentile(kPercentiles[i]),
+                expected / ShellMediaHistogram::kSubBuckets)
+        << kPercentiles[i];
+  }
+
+  histogram.Reset();
+  EXPECT_EQ(0, histogram.GetCount());
+}
+
+}  // namespace media
@@ -65,6 +65,13 @@ class MEDIA_EXPORT ShellMediaPlatform {
   virtual int GetMaxVideoFrames() const {
     return limits::kMaxVideoFrames;
   }
+  // The maximum number of bytes the progressive demuxer downloads with a
+  // single read when the parser can provide a run of AUs that are contiguous
+  // in the stream, such as the samples of an mp4 chunk. Return 0 to download
+  // each AU with its own read.
+  virtual size_t GetMaxDemuxerBatchDownloadSize() const {
+    return 256 * 1024;
+  }
 
  private:
   static void SetInstance(ShellMediaPlatform* shell_media_platform);
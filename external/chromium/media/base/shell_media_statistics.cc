@@ -19,18 +19,60 @@
 #include <limits>
 
 #include "base/basictypes.h"
+#include "base/format_macros.h"
+#include "base/logging.h"
+#include "base/stringprintf.h"
 
 namespace media {
 
+namespace {
+
+const char* const kStatNames[] = {
+  "audio_codec",
+  "audio_channels",
+  "audio_sample_per_second",
+  "audio_underflow",
+  "video_codec",
+  "video_width",
+  "video_height",
+  "video_frame_decode",
+  "video_frame_drop",
+  "video_frame_late",
+  "video_renderer_backlog",
+  "video_decoder_threads",
+  "video_decode_thread_time",
+  "video_frame_pool_hit",
+  "video_frame_pool_miss",
+  "decrypt",
+  "source_buffer_eviction",
+  "source_buffer_pool_eviction",
+  "start_of_global_stat",
+  "largest_free_shell_buffer",
+  "allocated_shell_buffer_size",
+};
+
+COMPILE_ASSERT(arraysize(kStatNames) == ShellMediaStatistics::STAT_TYPE_MAX,
+               stat_names_must_match_stat_types);
+
+}  // namespace
+
 ShellMediaStatistics::ShellMediaStatistics() {
   Reset(true);  // reset all stats, include global stats.
 }
 
 void ShellMediaStatistics::OnPlaybackBegin() {
+  // Leave the stats of the previous playback in the log, where they are
+  // available in every build.
+  if (GetCount(STAT_TYPE_VIDEO_FRAME_DECODE) ||
+      GetCount(STAT_TYPE_AUDIO_CODEC)) {
+    LOG(INFO) << "Media statistics: " << GetPercentilesAsJSON();
+  }
   Reset(false);  // reset non-global stats.
 }
 
 void ShellMediaStatistics::record(StatType type, int64 value) {
+  histograms_[type].Record(value);
+#if !defined(__LB_SHELL__FOR_RELEASE__)
   if (type == STAT_TYPE_VIDEO_WIDTH)
     type = STAT_TYPE_VIDEO_WIDTH;
   ++stats_[type].times_;
@@ -40,6 +82,7 @@ void ShellMediaStatistics::record(StatType type, int64 value) {
   if (value < stats_[type].min_)
     stats_[type].min_ = value;
   stats_[type].current_ = value;
+#endif  // !defined(__LB_SHELL__FOR_RELEASE__)
 }
 
 void ShellMediaStatistics::record(StatType type,
@@ -97,6 +140,42 @@ double ShellMediaStatistics::GetMaxDuration(StatType type) const {
   return base::TimeDelta::FromInternalValue(GetMax(type)).InSecondsF();
 }
 
+int64 ShellMediaStatistics::GetCount(StatType type) const {
+  return histograms_[type].GetCount();
+}
+
+int64 ShellMediaStatistics::GetPercentile(StatType type,
+                                          double percentile) const {
+  return histograms_[type].GetPercentile(percentile);
+}
+
+std::string ShellMediaStatistics::GetPercentilesAsJSON() const {
+  std::string json = base::StringPrintf(
+      "{\"elapsed\": %.3f, \"stats\": {", GetElapsedTime());
+  const char* separator = "";
+  for (int i = 0; i < STAT_TYPE_MAX; ++i) {
+    StatType type = static_cast<StatType>(i);
+    int64 count = GetCount(type);
+    if (count == 0)
+      continue;
+    base::StringAppendF(
+        &json, "%s\"%s\": {\"count\": %" PRId64 ", \"p50\": %" PRId64
+        ", \"p95\": %" PRId64 ", \"p99\": %" PRId64 "}",
+        separator, GetStatName(type), count, GetPercentile(type, 50),
+        GetPercentile(type, 95), GetPercentile(type, 99));
+    separator = ", ";
+  }
+  json.append("}}");
+  return json;
+}
+
+// static
+const char* ShellMediaStatistics::GetStatName(StatType type) {
+  DCHECK_GE(type, 0);
+  DCHECK_LT(type, STAT_TYPE_MAX);
+  return kStatNames[type];
+}
+
 // static
 ShellMediaStatistics& ShellMediaStatistics::Instance() {
   static ShellMediaStatistics media_statistics;
@@ -113,16 +192,18 @@ void ShellMediaStatistics::Reset(bool include_global_stats) {
     stats_[i].total_ = 0;
     stats_[i].min_ = std::numeric_limits<int64>::max();
     stats_[i].max_ = std::numeric_limits<int64>::min();
+    histograms_[i].Reset();
   }
 }
 
 ShellScopedMediaStat::ShellScopedMediaStat(ShellMediaStatistics::StatType type)
   : type_(type),
-    start_(base::Time::Now()) {
+    start_(base::TimeTicks::Now()) {
 }
 
 ShellScopedMediaStat::~ShellScopedMediaStat() {
-  ShellMediaStatistics::Instance().record(type_, base::Time::Now() - start_);
+  ShellMediaStatistics::Instance().record(type_,
+                                          base::TimeTicks::Now() - start_);
 }
 
 }  // namespace media
@@ -17,14 +17,20 @@
 #ifndef MEDIA_BASE_SHELL_MEDIA_STATISTICS_H_
 #define MEDIA_BASE_SHELL_MEDIA_STATISTICS_H_
 
+#include <string>
+
 #include "base/synchronization/lock.h"
 #include "base/time.h"
+#include "media/base/shell_media_histogram.h"
 
 namespace media {
 
 // This class collects events and their durations in the media stack.
 // Note that it is not thread safe but as its purpose is just to collect
 // performance data it is ok to call it from different threads.
+// Every value is also recorded in a lock free histogram per stat, which is
+// cheap enough to stay enabled in release builds where the rest of the stats
+// are compiled out.
 class ShellMediaStatistics {
  public:
   enum StatType {
@@ -45,8 +51,22 @@ class ShellMediaStatistics {
     // How many frames we cached in the video renderer. If this value drops it
     // is more likely that we will have jitter.
     STAT_TYPE_VIDEO_RENDERER_BACKLOG,
+    // How many threads the video decoder uses.
+    STAT_TYPE_VIDEO_DECODER_THREADS,
+    // CPU time a video decoder spent on one Decode(), including the time of
+    // its codec threads.
+    STAT_TYPE_VIDEO_DECODE_THREAD_TIME,
+    // A decoded video frame reused the planes of a previous frame.
+    STAT_TYPE_VIDEO_FRAME_POOL_HIT,
+    // A decoded video frame had to allocate new planes.
+    STAT_TYPE_VIDEO_FRAME_POOL_MISS,
     // Time spend in decrypting a buffer
     STAT_TYPE_DECRYPT,
+    // Bytes of buffered media data a SourceBufferStream garbage collected.
+    STAT_TYPE_SOURCE_BUFFER_EVICTION,
+    // Same as above, when the garbage collection was to make room in the
+    // shell buffer pool rather than to keep the stream within its limit.
+    STAT_TYPE_SOURCE_BUFFER_POOL_EVICTION,
     // The stat types after the following are global stats. i.e. their values
     // will be preserved between playng back of different videos.
     STAT_TYPE_START_OF_GLOBAL_STAT,
@@ -87,6 +107,17 @@ class ShellMediaStatistics {
   int64 GetMin(StatType type) const;
   int64 GetMax(StatType type) const;
 
+  // These are backed by the histograms and are available in all builds.
+  // Durations are in microseconds.
+  int64 GetCount(StatType type) const;
+  int64 GetPercentile(StatType type, double percentile) const;
+  // Returns the sample count and p50/p95/p99 of every stat recorded since
+  // the playback began as a JSON object, so results can be compared across
+  // builds by scripts.
+  std::string GetPercentilesAsJSON() const;
+
+  static const char* GetStatName(StatType type);
+
   // The following access functions are just provided for easy of use. They are
   // not applicable to all stats. it is the responsibility of the user of these
   // functions to ensure that the call is valid.
@@ -104,6 +135,7 @@ class ShellMediaStatistics {
 
   base::Time start_;
   Stat stats_[STAT_TYPE_MAX];
+  ShellMediaHistogram histograms_[STAT_TYPE_MAX];
 };
 
 class ShellScopedMediaStat {
@@ -113,17 +145,11 @@ class ShellScopedMediaStat {
 
  private:
   ShellMediaStatistics::StatType type_;
-  base::Time start_;
+  base::TimeTicks start_;
 };
 
 }  // namespace media
 
-#if defined(__LB_SHELL__FOR_RELEASE__)
-#define UPDATE_MEDIA_STATISTICS(type, value) do {} while (false)
-
-// This macro reports a media stat with its duration
-#define SCOPED_MEDIA_STATISTICS(type)        do {} while (false)
-#else  // defined(__LB_SHELL__FOR_RELEASE__)
 // This macro reports a media stat with its new value
 #define UPDATE_MEDIA_STATISTICS(type, value)                 \
   media::ShellMediaStatistics::Instance().record(            \
@@ -133,6 +159,5 @@ class ShellScopedMediaStat {
 #define SCOPED_MEDIA_STATISTICS(type)                        \
   media::ShellScopedMediaStat statistics_event(              \
       media::ShellMediaStatistics::type)
-#endif  // defined(__LB_SHELL__FOR_RELEASE__)
 
 #endif  // MEDIA_BASE_SHELL_MEDIA_STATISTICS_H_
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/base/shell_video_frame_pool.h"
+
+#include "base/bind.h"
+#include "base/logging.h"
+#include "base/memory/aligned_memory.h"
+#include "media/base/shell_media_statistics.h"
+
+namespace media {
+
+namespace {
+
+size_t RoundUp(size_t value, size_t alignment) {
+  // Check that |alignment| is a power of 2.
+  DCHECK((alignment + (alignment - 1)) == (alignment | (alignment - 1)));
+  return ((value + (alignment - 1)) & ~(alignment - 1));
+}
+
+// Plane layout of a YUV frame, this must match VideoFrame::AllocateYUV().
+struct PlaneLayout {
+  PlaneLayout(VideoFrame::Format format, const gfx::Size& coded_size) {
+    y_stride = RoundUp(coded_size.width(), VideoFrame::kFrameSizeAlignment);
+    uv_stride = RoundUp(RoundUp(coded_size.width(), 2) / 2,
+                        VideoFrame::kFrameSizeAlignment);
+    // height is a multiple of two macroblocks for interlaced h264
+    size_t y_height = RoundUp(coded_size.height(),
+                              VideoFrame::kFrameSizeAlignment * 2);
+    size_t uv_height = format == VideoFrame::YV12 ? y_height / 2 : y_height;
+    y_bytes = y_height * y_stride;
+    uv_bytes = uv_height * uv_stride;
+    // h264 chroma MC can overread the UV planes by one line
+    total_bytes = y_bytes + (uv_bytes * 2 + uv_stride) +
+                  VideoFrame::kFrameSizePadding;
+  }
+
+  size_t y_stride;
+  size_t uv_stride;
+  size_t y_bytes;
+  size_t uv_bytes;
+  size_t total_bytes;
+};
+
+}  // namespace
+
+ShellVideoFramePool::ShellVideoFramePool(size_t max_free_frames)
+    : max_free_frames_(max_free_frames),
+      format_(VideoFrame::INVALID),
+      generation_(0) {
+}
+
+ShellVideoFramePool::~ShellVideoFramePool() {
+  base::AutoLock lock(lock_);
+  Drain_Locked();
+}
+
+scoped_refptr<VideoFrame> ShellVideoFramePool::CreateFrame(
+    VideoFrame::Format format,
+    const gfx::Size& coded_size,
+    const gfx::Rect& visible_rect,
+    const gfx::Size& natural_size,
+    base::TimeDelta timestamp) {
+  DCHECK(format == VideoFrame::YV12 || format == VideoFrame::YV16);
+  DCHECK(VideoFrame::IsValidConfig(format, coded_size, visible_rect,
+                                   natural_size));
+  PlaneLayout layout(format, coded_size);
+
+  uint8* data = NULL;
+  uint32 generation;
+  {
+    base::AutoLock lock(lock_);
+    if (format != format_ || coded_size != coded_size_) {
+      Drain_Locked();
+      format_ = format;
+      coded_size_ = coded_size;
+    }
+    if (!free_frames_.empty()) {
+      data = free_frames_.back();
+      free_frames_.pop_back();
+    }
+    generation = generation_;
+  }
+
+  if (data) {
+    UPDATE_MEDIA_STATISTICS(STAT_TYPE_VIDEO_FRAME_POOL_HIT, 1);
+  } else {
+    UPDATE_MEDIA_STATISTICS(STAT_TYPE_VIDEO_FRAME_POOL_MISS, 1);
+    data = reinterpret_cast<uint8*>(base::AlignedAlloc(
+        layout.total_bytes, VideoFrame::kFrameAddressAlignment));
+  }
+
+  return VideoFrame::WrapExternalYuvData(
+      format, coded_size, visible_rect, natural_size,
+      layout.y_stride, layout.uv_stride, layout.uv_stride,
+      data, data + layout.y_bytes, data + layout.y_bytes + layout.uv_bytes,
+      timestamp,
+      base::Bind(&ShellVideoFramePool::OnFrameDestroyed, this, generation,
+                 data));
+}
+
+void ShellVideoFramePool::Drain() {
+  base::AutoLock lock(lock_);
+  Drain_Locked();
+}
+
+size_t ShellVideoFramePool::GetFreeFrameCount() {
+  base::AutoLock lock(lock_);
+  return free_frames_.size();
+}
+
+void ShellVideoFramePool::Drain_Locked() {
+  lock_.AssertAcquired();
+  for (size_t i = 0; i < free_frames_.size(); ++i) {
+    base::AlignedFree(free_frames_[i]);
+  }
+  free_frames_.clear();
+  ++generation_;
+}
+
+void ShellVideoFramePool::OnFrameDestroyed(uint32 generation, uint8* data) {
+  {
+    base::AutoLock lock(lock_);
+    if (generation == generation_ && free_frames_.size() < max_free_frames_) {
+      free_frames_.push_back(data);
+      return;
+    }
+  }
+  base::AlignedFree(data);
+}
+
+}  // namespace media
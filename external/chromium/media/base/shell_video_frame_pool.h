@@ -0,0 +1,85 @@
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_BASE_SHELL_VIDEO_FRAME_POOL_H_
+#define MEDIA_BASE_SHELL_VIDEO_FRAME_POOL_H_
+
+#include <vector>
+
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/time.h"
+#include "media/base/media_export.h"
+#include "media/base/video_frame.h"
+#include "ui/gfx/rect.h"
+#include "ui/gfx/size.h"
+
+namespace media {
+
+// Recycles the planes of YUV video frames, so that software decoders don't
+// allocate and free a whole picture for every frame they decode.
+//
+// The pool holds planes for a single format and coded size at a time. Asking
+// for a frame of a different format or size drains the pool, as does Drain(),
+// and planes of frames destroyed after a drain are freed rather than
+// recycled. Every frame made by the pool holds a reference to it, so the pool
+// lives as long as its longest lived frame. Frames may be created and
+// destroyed on any thread.
+class MEDIA_EXPORT ShellVideoFramePool
+    : public base::RefCountedThreadSafe<ShellVideoFramePool> {
+ public:
+  // At most max_free_frames unused planes are kept for reuse, the planes of
+  // any frames destroyed beyond that are freed.
+  explicit ShellVideoFramePool(size_t max_free_frames);
+
+  // Returns a YV12 or YV16 frame with the same plane layout, strides and
+  // alignment as one made by VideoFrame::CreateFrame(), reusing the planes
+  // of a destroyed frame of the same format and coded size if there is one.
+  scoped_refptr<VideoFrame> CreateFrame(VideoFrame::Format format,
+                                        const gfx::Size& coded_size,
+                                        const gfx::Rect& visible_rect,
+                                        const gfx::Size& natural_size,
+                                        base::TimeDelta timestamp);
+
+  // Frees all unused planes. Call when the stream's resolution changes.
+  void Drain();
+
+  size_t GetFreeFrameCount();
+
+ private:
+  friend class base::RefCountedThreadSafe<ShellVideoFramePool>;
+  ~ShellVideoFramePool();
+
+  void Drain_Locked();
+  // Bound as the no_longer_needed_cb of every frame made by CreateFrame().
+  void OnFrameDestroyed(uint32 generation, uint8* data);
+
+  base::Lock lock_;
+  size_t max_free_frames_;
+  // format and coded size of the planes in free_frames_
+  VideoFrame::Format format_;
+  gfx::Size coded_size_;
+  // incremented whenever the pool is drained, frames made before that are
+  // not recycled
+  uint32 generation_;
+  std::vector<uint8*> free_frames_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShellVideoFramePool);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_BASE_SHELL_VIDEO_FRAME_POOL_H_
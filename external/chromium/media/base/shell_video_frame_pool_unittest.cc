@@ -0,0 +1,124 @@
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/base/shell_video_frame_pool.h"
+
+#include "media/base/video_frame.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const size_t kMaxFreeFrames = 4;
+
+class ShellVideoFramePoolTest : public testing::Test {
+ protected:
+  ShellVideoFramePoolTest()
+      : pool_(new ShellVideoFramePool(kMaxFreeFrames)) {
+  }
+
+  scoped_refptr<VideoFrame> CreateFrame(VideoFrame::Format format,
+                                        const gfx::Size& size) {
+    return pool_->CreateFrame(format, size, gfx::Rect(size), size,
+                              base::TimeDelta());
+  }
+
+  scoped_refptr<ShellVideoFramePool> pool_;
+};
+
+TEST_F(ShellVideoFramePoolTest, LayoutMatchesCreateFrame) {
+  VideoFrame::Format formats[] = { VideoFrame::YV12, VideoFrame::YV16 };
+  gfx::Size sizes[] = { gfx::Size(1920, 1080), gfx::Size(1280, 720),
+                        gfx::Size(854, 480), gfx::Size(175, 99) };
+  for (size_t i = 0; i < arraysize(formats); ++i) {
+    for (size_t j = 0; j < arraysize(sizes); ++j) {
+      scoped_refptr<VideoFrame> expected = VideoFrame::CreateFrame(
+          formats[i], sizes[j], gfx::Rect(sizes[j]), sizes[j],
+          base::TimeDelta());
+      scoped_refptr<VideoFrame> frame = CreateFrame(formats[i], sizes[j]);
+      for (size_t plane = 0; plane < 3; ++plane) {
+        EXPECT_EQ(frame->stride(plane), expected->stride(plane));
+        EXPECT_EQ(frame->data(plane) - frame->data(VideoFrame::kYPlane),
+                  expected->data(plane) - expected->data(VideoFrame::kYPlane));
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(frame->data(plane)) %
+                      VideoFrame::kFrameAddressAlignment,
+                  reinterpret_cast<uintptr_t>(expected->data(plane)) %
+                      VideoFrame::kFrameAddressAlignment);
+      }
+    }
+  }
+}
+
+TEST_F(ShellVideoFramePoolTest, RecyclesPlanes) {
+  gfx::Size size(1280, 720);
+  scoped_refptr<VideoFrame> frame = CreateFrame(VideoFrame::YV12, size);
+  uint8* data = frame->data(VideoFrame::kYPlane);
+  frame = NULL;
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 1);
+  frame = CreateFrame(VideoFrame::YV12, size);
+  EXPECT_EQ(frame->data(VideoFrame::kYPlane), data);
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 0);
+}
+
+TEST_F(ShellVideoFramePoolTest, KeepsAtMostMaxFreeFrames) {
+  gfx::Size size(640, 360);
+  std::vector<scoped_refptr<VideoFrame> > frames;
+  for (size_t i = 0; i < kMaxFreeFrames * 2; ++i) {
+    frames.push_back(CreateFrame(VideoFrame::YV12, size));
+  }
+  frames.clear();
+  EXPECT_EQ(pool_->GetFreeFrameCount(), kMaxFreeFrames);
+}
+
+TEST_F(ShellVideoFramePoolTest, ResolutionChangeDrains) {
+  scoped_refptr<VideoFrame> old_frame =
+      CreateFrame(VideoFrame::YV12, gfx::Size(1280, 720));
+  CreateFrame(VideoFrame::YV12, gfx::Size(1280, 720));
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 1);
+
+  // a new size frees the unused planes of the old one
+  scoped_refptr<VideoFrame> frame =
+      CreateFrame(VideoFrame::YV12, gfx::Size(1920, 1080));
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 0);
+
+  // and planes of old frames still in use are not recycled
+  old_frame = NULL;
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 0);
+  frame = NULL;
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 1);
+}
+
+TEST_F(ShellVideoFramePoolTest, DrainFreesAllPlanes) {
+  scoped_refptr<VideoFrame> frame =
+      CreateFrame(VideoFrame::YV16, gfx::Size(320, 240));
+  CreateFrame(VideoFrame::YV16, gfx::Size(320, 240));
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 1);
+  pool_->Drain();
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 0);
+  frame = NULL;
+  EXPECT_EQ(pool_->GetFreeFrameCount(), 0);
+}
+
+TEST_F(ShellVideoFramePoolTest, FramesOutliveThePoolReference) {
+  scoped_refptr<VideoFrame> frame =
+      CreateFrame(VideoFrame::YV12, gfx::Size(320, 240));
+  // the frame keeps the pool alive until it is destroyed
+  pool_ = NULL;
+  memset(frame->data(VideoFrame::kYPlane), 0,
+         frame->stride(VideoFrame::kYPlane) * 240);
+  frame = NULL;
+}
+
+}  // namespace media
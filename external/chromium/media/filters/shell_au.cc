@@ -21,14 +21,52 @@ namespace {
 
 using namespace media;
 
-bool ReadBytes(uint64 offset, size_t size, uint8* buffer,
-               ShellDataSourceReader* reader) {
-  if (reader->BlockingRead(offset, size, buffer) != size) {
-    DLOG(ERROR) << "unable to download AU";
-    return false;
+// Where the bytes of an AU come from when it is read into a ShellBuffer,
+// either directly from the data source or from a range of the stream that the
+// demuxer has already downloaded in to memory. The range may lie in the same
+// memory as the buffer, see ShellAU::ReadFromMemory().
+class AUByteSource {
+ public:
+  explicit AUByteSource(ShellDataSourceReader* reader)
+      : reader_(reader), data_(NULL), data_offset_(0), data_size_(0) {
+  }
+  AUByteSource(const uint8* data, uint64 data_offset, size_t data_size)
+      : reader_(NULL), data_(data), data_offset_(data_offset),
+        data_size_(data_size) {
+  }
+
+  bool ReadBytes(uint64 offset, size_t size, uint8* buffer) const {
+    if (reader_) {
+      int bytes_read = reader_->BlockingRead(offset, size, buffer);
+      if (bytes_read != static_cast<int>(size)) {
+        DLOG(ERROR) << "unable to download AU";
+        return false;
+      }
+      return true;
+    }
+    if (offset < data_offset_ ||
+        offset + size > data_offset_ + data_size_) {
+      DLOG(ERROR) << "AU lies outside of downloaded range";
+      return false;
+    }
+    const uint8* source = data_ + (offset - data_offset_);
+    // Converting in place only moves bytes towards the start of the memory,
+    // an AU that grows more than that allows would overwrite its own bytes
+    // before they are read. It doesn't fit its buffer then either.
+    if (buffer > source && buffer < data_ + data_size_) {
+      DLOG(WARNING) << "AU outgrew the memory it is converted in";
+      return false;
+    }
+    memmove(buffer, source, size);
+    return true;
   }
-  return true;
-}
+
+ private:
+  ShellDataSourceReader* reader_;
+  const uint8* data_;
+  uint64 data_offset_;
+  size_t data_size_;
+};
 
 // ==== ShellEndOfStreamAU ==================================================
 
@@ -46,6 +84,12 @@ class ShellEndOfStreamAU : public media::ShellAU {
     NOTREACHED();
     return false;
   }
+  virtual bool ReadFromMemory(const uint8* data, uint64 data_offset,
+                              size_t data_size,
+                              media::ShellBuffer* buffer) OVERRIDE {
+    NOTREACHED();
+    return false;
+  }
   virtual Type GetType() const OVERRIDE { return type_; }
   virtual bool IsKeyframe() const OVERRIDE {
     NOTREACHED();
@@ -55,6 +99,10 @@ class ShellEndOfStreamAU : public media::ShellAU {
     NOTREACHED();
     return false;
   }
+  virtual uint64 GetOffset() const OVERRIDE {
+    NOTREACHED();
+    return 0;
+  }
   virtual size_t GetSize() const OVERRIDE { return 0; }
   virtual size_t GetMaxSize() const OVERRIDE { return 0; }
   virtual TimeDelta GetTimestamp() const OVERRIDE {
@@ -90,9 +138,12 @@ class ShellAudioAU : public media::ShellAU {
   }
   virtual bool Read(ShellDataSourceReader* reader,
                     ShellBuffer* buffer) OVERRIDE;
+  virtual bool ReadFromMemory(const uint8* data, uint64 data_offset,
+                              size_t data_size, ShellBuffer* buffer) OVERRIDE;
   virtual Type GetType() const OVERRIDE { return media::DemuxerStream::AUDIO; }
   virtual bool IsKeyframe() const OVERRIDE { return is_keyframe_; }
   virtual bool AddPrepend() const OVERRIDE { return true; }
+  virtual uint64 GetOffset() const OVERRIDE { return offset_; }
   virtual size_t GetSize() const OVERRIDE { return size_; }
   virtual size_t GetMaxSize() const OVERRIDE {
     return size_ + prepend_size_;
@@ -106,6 +157,8 @@ class ShellAudioAU : public media::ShellAU {
     timestamp_ = timestamp;
   }
 
+  bool ReadFrom(const AUByteSource& source, ShellBuffer* buffer);
+
   uint64 offset_;
   size_t size_;
   size_t prepend_size_;
@@ -126,9 +179,18 @@ ShellAudioAU::ShellAudioAU(uint64 offset, size_t size, size_t prepend_size,
 
 bool ShellAudioAU::Read(ShellDataSourceReader* reader,
                         ShellBuffer* buffer) {
+  return ReadFrom(AUByteSource(reader), buffer);
+}
+
+bool ShellAudioAU::ReadFromMemory(const uint8* data, uint64 data_offset,
+                                  size_t data_size, ShellBuffer* buffer) {
+  return ReadFrom(AUByteSource(data, data_offset, data_size), buffer);
+}
+
+bool ShellAudioAU::ReadFrom(const AUByteSource& source, ShellBuffer* buffer) {
   DCHECK_LE(size_ + prepend_size_, buffer->GetDataSize());
-  if (!ReadBytes(
-      offset_, size_, buffer->GetWritableData() + prepend_size_, reader))
+  if (!source.ReadBytes(
+      offset_, size_, buffer->GetWritableData() + prepend_size_))
     return false;
 
   if (!parser_->Prepend(this, buffer)) {
@@ -154,6 +216,8 @@ class ShellVideoAU : public media::ShellAU {
   }
   virtual bool Read(ShellDataSourceReader* reader,
                     ShellBuffer* buffer) OVERRIDE;
+  virtual bool ReadFromMemory(const uint8* data, uint64 data_offset,
+                              size_t data_size, ShellBuffer* buffer) OVERRIDE;
   virtual Type GetType() const OVERRIDE { return media::DemuxerStream::VIDEO; }
   virtual bool IsKeyframe() const OVERRIDE { return is_keyframe_; }
 #if defined(__LB_WIIU__)
@@ -161,6 +225,7 @@ class ShellVideoAU : public media::ShellAU {
 #else
   virtual bool AddPrepend() const OVERRIDE { return is_keyframe_; }
 #endif
+  virtual uint64 GetOffset() const OVERRIDE { return offset_; }
   virtual size_t GetSize() const OVERRIDE { return size_; }
   virtual size_t GetMaxSize() const OVERRIDE {
     // TODO : This code is a proof of concept. It should be fixed
@@ -176,6 +241,8 @@ class ShellVideoAU : public media::ShellAU {
     timestamp_ = timestamp;
   }
 
+  bool ReadFrom(const AUByteSource& source, ShellBuffer* buffer);
+
   uint64 offset_;
   size_t size_;
   size_t prepend_size_;
@@ -199,26 +266,32 @@ ShellVideoAU::ShellVideoAU(uint64 offset, size_t size, size_t prepend_size,
 
 bool ShellVideoAU::Read(ShellDataSourceReader* reader,
                         ShellBuffer* buffer) {
+  return ReadFrom(AUByteSource(reader), buffer);
+}
+
+bool ShellVideoAU::ReadFromMemory(const uint8* data, uint64 data_offset,
+                                  size_t data_size, ShellBuffer* buffer) {
+  return ReadFrom(AUByteSource(data, data_offset, data_size), buffer);
+}
+
+bool ShellVideoAU::ReadFrom(const AUByteSource& source, ShellBuffer* buffer) {
   size_t au_left = size_;  // bytes left in the AU
   uint64 au_offset = offset_;  // offset to read in the reader
-  size_t buf_left = buffer->GetAllocatedSize();  // bytes left in the buffer
+  // bytes left in the buffer
+  size_t buf_left = buffer->GetAllocatedSize() - prepend_size_;
   // The current write position in the buffer
   uint8* buf = buffer->GetWritableData() + prepend_size_;
 
   // The NALU is stored as [size][data][size][data].... We are going to
   // transform it into [start code][data][start code][data]....
   // The length of size is indicated by length_of_nalu_size_
-  while (au_left >= length_of_nalu_size_ && buf_left >= kAnnexBStartCode) {
+  while (au_left >= length_of_nalu_size_ && buf_left >= kAnnexBStartCodeSize) {
     uint8 size_buf[4];
     uint32 nal_size;
 
-    // Store [start code]
-    LB::Platform::store_uint32_big_endian(kAnnexBStartCode, buf);
-    buf += kAnnexBStartCodeSize;
-    buf_left -= kAnnexBStartCodeSize;
-
-    // Read [size]
-    if (!ReadBytes(au_offset, length_of_nalu_size_, size_buf, reader))
+    // Read [size], before the [start code] that may overwrite it when the AU
+    // is converted in place.
+    if (!source.ReadBytes(au_offset, length_of_nalu_size_, size_buf))
       return false;
 
     au_offset += length_of_nalu_size_;
@@ -233,17 +306,20 @@ bool ShellVideoAU::Read(ShellDataSourceReader* reader,
       nal_size = LB::Platform::load_uint32_big_endian(size_buf);
     }
 
-    if (au_left < nal_size || buf_left < nal_size)
+    if (au_left < nal_size || buf_left - kAnnexBStartCodeSize < nal_size)
       break;
 
-    // Read the [data] from reader into buf
-    if (!ReadBytes(au_offset, nal_size, buf, reader))
+    // Read the [data] from reader into buf, after the [start code]
+    if (!source.ReadBytes(au_offset, nal_size, buf + kAnnexBStartCodeSize))
       return false;
 
-    buf += nal_size;
+    // Store [start code]
+    LB::Platform::store_uint32_big_endian(kAnnexBStartCode, buf);
+
+    buf += kAnnexBStartCodeSize + nal_size;
     au_offset += nal_size;
     au_left -= nal_size;
-    buf_left -= nal_size;
+    buf_left -= kAnnexBStartCodeSize + nal_size;
   }
 
   if (au_left != 0) {
@@ -16,6 +16,8 @@
 #ifndef MEDIA_FILTERS_SHELL_AU_H_
 #define MEDIA_FILTERS_SHELL_AU_H_
 
+#include <vector>
+
 #include "base/memory/ref_counted.h"
 #include "media/base/demuxer_stream.h"
 #include "media/base/shell_buffer_factory.h"
@@ -53,9 +55,19 @@ class ShellAU : public base::RefCountedThreadSafe<ShellAU> {
   // Read an AU from reader to buffer and also do all the necessary operations
   // like prepending head to make it ready to decode.
   virtual bool Read(ShellDataSourceReader* reader, ShellBuffer* buffer) = 0;
+  // Same as Read() above, but sources the bytes of the AU from memory that the
+  // demuxer has already downloaded. |data| holds |data_size| bytes of the
+  // stream starting at stream byte offset |data_offset|, which must contain
+  // the entire AU. |data| may lie in the memory of |buffer| after where the
+  // AU is written to, in which case the AU is converted in place. Returns
+  // false if the converted AU would overwrite bytes it has yet to read.
+  virtual bool ReadFromMemory(const uint8* data, uint64 data_offset,
+                              size_t data_size, ShellBuffer* buffer) = 0;
   virtual Type GetType() const = 0;
   virtual bool IsKeyframe() const = 0;
   virtual bool AddPrepend() const = 0;
+  // Get the byte offset of this AU in the stream.
+  virtual uint64 GetOffset() const = 0;
   // Get the size of this AU, it is always no larger than its max size.
   virtual size_t GetSize() const = 0;
   // Get the max required buffer of this AU
@@ -72,6 +84,8 @@ class ShellAU : public base::RefCountedThreadSafe<ShellAU> {
   virtual ~ShellAU();
 };
 
+typedef std::vector<scoped_refptr<ShellAU> > ShellAUVector;
+
 }  // namespace media
 
 #endif  // MEDIA_FILTERS_SHELL_AU_H_
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/filters/shell_au.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "base/time.h"
+#include "media/base/shell_buffer_factory.h"
+#include "media/filters/shell_parser.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+namespace {
+
+const uint64 kRangeOffset = 1000;
+const size_t kPrependSize = 16;
+const uint8 kPrependByte = 0xee;
+
+// Fills the prepend of every AU with kPrependByte.
+class FakeParser : public ShellParser {
+ public:
+  FakeParser() : ShellParser(NULL) {}
+
+  virtual bool ParseConfig() OVERRIDE { return true; }
+  virtual scoped_refptr<ShellAU> GetNextAU(DemuxerStream::Type type) OVERRIDE {
+    return NULL;
+  }
+  virtual bool Prepend(scoped_refptr<ShellAU> au,
+                       scoped_refptr<ShellBuffer> buffer) OVERRIDE {
+    memset(buffer->GetWritableData(), kPrependByte, kPrependSize);
+    return true;
+  }
+  virtual bool SeekTo(base::TimeDelta timestamp) OVERRIDE { return true; }
+
+ private:
+  virtual ~FakeParser() {}
+};
+
+// Builds a run of AUs back to back in a stream, and the bytes each of them
+// should be converted to.
+class RunBuilder {
+ public:
+  explicit RunBuilder(ShellParser* parser) : parser_(parser) {}
+
+  void AddAudioAU(size_t size) {
+    std::vector<uint8> payload = MakePayload(size);
+    std::vector<uint8> expected(kPrependSize, kPrependByte);
+    expected.insert(expected.end(), payload.begin(), payload.end());
+    AddAU(ShellAU::CreateAudioAU(NextOffset(), size, kPrependSize, true,
+                                 NextTimestamp(), base::TimeDelta(), parser_),
+          payload, expected);
+  }
+
+  // Adds a video AU of |nalu_count| NALUs of |nalu_size| bytes each, with
+  // sizes |length_of_nalu_size| bytes long.
+  void AddVideoAU(uint8 length_of_nalu_size, int nalu_count,
+                  size_t nalu_size) {
+    std::vector<uint8> stream;
+    std::vector<uint8> expected(kPrependSize, kPrependByte);
+    for (int i = 0; i < nalu_count; ++i) {
+      for (int j = length_of_nalu_size - 1; j >= 0; --j)
+        stream.push_back(static_cast<uint8>(nalu_size >> (j * 8)));
+      const uint8 kStartCode[] = { 0, 0, 0, 1 };
+      expected.insert(expected.end(), kStartCode,
+                      kStartCode + sizeof(kStartCode));
+      std::vector<uint8> nalu = MakePayload(nalu_size);
+      stream.insert(stream.end(), nalu.begin(), nalu.end());
+      expected.insert(expected.end(), nalu.begin(), nalu.end());
+    }
+    AddAU(ShellAU::CreateVideoAU(NextOffset(), stream.size(), kPrependSize,
+                                 length_of_nalu_size, true, NextTimestamp(),
+                                 base::TimeDelta(), parser_),
+          stream, expected);
+  }
+
+  // Lays the run out as ShellDemuxer does, an aligned slot for each AU in
+  // a region, with the stream bytes of the run read in to the end of it.
+  scoped_refptr<ShellBuffer> CreateRegion() {
+    size_t region_size = 0;
+    for (size_t i = 0; i < aus_.size(); ++i)
+      region_size += ShellBufferFactory::SizeAlign(aus_[i]->GetMaxSize());
+    scoped_refptr<ShellBuffer> region =
+        ShellBufferFactory::Instance()->AllocateBufferNow(region_size);
+    if (region) {
+      memcpy(range(region), &stream_[0], stream_.size());
+    }
+    return region;
+  }
+
+  uint8* range(const scoped_refptr<ShellBuffer>& region) const {
+    return region->GetWritableData() + region->GetDataSize() - stream_.size();
+  }
+
+  const ShellAUVector& aus() const { return aus_; }
+  const std::vector<uint8>& stream() const { return stream_; }
+  const std::vector<uint8>& expected(size_t i) const { return expected_[i]; }
+
+ private:
+  static std::vector<uint8> MakePayload(size_t size) {
+    static uint8 next_byte = 0;
+    std::vector<uint8> payload(size);
+    for (size_t i = 0; i < size; ++i)
+      payload[i] = next_byte++;
+    return payload;
+  }
+
+  uint64 NextOffset() const { return kRangeOffset + stream_.size(); }
+  base::TimeDelta NextTimestamp() const {
+    return base::TimeDelta::FromMilliseconds(aus_.size() * 10);
+  }
+
+  void AddAU(const scoped_refptr<ShellAU>& au,
+             const std::vector<uint8>& stream,
+             const std::vector<uint8>& expected) {
+    aus_.push_back(au);
+    stream_.insert(stream_.end(), stream.begin(), stream.end());
+    expected_.push_back(expected);
+  }
+
+  ShellParser* parser_;
+  ShellAUVector aus_;
+  std::vector<uint8> stream_;
+  std::vector<std::vector<uint8> > expected_;
+};
+
+bool Holds(const scoped_refptr<ShellBuffer>& buffer,
+           const std::vector<uint8>& expected) {
+  return buffer->GetDataSize() == static_cast<int>(expected.size()) &&
+         memcmp(buffer->GetData(), &expected[0], expected.size()) == 0;
+}
+
+}  // namespace
+
+class ShellAUTest : public testing::Test {
+ protected:
+  ShellAUTest() {
+    ShellBufferFactory::Initialize();
+    parser_ = new FakeParser;
+  }
+
+  virtual ~ShellAUTest() {
+    parser_ = NULL;
+    ShellBufferFactory::Terminate();
+  }
+
+  // Converts AU |i| of |run| from the region in to its slot.
+  bool ConvertInPlace(const RunBuilder& run,
+                      const scoped_refptr<ShellBuffer>& region,
+                      size_t i,
+                      scoped_refptr<ShellBuffer>* slice) {
+    size_t slot_offset = 0;
+    for (size_t j = 0; j < i; ++j)
+      slot_offset += ShellBufferFactory::SizeAlign(run.aus()[j]->GetMaxSize());
+    *slice = ShellBuffer::CreateSlice(region, slot_offset,
+                                      run.aus()[i]->GetMaxSize());
+    return run.aus()[i]->ReadFromMemory(run.range(region), kRangeOffset,
+                                        run.stream().size(), *slice);
+  }
+
+  scoped_refptr<FakeParser> parser_;
+};
+
+TEST_F(ShellAUTest, ConvertsRunInPlace) {
+  RunBuilder run(parser_);
+  run.AddVideoAU(4, 3, 5000);
+  run.AddAudioAU(300);
+  run.AddVideoAU(2, 10, 700);
+  run.AddAudioAU(1);
+  run.AddVideoAU(1, 4, 200);
+  scoped_refptr<ShellBuffer> region = run.CreateRegion();
+  ASSERT_TRUE(region);
+
+  std::vector<scoped_refptr<ShellBuffer> > slices(run.aus().size());
+  for (size_t i = 0; i < run.aus().size(); ++i) {
+    ASSERT_TRUE(ConvertInPlace(run, region, i, &slices[i])) << i;
+  }
+  // Checked once all are converted, as the later AUs could overwrite the
+  // earlier ones.
+  for (size_t i = 0; i < run.aus().size(); ++i) {
+    EXPECT_TRUE(Holds(slices[i], run.expected(i))) << i;
+  }
+}
+
+TEST_F(ShellAUTest, AUTooLargeForItsSlotLeavesTheNextIntact) {
+  RunBuilder run(parser_);
+  // Each 2 byte NALU in the stream converts to 5 bytes, so this AU does not
+  // fit in its slot.
+  run.AddVideoAU(1, 2000, 1);
+  run.AddAudioAU(300);
+  scoped_refptr<ShellBuffer> region = run.CreateRegion();
+  ASSERT_TRUE(region);
+
+  scoped_refptr<ShellBuffer> slice;
+  EXPECT_FALSE(ConvertInPlace(run, region, 0, &slice));
+  // The AU after it is untouched.
+  ASSERT_TRUE(ConvertInPlace(run, region, 1, &slice));
+  EXPECT_TRUE(Holds(slice, run.expected(1)));
+}
+
+}  // namespace media
@@ -48,7 +48,8 @@ ShellAudioRendererImpl::ShellAudioRendererImpl(
     , state_(kUninitialized)
     , end_of_stream_state_(kWaitingForEOS)
     , decoded_audio_bus_(NULL)
-    , decode_complete_(false) {
+    , decode_complete_(false)
+    , time_stretching_(false) {
   DCHECK(message_loop_ != NULL);
 }
 
@@ -102,6 +103,11 @@ void ShellAudioRendererImpl::Flush(const base::Closure &callback) {
   // in process
   sink_->Pause(true);
 
+  // Audio after the flush starts a new stream.
+  if (time_stretcher_)
+    time_stretcher_->Flush();
+  time_stretching_ = false;
+
   // Reset the decoder. It will call the callback when it has finished.
   decoder_->Reset(callback);
 }
@@ -251,6 +257,12 @@ void ShellAudioRendererImpl::OnDecoderSelected(
       decoder_->bits_per_channel(),
       mp4::AAC::kSamplesPerFrame);
 
+  time_stretcher_.reset(new ShellAudioTimeStretcher(
+      channels, decoder_->samples_per_second(),
+      ShellAudioTimeStretcher::kSampleTypeFloat32,
+      ShellAudioTimeStretcher::kStorageTypePlanar));
+  time_stretching_ = false;
+
   state_ = kPaused;
 
   DCHECK(sink_.get());
@@ -373,6 +385,32 @@ void ShellAudioRendererImpl::DecodedAudioReady(
           state_ = kPlaying;
           DoPlay();
         }
+        // This is read by the renderer thread in Render(), but will only be
+        // read when decode_complete_ is set to true.
+        buffered_timestamp_ = buffer->GetTimestamp();
+      } else if (time_stretching_ ||
+                 (playback_rate_ > 0.0f && playback_rate_ != 1.0f)) {
+        if (!time_stretching_) {
+          time_stretching_ = true;
+          time_stretcher_start_timestamp_ = buffer->GetTimestamp();
+        }
+        // The decoder output is planar, like the time stretcher's input.
+        int frames = buffer->GetDataSize() / decoded_audio_bus_->channels() /
+                     sizeof(float);  // NOLINT(runtime/sizeof)
+        // While paused, keep the last rate for the audio already queued.
+        if (playback_rate_ > 0.0f)
+          time_stretcher_->SetPlaybackRate(playback_rate_);
+        time_stretcher_->EnqueueFrames(buffer->GetData(), frames);
+        // Playing faster than real time takes more than one buffer of input
+        // to fill a buffer of output.
+        if (time_stretcher_->frames_available() <
+                decoded_audio_bus_->frames() &&
+            ShouldQueueRead(state_)) {
+          decoder_->Read(
+              base::Bind(&ShellAudioRendererImpl::DecodedAudioReady, this));
+          return;
+        }
+        FillFromTimeStretcher(decoded_audio_bus_);
       } else {
         // Here we assume that a non-interleaved audio_bus means that the
         // decoder output is in planar form, where each channel follows the
@@ -389,10 +427,10 @@ void ShellAudioRendererImpl::DecodedAudioReady(
           memcpy(decoded_audio_bus_->channel(i), decoded_channel_data,
                  audio_bus_size_per_channel_in_bytes);
         }
+        // This is read by the renderer thread in Render(), but will only be
+        // read when decode_complete_ is set to true.
+        buffered_timestamp_ = buffer->GetTimestamp();
       }
-      // This is read by the renderer thread in Render(), but will only be read
-      // when decode_complete_ is set to true.
-      buffered_timestamp_ = buffer->GetTimestamp();
     }
   } else {
     DCHECK(status == AudioDecoder::kAborted ||
@@ -417,6 +455,25 @@ void ShellAudioRendererImpl::DecodedAudioReady(
   decode_complete_ = true;
 }
 
+void ShellAudioRendererImpl::FillFromTimeStretcher(AudioBus* dest) {
+  DCHECK(time_stretching_);
+  const int kMaxChannels = 8;
+  DCHECK_LE(dest->channels(), kMaxChannels);
+  float* channel_data[kMaxChannels];
+  for (int i = 0; i < dest->channels(); ++i)
+    channel_data[i] = dest->channel(i);
+
+  int frames = time_stretcher_->FillChannels(channel_data, dest->frames());
+  if (frames < dest->frames())
+    dest->ZeroFramesPartial(frames, dest->frames() - frames);
+
+  buffered_timestamp_ = time_stretcher_start_timestamp_ +
+      base::TimeDelta::FromMicroseconds(static_cast<int64>(
+          time_stretcher_->input_position() *
+          base::Time::kMicrosecondsPerSecond /
+          audio_parameters_.sample_rate()));
+}
+
 // CAUTION: this method will not usually execute on the renderer thread!
 // This is normally called by the system audio thread, and must not block or
 // perform high-latency operations.
@@ -444,6 +501,12 @@ int ShellAudioRendererImpl::Render(AudioBus* dest,
     base::TimeDelta adjusted_delay = (audio_delay - silence_rendered_);
     if (adjusted_delay < kZeroTimeDelta)
       adjusted_delay = kZeroTimeDelta;
+    if (time_stretching_) {
+      // The audio in the sink covers playback_rate() times its duration of
+      // the stream.
+      adjusted_delay = base::TimeDelta::FromMicroseconds(static_cast<int64>(
+          adjusted_delay.InMicroseconds() * time_stretcher_->playback_rate()));
+    }
 
     const base::TimeDelta current_time = rendered_timestamp_ - adjusted_delay;
     time_cb_.Run(current_time, rendered_timestamp_);
@@ -460,8 +523,17 @@ int ShellAudioRendererImpl::Render(AudioBus* dest,
       DCHECK_NE(dest, (AudioBus*)NULL);
       decode_complete_ = false;
       decoded_audio_bus_ = dest;
-      decoder_->Read(
-          base::Bind(&ShellAudioRendererImpl::DecodedAudioReady, this));
+      if (time_stretching_ &&
+          time_stretcher_->frames_available() >= dest->frames()) {
+        // Playing slower than real time leaves output over from earlier
+        // decodes, which is used up before decoding more.
+        FillFromTimeStretcher(dest);
+        decode_status_ = AudioDecoder::kOk;
+        decode_complete_ = true;
+      } else {
+        decoder_->Read(
+            base::Bind(&ShellAudioRendererImpl::DecodedAudioReady, this));
+      }
     }
 
     // Must be polling for the Read that is currently in progress
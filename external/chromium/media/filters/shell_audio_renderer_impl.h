@@ -17,9 +17,11 @@
 #define MEDIA_FILTERS_SHELL_AUDIO_RENDERER_IMPL_H_
 
 #include "base/callback.h"
+#include "base/memory/scoped_ptr.h"
 #include "base/message_loop.h"
 #include "media/base/audio_decoder.h"
 #include "media/filters/shell_audio_renderer.h"
+#include "media/filters/shell_audio_time_stretcher.h"
 
 namespace media {
 
@@ -125,6 +127,9 @@ class MEDIA_EXPORT ShellAudioRendererImpl : public ShellAudioRenderer {
 
   void DecodedAudioReady(AudioDecoder::Status status,
                          const scoped_refptr<Buffer>& buffer);
+  // Fills |dest| with output from time_stretcher_, padding it with silence
+  // if there isn't enough, and sets buffered_timestamp_ to match.
+  void FillFromTimeStretcher(AudioBus* dest);
 
   void OnDecoderSelected(
       scoped_ptr<AudioDecoderSelector> decoder_selector,
@@ -188,6 +193,16 @@ class MEDIA_EXPORT ShellAudioRendererImpl : public ShellAudioRenderer {
   // Read/written only in Render callback. Indicates how much silence has been
   // written to the sink after EOS was encountered
   base::TimeDelta silence_rendered_;
+
+  // Changes the tempo of the decoded audio when playing at a rate other than
+  // 1.  Once the playback rate first changes, all audio goes through it until
+  // the next Flush(), so that changing the rate back doesn't cause a glitch.
+  // Like decoded_audio_bus_, it is used by the MediaPipeline thread while a
+  // decode is pending and by the Render callback otherwise.
+  scoped_ptr<ShellAudioTimeStretcher> time_stretcher_;
+  bool time_stretching_;
+  // Timestamp of the first buffer given to time_stretcher_ since it started.
+  base::TimeDelta time_stretcher_start_timestamp_;
 };
 
 }  // namespace media
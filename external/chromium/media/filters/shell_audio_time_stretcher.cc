@@ -0,0 +1,497 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// MSVC++ requires this to be set before any other includes to get M_PI.
+#define _USE_MATH_DEFINES
+
+#include "media/filters/shell_audio_time_stretcher.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "base/cpu.h"
+#include "base/logging.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace media {
+
+namespace {
+
+// Duration of the overlap-added blocks.  Long enough to hold a couple of
+// periods of low pitched voices, short enough not to smear transients.
+const int kBlockMs = 20;
+// How far from its ideal position a block may be taken.
+const int kSearchRadiusMs = 10;
+// The search first tries every kSearchDecimation-th candidate, then every
+// candidate around the best of those.
+const int kSearchDecimation = 4;
+// Trimmed input is only erased once this many blocks of it have built up, to
+// keep the cost of moving the rest of the input down low.
+const int kTrimBlocks = 4;
+
+int MsToFrames(int ms, int sample_rate) {
+  return ms * sample_rate / 1000;
+}
+
+}  // namespace
+
+const float ShellAudioTimeStretcher::kMinPlaybackRate = 0.5f;
+const float ShellAudioTimeStretcher::kMaxPlaybackRate = 4.0f;
+
+ShellAudioTimeStretcher::ShellAudioTimeStretcher(int channels,
+                                                 int sample_rate,
+                                                 SampleType sample_type,
+                                                 StorageType storage_type)
+    : channels_(channels)
+    , sample_type_(sample_type)
+    , storage_type_(storage_type)
+    , playback_rate_(1.0f)
+    , block_size_(MsToFrames(kBlockMs, sample_rate) & ~1)
+    , hop_size_(block_size_ / 2)
+    , search_radius_(MsToFrames(kSearchRadiusMs, sample_rate))
+    , window_(block_size_)
+    , input_(channels)
+    , input_offset_(0)
+    , output_(channels)
+    , output_read_(0)
+    , overlap_(channels, std::vector<float>(hop_size_))
+    , last_block_(-1)
+    , ideal_position_(0) {
+  DCHECK_GT(channels_, 0);
+  DCHECK_GT(hop_size_, 0);
+  for (int i = 0; i < block_size_; ++i)
+    window_[i] = 0.5f * (1.0f - cosf(2.0f * M_PI * i / block_size_));
+}
+
+ShellAudioTimeStretcher::~ShellAudioTimeStretcher() {
+}
+
+void ShellAudioTimeStretcher::SetPlaybackRate(float playback_rate) {
+  playback_rate_ =
+      std::max(kMinPlaybackRate, std::min(kMaxPlaybackRate, playback_rate));
+}
+
+void ShellAudioTimeStretcher::EnqueueFrames(const uint8* data, int frames) {
+  DCHECK_GE(frames, 0);
+  int offset = static_cast<int>(search_input_.size());
+  for (int ch = 0; ch < channels_; ++ch)
+    input_[ch].resize(offset + frames);
+  search_input_.resize(offset + frames);
+
+  // Deinterleave and convert to float.
+  const int16* int16_data = reinterpret_cast<const int16*>(data);
+  const float* float_data = reinterpret_cast<const float*>(data);
+  for (int ch = 0; ch < channels_; ++ch) {
+    float* dest = &input_[ch][offset];
+    int index = storage_type_ == kStorageTypePlanar ? ch * frames : ch;
+    int step = storage_type_ == kStorageTypePlanar ? 1 : channels_;
+    if (sample_type_ == kSampleTypeInt16) {
+      for (int i = 0; i < frames; ++i, index += step)
+        dest[i] = int16_data[index] * (1.0f / 32768.0f);
+    } else {
+      for (int i = 0; i < frames; ++i, index += step)
+        dest[i] = float_data[index];
+    }
+  }
+
+  // Mix the channels down for the search.
+  float* mix = &search_input_[offset];
+  const float scale = 1.0f / channels_;
+  for (int i = 0; i < frames; ++i) {
+    float sum = 0;
+    for (int ch = 0; ch < channels_; ++ch)
+      sum += input_[ch][offset + i];
+    mix[i] = sum * scale;
+  }
+
+  Stretch();
+}
+
+int ShellAudioTimeStretcher::FillFrames(uint8* dest, int frames) {
+  frames = std::min(frames, frames_available());
+  int16* int16_dest = reinterpret_cast<int16*>(dest);
+  float* float_dest = reinterpret_cast<float*>(dest);
+  for (int ch = 0; ch < channels_; ++ch) {
+    const float* src = &output_[ch][output_read_];
+    int index = storage_type_ == kStorageTypePlanar ? ch * frames : ch;
+    int step = storage_type_ == kStorageTypePlanar ? 1 : channels_;
+    if (sample_type_ == kSampleTypeInt16) {
+      for (int i = 0; i < frames; ++i, index += step) {
+        float sample = std::max(-1.0f, std::min(1.0f, src[i]));
+        int16_dest[index] = static_cast<int16>(
+            sample * 32767.0f + (sample < 0 ? -0.5f : 0.5f));
+      }
+    } else {
+      for (int i = 0; i < frames; ++i, index += step)
+        float_dest[index] = src[i];
+    }
+  }
+  output_read_ += frames;
+  return frames;
+}
+
+int ShellAudioTimeStretcher::FillChannels(float* const* dest, int frames) {
+  frames = std::min(frames, frames_available());
+  for (int ch = 0; ch < channels_; ++ch) {
+    memcpy(dest[ch], &output_[ch][output_read_], frames * sizeof(float));
+  }
+  output_read_ += frames;
+  return frames;
+}
+
+int ShellAudioTimeStretcher::frames_available() const {
+  return static_cast<int>(output_[0].size()) - output_read_;
+}
+
+double ShellAudioTimeStretcher::input_position() const {
+  // ideal_position_ is where the output produced so far ends in the input.
+  return input_offset_ + ideal_position_ -
+         frames_available() * static_cast<double>(playback_rate_);
+}
+
+void ShellAudioTimeStretcher::Flush() {
+  for (int ch = 0; ch < channels_; ++ch) {
+    input_[ch].clear();
+    output_[ch].clear();
+  }
+  search_input_.clear();
+  input_offset_ = 0;
+  output_read_ = 0;
+  last_block_ = -1;
+  ideal_position_ = 0;
+}
+
+void ShellAudioTimeStretcher::Stretch() {
+  // Move the output that has been returned out of the way before adding to it.
+  if (output_read_ > 0) {
+    for (int ch = 0; ch < channels_; ++ch) {
+      output_[ch].erase(output_[ch].begin(),
+                        output_[ch].begin() + output_read_);
+    }
+    output_read_ = 0;
+  }
+
+  const int available = static_cast<int>(search_input_.size());
+  if (last_block_ < 0) {
+    if (available < block_size_)
+      return;
+    // Pretend the first block was overlapped with itself, so the output
+    // starts with the input rather than fading in.
+    for (int ch = 0; ch < channels_; ++ch) {
+      MultiplyAdd(&input_[ch][0], &window_[hop_size_], NULL, hop_size_,
+                  &overlap_[ch][0]);
+    }
+    AddBlock(0);
+    last_block_ = 0;
+    ideal_position_ = hop_size_ * playback_rate_;
+  }
+
+  while (true) {
+    // The natural continuation of the last block is the best match for the
+    // next one, which is searched for around its ideal position.
+    int target = last_block_ + hop_size_;
+    int ideal = static_cast<int>(ideal_position_ + 0.5);
+    int first = std::max(0, ideal - search_radius_);
+    int last = ideal + search_radius_;
+    if (std::max(target, last) + block_size_ > available)
+      break;
+
+    int block = FindBestBlock(target, first, last);
+    AddBlock(block);
+    last_block_ = block;
+    ideal_position_ += hop_size_ * playback_rate_;
+  }
+
+  TrimInput();
+}
+
+int ShellAudioTimeStretcher::FindBestBlock(int target, int first,
+                                           int last) const {
+  // Try the natural continuation first so that it wins any ties, which makes
+  // a playback rate of 1 reproduce the input exactly.
+  int best = first;
+  float best_similarity = -FLT_MAX;
+  if (target >= first && target <= last) {
+    best = target;
+    best_similarity = Similarity(target, target);
+  }
+
+  for (int candidate = first; candidate <= last;
+       candidate += kSearchDecimation) {
+    float similarity = Similarity(target, candidate);
+    if (similarity > best_similarity) {
+      best = candidate;
+      best_similarity = similarity;
+    }
+  }
+
+  int coarse_best = best;
+  int refine_first = std::max(first, coarse_best - kSearchDecimation + 1);
+  int refine_last = std::min(last, coarse_best + kSearchDecimation - 1);
+  for (int candidate = refine_first; candidate <= refine_last; ++candidate) {
+    if (candidate == coarse_best)
+      continue;
+    float similarity = Similarity(target, candidate);
+    if (similarity > best_similarity) {
+      best = candidate;
+      best_similarity = similarity;
+    }
+  }
+  return best;
+}
+
+float ShellAudioTimeStretcher::Similarity(int target, int candidate) const {
+  // The cross-correlation normalized by the energy of the candidate, so that
+  // loud candidates aren't favoured.
+  float energy;
+  float dot = DotProductAndEnergy(&search_input_[target],
+                                  &search_input_[candidate], block_size_,
+                                  &energy);
+  return energy > 0 ? dot / sqrtf(energy) : 0;
+}
+
+void ShellAudioTimeStretcher::AddBlock(int block) {
+  for (int ch = 0; ch < channels_; ++ch) {
+    std::vector<float>& output = output_[ch];
+    int size = static_cast<int>(output.size());
+    output.resize(size + hop_size_);
+    const float* src = &input_[ch][block];
+    MultiplyAdd(src, &window_[0], &overlap_[ch][0], hop_size_, &output[size]);
+    MultiplyAdd(src + hop_size_, &window_[hop_size_], NULL, hop_size_,
+                &overlap_[ch][0]);
+  }
+}
+
+void ShellAudioTimeStretcher::TrimInput() {
+  if (last_block_ < 0)
+    return;
+  int ideal = static_cast<int>(ideal_position_ + 0.5);
+  // Only the input from the next block's search range and the continuation
+  // of the last block on is needed, but trimming up to the last block keeps
+  // last_block_ from looking like no block was taken yet.
+  int keep = std::min(last_block_, ideal - search_radius_);
+  if (keep < kTrimBlocks * block_size_)
+    return;
+
+  for (int ch = 0; ch < channels_; ++ch)
+    input_[ch].erase(input_[ch].begin(), input_[ch].begin() + keep);
+  search_input_.erase(search_input_.begin(), search_input_.begin() + keep);
+  input_offset_ += keep;
+  last_block_ -= keep;
+  ideal_position_ -= keep;
+}
+
+// static
+float ShellAudioTimeStretcher::DotProductAndEnergy(const float* a,
+                                                   const float* b, int len,
+                                                   float* energy) {
+  // Rely on function level static initialization to keep
+  // DotProductAndEnergyProc selection thread safe.
+  typedef float (*DotProductAndEnergyProc)(const float* a, const float* b,
+                                           int len, float* energy);
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+  static const DotProductAndEnergyProc kDotProductAndEnergyProc =
+      base::CPU().has_sse() ? DotProductAndEnergy_SSE : DotProductAndEnergy_C;
+#elif defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+  static const DotProductAndEnergyProc kDotProductAndEnergyProc =
+      DotProductAndEnergy_NEON;
+#else
+  static const DotProductAndEnergyProc kDotProductAndEnergyProc =
+      DotProductAndEnergy_C;
+#endif
+
+  return kDotProductAndEnergyProc(a, b, len, energy);
+}
+
+// static
+float ShellAudioTimeStretcher::DotProductAndEnergy_C(const float* a,
+                                                     const float* b, int len,
+                                                     float* energy) {
+  float dot = 0;
+  float sum = 0;
+  for (int i = 0; i < len; ++i) {
+    dot += a[i] * b[i];
+    sum += b[i] * b[i];
+  }
+  *energy = sum;
+  return dot;
+}
+
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+// static
+float ShellAudioTimeStretcher::DotProductAndEnergy_SSE(const float* a,
+                                                       const float* b,
+                                                       int len,
+                                                       float* energy) {
+  __m128 m_dot = _mm_setzero_ps();
+  __m128 m_energy = _mm_setzero_ps();
+  int rem = len % 4;
+  for (int i = 0; i < len - rem; i += 4) {
+    __m128 m_b = _mm_loadu_ps(b + i);
+    m_dot = _mm_add_ps(m_dot, _mm_mul_ps(_mm_loadu_ps(a + i), m_b));
+    m_energy = _mm_add_ps(m_energy, _mm_mul_ps(m_b, m_b));
+  }
+
+  // Sum components together.
+  float dot;
+  m_dot = _mm_add_ps(_mm_movehl_ps(m_dot, m_dot), m_dot);
+  _mm_store_ss(&dot, _mm_add_ss(m_dot, _mm_shuffle_ps(m_dot, m_dot, 1)));
+  m_energy = _mm_add_ps(_mm_movehl_ps(m_energy, m_energy), m_energy);
+  _mm_store_ss(energy, _mm_add_ss(m_energy,
+                                  _mm_shuffle_ps(m_energy, m_energy, 1)));
+
+  // Handle any remaining values that wouldn't fit in an SSE pass.
+  if (rem) {
+    float rem_energy;
+    dot += DotProductAndEnergy_C(a + len - rem, b + len - rem, rem,
+                                 &rem_energy);
+    *energy += rem_energy;
+  }
+  return dot;
+}
+#endif
+
+#if defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+// static
+float ShellAudioTimeStretcher::DotProductAndEnergy_NEON(const float* a,
+                                                        const float* b,
+                                                        int len,
+                                                        float* energy) {
+  float32x4_t m_dot = vmovq_n_f32(0);
+  float32x4_t m_energy = vmovq_n_f32(0);
+  int rem = len % 4;
+  for (int i = 0; i < len - rem; i += 4) {
+    float32x4_t m_b = vld1q_f32(b + i);
+    m_dot = vmlaq_f32(m_dot, vld1q_f32(a + i), m_b);
+    m_energy = vmlaq_f32(m_energy, m_b, m_b);
+  }
+
+  // Sum components together.
+  float32x2_t m_half = vadd_f32(vget_high_f32(m_dot), vget_low_f32(m_dot));
+  float dot = vget_lane_f32(vpadd_f32(m_half, m_half), 0);
+  m_half = vadd_f32(vget_high_f32(m_energy), vget_low_f32(m_energy));
+  *energy = vget_lane_f32(vpadd_f32(m_half, m_half), 0);
+
+  // Handle any remaining values that wouldn't fit in a NEON pass.
+  if (rem) {
+    float rem_energy;
+    dot += DotProductAndEnergy_C(a + len - rem, b + len - rem, rem,
+                                 &rem_energy);
+    *energy += rem_energy;
+  }
+  return dot;
+}
+#endif
+
+// static
+void ShellAudioTimeStretcher::MultiplyAdd(const float* src,
+                                          const float* window,
+                                          const float* addend, int len,
+                                          float* dest) {
+  // Rely on function level static initialization to keep MultiplyAddProc
+  // selection thread safe.
+  typedef void (*MultiplyAddProc)(const float* src, const float* window,
+                                  const float* addend, int len, float* dest);
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+  static const MultiplyAddProc kMultiplyAddProc =
+      base::CPU().has_sse() ? MultiplyAdd_SSE : MultiplyAdd_C;
+#elif defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+  static const MultiplyAddProc kMultiplyAddProc = MultiplyAdd_NEON;
+#else
+  static const MultiplyAddProc kMultiplyAddProc = MultiplyAdd_C;
+#endif
+
+  kMultiplyAddProc(src, window, addend, len, dest);
+}
+
+// static
+void ShellAudioTimeStretcher::MultiplyAdd_C(const float* src,
+                                            const float* window,
+                                            const float* addend, int len,
+                                            float* dest) {
+  if (addend) {
+    for (int i = 0; i < len; ++i)
+      dest[i] = src[i] * window[i] + addend[i];
+  } else {
+    for (int i = 0; i < len; ++i)
+      dest[i] = src[i] * window[i];
+  }
+}
+
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+// static
+void ShellAudioTimeStretcher::MultiplyAdd_SSE(const float* src,
+                                              const float* window,
+                                              const float* addend, int len,
+                                              float* dest) {
+  int rem = len % 4;
+  if (addend) {
+    for (int i = 0; i < len - rem; i += 4) {
+      _mm_storeu_ps(dest + i, _mm_add_ps(
+          _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(window + i)),
+          _mm_loadu_ps(addend + i)));
+    }
+  } else {
+    for (int i = 0; i < len - rem; i += 4) {
+      _mm_storeu_ps(dest + i, _mm_mul_ps(_mm_loadu_ps(src + i),
+                                         _mm_loadu_ps(window + i)));
+    }
+  }
+
+  // Handle any remaining values that wouldn't fit in an SSE pass.
+  if (rem) {
+    int offset = len - rem;
+    MultiplyAdd_C(src + offset, window + offset,
+                  addend ? addend + offset : NULL, rem, dest + offset);
+  }
+}
+#endif
+
+#if defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+// static
+void ShellAudioTimeStretcher::MultiplyAdd_NEON(const float* src,
+                                               const float* window,
+                                               const float* addend, int len,
+                                               float* dest) {
+  int rem = len % 4;
+  if (addend) {
+    for (int i = 0; i < len - rem; i += 4) {
+      vst1q_f32(dest + i, vmlaq_f32(vld1q_f32(addend + i), vld1q_f32(src + i),
+                                    vld1q_f32(window + i)));
+    }
+  } else {
+    for (int i = 0; i < len - rem; i += 4)
+      vst1q_f32(dest + i, vmulq_f32(vld1q_f32(src + i), vld1q_f32(window + i)));
+  }
+
+  // Handle any remaining values that wouldn't fit in a NEON pass.
+  if (rem) {
+    int offset = len - rem;
+    MultiplyAdd_C(src + offset, window + offset,
+                  addend ? addend + offset : NULL, rem, dest + offset);
+  }
+}
+#endif
+
+}  // namespace media
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEDIA_FILTERS_SHELL_AUDIO_TIME_STRETCHER_H_
+#define MEDIA_FILTERS_SHELL_AUDIO_TIME_STRETCHER_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/gtest_prod_util.h"
+#include "media/base/media_export.h"
+
+namespace media {
+
+// ShellAudioTimeStretcher changes the tempo of audio without changing its
+// pitch, using WSOLA (Waveform Similarity based Overlap-Add).
+//
+// The output is built from Hann windowed blocks of input, overlapped by half
+// a block.  Each block is taken from near the point of the input that the
+// playback rate calls for, at the offset whose waveform best matches the
+// natural continuation of the previous block, so that the overlap-add doesn't
+// introduce phase cancellation.  The search runs on a mono mix of the input,
+// so its cost doesn't depend on the channel count.
+//
+// Input is processed as soon as it is enqueued, so the work happens on the
+// thread feeding the stretcher, and draining output is just a copy.
+class MEDIA_EXPORT ShellAudioTimeStretcher {
+ public:
+  enum SampleType {
+    kSampleTypeInt16,
+    kSampleTypeFloat32,
+  };
+
+  // In planar storage, all the samples of a channel follow the samples of the
+  // previous channel.
+  enum StorageType {
+    kStorageTypeInterleaved,
+    kStorageTypePlanar,
+  };
+
+  // Playback rates outside this range are clamped.
+  static const float kMinPlaybackRate;
+  static const float kMaxPlaybackRate;
+
+  ShellAudioTimeStretcher(int channels, int sample_rate,
+                          SampleType sample_type, StorageType storage_type);
+  ~ShellAudioTimeStretcher();
+
+  void SetPlaybackRate(float playback_rate);
+  float playback_rate() const { return playback_rate_; }
+
+  // Appends |frames| frames of input in the sample and storage type the
+  // stretcher was created with, and stretches as much of it as possible.
+  void EnqueueFrames(const uint8* data, int frames);
+
+  // Copies up to |frames| frames of output into |dest|, in the sample and
+  // storage type the stretcher was created with.  Returns the number of
+  // frames copied.
+  int FillFrames(uint8* dest, int frames);
+  // Copies up to |frames| frames of output as float samples into one buffer
+  // per channel, as held by an AudioBus.  Returns the number of frames copied.
+  int FillChannels(float* const* dest, int frames);
+
+  // Number of frames of output ready to be returned.
+  int frames_available() const;
+
+  // The position in the input, in frames since the last Flush(), that
+  // corresponds to the end of the output returned so far.
+  double input_position() const;
+
+  // Drops all input and output, and starts the next input as a new stream.
+  void Flush();
+
+ private:
+  FRIEND_TEST_ALL_PREFIXES(ShellAudioTimeStretcherTest, DotProductAndEnergy);
+  FRIEND_TEST_ALL_PREFIXES(ShellAudioTimeStretcherTest, MultiplyAdd);
+  FRIEND_TEST_ALL_PREFIXES(ShellAudioTimeStretcherTest, Benchmark);
+
+  // Produces output blocks while there is enough input to search for them.
+  void Stretch();
+  // Returns the start, in input frames, of the candidate block in
+  // [first, last] whose waveform best matches the block at |target|.
+  int FindBestBlock(int target, int first, int last) const;
+  // Returns how similar the blocks at |target| and |candidate| are.
+  float Similarity(int target, int candidate) const;
+  // Overlap-adds the block at |block| to the output.
+  void AddBlock(int block);
+  // Drops input that no later block can use.
+  void TrimInput();
+
+  // Returns the dot product of |a| and |b|, and the energy (the dot product
+  // with itself) of |b| in |energy|.  Neither needs to be aligned.  On x86,
+  // the underlying implementation is chosen at run time based on SSE support.
+  // On ARM, NEON support is chosen at compile time based on compilation flags.
+  static float DotProductAndEnergy(const float* a, const float* b, int len,
+                                   float* energy);
+  static float DotProductAndEnergy_C(const float* a, const float* b, int len,
+                                     float* energy);
+  static float DotProductAndEnergy_SSE(const float* a, const float* b,
+                                       int len, float* energy);
+  static float DotProductAndEnergy_NEON(const float* a, const float* b,
+                                        int len, float* energy);
+
+  // Sets dest[i] to src[i] * window[i] + addend[i].  |addend| may be NULL.
+  // None of the pointers need to be aligned, but |dest| may only alias
+  // |addend|.
+  static void MultiplyAdd(const float* src, const float* window,
+                          const float* addend, int len, float* dest);
+  static void MultiplyAdd_C(const float* src, const float* window,
+                            const float* addend, int len, float* dest);
+  static void MultiplyAdd_SSE(const float* src, const float* window,
+                              const float* addend, int len, float* dest);
+  static void MultiplyAdd_NEON(const float* src, const float* window,
+                               const float* addend, int len, float* dest);
+
+  const int channels_;
+  const SampleType sample_type_;
+  const StorageType storage_type_;
+  float playback_rate_;
+
+  // Size of the overlap-added blocks, and the distance between them in the
+  // output.  The block size is twice the hop size.
+  const int block_size_;
+  const int hop_size_;
+  // How far from the ideal position a block may be taken from the input.
+  const int search_radius_;
+  // A periodic Hann window of block_size_ frames, which adds up to one when
+  // overlapped by half.
+  std::vector<float> window_;
+
+  // Input samples of each channel, and their mono mix, which the search runs
+  // on.  Index 0 holds input frame |input_offset_|.
+  std::vector<std::vector<float> > input_;
+  std::vector<float> search_input_;
+  int64 input_offset_;
+
+  // Output samples of each channel, of which the first |output_read_| have
+  // already been returned.
+  std::vector<std::vector<float> > output_;
+  int output_read_;
+  // The second half of the last windowed block, which the next block is
+  // overlapped with.
+  std::vector<std::vector<float> > overlap_;
+
+  // Input frame the last block was taken from, or -1 before the first block.
+  int last_block_;
+  // Input frame the next block would ideally be taken from.
+  double ideal_position_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShellAudioTimeStretcher);
+};
+
+}  // namespace media
+
+#endif  // MEDIA_FILTERS_SHELL_AUDIO_TIME_STRETCHER_H_
@@ -0,0 +1,330 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// MSVC++ requires this to be set before any other includes to get M_PI.
+#define _USE_MATH_DEFINES
+
+#include "media/filters/shell_audio_time_stretcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "base/command_line.h"
+#include "base/string_number_conversions.h"
+#include "base/stringize_macros.h"
+#include "base/time.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+static const int kSampleRate = 48000;
+
+// Command line switch for runtime adjustment of Benchmark iterations.
+static const char kBenchmarkIterations[] = "time-stretch-iterations";
+
+// Returns |frames| frames of deterministic noise for each of |channels|
+// channels, interleaved.
+static std::vector<float> MakeNoise(int channels, int frames) {
+  std::vector<float> samples(channels * frames);
+  uint32 seed = 1;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    seed = seed * 1664525 + 1013904223;
+    samples[i] = static_cast<int32>(seed) / 4294967296.0f;
+  }
+  return samples;
+}
+
+// Returns |frames| frames of a sine wave at |frequency| Hz.
+static std::vector<float> MakeSine(float frequency, int frames) {
+  std::vector<float> samples(frames);
+  for (int i = 0; i < frames; ++i)
+    samples[i] = 0.5f * sinf(2 * M_PI * frequency * i / kSampleRate);
+  return samples;
+}
+
+// Feeds |input| through |stretcher| in chunks of |chunk_frames| and returns
+// the output, interleaved.
+static std::vector<float> Stretch(ShellAudioTimeStretcher* stretcher,
+                                  int channels, const std::vector<float>& input,
+                                  int chunk_frames) {
+  std::vector<float> output;
+  int frames = static_cast<int>(input.size()) / channels;
+  std::vector<float> chunk(chunk_frames * channels);
+  for (int offset = 0; offset < frames; offset += chunk_frames) {
+    int count = std::min(chunk_frames, frames - offset);
+    stretcher->EnqueueFrames(
+        reinterpret_cast<const uint8*>(&input[offset * channels]), count);
+    int available;
+    while ((available = stretcher->FillFrames(
+                reinterpret_cast<uint8*>(&chunk[0]), chunk_frames)) > 0) {
+      output.insert(output.end(), chunk.begin(),
+                    chunk.begin() + available * channels);
+    }
+  }
+  return output;
+}
+
+// Counts the upward zero crossings of a mono signal.
+static int CountZeroCrossings(const std::vector<float>& samples) {
+  int crossings = 0;
+  for (size_t i = 1; i < samples.size(); ++i) {
+    if (samples[i - 1] < 0 && samples[i] >= 0)
+      ++crossings;
+  }
+  return crossings;
+}
+
+TEST(ShellAudioTimeStretcherTest, UnityRateReproducesInput) {
+  const int kChannels = 2;
+  ShellAudioTimeStretcher stretcher(
+      kChannels, kSampleRate, ShellAudioTimeStretcher::kSampleTypeFloat32,
+      ShellAudioTimeStretcher::kStorageTypeInterleaved);
+  std::vector<float> input = MakeNoise(kChannels, kSampleRate);
+  std::vector<float> output = Stretch(&stretcher, kChannels, input, 1024);
+
+  // Everything but the last block and search radius is output.
+  ASSERT_GT(output.size(), input.size() * 9 / 10);
+  ASSERT_LE(output.size(), input.size());
+  for (size_t i = 0; i < output.size(); ++i)
+    ASSERT_NEAR(input[i], output[i], 1e-5f) << "at sample " << i;
+}
+
+TEST(ShellAudioTimeStretcherTest, OutputDurationFollowsRate) {
+  const int kChannels = 2;
+  const float kRates[] = { 0.5f, 0.75f, 1.25f, 1.5f, 2.0f };
+  std::vector<float> input = MakeNoise(kChannels, 4 * kSampleRate);
+  int input_frames = static_cast<int>(input.size()) / kChannels;
+  for (size_t i = 0; i < arraysize(kRates); ++i) {
+    ShellAudioTimeStretcher stretcher(
+        kChannels, kSampleRate, ShellAudioTimeStretcher::kSampleTypeFloat32,
+        ShellAudioTimeStretcher::kStorageTypeInterleaved);
+    stretcher.SetPlaybackRate(kRates[i]);
+    std::vector<float> output = Stretch(&stretcher, kChannels, input, 1000);
+    int output_frames = static_cast<int>(output.size()) / kChannels;
+
+    // The input held back for the search is at most 50ms.
+    EXPECT_NEAR(input_frames / kRates[i], output_frames,
+                kSampleRate / 20 / kRates[i]) << "rate " << kRates[i];
+    EXPECT_NEAR(stretcher.input_position(), output_frames * kRates[i],
+                kSampleRate / 100) << "rate " << kRates[i];
+  }
+}
+
+TEST(ShellAudioTimeStretcherTest, PitchIsPreserved) {
+  const float kFrequency = 440;
+  std::vector<float> input = MakeSine(kFrequency, 2 * kSampleRate);
+  int input_crossings = CountZeroCrossings(input);
+
+  const float kRates[] = { 0.5f, 1.5f, 2.0f };
+  for (size_t i = 0; i < arraysize(kRates); ++i) {
+    ShellAudioTimeStretcher stretcher(
+        1, kSampleRate, ShellAudioTimeStretcher::kSampleTypeFloat32,
+        ShellAudioTimeStretcher::kStorageTypeInterleaved);
+    stretcher.SetPlaybackRate(kRates[i]);
+    std::vector<float> output = Stretch(&stretcher, 1, input, 512);
+    ASSERT_FALSE(output.empty());
+
+    // The number of periods scales with the duration, not the frequency.
+    float input_frequency =
+        input_crossings * static_cast<float>(kSampleRate) / input.size();
+    float output_frequency = CountZeroCrossings(output) *
+                             static_cast<float>(kSampleRate) / output.size();
+    EXPECT_NEAR(input_frequency, output_frequency, 5) << "rate " << kRates[i];
+  }
+}
+
+TEST(ShellAudioTimeStretcherTest, PlanarInt16) {
+  const int kChannels = 2;
+  const int kFrames = 4800;
+  ShellAudioTimeStretcher stretcher(
+      kChannels, kSampleRate, ShellAudioTimeStretcher::kSampleTypeInt16,
+      ShellAudioTimeStretcher::kStorageTypePlanar);
+  // A ramp on the first channel, and its negation on the second one.
+  std::vector<int16> input(kChannels * kFrames);
+  for (int i = 0; i < kFrames; ++i) {
+    input[i] = static_cast<int16>(i * 4);
+    input[kFrames + i] = static_cast<int16>(-i * 4);
+  }
+  stretcher.EnqueueFrames(reinterpret_cast<const uint8*>(&input[0]), kFrames);
+
+  int available = stretcher.frames_available();
+  ASSERT_GT(available, kFrames / 2);
+  std::vector<int16> output(kChannels * available);
+  EXPECT_EQ(available, stretcher.FillFrames(
+      reinterpret_cast<uint8*>(&output[0]), available));
+  for (int i = 0; i < available; ++i) {
+    ASSERT_NEAR(input[i], output[i], 1);
+    ASSERT_NEAR(input[kFrames + i], output[available + i], 1);
+  }
+  EXPECT_EQ(0, stretcher.frames_available());
+}
+
+TEST(ShellAudioTimeStretcherTest, FillChannels) {
+  const int kChannels = 2;
+  const int kFrames = 4800;
+  ShellAudioTimeStretcher stretcher(
+      kChannels, kSampleRate, ShellAudioTimeStretcher::kSampleTypeFloat32,
+      ShellAudioTimeStretcher::kStorageTypePlanar);
+  std::vector<float> input = MakeNoise(kChannels, kFrames);
+  stretcher.EnqueueFrames(reinterpret_cast<const uint8*>(&input[0]), kFrames);
+
+  std::vector<float> left(kFrames);
+  std::vector<float> right(kFrames);
+  float* channels[] = { &left[0], &right[0] };
+  int filled = stretcher.FillChannels(channels, kFrames);
+  ASSERT_GT(filled, 0);
+  for (int i = 0; i < filled; ++i) {
+    ASSERT_NEAR(input[i], left[i], 1e-5f);
+    ASSERT_NEAR(input[kFrames + i], right[i], 1e-5f);
+  }
+}
+
+TEST(ShellAudioTimeStretcherTest, Flush) {
+  ShellAudioTimeStretcher stretcher(
+      1, kSampleRate, ShellAudioTimeStretcher::kSampleTypeFloat32,
+      ShellAudioTimeStretcher::kStorageTypeInterleaved);
+  stretcher.SetPlaybackRate(1.5f);
+  std::vector<float> input = MakeNoise(1, kSampleRate / 10);
+  stretcher.EnqueueFrames(reinterpret_cast<const uint8*>(&input[0]),
+                          input.size());
+  EXPECT_GT(stretcher.frames_available(), 0);
+
+  stretcher.Flush();
+  EXPECT_EQ(0, stretcher.frames_available());
+  EXPECT_EQ(0, stretcher.input_position());
+
+  // The next input starts a new stream.
+  stretcher.SetPlaybackRate(1.0f);
+  stretcher.EnqueueFrames(reinterpret_cast<const uint8*>(&input[0]),
+                          input.size());
+  std::vector<float> output(stretcher.frames_available());
+  ASSERT_FALSE(output.empty());
+  stretcher.FillFrames(reinterpret_cast<uint8*>(&output[0]), output.size());
+  for (size_t i = 0; i < output.size(); ++i)
+    ASSERT_NEAR(input[i], output[i], 1e-5f);
+}
+
+// Define platform independent function names for the optimized function
+// tests.
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE__)
+#define DOT_PRODUCT_AND_ENERGY_FUNC DotProductAndEnergy_SSE
+#define MULTIPLY_ADD_FUNC MultiplyAdd_SSE
+#elif defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+#define DOT_PRODUCT_AND_ENERGY_FUNC DotProductAndEnergy_NEON
+#define MULTIPLY_ADD_FUNC MultiplyAdd_NEON
+#endif
+
+// Ensure the optimized functions return the same values as the C versions,
+// for unaligned pointers and lengths that aren't a multiple of the vector
+// size.
+#if defined(DOT_PRODUCT_AND_ENERGY_FUNC)
+TEST(ShellAudioTimeStretcherTest, DotProductAndEnergy) {
+  std::vector<float> samples = MakeNoise(1, 1024);
+  for (int offset = 0; offset < 4; ++offset) {
+    const float* a = &samples[offset];
+    const float* b = &samples[512 + offset * 3];
+    int len = 480 + offset;
+    float energy;
+    float expected_energy;
+    float dot = ShellAudioTimeStretcher::DOT_PRODUCT_AND_ENERGY_FUNC(
+        a, b, len, &energy);
+    float expected_dot = ShellAudioTimeStretcher::DotProductAndEnergy_C(
+        a, b, len, &expected_energy);
+    EXPECT_NEAR(expected_dot, dot, 1e-4f);
+    EXPECT_NEAR(expected_energy, energy, 1e-4f);
+  }
+}
+
+TEST(ShellAudioTimeStretcherTest, MultiplyAdd) {
+  std::vector<float> samples = MakeNoise(1, 1024);
+  for (int offset = 0; offset < 4; ++offset) {
+    const float* src = &samples[offset];
+    const float* window = &samples[256 + offset * 3];
+    const float* addend = &samples[512 + offset];
+    int len = 240 + offset;
+    std::vector<float> dest(len);
+    std::vector<float> expected(len);
+
+    ShellAudioTimeStretcher::MULTIPLY_ADD_FUNC(src, window, addend, len,
+                                               &dest[0]);
+    ShellAudioTimeStretcher::MultiplyAdd_C(src, window, addend, len,
+                                           &expected[0]);
+    for (int i = 0; i < len; ++i)
+      ASSERT_FLOAT_EQ(expected[i], dest[i]);
+
+    ShellAudioTimeStretcher::MULTIPLY_ADD_FUNC(src, window, NULL, len,
+                                               &dest[0]);
+    ShellAudioTimeStretcher::MultiplyAdd_C(src, window, NULL, len,
+                                           &expected[0]);
+    for (int i = 0; i < len; ++i)
+      ASSERT_FLOAT_EQ(expected[i], dest[i]);
+  }
+}
+#endif
+
+// Benchmark the cost of stretching, in nanoseconds per output frame, for a
+// few playback rates and channel counts.  Make sure to build with
+// branding=Chrome so that DCHECKs are compiled out when benchmarking.
+TEST(ShellAudioTimeStretcherTest, Benchmark) {
+  // Retrieve benchmark iterations from command line.  Each iteration
+  // stretches one second of audio.
+  int iterations = 2;
+  std::string value(CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+      kBenchmarkIterations));
+  if (!value.empty())
+    base::StringToInt(value, &iterations);
+
+  const int kChannels[] = { 1, 2, 6 };
+  const float kRates[] = { 0.5f, 1.0f, 1.25f, 1.5f, 2.0f };
+  const int kChunkFrames = 1024;
+  printf("Benchmarking %d iterations:\n", iterations);
+  for (size_t c = 0; c < arraysize(kChannels); ++c) {
+    int channels = kChannels[c];
+    std::vector<float> input = MakeNoise(channels, kSampleRate);
+    std::vector<float> output(kChunkFrames * channels);
+    for (size_t r = 0; r < arraysize(kRates); ++r) {
+      ShellAudioTimeStretcher stretcher(
+          channels, kSampleRate, ShellAudioTimeStretcher::kSampleTypeFloat32,
+          ShellAudioTimeStretcher::kStorageTypeInterleaved);
+      stretcher.SetPlaybackRate(kRates[r]);
+
+      int64 output_frames = 0;
+      base::TimeTicks start = base::TimeTicks::HighResNow();
+      for (int i = 0; i < iterations; ++i) {
+        for (int offset = 0; offset + kChunkFrames <= kSampleRate;
+             offset += kChunkFrames) {
+          stretcher.EnqueueFrames(
+              reinterpret_cast<const uint8*>(&input[offset * channels]),
+              kChunkFrames);
+          int filled;
+          while ((filled = stretcher.FillFrames(
+                      reinterpret_cast<uint8*>(&output[0]), kChunkFrames))) {
+            output_frames += filled;
+          }
+        }
+      }
+      double total_ns =
+          (base::TimeTicks::HighResNow() - start).InMicrosecondsF() * 1000;
+      ASSERT_GT(output_frames, 0);
+      printf("%d channels at %.2fx: %.1fns per output frame\n", channels,
+             kRates[r], total_ns / output_frames);
+    }
+  }
+}
+
+}  // namespace media
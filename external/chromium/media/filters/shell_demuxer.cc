@@ -27,9 +27,17 @@
 #include "base/time.h"
 #include "media/base/bind_to_loop.h"
 #include "media/base/data_source.h"
+#include "media/base/shell_media_platform.h"
 
 #include <inttypes.h>
 
+namespace {
+
+// Upper bound on the number of AUs downloaded with a single read.
+static const size_t kMaxAUsPerBatch = 64;
+
+}  // namespace
+
 namespace media {
 
 ShellDemuxerStream::ShellDemuxerStream(ShellDemuxer* demuxer,
@@ -194,6 +202,8 @@ ShellDemuxer::ShellDemuxer(
     , video_reached_eos_(false) {
   DCHECK(data_source_);
   DCHECK(message_loop_);
+  max_batch_download_size_ =
+      ShellMediaPlatform::Instance()->GetMaxDemuxerBatchDownloadSize();
   reader_ = new ShellDataSourceReader();
   reader_->SetDataSource(data_source_);
 }
@@ -283,12 +293,19 @@ void ShellDemuxer::Request(DemuxerStream::Type type) {
 }
 
 void ShellDemuxer::RequestTask(DemuxerStream::Type type) {
-  DCHECK(!requested_au_) << "overlapping requests not supported!";
+  DCHECK(requested_aus_.empty()) << "overlapping requests not supported!";
   flushing_ = false;
-  // Ask parser for next AU
-  scoped_refptr<ShellAU> au = parser_->GetNextAU(type);
+  // Ask parser for the next AU, or for a run of AUs if batching is enabled
+  ShellAUVector aus;
+  size_t max_count = max_batch_download_size_ > 0 ? kMaxAUsPerBatch : 1;
+  bool parsed =
+      parser_->GetNextAUs(type, max_batch_download_size_, max_count, &aus);
   // fatal parsing error returns NULL or malformed AU
-  if (!au || !au->IsValid()) {
+  bool valid = parsed && !aus.empty();
+  for (size_t i = 0; valid && i < aus.size(); ++i) {
+    valid = aus[i] && aus[i]->IsValid();
+  }
+  if (!valid) {
     if (!stopped_) {
       DLOG(ERROR) << "got back bad AU from parser";
       host_->OnDemuxerError(DEMUXER_ERROR_COULD_NOT_PARSE);
@@ -296,6 +313,7 @@ void ShellDemuxer::RequestTask(DemuxerStream::Type type) {
     return;
   }
 
+  scoped_refptr<ShellAU> au = aus.front();
   // make sure we got back an AU of the correct type
   DCHECK(au->GetType() == type);
 
@@ -305,6 +323,7 @@ void ShellDemuxer::RequestTask(DemuxerStream::Type type) {
 
   // don't issue allocation requests for EOS AUs
   if (au->IsEndOfStream()) {
+    DCHECK_EQ(aus.size(), 1U);
     TRACE_EVENT0("media_stack", "ShellDemuxer::RequestTask() EOS sent");
     // enqueue EOS buffer with correct stream
     scoped_refptr<ShellBuffer> eos_buffer =
@@ -321,12 +340,24 @@ void ShellDemuxer::RequestTask(DemuxerStream::Type type) {
   }
 
   // enqueue the request
-  requested_au_ = au;
+  requested_aus_.swap(aus);
+
+  // A single AU gets a buffer of exactly its size, a run of AUs gets one
+  // region with an aligned slot for each AU in the run, so that every slice
+  // of the region starts on an aligned address.
+  size_t allocation_size = requested_aus_.front()->GetMaxSize();
+  if (requested_aus_.size() > 1) {
+    allocation_size = 0;
+    for (size_t i = 0; i < requested_aus_.size(); ++i) {
+      allocation_size +=
+          ShellBufferFactory::SizeAlign(requested_aus_[i]->GetMaxSize());
+    }
+  }
 
   // AllocateBuffer will return false if the requested size is larger
   // than the maximum limit for a single buffer.
   if (!ShellBufferFactory::Instance()->AllocateBuffer(
-      au->GetMaxSize(),
+      allocation_size,
       base::Bind(&ShellDemuxer::BufferAllocated, this))) {
     DLOG(ERROR) << "buffer allocation failed.";
     host_->OnDemuxerError(PIPELINE_ERROR_COULD_NOT_RENDER);
@@ -343,15 +374,16 @@ void ShellDemuxer::BufferAllocated(scoped_refptr<ShellBuffer> buffer) {
 }
 
 void ShellDemuxer::DownloadTask(scoped_refptr<ShellBuffer> buffer) {
-  // We need a requested_au_ or to have canceled this request and
+  // We need a requested AU or to have canceled this request and
   // are buffering to a new location for this to make sense
-  DCHECK(requested_au_);
+  DCHECK(!requested_aus_.empty());
 
+  scoped_refptr<ShellAU> first_au = requested_aus_.front();
   const char* event_type =
-      requested_au_->GetType() == DemuxerStream::AUDIO ? "audio" : "video";
+      first_au->GetType() == DemuxerStream::AUDIO ? "audio" : "video";
   TRACE_EVENT2("media_stack", "ShellDemuxer::DownloadTask()",
                "type", event_type,
-               "timestamp", requested_au_->GetTimestamp().InMicroseconds());
+               "timestamp", first_au->GetTimestamp().InMicroseconds());
   // do nothing if stopped
   if (stopped_) {
     DLOG(INFO) << "aborting download task, stopped";
@@ -363,32 +395,101 @@ void ShellDemuxer::DownloadTask(scoped_refptr<ShellBuffer> buffer) {
   // flushing_ will be reset by the next call to RequestTask()
   if (flushing_) {
     DLOG(INFO) << "skipped AU download due to flush";
-    requested_au_ = NULL;
+    requested_aus_.clear();
     IssueNextRequestTask();
     return;
   }
 
-  if (!requested_au_->Read(reader_, buffer)) {
+  if (requested_aus_.size() > 1) {
+    DownloadBatch(buffer);
+    return;
+  }
+
+  if (!first_au->Read(reader_, buffer)) {
     DLOG(ERROR) << "au read failed";
     host_->OnDemuxerError(PIPELINE_ERROR_READ);
     return;
   }
+  EnqueueAU(first_au, buffer);
+  DownloadDone();
+}
+
+void ShellDemuxer::DownloadBatch(scoped_refptr<ShellBuffer> region) {
+  DCHECK_GT(requested_aus_.size(), 1U);
+  // The parser guarantees the AUs are back to back in the stream, so the
+  // whole run can be downloaded with one read in to the end of the region,
+  // from which each AU is then converted in to its own slice of the region.
+  uint64 range_offset = requested_aus_.front()->GetOffset();
+  size_t range_size = BatchRangeSize();
+  TRACE_EVENT2("media_stack", "ShellDemuxer::DownloadBatch()",
+               "aus", requested_aus_.size(), "bytes", range_size);
+  uint8* range = region->GetWritableData() + region->GetDataSize() - range_size;
+
+  // Queue the read so that this thread is free to handle a seek while the
+  // range downloads, BatchReadDone() runs back on this thread. If the reader
+  // has too many reads queued already, wait for this one instead.
+  ShellDataSourceReader::AsyncReadCB read_cb = BindToLoop(
+      blocking_thread_.message_loop_proxy(),
+      base::Bind(&ShellDemuxer::BatchReadDone, this, region));
+  if (!reader_->AsyncRead(range_offset, range_size, range, read_cb)) {
+    BatchReadDone(region,
+                  reader_->BlockingRead(range_offset, range_size, range));
+  }
+}
 
-  // copy timestamp and duration values
-  buffer->SetTimestamp(requested_au_->GetTimestamp());
-  buffer->SetDuration(requested_au_->GetDuration());
+void ShellDemuxer::BatchReadDone(scoped_refptr<ShellBuffer> region,
+                                 int bytes_read) {
+  if (stopped_) {
+    DLOG(INFO) << "dropping batch download, stopped";
+    return;
+  }
 
-  // enqueue buffer into appropriate stream
-  if (requested_au_->GetType() == DemuxerStream::AUDIO) {
-    audio_demuxer_stream_->EnqueueBuffer(buffer);
-  } else if (requested_au_->GetType() == DemuxerStream::VIDEO) {
-    video_demuxer_stream_->EnqueueBuffer(buffer);
-  } else {
-    NOTREACHED() << "invalid buffer type enqueued";
+  // a seek arrived while the range downloaded, see DownloadTask()
+  if (flushing_) {
+    DLOG(INFO) << "skipped batch download due to flush";
+    requested_aus_.clear();
+    IssueNextRequestTask();
+    return;
+  }
+
+  uint64 range_offset = requested_aus_.front()->GetOffset();
+  size_t range_size = BatchRangeSize();
+  if (bytes_read != static_cast<int>(range_size)) {
+    DLOG(ERROR) << "batch read failed";
+    host_->OnDemuxerError(PIPELINE_ERROR_READ);
+    return;
   }
 
-  // finished with this au, deref
-  requested_au_ = NULL;
+  // Each slot is at least as large as its AU is in the stream, and an AU only
+  // grows in to the spare space of its own slot when converted, so
+  // converting the AUs front to back never overwrites bytes still to be read.
+  const uint8* range = region->GetData() + region->GetDataSize() - range_size;
+  size_t slot_offset = 0;
+  for (size_t i = 0; i < requested_aus_.size(); ++i) {
+    scoped_refptr<ShellAU> au = requested_aus_[i];
+    scoped_refptr<ShellBuffer> slice =
+        ShellBuffer::CreateSlice(region, slot_offset, au->GetMaxSize());
+    slot_offset += ShellBufferFactory::SizeAlign(au->GetMaxSize());
+    if (!au->ReadFromMemory(range, range_offset, range_size, slice)) {
+      DLOG(ERROR) << "au read failed";
+      host_->OnDemuxerError(PIPELINE_ERROR_READ);
+      return;
+    }
+    EnqueueAU(au, slice);
+  }
+
+  DownloadDone();
+}
+
+size_t ShellDemuxer::BatchRangeSize() const {
+  return static_cast<size_t>(
+      requested_aus_.back()->GetOffset() + requested_aus_.back()->GetSize() -
+      requested_aus_.front()->GetOffset());
+}
+
+void ShellDemuxer::DownloadDone() {
+  // finished with these aus, deref
+  requested_aus_.clear();
 
   // Calculate total range of buffered data for both audio and video.
   Ranges<base::TimeDelta> buffered(
@@ -402,8 +503,24 @@ void ShellDemuxer::DownloadTask(scoped_refptr<ShellBuffer> buffer) {
   IssueNextRequestTask();
 }
 
+void ShellDemuxer::EnqueueAU(scoped_refptr<ShellAU> au,
+                             scoped_refptr<ShellBuffer> buffer) {
+  // copy timestamp and duration values
+  buffer->SetTimestamp(au->GetTimestamp());
+  buffer->SetDuration(au->GetDuration());
+
+  // enqueue buffer into appropriate stream
+  if (au->GetType() == DemuxerStream::AUDIO) {
+    audio_demuxer_stream_->EnqueueBuffer(buffer);
+  } else if (au->GetType() == DemuxerStream::VIDEO) {
+    video_demuxer_stream_->EnqueueBuffer(buffer);
+  } else {
+    NOTREACHED() << "invalid buffer type enqueued";
+  }
+}
+
 void ShellDemuxer::IssueNextRequestTask() {
-  DCHECK(!requested_au_);
+  DCHECK(requested_aus_.empty());
   // if we're stopped don't download anymore
   if (stopped_) {
     DLOG(INFO) << "stopped so request loop is stopping";
@@ -129,6 +129,17 @@ class MEDIA_EXPORT ShellDemuxer : public Demuxer {
   bool ParseConfigBlocking();
   void RequestTask(DemuxerStream::Type type);
   void DownloadTask(scoped_refptr<ShellBuffer> buffer);
+  // Downloads all of requested_aus_ into slices of |region| and enqueues them.
+  // The range is read asynchronously, and converted by BatchReadDone().
+  void DownloadBatch(scoped_refptr<ShellBuffer> region);
+  // |bytes_read| bytes of the range were read in to the end of |region|.
+  void BatchReadDone(scoped_refptr<ShellBuffer> region, int bytes_read);
+  // bytes from the start of the first requested AU to the end of the last.
+  size_t BatchRangeSize() const;
+  // Releases requested_aus_ once they are enqueued, reports the buffered
+  // ranges and requests the next AU.
+  void DownloadDone();
+  void EnqueueAU(scoped_refptr<ShellAU> au, scoped_refptr<ShellBuffer> buffer);
   void IssueNextRequestTask();
   void SeekTask(base::TimeDelta time, const PipelineStatusCB& cb);
 
@@ -148,7 +159,14 @@ class MEDIA_EXPORT ShellDemuxer : public Demuxer {
   scoped_refptr<ShellDemuxerStream> video_demuxer_stream_;
   scoped_refptr<ShellParser> parser_;
 
-  scoped_refptr<ShellAU> requested_au_;
+  // The AUs we've allocated, or are waiting for allocation of, a buffer for.
+  // Contains more than one AU if the parser provided a run of AUs contiguous
+  // in the stream, in which case a single buffer is allocated for the whole
+  // run and is sliced in to one ShellBuffer per AU.
+  ShellAUVector requested_aus_;
+  // maximum number of bytes to download at once for a run of AUs, 0 to
+  // disable batched downloads.
+  size_t max_batch_download_size_;
   bool audio_reached_eos_;
   bool video_reached_eos_;
 };
@@ -17,6 +17,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include "base/stringprintf.h"
 #include "lb_platform.h"
 
@@ -64,6 +66,31 @@ static const uint8 kAVCPacketTypeEndOfSequence = 2;
 // SCRIPTDATA parsing constants
 static const uint8 kAMF0NumberType = 0x00;
 static const int kAMF0NumberLength = 9;
+static const uint8 kAMF0StrictArrayType = 0x0a;
+// type marker and uint32 count
+static const int kAMF0StrictArrayHeaderLength = 5;
+
+// The keyframe index scan downloads tag headers in windows of this size, so
+// the headers of small tags, like audio tags, come several to a read.
+static const int kIndexScanWindowSize = 8 * 1024;
+// bytes of an FLV tag needed to tell if it is a video keyframe
+static const int kKeyframeCheckSize = kTagSize + 2;
+
+// Returns true if |tag| points at the header of a tag carrying AVC keyframe
+// data. |tag| must have at least kKeyframeCheckSize bytes.
+static bool IsVideoKeyframeTag(const uint8* tag) {
+  uint32 tag_data_size = LB::Platform::load_uint32_big_endian(tag + 1) >> 8;
+  return tag[0] == kVideoTagType &&
+         tag_data_size >= kVideoTagSize &&
+         tag[kTagSize] == (0x10 | kCodecIDAVC) &&
+         tag[kTagSize + 1] == kAVCPacketTypeNALU;
+}
+
+// Extracts the timestamp from an FLV tag header, wonky byte order comes from
+// the standard.
+static uint32 LoadTagTimestamp(const uint8* tag) {
+  return tag[4] << 16 | tag[5] << 8 | tag[6] | tag[7] << 24;
+}
 
 // static
 scoped_refptr<ShellParser> ShellFLVParser::Construct(
@@ -96,6 +123,9 @@ ShellFLVParser::ShellFLVParser(
     uint32 tag_start_offset)
     : ShellAVCParser(reader)
     , tag_offset_(tag_start_offset)
+    , index_scan_offset_(tag_start_offset)
+    , keyframe_index_complete_(false)
+    , found_video_keyframe_(false)
     , at_end_of_file_(false) {
 }
 
@@ -105,8 +135,7 @@ ShellFLVParser::~ShellFLVParser() {
 bool ShellFLVParser::ParseConfig() {
   // traverse file until we either reach the limit of bytes we're willing to
   // parse of config info or we've encountered actual keyframe video data.
-  while (tag_offset_ < kMetadataMaxBytes &&
-         time_to_byte_map_.size() == 0) {
+  while (tag_offset_ < kMetadataMaxBytes && !found_video_keyframe_) {
      if (!ParseNextTag()) {
        return false;
      }
@@ -136,66 +165,78 @@ scoped_refptr<ShellAU> ShellFLVParser::GetNextAU(DemuxerStream::Type type) {
 
 // seeking an flv:
 // 1) finding nearest video keyframe before timestamp:
-//  a) If we are seeking in to an area we have already parsed then we
-//      will find the bounding keyframe.
-//  b) If not, we parse the FLV until a) is true.
+//  a) If the keyframe index came from the metadata, or we have already
+//     indexed past the timestamp, we will find the bounding keyframe.
+//  b) If not, we scan the tag headers until a) is true.
 // 2) set tag_offset_ to the byte offset of the keyframe found in 1)
 bool ShellFLVParser::SeekTo(base::TimeDelta timestamp) {
   // convert timestamp to millisecond FLV timestamp
   uint32 timestamp_flv = (uint32)timestamp.InMilliseconds();
-  bool found_upper_bound = false;
-  uint64 seek_byte_offset = tag_offset_;
-  uint32 seek_timestamp = 0;
+  // this is case 1b)
+  if (!keyframe_index_complete_ &&
+      (time_to_byte_map_.empty() ||
+       time_to_byte_map_.rbegin()->first <= timestamp_flv)) {
+    if (!IndexKeyframesUntil(timestamp_flv)) {
+      return false;
+    }
+  }
+  // is map empty? This is an error case, we should always have found a
+  // keyframe during ParseConfig()
+  if (time_to_byte_map_.empty()) {
+    NOTREACHED() << "empty time to byte map on FLV seek";
+    return false;
+  }
   // upper_bound returns iterator of first element in container with key > arg
   TimeToByteMap::iterator keyframe_in_map =
       time_to_byte_map_.upper_bound(timestamp_flv);
-  // this is case 1a), or keyframe is last keyframe before EOS,
-  // or map is empty (error state)
-  if (keyframe_in_map == time_to_byte_map_.end()) {
-    // is map empty? This is an error case, we should always have found a
-    // keyframe during ParseConfig()
-    if (time_to_byte_map_.size() == 0) {
-      NOTREACHED() << "empty time to byte map on FLV seek";
-      return false;
-    } else {
-      // start at last keyframe in the map and parse from there
-      seek_byte_offset = time_to_byte_map_.rbegin()->second;
-    }
-  } else {
-    found_upper_bound = true;
-    // it's possible timestamp <= first keyframe in map, in which case we
-    // use the first keyframe in map.
-    if (keyframe_in_map != time_to_byte_map_.begin()) {
-      keyframe_in_map--;
-    }
-    seek_byte_offset = keyframe_in_map->second;
-    seek_timestamp = keyframe_in_map->first;
-  }
-  // if seek has changed our position in the file jump there now
-  if (seek_byte_offset != tag_offset_) {
-    JumpParserTo(seek_byte_offset);
-  }
-  // if found_upper_bound is still false we are in case 1b), parse ahead until
-  // we encounter an upper bound or an eof
-  while (!found_upper_bound && !at_end_of_file_) {
-    // save highest keyframe in file in case it becomes the one we want
-    seek_byte_offset = time_to_byte_map_.rbegin()->second;
-    seek_timestamp = time_to_byte_map_.rbegin()->first;
-    // parse next tag in the file
-    if (!ParseNextTag()) {
-      return false;
-    }
-    // check last keyframe timestamp, if it's greater than our target timestamp
-    // we can stop
-    found_upper_bound = (time_to_byte_map_.rbegin()->first > timestamp_flv);
+  // it's possible timestamp < first keyframe in map, in which case we
+  // use the first keyframe in map.
+  if (keyframe_in_map != time_to_byte_map_.begin()) {
+    keyframe_in_map--;
   }
-  // make sure we have done step 2), jump parser to new keyframe
-  if (seek_byte_offset != tag_offset_) {
-    JumpParserTo(seek_byte_offset);
+  // jump parser to new keyframe
+  if (keyframe_in_map->second != tag_offset_) {
+    JumpParserTo(keyframe_in_map->second);
   }
   DLOG(INFO) << base::StringPrintf(
       "flv parser seeking to timestamp: %" PRId64" chose keyframe at %d",
-      timestamp.InMilliseconds(), seek_timestamp);
+      timestamp.InMilliseconds(), keyframe_in_map->first);
+  return true;
+}
+
+bool ShellFLVParser::IndexKeyframesUntil(uint32 timestamp) {
+  scoped_array<uint8> window(new uint8[kIndexScanWindowSize]);
+  uint64 window_offset = 0;
+  int window_size = 0;
+  uint64 offset = index_scan_offset_;
+  while (true) {
+    if (offset < window_offset ||
+        offset + kKeyframeCheckSize > window_offset + window_size) {
+      window_offset = offset;
+      window_size = reader_->BlockingRead(offset, kIndexScanWindowSize,
+                                          window.get());
+      if (window_size < 0) {
+        return false;
+      }
+      if (window_size < kKeyframeCheckSize) {
+        // the last tag in the file has been indexed.
+        keyframe_index_complete_ = true;
+        break;
+      }
+    }
+    const uint8* tag = window.get() + (offset - window_offset);
+    uint32 tag_data_size = LB::Platform::load_uint32_big_endian(tag + 1) >> 8;
+    uint32 tag_timestamp = LoadTagTimestamp(tag);
+    bool is_keyframe = IsVideoKeyframeTag(tag);
+    if (is_keyframe) {
+      time_to_byte_map_[tag_timestamp] = offset;
+    }
+    offset += kTagSize + tag_data_size + 4;
+    if (is_keyframe && tag_timestamp > timestamp) {
+      break;
+    }
+  }
+  index_scan_offset_ = std::max(index_scan_offset_, offset);
   return true;
 }
 
@@ -280,11 +321,7 @@ bool ShellFLVParser::ParseNextTag() {
   uint32 tag_data_size =
       LB::Platform::load_uint32_big_endian(tag_buffer + 1) >> 8;
 
-  // extract timestamp, wonky byte order comes from the standard
-  int32 timestamp = tag_buffer[4] << 16
-                  | tag_buffer[5] << 8
-                  | tag_buffer[6]
-                  | tag_buffer[7] << 24;
+  int32 timestamp = LoadTagTimestamp(tag_buffer);
 
   // choose which tag type to parse
   bool parse_result = true;
@@ -315,6 +352,10 @@ bool ShellFLVParser::ParseNextTag() {
   }
 
   // advance read pointer to next tag header
+  if (tag_offset_ == index_scan_offset_) {
+    // this tag's keyframe, if any, has now been added to the index
+    index_scan_offset_ += kTagSize + tag_data_size + 4;
+  }
   tag_offset_ += kTagSize + tag_data_size + 4;
   return parse_result;
 }
@@ -402,10 +443,9 @@ bool ShellFLVParser::ParseVideoDataTag(uint8* tag,
   } else if (tag[1] == kAVCPacketTypeNALU) {  // raw AVC data
     // should we add this to our keyframe map?
     bool is_keyframe = (tag[0] & 0xf0) == 0x10;
-    // TODO: when we add support for seeking, make sure these numbers are
-    // consistent with the numbers provided by the time-to-byte manifest.
     if (is_keyframe) {
       time_to_byte_map_[timestamp] = tag_offset_;
+      found_video_keyframe_ = true;
     }
     // extract 24-bit composition time offset for this frame
     int32 composition_time_offset =
@@ -473,9 +513,54 @@ bool ShellFLVParser::ParseScriptDataObjectTag(uint8* tag,
     bits_per_second_ = (uint32)(byterate * 8.0);
   }
 
+  // The keyframes index is optional too.
+  ParseKeyframesMetadata(script_buffer);
+
   return true;
 }
 
+// Many FLV muxers add a keyframes object to onMetaData, with two strict
+// arrays: filepositions holds the offsets of the keyframe tags and times their
+// timestamps in seconds. It lets seeks go straight to the right keyframe.
+void ShellFLVParser::ParseKeyframesMetadata(
+    scoped_refptr<ShellScopedArray> amf0) {
+  std::vector<double> positions;
+  std::vector<double> times;
+  if (!ExtractAMF0NumberArray(amf0, "filepositions", &positions) ||
+      !ExtractAMF0NumberArray(amf0, "times", &times) ||
+      positions.empty() || positions.size() != times.size()) {
+    return;
+  }
+  // The positions must be after this tag and increasing, and the times
+  // must not decrease.
+  int64 file_size = reader_->FileSize();
+  TimeToByteMap keyframes;
+  double last_position = tag_offset_;
+  double last_time = 0;
+  for (size_t i = 0; i < positions.size(); ++i) {
+    if (positions[i] <= last_position || times[i] < last_time ||
+        (file_size > 0 && positions[i] >= file_size)) {
+      DLOG(WARNING) << "ignoring invalid FLV keyframes metadata";
+      return;
+    }
+    last_position = positions[i];
+    last_time = times[i];
+    keyframes[(uint32)(times[i] * 1000.0 + 0.5)] = (uint64)positions[i];
+  }
+  // Make sure the first position points at a keyframe, so a file whose
+  // metadata doesn't match its tags falls back to building the index.
+  uint8 tag[kKeyframeCheckSize];
+  uint64 first_position = keyframes.begin()->second;
+  if (reader_->BlockingRead(first_position, kKeyframeCheckSize, tag) <
+          kKeyframeCheckSize ||
+      !IsVideoKeyframeTag(tag)) {
+    DLOG(WARNING) << "FLV keyframes metadata doesn't match the file";
+    return;
+  }
+  time_to_byte_map_.insert(keyframes.begin(), keyframes.end());
+  keyframe_index_complete_ = true;
+}
+
 // The SCRIPTDATA tag contains a list of ordered pairs of AMF0 strings followed
 // by an arbitrary AMF0 object. Typically there's one object of interest with
 // string name 'onMetaData' followed by an anonymous object. In any event we
@@ -486,14 +571,73 @@ bool ShellFLVParser::ExtractAMF0Number(scoped_refptr<ShellScopedArray> amf0,
                                        const char* name,
                                        double* number_out) {
   DCHECK(number_out);
+  int offset = FindAMF0Name(amf0, name, kAMF0NumberLength);
+  if (offset < 0) {
+    return false;
+  }
+  uint8* buffer = amf0->Get();
+  // make sure the first byte matches the number type code
+  if (buffer[offset] != kAMF0NumberType) {
+    return false;
+  }
+  // advance pointer past the number type to the number itself, load
+  // big-endian double as uint, then cast to correct type
+  uint64 num_as_uint = LB::Platform::load_uint64_big_endian(buffer + offset + 1);
+  *number_out = *((double*)(&num_as_uint));
+  return true;
+}
+
+// A strict array is its type code followed by a u32 big-endian count and then
+// that many values, which we require to all be Numbers.
+bool ShellFLVParser::ExtractAMF0NumberArray(
+    scoped_refptr<ShellScopedArray> amf0,
+    const char* name,
+    std::vector<double>* numbers_out) {
+  DCHECK(numbers_out);
+  int offset = FindAMF0Name(amf0, name, kAMF0StrictArrayHeaderLength);
+  if (offset < 0) {
+    return false;
+  }
+  uint8* buffer = amf0->Get();
+  if (buffer[offset] != kAMF0StrictArrayType) {
+    return false;
+  }
+  uint32 count = LB::Platform::load_uint32_big_endian(buffer + offset + 1);
+  offset += kAMF0StrictArrayHeaderLength;
+  if (count > (amf0->Size() - offset) / kAMF0NumberLength) {
+    return false;
+  }
+  numbers_out->resize(count);
+  for (uint32 i = 0; i < count; ++i) {
+    if (buffer[offset] != kAMF0NumberType) {
+      return false;
+    }
+    uint64 num_as_uint =
+        LB::Platform::load_uint64_big_endian(buffer + offset + 1);
+    (*numbers_out)[i] = *((double*)(&num_as_uint));
+    offset += kAMF0NumberLength;
+  }
+  return true;
+}
+
+// The SCRIPTDATA tag contains a list of ordered pairs of AMF0 strings followed
+// by an arbitrary AMF0 object. Typically there's one object of interest with
+// string name 'onMetaData' followed by an anonymous object. In any event we
+// will scan the buffer looking only for the provided string and return the
+// offset of the value following it.
+// b/8091962 is to replace this (brittle) code with a proper AMF0 parser.
+int ShellFLVParser::FindAMF0Name(scoped_refptr<ShellScopedArray> amf0,
+                                 const char* name,
+                                 int value_size) {
   // the string will be proceeded by a u16 big-endian string length
   uint16 name_length = strlen(name);
   // there's lots of nonprinting characters and zeros in amf0, so we'll need
   // to search for the string using our own method
   int match_offset = 0;
   int name_offset = 0;
-  // the last index in the buffer we could extract a string followed by Number
-  int search_length = amf0->Size() - (name_length + kAMF0NumberLength);
+  // the last index in the buffer that could be part of a string followed by
+  // a value
+  int search_length = amf0->Size() - value_size;
   uint8* search_buffer = amf0->Get();
   while (match_offset <= search_length && name_offset < name_length) {
     if (search_buffer[match_offset] == name[name_offset]) {
@@ -505,22 +649,12 @@ bool ShellFLVParser::ExtractAMF0Number(scoped_refptr<ShellScopedArray> amf0,
   }
   // If we got a match name_offset will be pointing past the end of the search
   // string and match_offset will be pointing to valid memory with room to
-  // extract a Number
+  // extract the value
   if ((name_offset == name_length) &&
-      (match_offset <= amf0->Size() - kAMF0NumberLength)) {
-    // make sure the first byte matches the number type code
-    if (search_buffer[match_offset] != kAMF0NumberType) {
-      return false;
-    }
-    // advance pointer past the number type to the number itself
-    match_offset++;
-    // load big-endian double as uint, then cast to correct type
-    uint64 num_as_uint = LB::Platform::load_uint64_big_endian(
-        search_buffer + match_offset);
-    *number_out = *((double*)(&num_as_uint));
-    return true;
+      (match_offset <= (int)amf0->Size() - value_size)) {
+    return match_offset;
   }
-  return false;
+  return -1;
 }
 
 void ShellFLVParser::JumpParserTo(uint64 byte_offset) {
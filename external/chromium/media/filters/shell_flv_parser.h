@@ -19,6 +19,7 @@
 
 #include <map>
 #include <list>
+#include <vector>
 
 #include "media/base/shell_buffer_factory.h"
 #include "media/filters/shell_avc_parser.h"
@@ -57,10 +58,30 @@ class ShellFLVParser : public ShellAVCParser {
   bool ParseVideoDataTag(uint8* tag, uint32 size, uint32 timestamp);
   bool ParseScriptDataObjectTag(uint8* tag, uint32 size, uint32 timestamp);
 
+  // Walks the FLV tag headers from index_scan_offset_, adding every video
+  // keyframe to time_to_byte_map_, until it has found a keyframe later than
+  // |timestamp| or reached the end of the file. Only the tag headers are
+  // read, several at a time where the tags are small. Returns false on fatal
+  // error.
+  bool IndexKeyframesUntil(uint32 timestamp);
+
   // SCRIPTDATAOBJECT parsing
   bool ExtractAMF0Number(scoped_refptr<ShellScopedArray> amf0,
                          const char* name,
                          double* number_out);
+  // Extracts an AMF0 strict array of Numbers, such as the filepositions and
+  // times arrays of the onMetaData keyframes object.
+  bool ExtractAMF0NumberArray(scoped_refptr<ShellScopedArray> amf0,
+                              const char* name,
+                              std::vector<double>* numbers_out);
+  // Returns the offset just past the AMF0 string |name| in |amf0| if it is
+  // followed by at least |value_size| bytes, or -1.
+  int FindAMF0Name(scoped_refptr<ShellScopedArray> amf0,
+                   const char* name,
+                   int value_size);
+  // Fills time_to_byte_map_ from the keyframes object in the onMetaData
+  // SCRIPTDATA, if it has one and it looks valid.
+  void ParseKeyframesMetadata(scoped_refptr<ShellScopedArray> amf0);
 
   // flush internal parsing state and move tag_offset_ to the provided argument.
   void JumpParserTo(uint64 byte_offset);
@@ -72,11 +93,21 @@ class ShellFLVParser : public ShellAVCParser {
   // Stores a map of video keyframe times to byte offsets in the FLV file. At
   // peak keyframe rates of 1 per second of video, and 16 bytes per entry
   // this map will consume approximately 1 MB of memory for 18 hours
-  // of video worst-case. We build the data structure while traversing the
-  // FLV tag-to-tag. The stream positions point at the start of the FLV tag
-  // just like the entry conditions for tag_offset_ in ParseNextTag().
+  // of video worst-case. If the onMetaData SCRIPTDATA has a keyframes object
+  // the map is filled from it, otherwise we build the data structure while
+  // traversing the FLV tag-to-tag. The stream positions point at the start of
+  // the FLV tag just like the entry conditions for tag_offset_ in
+  // ParseNextTag().
   typedef std::map<uint32, uint64> TimeToByteMap;
   TimeToByteMap time_to_byte_map_;
+  // Every keyframe in a tag before this offset is in time_to_byte_map_.
+  uint64 index_scan_offset_;
+  // True once time_to_byte_map_ covers the whole file, either because it came
+  // from the metadata or because the index scan reached the end of the file.
+  bool keyframe_index_complete_;
+  // True once ParseNextTag() has encountered a video keyframe, which should
+  // follow the configuration tags.
+  bool found_video_keyframe_;
 
   // We maintain a record of data tags we have parsed headers for but not
   // downloaded the actual byte contents of.
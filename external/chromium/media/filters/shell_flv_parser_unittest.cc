@@ -0,0 +1,318 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "media/filters/shell_flv_parser.h"
+
+#include <stdlib.h>  // for rand
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "base/time.h"
+#include "lb_platform.h"
+#include "media/base/mock_shell_data_source_reader.h"
+#include "media/base/shell_buffer_factory.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+namespace media {
+
+namespace {
+
+// Offset of the first tag, after the FLV header and PreviousTagSize0.
+const uint32 kFirstTagOffset = 9 + 4;
+const uint8 kAudioTagType = 8;
+const uint8 kVideoTagType = 9;
+const uint8 kScriptDataObjectTagType = 18;
+
+// Builds an FLV file with an onMetaData tag followed by interleaved AAC and
+// AVC data tags, 30 video frames and about 43 audio frames per second with a
+// keyframe every |keyframe_interval| video frames.
+class FLVBuilder {
+ public:
+  FLVBuilder(int duration_seconds, int keyframe_interval,
+             bool keyframes_metadata)
+      : duration_seconds_(duration_seconds) {
+    // A/V tags are written first so the keyframe positions are known, the
+    // script tag is the same size whatever the positions are.
+    std::vector<uint8> tags;
+    uint32 video_ms = 0;
+    uint32 audio_ms = 0;
+    int frame = 0;
+    while (video_ms < duration_seconds * 1000U) {
+      if (audio_ms <= video_ms) {
+        const uint8 kAudio[] = { 0xaf, 0x01, 0x21, 0x10, 0x04, 0x60 };
+        WriteTag(kAudioTagType, audio_ms, kAudio, sizeof(kAudio), &tags);
+        audio_ms += 23;
+        continue;
+      }
+      bool is_keyframe = frame % keyframe_interval == 0;
+      // frames of different sizes, keyframes being the largest
+      std::vector<uint8> video(is_keyframe ? 600 : 40 + frame % 200, 0x5a);
+      video[0] = is_keyframe ? 0x17 : 0x27;
+      video[1] = 0x01;
+      video[2] = video[3] = video[4] = 0;
+      if (is_keyframe) {
+        keyframe_times_.push_back(video_ms);
+        keyframe_positions_.push_back(tags.size());
+      }
+      WriteTag(kVideoTagType, video_ms, &video[0], video.size(), &tags);
+      video_ms = ++frame * 1000 / 30;
+    }
+
+    std::vector<uint8> script;
+    BuildScriptTag(keyframes_metadata, 0, &script);
+    for (size_t i = 0; i < keyframe_positions_.size(); ++i)
+      keyframe_positions_[i] += kFirstTagOffset + script.size();
+    script.clear();
+    BuildScriptTag(keyframes_metadata, 0, &script);
+
+    const uint8 kHeader[] = { 'F', 'L', 'V', 0x01, 0x05, 0, 0, 0, 9,
+                              0, 0, 0, 0 };
+    file_.assign(kHeader, kHeader + sizeof(kHeader));
+    file_.insert(file_.end(), script.begin(), script.end());
+    file_.insert(file_.end(), tags.begin(), tags.end());
+  }
+
+  // Same as the constructor's script tag, but with every file position
+  // moved by |position_error| bytes.
+  void CorruptKeyframesMetadata(int position_error) {
+    std::vector<uint8> script;
+    BuildScriptTag(true, position_error, &script);
+    std::copy(script.begin(), script.end(), file_.begin() + kFirstTagOffset);
+  }
+
+  const std::vector<uint8>& file() const { return file_; }
+  const std::vector<uint32>& keyframe_times() const { return keyframe_times_; }
+  const std::vector<uint64>& keyframe_positions() const {
+    return keyframe_positions_;
+  }
+
+ private:
+  static void WriteTag(uint8 type, uint32 timestamp, const uint8* data,
+                       size_t size, std::vector<uint8>* out) {
+    uint8 header[11];
+    header[0] = type;
+    header[1] = size >> 16;
+    header[2] = size >> 8;
+    header[3] = size;
+    header[4] = timestamp >> 16;
+    header[5] = timestamp >> 8;
+    header[6] = timestamp;
+    header[7] = timestamp >> 24;
+    header[8] = header[9] = header[10] = 0;
+    out->insert(out->end(), header, header + sizeof(header));
+    out->insert(out->end(), data, data + size);
+    WriteUint32(sizeof(header) + size, out);
+  }
+
+  static void WriteUint32(uint32 value, std::vector<uint8>* out) {
+    uint8 bytes[4];
+    LB::Platform::store_uint32_big_endian(value, bytes);
+    out->insert(out->end(), bytes, bytes + sizeof(bytes));
+  }
+
+  static void WriteAMF0Name(const char* name, std::vector<uint8>* out) {
+    size_t length = strlen(name);
+    out->push_back(length >> 8);
+    out->push_back(length);
+    out->insert(out->end(), name, name + length);
+  }
+
+  static void WriteAMF0Number(double number, std::vector<uint8>* out) {
+    uint64 num_as_uint = *reinterpret_cast<uint64*>(&number);
+    uint8 bytes[8];
+    LB::Platform::store_uint64_big_endian(num_as_uint, bytes);
+    out->push_back(0x00);
+    out->insert(out->end(), bytes, bytes + sizeof(bytes));
+  }
+
+  void BuildScriptTag(bool keyframes_metadata, int position_error,
+                      std::vector<uint8>* out) {
+    std::vector<uint8> amf0;
+    amf0.push_back(0x02);
+    WriteAMF0Name("onMetaData", &amf0);
+    // ECMA array
+    amf0.push_back(0x08);
+    WriteUint32(keyframes_metadata ? 2 : 1, &amf0);
+    WriteAMF0Name("duration", &amf0);
+    WriteAMF0Number(duration_seconds_, &amf0);
+    if (keyframes_metadata) {
+      WriteAMF0Name("keyframes", &amf0);
+      // anonymous object
+      amf0.push_back(0x03);
+      WriteAMF0Name("filepositions", &amf0);
+      amf0.push_back(0x0a);
+      WriteUint32(keyframe_positions_.size(), &amf0);
+      for (size_t i = 0; i < keyframe_positions_.size(); ++i)
+        WriteAMF0Number(keyframe_positions_[i] + position_error, &amf0);
+      WriteAMF0Name("times", &amf0);
+      amf0.push_back(0x0a);
+      WriteUint32(keyframe_times_.size(), &amf0);
+      for (size_t i = 0; i < keyframe_times_.size(); ++i)
+        WriteAMF0Number(keyframe_times_[i] / 1000.0, &amf0);
+      // object end
+      const uint8 kObjectEnd[] = { 0, 0, 9 };
+      amf0.insert(amf0.end(), kObjectEnd, kObjectEnd + sizeof(kObjectEnd));
+    }
+    const uint8 kObjectEnd[] = { 0, 0, 9 };
+    amf0.insert(amf0.end(), kObjectEnd, kObjectEnd + sizeof(kObjectEnd));
+    WriteTag(kScriptDataObjectTagType, 0, &amf0[0], amf0.size(), out);
+  }
+
+  int duration_seconds_;
+  std::vector<uint8> file_;
+  std::vector<uint32> keyframe_times_;
+  std::vector<uint64> keyframe_positions_;
+};
+
+}  // namespace
+
+class ShellFLVParserTest : public testing::Test {
+ protected:
+  ShellFLVParserTest() : read_count_(0) {
+    // we create and destroy buffer factory after each test to detect any
+    // leaked reference-counted objects or pending callbacks
+    ShellBufferFactory::Initialize();
+    reader_ = new ::testing::NiceMock<MockShellDataSourceReader>();
+    ON_CALL(*reader_, BlockingRead(_, _, _))
+        .WillByDefault(Invoke(this, &ShellFLVParserTest::BlockingRead));
+  }
+
+  virtual ~ShellFLVParserTest() {
+    parser_ = NULL;
+    reader_->Stop(base::Closure());
+    reader_ = NULL;
+    ShellBufferFactory::Terminate();
+  }
+
+  void CreateParser(const FLVBuilder& builder) {
+    builder_ = &builder;
+    ON_CALL(*reader_, FileSize())
+        .WillByDefault(Return(builder.file().size()));
+    parser_ = new ShellFLVParser(reader_, kFirstTagOffset);
+    ASSERT_TRUE(parser_->ParseConfig());
+  }
+
+  int BlockingRead(int64 position, int size, uint8* data) {
+    ++read_count_;
+    const std::vector<uint8>& file = builder_->file();
+    if (position >= static_cast<int64>(file.size()))
+      return 0;
+    size = std::min<int64>(size, file.size() - position);
+    memcpy(data, &file[position], size);
+    return size;
+  }
+
+  // Seeks to |timestamp| and checks the next video AU is the keyframe at or
+  // before it. Returns the number of reads the seek took.
+  int SeekAndCheck(uint32 timestamp) {
+    const std::vector<uint32>& times = builder_->keyframe_times();
+    size_t keyframe =
+        std::upper_bound(times.begin(), times.end(), timestamp) -
+        times.begin();
+    keyframe = keyframe ? keyframe - 1 : 0;
+
+    int reads_before = read_count_;
+    EXPECT_TRUE(parser_->SeekTo(
+        base::TimeDelta::FromMilliseconds(timestamp)));
+    int seek_reads = read_count_ - reads_before;
+
+    scoped_refptr<ShellAU> au = parser_->GetNextAU(DemuxerStream::VIDEO);
+    EXPECT_TRUE(au.get());
+    if (au.get()) {
+      EXPECT_TRUE(au->IsKeyframe());
+      EXPECT_EQ(times[keyframe], au->GetTimestamp().InMilliseconds())
+          << "seeking to " << timestamp;
+    }
+    return seek_reads;
+  }
+
+  const FLVBuilder* builder_;
+  int read_count_;
+  scoped_refptr<MockShellDataSourceReader> reader_;
+  scoped_refptr<ShellFLVParser> parser_;
+};
+
+TEST_F(ShellFLVParserTest, SeeksWithKeyframesMetadata) {
+  FLVBuilder builder(60, 30, true);
+  CreateParser(builder);
+  // the whole index comes from the metadata, so seeks don't need any reads
+  EXPECT_EQ(0, SeekAndCheck(45000));
+  EXPECT_EQ(0, SeekAndCheck(1500));
+  EXPECT_EQ(0, SeekAndCheck(59999));
+  EXPECT_EQ(0, SeekAndCheck(0));
+}
+
+TEST_F(ShellFLVParserTest, BuildsIndexWithoutMetadata) {
+  FLVBuilder builder(60, 30, false);
+  CreateParser(builder);
+  // seeking ahead scans the tag headers, several tags to a read
+  int first_seek_reads = SeekAndCheck(45000);
+  EXPECT_GT(first_seek_reads, 0);
+  EXPECT_LT(first_seek_reads, 45 * (30 + 43) / 4);
+  // anything before that has been indexed
+  EXPECT_EQ(0, SeekAndCheck(10000));
+  EXPECT_EQ(0, SeekAndCheck(44000));
+  // seeking past the end indexes the rest of the file, after which every
+  // seek is a lookup
+  SeekAndCheck(70000);
+  EXPECT_EQ(0, SeekAndCheck(59999));
+  EXPECT_EQ(0, SeekAndCheck(50000));
+}
+
+TEST_F(ShellFLVParserTest, IgnoresInvalidKeyframesMetadata) {
+  FLVBuilder builder(60, 30, true);
+  builder.CorruptKeyframesMetadata(7);
+  CreateParser(builder);
+  EXPECT_GT(SeekAndCheck(45000), 0);
+  EXPECT_EQ(0, SeekAndCheck(30000));
+}
+
+// Seeks randomly through about two hours of FLV, with and without the
+// keyframes metadata, checking every result and reporting the time and the
+// reads taken per seek.
+TEST_F(ShellFLVParserTest, RandomSeekBenchmark) {
+  static const int kDurationSeconds = 2 * 60 * 60;
+  static const int kSeekCount = 1000;
+  std::vector<uint32> seek_times(kSeekCount);
+  for (int i = 0; i < kSeekCount; ++i) {
+    seek_times[i] = rand() % (kDurationSeconds * 1000);
+  }
+
+  for (int metadata = 0; metadata < 2; ++metadata) {
+    FLVBuilder builder(kDurationSeconds, 60, metadata);
+    CreateParser(builder);
+    int seek_reads = 0;
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (int i = 0; i < kSeekCount; ++i) {
+      seek_reads += SeekAndCheck(seek_times[i]);
+    }
+    double total_time_ms =
+        (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+    printf("%s metadata: %d random seeks took %.2fms and %d reads, %.2fus "
+           "per seek.\n", metadata ? "with" : "without", kSeekCount,
+           total_time_ms, seek_reads,
+           (total_time_ms * 1000.0) / kSeekCount);
+  }
+}
+
+}  // namespace media
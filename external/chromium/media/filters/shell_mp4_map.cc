@@ -16,6 +16,8 @@
 
 #include "media/filters/shell_mp4_map.h"
 
+#include <algorithm>
+
 #include "base/stringprintf.h"
 #include "lb_platform.h"
 #include "media/filters/shell_mp4_parser.h"
@@ -74,6 +76,17 @@ uint8* ShellMP4Map::TableCache::GetBytesAtEntry(uint32 entry_number) {
       cache_entry_count_ = 0;
       return NULL;
     }
+    // Access through the tables is mostly sequential, so start downloading
+    // the next cache slot now to hide its latency when we get there.
+    uint32 next_first_entry_number =
+        cache_first_entry_number_ + cache_size_entries_;
+    if (next_first_entry_number < entry_count_) {
+      uint32 next_entry_count = std::min(cache_size_entries_ + 1,
+                                         entry_count_ - next_first_entry_number);
+      reader_->ReadAhead(
+          table_offset_ + (next_first_entry_number * entry_size_),
+          next_entry_count * entry_size_);
+    }
   }
   // cache is assumed to be valid and to contain the entry from here on
   DCHECK(cache_->Get());
@@ -137,6 +150,12 @@ bool ShellMP4Map::TableCache::ReadU64Entry(uint32 entry_number, uint64* entry) {
 // stts | time-to-sample        | 8    | run-length sample number to duration
 // stsz | sample size           | 4    | per-sample list of sample sizes
 
+// The integration state of the run-length tables is saved at least every
+// kMinIndexStride table entries, with the stride doubling as needed to keep
+// each index under kMaxIndexEntries entries.
+static const uint32 kMinIndexStride = 16;
+static const uint32 kMaxIndexEntries = 4096;
+
 ShellMP4Map::ShellMP4Map(scoped_refptr<ShellDataSourceReader> reader)
     : reader_(reader)
     , current_chunk_sample_(0)
@@ -147,12 +166,14 @@ ShellMP4Map::ShellMP4Map(scoped_refptr<ShellDataSourceReader> reader)
     , ctts_sample_offset_(0)
     , ctts_next_first_sample_(0)
     , ctts_table_index_(0)
+    , ctts_index_stride_(kMinIndexStride)
     , stsc_first_chunk_(0)
     , stsc_first_chunk_sample_(0)
     , stsc_samples_per_chunk_(0)
     , stsc_next_first_chunk_(0)
     , stsc_next_first_chunk_sample_(0)
     , stsc_table_index_(0)
+    , stsc_index_stride_(kMinIndexStride)
     , stss_last_keyframe_(0)
     , stss_next_keyframe_(0)
     , stss_table_index_(0)
@@ -162,6 +183,7 @@ ShellMP4Map::ShellMP4Map(scoped_refptr<ShellDataSourceReader> reader)
     , stts_next_first_sample_(0)
     , stts_next_first_sample_time_(0)
     , stts_table_index_(0)
+    , stts_index_stride_(kMinIndexStride)
     , stsz_default_size_(0) {
 }
 
@@ -499,6 +521,15 @@ bool ShellMP4Map::SetAtom(uint32 four_cc,
   return atom_init;
 }
 
+// static
+uint32 ShellMP4Map::IndexStride(uint32 entry_count) {
+  uint32 stride = kMinIndexStride;
+  while (entry_count / stride >= kMaxIndexEntries) {
+    stride *= 2;
+  }
+  return stride;
+}
+
 bool ShellMP4Map::co64_Init() {
   DCHECK(co64_);
   // load offset of first chunk into current_chunk_offset_
@@ -520,18 +551,24 @@ bool ShellMP4Map::co64_Init() {
 //
 bool ShellMP4Map::ctts_Init() {
   DCHECK(ctts_);
-  // get cache segment vector to reserve table entries in advance
-  int cache_segments = (ctts_->GetEntryCount() /
-                        ctts_->GetCacheSizeEntries()) + 1;
-  ctts_samples_.reserve(cache_segments);
+  // reserve the entire index in advance
+  ctts_index_stride_ = IndexStride(ctts_->GetEntryCount());
+  ctts_samples_.reserve((ctts_->GetEntryCount() / ctts_index_stride_) + 1);
   if (ctts_->GetEntryCount() > 0) {
     // save the start of the first table integration at 0
     ctts_samples_.push_back(0);
     ctts_table_index_ = 0;
     ctts_first_sample_ = 0;
     // load first entry in table, to start integration
-    return ctts_->ReadU32PairEntry(0, &ctts_next_first_sample_,
-                                   &ctts_sample_offset_);
+    if (!ctts_->ReadU32PairEntry(0, &ctts_next_first_sample_,
+                                 &ctts_sample_offset_)) {
+      return false;
+    }
+    // if the whole table is already in memory we can index it for free
+    if (ctts_->GetCacheSizeEntries() >= ctts_->GetEntryCount()) {
+      return ctts_BuildIndex();
+    }
+    return true;
   }
   // drop empty ctts_ table
   ctts_ = NULL;
@@ -559,8 +596,7 @@ bool ShellMP4Map::ctts_AdvanceToSample(uint32 sample_number) {
   // sample_number could also be ahead of our current range, for example when
   // seeking forward. See if we've calculated these values ahead of us before,
   // and if we can slip forward to them
-  int next_cache_index = (ctts_table_index_ /
-                          ctts_->GetCacheSizeEntries()) + 1;
+  int next_cache_index = (ctts_table_index_ / ctts_index_stride_) + 1;
   if ((next_cache_index < ctts_samples_.size()) &&
       (sample_number >= ctts_samples_[next_cache_index])) {
     if (!ctts_SlipCacheToSample(sample_number, next_cache_index)) {
@@ -570,30 +606,7 @@ bool ShellMP4Map::ctts_AdvanceToSample(uint32 sample_number) {
 
   // perform integration until sample number is within correct ctts range
   while (ctts_next_first_sample_ <= sample_number) {
-    // next first sample is now our the first sample
-    ctts_first_sample_ = ctts_next_first_sample_;
-    // advance to next entry in table
-    ctts_table_index_++;
-    // If this would be a new cache entry, keep a record of integration up
-    // to this point so we don't have to start from 0 on seeking back
-    if (!(ctts_table_index_ % ctts_->GetCacheSizeEntries())) {
-      int cache_index = ctts_table_index_ / ctts_->GetCacheSizeEntries();
-      // check that this is our first time with these data
-      if (cache_index == ctts_samples_.size()) {
-        ctts_samples_.push_back(ctts_first_sample_);
-      }
-      // our integration at this point should always match any stored record
-      DCHECK_EQ(ctts_first_sample_, ctts_samples_[cache_index]);
-    }
-
-    if (ctts_table_index_ < ctts_->GetEntryCount()) {
-      // load the sample count to determine next first sample
-      uint32 sample_count;
-      if (!ctts_->ReadU32PairEntry(ctts_table_index_, &sample_count,
-                                   &ctts_sample_offset_))
-        return false;
-      ctts_next_first_sample_ = ctts_first_sample_ + sample_count;
-    } else {
+    if (ctts_table_index_ + 1 >= ctts_->GetEntryCount()) {
       // This means that the last entry in the table specified a sample range
       // that this sample number has exceeded, and so the ctts of this sample
       // number is undefined. While not a fatal error it's kind of a weird
@@ -606,6 +619,9 @@ bool ShellMP4Map::ctts_AdvanceToSample(uint32 sample_number) {
       ctts_next_first_sample_ = UINT32_MAX;
       break;
     }
+    if (!ctts_IntegrateStep()) {
+      return false;
+    }
   }
   return true;
 }
@@ -613,14 +629,13 @@ bool ShellMP4Map::ctts_AdvanceToSample(uint32 sample_number) {
 bool ShellMP4Map::ctts_SlipCacheToSample(uint32 sample_number,
                                          int starting_cache_index) {
   DCHECK_LT(starting_cache_index, ctts_samples_.size());
-  int cache_index = starting_cache_index;
-  for (; cache_index + 1 < ctts_samples_.size(); cache_index++) {
-    if (sample_number < ctts_samples_[cache_index + 1]) {
-      break;
-    }
-  }
+  // binary search for the last saved first sample at or before sample_number
+  int cache_index = std::upper_bound(
+      ctts_samples_.begin() + starting_cache_index, ctts_samples_.end(),
+      sample_number) - ctts_samples_.begin() - 1;
+  cache_index = std::max(cache_index, starting_cache_index);
   ctts_first_sample_ = ctts_samples_[cache_index];
-  ctts_table_index_ = cache_index * ctts_->GetCacheSizeEntries();
+  ctts_table_index_ = cache_index * ctts_index_stride_;
   // read sample count and duration to set next values
   uint32 sample_count;
   if (!ctts_->ReadU32PairEntry(ctts_table_index_, &sample_count,
@@ -630,6 +645,43 @@ bool ShellMP4Map::ctts_SlipCacheToSample(uint32 sample_number,
   return true;
 }
 
+bool ShellMP4Map::ctts_IntegrateStep() {
+  // next first sample is now our the first sample
+  ctts_first_sample_ = ctts_next_first_sample_;
+  // advance to next entry in table
+  ctts_table_index_++;
+  DCHECK_LT(ctts_table_index_, ctts_->GetEntryCount());
+  // If this would be a new index entry, keep a record of integration up
+  // to this point so we don't have to start from 0 on seeking back
+  if (!(ctts_table_index_ % ctts_index_stride_)) {
+    int cache_index = ctts_table_index_ / ctts_index_stride_;
+    // check that this is our first time with these data
+    if (cache_index == ctts_samples_.size()) {
+      ctts_samples_.push_back(ctts_first_sample_);
+    }
+    // our integration at this point should always match any stored record
+    DCHECK_EQ(ctts_first_sample_, ctts_samples_[cache_index]);
+  }
+  // load the sample count to determine next first sample
+  uint32 sample_count;
+  if (!ctts_->ReadU32PairEntry(ctts_table_index_, &sample_count,
+                               &ctts_sample_offset_)) {
+    return false;
+  }
+  ctts_next_first_sample_ = ctts_first_sample_ + sample_count;
+  return true;
+}
+
+bool ShellMP4Map::ctts_BuildIndex() {
+  while (ctts_table_index_ + 1 < ctts_->GetEntryCount()) {
+    if (!ctts_IntegrateStep()) {
+      return false;
+    }
+  }
+  // rewind integration to the start of the table
+  return ctts_SlipCacheToSample(0, 0);
+}
+
 bool ShellMP4Map::stco_Init() {
   DCHECK(stco_);
   // load offset of first chunk into current_chunk_offset_
@@ -650,9 +702,8 @@ bool ShellMP4Map::stco_Init() {
 bool ShellMP4Map::stsc_Init() {
   DCHECK(stsc_);
   // set up vector to correct final size
-  int cache_segments = (stsc_->GetEntryCount() /
-                        stsc_->GetCacheSizeEntries()) + 1;
-  stsc_sample_sums_.reserve(cache_segments);
+  stsc_index_stride_ = IndexStride(stsc_->GetEntryCount());
+  stsc_sample_sums_.reserve((stsc_->GetEntryCount() / stsc_index_stride_) + 1);
   // there must always be at least 1 entry in a valid stsc table
   if (stsc_->GetEntryCount() > 0) {
     stsc_first_chunk_ = 0;
@@ -683,6 +734,10 @@ bool ShellMP4Map::stsc_Init() {
     // since we known the size of the first chunk we can set next_chunk_sample_
     next_chunk_sample_ = stsc_samples_per_chunk_;
 
+    // if the whole table is already in memory we can index it for free
+    if (stsc_->GetCacheSizeEntries() >= stsc_->GetEntryCount()) {
+      return stsc_BuildIndex();
+    }
   } else {
     stsc_ = NULL;
   }
@@ -711,8 +766,7 @@ bool ShellMP4Map::stsc_AdvanceToSample(uint32 sample_number) {
   // sample_number could also be well head of our current piece of the
   // cache, so see if we can re-use any previously calculated summations to
   // skip to the nearest cache entry
-  int next_cache_index = (stsc_table_index_ /
-                          stsc_->GetCacheSizeEntries()) + 1;
+  int next_cache_index = (stsc_table_index_ / stsc_index_stride_) + 1;
   if ((next_cache_index < stsc_sample_sums_.size()) &&
       (sample_number >= stsc_sample_sums_[next_cache_index])) {
     if (!stsc_SlipCacheToSample(sample_number, next_cache_index)) {
@@ -722,52 +776,7 @@ bool ShellMP4Map::stsc_AdvanceToSample(uint32 sample_number) {
 
   // Integrate through each table entry until we find sample_number in range
   while (stsc_next_first_chunk_sample_ <= sample_number) {
-    // advance to next chunk sample range
-    stsc_first_chunk_sample_ = stsc_next_first_chunk_sample_;
-    // our next_first_chunk is now our first chunk
-    stsc_first_chunk_ = stsc_next_first_chunk_;
-    // advance to next entry in table
-    stsc_table_index_++;
-    // if we've advanced to a new segment of the cache, update the saved
-    // integration values
-    if (!(stsc_table_index_ % stsc_->GetCacheSizeEntries())) {
-      int cache_index = stsc_table_index_ / stsc_->GetCacheSizeEntries();
-      // check that this is our first time with these data
-      if (cache_index == stsc_sample_sums_.size()) {
-        stsc_sample_sums_.push_back(stsc_first_chunk_sample_);
-      }
-      // our integration at this point should always match any stored record
-      DCHECK_EQ(stsc_first_chunk_sample_, stsc_sample_sums_[cache_index]);
-    }
-    if (stsc_table_index_ < stsc_->GetEntryCount()) {
-      // look up our new sample rate
-      if (!stsc_->ReadU32PairEntry(stsc_table_index_, NULL,
-                                   &stsc_samples_per_chunk_)) {
-        return false;
-      }
-      // we need to look up next table entry to determine next first chunk
-      if (stsc_table_index_ + 1 < stsc_->GetEntryCount()) {
-        // look up next first chunk
-        if (!stsc_->ReadU32PairEntry(stsc_table_index_ + 1,
-                                     &stsc_next_first_chunk_, NULL)) {
-          return false;
-        }
-        --stsc_next_first_chunk_;
-        // carry sum of first_samples forward to next chunk range
-        stsc_next_first_chunk_sample_ +=
-            (stsc_next_first_chunk_ - stsc_first_chunk_) *
-             stsc_samples_per_chunk_;
-      } else {
-        // this is the normal place to encounter the end of the chunk table.
-        // set the next chunk to the highest valid chunk number
-        stsc_next_first_chunk_ = UINT32_MAX;
-        stsc_next_first_chunk_sample_ = UINT32_MAX;
-      }
-    } else {
-      // We should normally encounter the end of the chunk table on lookup
-      // of the next_first_chunk_ within the if clause associated with this
-      // else. Something has gone wrong.
-      NOTREACHED();
+    if (!stsc_IntegrateStep()) {
       return false;
     }
   }
@@ -777,17 +786,15 @@ bool ShellMP4Map::stsc_AdvanceToSample(uint32 sample_number) {
 bool ShellMP4Map::stsc_SlipCacheToSample(uint32 sample_number,
                                          int starting_cache_index) {
   DCHECK_LT(starting_cache_index, stsc_sample_sums_.size());
-  // look through old sample sums for the first entry that exceeds sample
+  // binary search the old sample sums for the first entry that exceeds
   // sample_number, we want the entry right before that
-  int cache_index = starting_cache_index;
-  for (; cache_index + 1 < stsc_sample_sums_.size(); cache_index++) {
-    if (sample_number < stsc_sample_sums_[cache_index + 1]) {
-      break;
-    }
-  }
+  int cache_index = std::upper_bound(
+      stsc_sample_sums_.begin() + starting_cache_index,
+      stsc_sample_sums_.end(), sample_number) - stsc_sample_sums_.begin() - 1;
+  cache_index = std::max(cache_index, starting_cache_index);
   // jump to new spot in table
   stsc_first_chunk_sample_ = stsc_sample_sums_[cache_index];
-  stsc_table_index_ = cache_index * stsc_->GetCacheSizeEntries();
+  stsc_table_index_ = cache_index * stsc_index_stride_;
   if (!stsc_->ReadU32PairEntry(stsc_table_index_, &stsc_first_chunk_,
                                &stsc_samples_per_chunk_)) {
     return false;
@@ -812,6 +819,66 @@ bool ShellMP4Map::stsc_SlipCacheToSample(uint32 sample_number,
   return true;
 }
 
+bool ShellMP4Map::stsc_IntegrateStep() {
+  // advance to next chunk sample range
+  stsc_first_chunk_sample_ = stsc_next_first_chunk_sample_;
+  // our next_first_chunk is now our first chunk
+  stsc_first_chunk_ = stsc_next_first_chunk_;
+  // advance to next entry in table
+  stsc_table_index_++;
+  // if we've advanced to a new index entry, update the saved integration
+  // values
+  if (!(stsc_table_index_ % stsc_index_stride_)) {
+    int cache_index = stsc_table_index_ / stsc_index_stride_;
+    // check that this is our first time with these data
+    if (cache_index == stsc_sample_sums_.size()) {
+      stsc_sample_sums_.push_back(stsc_first_chunk_sample_);
+    }
+    // our integration at this point should always match any stored record
+    DCHECK_EQ(stsc_first_chunk_sample_, stsc_sample_sums_[cache_index]);
+  }
+  if (stsc_table_index_ >= stsc_->GetEntryCount()) {
+    // We should normally encounter the end of the chunk table on lookup
+    // of the next_first_chunk_ below. Something has gone wrong.
+    NOTREACHED();
+    return false;
+  }
+  // look up our new sample rate
+  if (!stsc_->ReadU32PairEntry(stsc_table_index_, NULL,
+                               &stsc_samples_per_chunk_)) {
+    return false;
+  }
+  // we need to look up next table entry to determine next first chunk
+  if (stsc_table_index_ + 1 < stsc_->GetEntryCount()) {
+    // look up next first chunk
+    if (!stsc_->ReadU32PairEntry(stsc_table_index_ + 1,
+                                 &stsc_next_first_chunk_, NULL)) {
+      return false;
+    }
+    --stsc_next_first_chunk_;
+    // carry sum of first_samples forward to next chunk range
+    stsc_next_first_chunk_sample_ +=
+        (stsc_next_first_chunk_ - stsc_first_chunk_) *
+         stsc_samples_per_chunk_;
+  } else {
+    // this is the normal place to encounter the end of the chunk table.
+    // set the next chunk to the highest valid chunk number
+    stsc_next_first_chunk_ = UINT32_MAX;
+    stsc_next_first_chunk_sample_ = UINT32_MAX;
+  }
+  return true;
+}
+
+bool ShellMP4Map::stsc_BuildIndex() {
+  while (stsc_table_index_ + 1 < stsc_->GetEntryCount()) {
+    if (!stsc_IntegrateStep()) {
+      return false;
+    }
+  }
+  // rewind integration to the start of the table
+  return stsc_SlipCacheToSample(0, 0);
+}
+
 // stss is a list of sample numbers that are keyframes.
 bool ShellMP4Map::stss_Init() {
   int cache_segments = (stss_->GetEntryCount() /
@@ -994,10 +1061,10 @@ bool ShellMP4Map::stss_FindNearestKeyframe(uint32 sample_number) {
 // uint32 sample count - number of sequential samples with this duration
 // uint32 sample duration - duration in ticks of this sample range
 bool ShellMP4Map::stts_Init() {
-  int cache_segments = (stts_->GetEntryCount() /
-                        stts_->GetCacheSizeEntries()) + 1;
-  stts_samples_.reserve(cache_segments);
-  stts_timestamps_.reserve(cache_segments);
+  stts_index_stride_ = IndexStride(stts_->GetEntryCount());
+  int index_entries = (stts_->GetEntryCount() / stts_index_stride_) + 1;
+  stts_samples_.reserve(index_entries);
+  stts_timestamps_.reserve(index_entries);
   // need at least one entry in valid stts
   if (stts_->GetEntryCount() > 0) {
     // integration starts at 0 for both cache entries
@@ -1013,6 +1080,10 @@ bool ShellMP4Map::stts_Init() {
     stts_next_first_sample_time_ =
         stts_next_first_sample_ * stts_sample_duration_;
     stts_table_index_ = 0;
+    // if the whole table is already in memory we can index it for free
+    if (stts_->GetCacheSizeEntries() >= stts_->GetEntryCount()) {
+      return stts_BuildIndex();
+    }
   } else {
     stts_ = NULL;
   }
@@ -1033,8 +1104,7 @@ bool ShellMP4Map::stts_AdvanceToSample(uint32 sample_number) {
 
   // sample number could also be well ahead of this cache segment, if we've
   // previously calculated summations ahead let's skip to the correct one
-  int next_cache_index = (stts_table_index_ /
-                          stts_->GetCacheSizeEntries()) + 1;
+  int next_cache_index = (stts_table_index_ / stts_index_stride_) + 1;
   if ((next_cache_index < stts_samples_.size()) &&
       (sample_number >= stts_samples_[next_cache_index])) {
     if (!stts_SlipCacheToSample(sample_number, next_cache_index)) {
@@ -1051,21 +1121,18 @@ bool ShellMP4Map::stts_AdvanceToSample(uint32 sample_number) {
   return true;
 }
 
-// Move our integration steps to a previously saved entry in the cache tables.
-// Searches linearly through the vector of old cached values, so can accept a
-// starting index to do the search from.
+// Move our integration steps to a previously saved entry in the index.
+// Binary searches the saved values from the provided starting index.
 bool ShellMP4Map::stts_SlipCacheToSample(uint32 sample_number,
                                          int starting_cache_index) {
   DCHECK_LT(starting_cache_index, stts_samples_.size());
-  int cache_index = starting_cache_index;
-  for (; cache_index + 1 < stts_samples_.size(); cache_index++) {
-    if (sample_number < stts_samples_[cache_index + 1]) {
-      break;
-    }
-  }
+  int cache_index = std::upper_bound(
+      stts_samples_.begin() + starting_cache_index, stts_samples_.end(),
+      sample_number) - stts_samples_.begin() - 1;
+  cache_index = std::max(cache_index, starting_cache_index);
   stts_first_sample_ = stts_samples_[cache_index];
   stts_first_sample_time_ = stts_timestamps_[cache_index];
-  stts_table_index_ = cache_index * stts_->GetCacheSizeEntries();
+  stts_table_index_ = cache_index * stts_index_stride_;
   uint32 sample_count;
   // read sample count and duration to set next values
   if (!stts_->ReadU32PairEntry(stts_table_index_, &sample_count,
@@ -1089,8 +1156,7 @@ bool ShellMP4Map::stts_AdvanceToTime(uint64 timestamp) {
 
   // sample number could also be well ahead of this cache segment, if we've
   // previously calculated summations ahead let's skip to the correct one
-  int next_cache_index = (stts_table_index_ /
-                          stts_->GetCacheSizeEntries()) + 1;
+  int next_cache_index = (stts_table_index_ / stts_index_stride_) + 1;
   if ((next_cache_index < stts_timestamps_.size()) &&
       (timestamp >= stts_timestamps_[next_cache_index])) {
     if (!stts_SlipCacheToTime(timestamp, next_cache_index)) {
@@ -1115,9 +1181,9 @@ bool ShellMP4Map::stts_IntegrateStep() {
   stts_first_sample_ = stts_next_first_sample_;
   // bump table counter to next entry
   stts_table_index_++;
-  // see if we just crossed a cache boundary and should cache results
-  if (!(stts_table_index_ % stts_->GetCacheSizeEntries())) {
-    int cache_index = stts_table_index_ / stts_->GetCacheSizeEntries();
+  // see if we just crossed an index boundary and should save results
+  if (!(stts_table_index_ % stts_index_stride_)) {
+    int cache_index = stts_table_index_ / stts_index_stride_;
     // check that this is our first time with these data
     if (cache_index == stts_samples_.size()) {
       // both tables should always grow together
@@ -1153,15 +1219,13 @@ bool ShellMP4Map::stts_IntegrateStep() {
 
 bool ShellMP4Map::stts_SlipCacheToTime(uint64 timestamp, int starting_cache_index) {
   DCHECK_LT(starting_cache_index, stts_timestamps_.size());
-  int cache_index = starting_cache_index;
-  for (; cache_index + 1 < stts_timestamps_.size(); cache_index++) {
-    if (timestamp < stts_timestamps_[cache_index + 1]) {
-      break;
-    }
-  }
+  int cache_index = std::upper_bound(
+      stts_timestamps_.begin() + starting_cache_index, stts_timestamps_.end(),
+      timestamp) - stts_timestamps_.begin() - 1;
+  cache_index = std::max(cache_index, starting_cache_index);
   stts_first_sample_ = stts_samples_[cache_index];
   stts_first_sample_time_ = stts_timestamps_[cache_index];
-  stts_table_index_ = cache_index * stts_->GetCacheSizeEntries();
+  stts_table_index_ = cache_index * stts_index_stride_;
   // read sample count and duration to set next values
   uint32 sample_count;
   if (!stts_->ReadU32PairEntry(stts_table_index_, &sample_count,
@@ -1174,6 +1238,16 @@ bool ShellMP4Map::stts_SlipCacheToTime(uint64 timestamp, int starting_cache_inde
   return true;
 }
 
+bool ShellMP4Map::stts_BuildIndex() {
+  while (stts_table_index_ + 1 < stts_->GetEntryCount()) {
+    if (!stts_IntegrateStep()) {
+      return false;
+    }
+  }
+  // rewind integration to the start of the table
+  return stts_SlipCacheToSample(0, 0);
+}
+
 bool ShellMP4Map::stsz_Init() {
   return stsz_->GetBytesAtEntry(0) != NULL;
 }
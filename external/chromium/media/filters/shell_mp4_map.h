@@ -39,6 +39,14 @@ static const int kEntrySize_stsz = 4;
 // them to provide byte offsets, sizes, and timestamps of a mp4 atom while
 // reusing memory issued by ShellBufferFactory. The caching design benefits
 // from, but does not require, sequential access in sample numbers.
+//
+// The run-length tables (ctts, stsc, stts) must be integrated from the start
+// to find the state at any given sample. The map saves that integration state
+// at fixed strides through each table, in an index of bounded size, so random
+// access and seeking can binary search to a nearby checkpoint rather than
+// re-integrating from the start of the table. Tables small enough to be
+// entirely cached in memory are indexed as soon as they are set, others are
+// indexed as integration first passes through them.
 class ShellMP4Map : public base::RefCountedThreadSafe<ShellMP4Map> {
  public:
   explicit ShellMP4Map(scoped_refptr<ShellDataSourceReader> reader);
@@ -70,12 +78,20 @@ class ShellMP4Map : public base::RefCountedThreadSafe<ShellMP4Map> {
                const uint8* atom);         // pointer to atom body start
 
  private:
+  // Returns the number of table entries between saved integration states for
+  // a run-length table of entry_count entries.
+  static uint32 IndexStride(uint32 entry_count);
+
   bool co64_Init();
 
   bool ctts_Init();
   // advance the ctts cache and integration state to contain sample number.
   bool ctts_AdvanceToSample(uint32 sample_number);
   bool ctts_SlipCacheToSample(uint32 sample_number, int starting_cache_index);
+  // step through the ctts table by one table entry, return false on error
+  bool ctts_IntegrateStep();
+  // integrate through the whole table to fill the index, then rewind
+  bool ctts_BuildIndex();
 
   bool stco_Init();
 
@@ -86,6 +102,9 @@ class ShellMP4Map : public base::RefCountedThreadSafe<ShellMP4Map> {
   // nearest cache entry that contains given sample number. Starts the search
   // from the starting_cache_index.
   bool stsc_SlipCacheToSample(uint32 sample_number, int starting_cache_index);
+  // step through the stsc table by one table entry, return false on error
+  bool stsc_IntegrateStep();
+  bool stsc_BuildIndex();
 
   bool stss_Init();
   // step through table by one table entry, return false on error
@@ -100,6 +119,7 @@ class ShellMP4Map : public base::RefCountedThreadSafe<ShellMP4Map> {
   bool stts_SlipCacheToTime(uint64 timestamp, int starting_cache_index);
   // step through the stts table by one table entry, return false on error
   bool stts_IntegrateStep();
+  bool stts_BuildIndex();
 
   bool stsz_Init();
 
@@ -172,6 +192,7 @@ class ShellMP4Map : public base::RefCountedThreadSafe<ShellMP4Map> {
   uint32 ctts_sample_offset_;
   uint32 ctts_next_first_sample_;
   uint32 ctts_table_index_;
+  uint32 ctts_index_stride_;  // table entries between saved first samples
   std::vector<uint32> ctts_samples_;
 
   // ==== stco - per-chunk list of chunk file offsets (32-bit)
@@ -185,7 +206,8 @@ class ShellMP4Map : public base::RefCountedThreadSafe<ShellMP4Map> {
   uint32 stsc_next_first_chunk_;  // the chunk number the next region begins in
   uint32 stsc_next_first_chunk_sample_;  // sample number next region begins in
   uint32 stsc_table_index_;  // the index in the table of the current range
-  std::vector<uint32> stsc_sample_sums_;  // saved sums of cache segments
+  uint32 stsc_index_stride_;  // table entries between saved sums
+  std::vector<uint32> stsc_sample_sums_;  // saved sums every stride entries
 
   // ==== stss - list of keyframe sample numbers
   scoped_refptr<TableCache> stss_;
@@ -202,6 +224,8 @@ class ShellMP4Map : public base::RefCountedThreadSafe<ShellMP4Map> {
   uint32 stts_next_first_sample_;  // first sample number of next range
   uint64 stts_next_first_sample_time_;  // first timestamp of next range
   uint32 stts_table_index_;  // index in the table of the next entry
+  uint32 stts_index_stride_;  // table entries between saved states
+  // saved first sample number and time, every stride entries in the table
   std::vector<uint32> stts_samples_;
   std::vector<uint64> stts_timestamps_;
 
@@ -23,6 +23,7 @@
 #include <sstream>
 #include <vector>
 
+#include "base/time.h"
 #include "lb_platform.h"
 #include "media/base/shell_buffer_factory.h"
 #include "media/base/mock_shell_data_source_reader.h"
@@ -1134,4 +1135,69 @@ TEST_F(ShellMP4MapTest, GetKeyframe) {
   ASSERT_EQ(map_keyframe, last_keyframe);
 }
 
+// ==== Random Seek Benchmark ==================================================
+
+// Seeks randomly through a long synthetic table, about an hour and a half of
+// 30fps video, checking every result and reporting the time taken per seek.
+// The first pass pays for integrating the tables the first time, later seeks
+// should only need to search the saved integration states.
+TEST_F(ShellMP4MapTest, RandomSeekBenchmark) {
+  static const int kSampleCount = 200000;
+  static const int kSeekCount = 10000;
+  static const int kCacheSizeEntries = 1024;
+  // Varying durations and composition offsets make the stts and ctts close
+  // to one entry per sample, which is the worst case for integration. The
+  // seed keeps the sample offsets within range of the test table.
+  CreateTestSampleTable(17, kSampleCount, 20, 40, 5, 10, 15, 60, 1, 3, 0, 3);
+  ResetMap();
+  SetTestTable(kAtomType_stsz, kCacheSizeEntries);
+  SetTestTable(kAtomType_co64, kCacheSizeEntries);
+  SetTestTable(kAtomType_stsc, kCacheSizeEntries);
+  SetTestTable(kAtomType_ctts, kCacheSizeEntries);
+  SetTestTable(kAtomType_stts, kCacheSizeEntries);
+  SetTestTable(kAtomType_stss, kCacheSizeEntries);
+  ASSERT_TRUE(map_->IsComplete());
+
+  // reference decode timestamps and the keyframe at or before every sample
+  std::vector<uint64> dts(kSampleCount);
+  std::vector<uint32> keyframes(kSampleCount);
+  for (int i = 0; i < kSampleCount; ++i) {
+    dts[i] = GetTestSample(i).dts;
+    keyframes[i] = GetTestSample(i).is_key_frame ? i : keyframes[i - 1];
+  }
+  uint64 duration = dts[kSampleCount - 1] +
+                    GetTestSample(kSampleCount - 1).dts_duration;
+
+  std::vector<uint64> seek_times(kSeekCount);
+  for (int i = 0; i < kSeekCount; ++i) {
+    seek_times[i] = rand() % duration;
+  }
+
+  for (int pass = 0; pass < 2; ++pass) {
+    std::vector<uint32> samples(kSeekCount);
+    std::vector<uint64> offsets(kSeekCount);
+    std::vector<uint64> timestamps(kSeekCount);
+    base::TimeTicks start = base::TimeTicks::HighResNow();
+    for (int i = 0; i < kSeekCount; ++i) {
+      ASSERT_TRUE(map_->GetKeyframe(seek_times[i], samples[i]));
+      ASSERT_TRUE(map_->GetOffset(samples[i], offsets[i]));
+      ASSERT_TRUE(map_->GetTimestamp(samples[i], timestamps[i]));
+    }
+    double total_time_ms =
+        (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+    printf("pass %d: %d random seeks took %.2fms, %.2fus per seek.\n",
+           pass, kSeekCount, total_time_ms,
+           (total_time_ms * 1000.0) / kSeekCount);
+
+    for (int i = 0; i < kSeekCount; ++i) {
+      int sample = std::upper_bound(dts.begin(), dts.end(), seek_times[i]) -
+                   dts.begin() - 1;
+      uint32 keyframe = keyframes[sample];
+      ASSERT_EQ(samples[i], keyframe);
+      ASSERT_EQ(offsets[i], GetTestSample(keyframe).offset);
+      ASSERT_EQ(timestamps[i], GetTestSample(keyframe).cts);
+    }
+  }
+}
+
 }  // namespace
@@ -220,6 +220,58 @@ scoped_refptr<ShellAU> ShellMP4Parser::GetNextAU(DemuxerStream::Type type) {
                                 is_keyframe, timestamp, duration, this);
 }
 
+bool ShellMP4Parser::GetNextAUs(DemuxerStream::Type type,
+                                size_t max_bytes,
+                                size_t max_count,
+                                ShellAUVector* aus) {
+  DCHECK(aus);
+  scoped_refptr<ShellAU> au = GetNextAU(type);
+  if (!au)
+    return false;
+  aus->push_back(au);
+  if (au->IsEndOfStream())
+    return true;
+
+  scoped_refptr<ShellMP4Map> map;
+  uint32* sample;
+  if (type == DemuxerStream::AUDIO) {
+    map = audio_map_;
+    sample = &audio_sample_;
+  } else {
+    map = video_map_;
+    sample = &video_sample_;
+  }
+
+  // Samples within an mp4 chunk are stored back to back, so keep extending
+  // the run for as long as the next sample starts where the last one ended.
+  // We stop short of EOS and of any map error, leaving them to be reported by
+  // the next call to GetNextAU().
+  size_t run_bytes = au->GetSize();
+  uint64 run_end = au->GetOffset() + au->GetSize();
+  while (aus->size() < max_count) {
+    uint32 size = 0;
+    uint64 offset = 0;
+    if (!map->GetSize(*sample, size) ||
+        !map->GetOffset(*sample, offset) ||
+        offset != run_end ||
+        run_bytes + size > max_bytes) {
+      break;
+    }
+    au = GetNextAU(type);
+    if (!au || au->IsEndOfStream() || !au->IsValid()) {
+      // we've already checked the size and offset of this sample, so this
+      // should not happen, but if it does we've lost this AU from the run.
+      DLOG(ERROR) << "failed to extend run of AUs";
+      return false;
+    }
+    DCHECK_EQ(au->GetOffset(), run_end);
+    aus->push_back(au);
+    run_bytes += size;
+    run_end += size;
+  }
+  return true;
+}
+
 bool ShellMP4Parser::SeekTo(base::TimeDelta timestamp) {
   // get video timestamp in video time units
   uint64 video_ticks = TimeToTicks(timestamp, video_time_scale_hz_);
@@ -81,6 +81,10 @@ class ShellMP4Parser : public ShellAVCParser {
   // === ShellParser implementation
   virtual bool ParseConfig() OVERRIDE;
   virtual scoped_refptr<ShellAU> GetNextAU(DemuxerStream::Type type) OVERRIDE;
+  virtual bool GetNextAUs(DemuxerStream::Type type,
+                          size_t max_bytes,
+                          size_t max_count,
+                          ShellAUVector* aus) OVERRIDE;
   virtual bool SeekTo(base::TimeDelta timestamp) OVERRIDE;
 
  private:
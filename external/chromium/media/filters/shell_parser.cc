@@ -69,6 +69,18 @@ ShellParser::ShellParser(scoped_refptr<ShellDataSourceReader> reader)
 ShellParser::~ShellParser() {
 }
 
+bool ShellParser::GetNextAUs(DemuxerStream::Type type,
+                             size_t max_bytes,
+                             size_t max_count,
+                             ShellAUVector* aus) {
+  DCHECK(aus);
+  scoped_refptr<ShellAU> au = GetNextAU(type);
+  if (!au)
+    return false;
+  aus->push_back(au);
+  return true;
+}
+
 bool ShellParser::IsConfigComplete() {
   return (video_config_.IsValidConfig()) &&
          (audio_config_.IsValidConfig()) &&
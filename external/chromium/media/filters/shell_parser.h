@@ -48,6 +48,16 @@ class ShellParser : public base::RefCountedThreadSafe<ShellParser> {
   // fatal error. On success this advances the respective audio or video cursor
   // to the next AU.
   virtual scoped_refptr<ShellAU> GetNextAU(DemuxerStream::Type type) = 0;
+  // Appends to |aus| a run of up to |max_count| AUs of the provided type that
+  // are contiguous in the stream and together occupy no more than |max_bytes|
+  // bytes, so that the demuxer can download all of them with a single read.
+  // At least one AU is always returned, regardless of |max_bytes|, and it may
+  // be an EOS AU. Returns false on fatal error. The default implementation
+  // returns a single AU from GetNextAU().
+  virtual bool GetNextAUs(DemuxerStream::Type type,
+                          size_t max_bytes,
+                          size_t max_count,
+                          ShellAUVector* aus);
   // Write the appropriate prepend header for the supplied au into the supplied
   // buffer. Return false on error.
   virtual bool Prepend(scoped_refptr<ShellAU> au,
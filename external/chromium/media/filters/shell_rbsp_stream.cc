@@ -16,25 +16,48 @@
 
 #include "media/filters/shell_rbsp_stream.h"
 
+#include <algorithm>
+
+#include "base/cpu.h"
 #include "base/logging.h"
+#include "build/build_config.h"
+
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+#include <arm_neon.h>
+#endif
 
 namespace media {
 
+namespace {
+
+// Whether the byte at |offset| is an emulation prevention byte.
+inline bool IsEmulationPreventionByte(const uint8* buffer, size_t offset) {
+  return buffer[offset] == 0x03 && offset >= 2 &&
+         buffer[offset - 1] == 0 && buffer[offset - 2] == 0;
+}
+
+}  // namespace
+
 ShellRBSPStream::ShellRBSPStream(const uint8* nalu_buffer,
                                  size_t nalu_buffer_size)
     : nalu_buffer_(nalu_buffer)
     , nalu_buffer_size_(nalu_buffer_size)
     , nalu_buffer_byte_offset_(0)
-    , current_nalu_byte_(0)
-    , number_consecutive_zeros_(0)
-    , rbsp_bit_offset_(0) {
+    , next_emulation_prevention_byte_(
+          FindEmulationPreventionByte(nalu_buffer, nalu_buffer_size, 0))
+    , cache_(0)
+    , cache_bits_(0) {
 }
 
 // read unsigned Exp-Golomb coded integer, ISO 14496-10 Section 9.1
 bool ShellRBSPStream::ReadUEV(uint32& uev_out) {
   int leading_zero_bits = -1;
   for (uint8 b = 0; b == 0; leading_zero_bits++) {
-    if (!ReadRBSPBit(b)) {
+    if (!ReadBit(b)) {
       return false;
     }
   }
@@ -78,136 +101,170 @@ bool ShellRBSPStream::ReadBits(size_t bits, uint32& bits_out) {
   if (bits == 0) {
     return true;
   }
-  uint32 result = 0;
-  size_t bytes = bits >> 3;
-  // read bytes first
-  for (int i = 0; i < bytes; i++) {
-    uint8 new_byte = 0;
-    if (!ReadRBSPByte(new_byte)) {
+  if (cache_bits_ < bits) {
+    FillCache();
+    if (cache_bits_ < bits) {
       return false;
     }
-    result = result << 8;
-    result = result | (uint32)new_byte;
   }
-  // scoot any leftover bits in
-  bits = bits % 8;
-  for (int i = 0; i < bits; i++) {
-    uint8 new_bit = 0;
-    if (!ReadRBSPBit(new_bit)) {
-      return false;
-    }
-    result = result << 1;
-    result = result | (uint32)new_bit;
+  cache_bits_ -= bits;
+  bits_out = static_cast<uint32>(
+      (cache_ >> cache_bits_) & ((GG_UINT64_C(1) << bits) - 1));
+  return true;
+}
+
+bool ShellRBSPStream::ReadByte(uint8& byte_out) {
+  uint32 bits = 0;
+  if (!ReadBits(8, bits)) {
+    return false;
   }
-  bits_out = result;
+  byte_out = static_cast<uint8>(bits);
   return true;
 }
 
-// jump over bytes in the RBSP stream
-bool ShellRBSPStream::SkipBytes(size_t bytes) {
-  for (int i = 0; i < bytes; ++i) {
-    if (!ConsumeNALUByte()) {
-      return false;
-    }
+// return single bit in the LSb from the RBSP stream. Bits are read from MSb
+// to LSb in the stream.
+bool ShellRBSPStream::ReadBit(uint8& bit_out) {
+  uint32 bits = 0;
+  if (!ReadBits(1, bits)) {
+    return false;
   }
+  bit_out = static_cast<uint8>(bits);
   return true;
 }
 
+// jump over bytes in the RBSP stream
+bool ShellRBSPStream::SkipBytes(size_t bytes) {
+  return SkipBits(bytes * 8);
+}
+
 // jump over bits in the RBSP stream
 bool ShellRBSPStream::SkipBits(size_t bits) {
-  // skip bytes first
-  size_t bytes = bits >> 3;
-  if (bytes > 0) {
-    if (!SkipBytes(bytes)) {
+  while (bits > cache_bits_) {
+    bits -= cache_bits_;
+    cache_bits_ = 0;
+    if (!FillCache()) {
       return false;
     }
   }
-  // mask off byte skips
-  bits = bits & 7;
-  // if no bits left to skip just return
-  if (bits == 0) {
-    return true;
-  }
-  // obey the convention that if our bit offset is 0 we haven't loaded the
-  // current byte, extract it from NALU stream as we are going to advance
-  // the bit cursor in to it (or potentially past it)
-  if (rbsp_bit_offset_ == 0) {
-    if (!ConsumeNALUByte()) {
-      return false;
-    }
-  }
-  // add to our bit offset
-  rbsp_bit_offset_ += bits;
-  // if we jumped in to the next byte advance the NALU stream, respecting the
-  // convention that if we're at 8 bits stay on the current byte
-  if (rbsp_bit_offset_ >= 9) {
-    if (!ConsumeNALUByte()) {
-      return false;
-    }
-  }
-  rbsp_bit_offset_ = rbsp_bit_offset_ % 8;
+  cache_bits_ -= bits;
   return true;
 }
 
-// advance by one byte through the NALU buffer, respecting the encoding of
-// 00 00 03 => 00 00. Updates the state of current_nalu_byte_ to the new value.
-bool ShellRBSPStream::ConsumeNALUByte() {
-  if (nalu_buffer_byte_offset_ >= nalu_buffer_size_) {
-    return false;
-  }
-  current_nalu_byte_ = nalu_buffer_[nalu_buffer_byte_offset_];
-  if (current_nalu_byte_ == 0x03 && number_consecutive_zeros_ >= 2) {
-    ++nalu_buffer_byte_offset_;
-    current_nalu_byte_ = nalu_buffer_[nalu_buffer_byte_offset_];
-    number_consecutive_zeros_ = 0;
-  }
+// static
+size_t ShellRBSPStream::FindEmulationPreventionByte(const uint8* buffer,
+                                                    size_t size,
+                                                    size_t offset) {
+  // Rely on function level static initialization to keep the proc selection
+  // thread safe.
+  typedef size_t (*FindProc)(const uint8* buffer, size_t size, size_t offset);
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE2__)
+  static const FindProc kFindProc = base::CPU().has_sse2() ?
+      FindEmulationPreventionByte_SSE2 : FindEmulationPreventionByte_C;
+#elif defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+  static const FindProc kFindProc = FindEmulationPreventionByte_NEON;
+#else
+  static const FindProc kFindProc = FindEmulationPreventionByte_C;
+#endif
+  return kFindProc(buffer, size, offset);
+}
 
-  if (current_nalu_byte_ == 0) {
-    ++number_consecutive_zeros_;
-  } else {
-    number_consecutive_zeros_ = 0;
+// static
+size_t ShellRBSPStream::FindEmulationPreventionByte_C(const uint8* buffer,
+                                                      size_t size,
+                                                      size_t offset) {
+  while (offset < size) {
+    uint8 byte = buffer[offset];
+    if (byte == 0x03) {
+      if (IsEmulationPreventionByte(buffer, offset))
+        return offset;
+      ++offset;
+    } else if (byte) {
+      // Neither this byte nor the next two can end a 00 00 03 sequence.
+      offset += 3;
+    } else {
+      ++offset;
+    }
   }
-  ++nalu_buffer_byte_offset_;
-  return true;
+  return size;
 }
 
-// return single bit in the LSb from the RBSP stream. Bits are read from MSb
-// to LSb in the stream.
-bool ShellRBSPStream::ReadRBSPBit(uint8& bit_out) {
-  // check to see if we need to consume a fresh byte
-  if (rbsp_bit_offset_ == 0) {
-    if (!ConsumeNALUByte()) {
-      return false;
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE2__)
+// static
+size_t ShellRBSPStream::FindEmulationPreventionByte_SSE2(const uint8* buffer,
+                                                         size_t size,
+                                                         size_t offset) {
+  // An emulation prevention byte at offset i needs zeros at i - 2 and i - 1,
+  // so if the 16 bytes starting at i - 2 are all non-zero, none of the bytes
+  // in [i, i + 16) can be one.
+  offset = std::max<size_t>(offset, 2);
+  const __m128i zero = _mm_setzero_si128();
+  while (offset + 14 <= size) {
+    __m128i bytes = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(buffer + offset - 2));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, zero))) {
+      size_t end = std::min(offset + 16, size);
+      for (; offset < end; ++offset) {
+        if (IsEmulationPreventionByte(buffer, offset))
+          return offset;
+      }
+    } else {
+      offset += 16;
     }
   }
-  // since we read from MSb to LSb in stream we shift right
-  uint8 bit = (current_nalu_byte_ >> (7 - rbsp_bit_offset_)) & 1;
-  // increment bit offset
-  rbsp_bit_offset_ = (rbsp_bit_offset_ + 1) % 8;
-  bit_out = bit;
-  return true;
+  return FindEmulationPreventionByte_C(buffer, size, offset);
 }
+#endif
 
-bool ShellRBSPStream::ReadRBSPByte(uint8& byte_out) {
-  // fast path for byte-aligned access
-  if (rbsp_bit_offset_ == 0) {
-    if (!ConsumeNALUByte()) {
-      return false;
+#if defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+// static
+size_t ShellRBSPStream::FindEmulationPreventionByte_NEON(const uint8* buffer,
+                                                         size_t size,
+                                                         size_t offset) {
+  // See FindEmulationPreventionByte_SSE2().
+  offset = std::max<size_t>(offset, 2);
+  while (offset + 14 <= size) {
+    uint8x16_t zeros = vceqq_u8(vld1q_u8(buffer + offset - 2), vdupq_n_u8(0));
+    uint64x2_t any_zero = vreinterpretq_u64_u8(zeros);
+    if (vgetq_lane_u64(any_zero, 0) | vgetq_lane_u64(any_zero, 1)) {
+      size_t end = std::min(offset + 16, size);
+      for (; offset < end; ++offset) {
+        if (IsEmulationPreventionByte(buffer, offset))
+          return offset;
+      }
+    } else {
+      offset += 16;
     }
-    byte_out = current_nalu_byte_;
-    return true;
   }
-  // at least some of the bits in the current byte will be included in this
-  // next byte, absorb them
-  uint8 upper_part = current_nalu_byte_;
-  // read next byte from stream
-  if (!ConsumeNALUByte()) {
-    return false;
+  return FindEmulationPreventionByte_C(buffer, size, offset);
+}
+#endif
+
+bool ShellRBSPStream::FillCache() {
+  size_t bits_before = cache_bits_;
+  while (cache_bits_ <= 56) {
+    if (nalu_buffer_byte_offset_ == next_emulation_prevention_byte_) {
+      if (nalu_buffer_byte_offset_ >= nalu_buffer_size_) {
+        break;
+      }
+      // drop the 03 of the 00 00 03 and look for the next one
+      ++nalu_buffer_byte_offset_;
+      next_emulation_prevention_byte_ = FindEmulationPreventionByte(
+          nalu_buffer_, nalu_buffer_size_, nalu_buffer_byte_offset_);
+      continue;
+    }
+    // every byte up to the next emulation prevention byte is copied as is
+    size_t bytes = std::min(
+        next_emulation_prevention_byte_ - nalu_buffer_byte_offset_,
+        (64 - cache_bits_) / 8);
+    const uint8* source = nalu_buffer_ + nalu_buffer_byte_offset_;
+    for (size_t i = 0; i < bytes; ++i) {
+      cache_ = (cache_ << 8) | source[i];
+    }
+    nalu_buffer_byte_offset_ += bytes;
+    cache_bits_ += bytes * 8;
   }
-  // form the byte from the two bytes
-  byte_out = (upper_part << rbsp_bit_offset_) |
-             (current_nalu_byte_ >> (8 - rbsp_bit_offset_));
-  return true;
+  return cache_bits_ > bits_before;
 }
 
 }  // namespace media
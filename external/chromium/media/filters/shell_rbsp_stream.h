@@ -18,6 +18,7 @@
 #define MEDIA_FILTERS_SHELL_RBSP_STREAM_H_
 
 #include "base/basictypes.h"
+#include "base/gtest_prod_util.h"
 
 namespace media {
 
@@ -26,6 +27,10 @@ namespace media {
 // that some other atoms are defined. This class takes a non-owning reference
 // to a buffer and extract various types from the stream while silently
 // consuming the extra encoding bytes and advancing a bit stream pointer.
+//
+// The RBSP is unescaped a word at a time into a bit cache: the position of the
+// next 00 00 03 sequence is found with a vectorized scan, and every byte
+// before it is copied into the cache without further checks.
 class ShellRBSPStream {
  public:
   // NON-OWNING pointer to buffer. It is assumed the client will dispose of
@@ -41,30 +46,46 @@ class ShellRBSPStream {
   // read and return up to 32 bits, filling from the right, meaning that
   // ReadBits(17) on a stream of all 1s would return 0x01ffff
   bool ReadBits(size_t bits, uint32& bits_out);
-  bool ReadByte(uint8& byte_out) { return ReadRBSPByte(byte_out); }
-  bool ReadBit(uint8& bit_out) { return ReadRBSPBit(bit_out); }
+  bool ReadByte(uint8& byte_out);
+  bool ReadBit(uint8& bit_out);
   // jump over bytes in the RBSP stream
   bool SkipBytes(size_t bytes);
   // jump over bits in the RBSP stream
   bool SkipBits(size_t bits);
 
+  // Returns the offset of the first emulation prevention byte, the 03 in a
+  // 00 00 03 sequence, at or after |offset| in |buffer|, or |size| if there
+  // is none.
+  static size_t FindEmulationPreventionByte(const uint8* buffer, size_t size,
+                                            size_t offset);
+
  private:
-  // advance by one byte through the NALU buffer, respecting the encoding of
-  // 00 00 03 => 00 00. Updates the state of current_nalu_byte_ to the new value.
-  // returns fale if we have moved past the end of the buffer.
-  bool ConsumeNALUByte();
-  // return single bit in the LSb from the RBSP stream. Bits are read from MSb
-  // to LSb in the stream.
-  bool ReadRBSPBit(uint8& bit_out);
-  bool ReadRBSPByte(uint8& byte_out);
+  FRIEND_TEST_ALL_PREFIXES(ShellRBSPStreamTest, FindEmulationPreventionByte);
+  FRIEND_TEST_ALL_PREFIXES(ShellRBSPStreamTest,
+                           FindEmulationPreventionByteBenchmark);
+
+  // Optimized versions of FindEmulationPreventionByte().
+  static size_t FindEmulationPreventionByte_C(const uint8* buffer, size_t size,
+                                              size_t offset);
+  static size_t FindEmulationPreventionByte_SSE2(const uint8* buffer,
+                                                 size_t size, size_t offset);
+  static size_t FindEmulationPreventionByte_NEON(const uint8* buffer,
+                                                 size_t size, size_t offset);
+
+  // Unescapes as many whole bytes from the NALU buffer into the bit cache as
+  // it will hold. Returns false if there are no bytes left to unescape.
+  bool FillCache();
 
   const uint8* nalu_buffer_;
   size_t nalu_buffer_size_;
+  // offset of the next byte of the NALU buffer to be unescaped
   size_t nalu_buffer_byte_offset_;
-  uint8 current_nalu_byte_;
-  int number_consecutive_zeros_;
-  // location of rbsp bit cursor within current_nalu_byte_
-  size_t rbsp_bit_offset_;
+  // offset of the next emulation prevention byte, or nalu_buffer_size_
+  size_t next_emulation_prevention_byte_;
+  // the next cache_bits_ bits of the RBSP stream are the low bits of cache_,
+  // MSb first
+  uint64 cache_;
+  size_t cache_bits_;
 };
 
 };
@@ -17,12 +17,21 @@
 #include "media/filters/shell_rbsp_stream.h"
 
 #include <list>
+#include <vector>
 
+#include "base/command_line.h"
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/string_number_conversions.h"
 #include "base/stringprintf.h"
+#include "base/time.h"
+#include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
+// Command line switch for runtime adjustment of benchmark iterations.
+static const char kBenchmarkIterations[] = "rbsp-iterations";
+static const int kDefaultIterations = 10;
+
 namespace media {
 
 class ShellRBSPStreamTest : public testing::Test {
@@ -634,4 +643,185 @@ TEST_F(ShellRBSPStreamTest, SkipBits) {
   }
 }
 
+TEST_F(ShellRBSPStreamTest, EmulationPreventionByteAtEnd) {
+  // the trailing 03 is dropped without reading past the end of the buffer
+  const uint8 buffer[] = { 0xab, 0x00, 0x00, 0x03 };
+  ShellRBSPStream stream(buffer, sizeof(buffer));
+  uint32 bits = 0;
+  ASSERT_TRUE(stream.ReadBits(24, bits));
+  ASSERT_EQ(bits, 0xab0000u);
+  uint8 bit = 0;
+  ASSERT_FALSE(stream.ReadBit(bit));
+}
+
+namespace {
+
+// Builds a synthetic Annex B stream of |size| bytes that looks like high
+// bitrate slice data: a start code every |nalu_size| bytes, and payloads of
+// random bytes with frequent runs of zeros, escaped as an encoder would.
+std::vector<uint8> BuildAnnexBStream(size_t size, size_t nalu_size) {
+  std::vector<uint8> stream;
+  stream.reserve(size);
+  uint32 seed = 1;
+  int zeros = 0;
+  while (stream.size() < size) {
+    if (stream.size() % nalu_size == 0) {
+      const uint8 kStartCode[] = { 0x00, 0x00, 0x00, 0x01, 0x65 };
+      stream.insert(stream.end(), kStartCode,
+                    kStartCode + sizeof(kStartCode));
+      zeros = 0;
+      continue;
+    }
+    seed = seed * 1103515245 + 12345;
+    uint8 byte = static_cast<uint8>(seed >> 16);
+    // entropy coded data is close to uniformly random, add some extra runs
+    // of zeros so there is a fair number of sequences to escape
+    if ((seed >> 8) % 64 == 0) {
+      byte = 0;
+    } else if ((seed >> 8) % 64 == 1 && zeros >= 2) {
+      byte &= 0x03;
+    }
+    if (zeros >= 2 && byte <= 0x03) {
+      stream.push_back(0x03);
+      zeros = 0;
+    }
+    stream.push_back(byte);
+    zeros = byte ? 0 : zeros + 1;
+  }
+  return stream;
+}
+
+// Straightforward version of FindEmulationPreventionByte() to compare with.
+size_t FindEmulationPreventionByteReference(const uint8* buffer, size_t size,
+                                            size_t offset) {
+  for (; offset < size; ++offset) {
+    if (offset >= 2 && buffer[offset] == 0x03 && buffer[offset - 1] == 0 &&
+        buffer[offset - 2] == 0) {
+      return offset;
+    }
+  }
+  return size;
+}
+
+int BenchmarkIterations() {
+  int iterations = kDefaultIterations;
+  std::string value(CommandLine::ForCurrentProcess()->GetSwitchValueASCII(
+      kBenchmarkIterations));
+  if (!value.empty())
+    base::StringToInt(value, &iterations);
+  return iterations;
+}
+
+}  // namespace
+
+TEST_F(ShellRBSPStreamTest, FindEmulationPreventionByte) {
+  std::vector<uint8> stream = BuildAnnexBStream(64 * 1024, 1000);
+  const uint8* buffer = &stream[0];
+  // check every offset, including the ones close to the end
+  for (size_t size = stream.size() - 40; size <= stream.size(); ++size) {
+    for (size_t offset = 0; offset <= size;
+         offset += offset < 64 ? 1 : 997) {
+      size_t expected =
+          FindEmulationPreventionByteReference(buffer, size, offset);
+      ASSERT_EQ(expected, ShellRBSPStream::FindEmulationPreventionByte_C(
+          buffer, size, offset));
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE2__)
+      ASSERT_EQ(expected, ShellRBSPStream::FindEmulationPreventionByte_SSE2(
+          buffer, size, offset));
+#endif
+#if defined(ARCH_CPU_ARM_FAMILY) && defined(USE_NEON)
+      ASSERT_EQ(expected, ShellRBSPStream::FindEmulationPreventionByte_NEON(
+          buffer, size, offset));
+#endif
+    }
+  }
+  // short buffers and sequences at the very start
+  const uint8 kShort[] = { 0x00, 0x00, 0x03, 0x00, 0x00, 0x03 };
+  EXPECT_EQ(2U, ShellRBSPStream::FindEmulationPreventionByte(kShort, 6, 0));
+  EXPECT_EQ(5U, ShellRBSPStream::FindEmulationPreventionByte(kShort, 6, 3));
+  EXPECT_EQ(5U, ShellRBSPStream::FindEmulationPreventionByte(kShort, 5, 3));
+  EXPECT_EQ(1U, ShellRBSPStream::FindEmulationPreventionByte(kShort + 1, 1, 0));
+}
+
+TEST_F(ShellRBSPStreamTest, ReadBitsAcrossEmulationPreventionBytes) {
+  std::vector<uint8> stream = BuildAnnexBStream(16 * 1024, 16 * 1024);
+  // unescape the stream the slow way
+  std::vector<uint8> rbsp;
+  for (size_t i = 0; i < stream.size(); ++i) {
+    if (FindEmulationPreventionByteReference(&stream[0], i + 1, i) != i)
+      rbsp.push_back(stream[i]);
+  }
+  ShellRBSPStream rbsp_stream(&stream[0], stream.size());
+  size_t bit_offset = 0;
+  for (size_t bits = 1; bit_offset + bits <= rbsp.size() * 8;
+       bits = bits % 32 + 1) {
+    uint32 expected = 0;
+    for (size_t i = 0; i < bits; ++i, ++bit_offset) {
+      expected = (expected << 1) |
+          ((rbsp[bit_offset / 8] >> (7 - bit_offset % 8)) & 1);
+    }
+    uint32 value = 0;
+    ASSERT_TRUE(rbsp_stream.ReadBits(bits, value));
+    ASSERT_EQ(expected, value) << bit_offset;
+  }
+}
+
+// Benchmark for the FindEmulationPreventionByte() methods and for reading a
+// high bitrate stream.  Build with DCHECKs compiled out when benchmarking.
+TEST_F(ShellRBSPStreamTest, FindEmulationPreventionByteBenchmark) {
+  const int kIterations = BenchmarkIterations();
+  // 4MB with a NALU every 64KB is roughly a second of 30Mbps video
+  std::vector<uint8> stream = BuildAnnexBStream(4 * 1024 * 1024, 64 * 1024);
+  const uint8* buffer = &stream[0];
+  const size_t size = stream.size();
+
+  printf("Benchmarking %d iterations:\n", kIterations);
+
+  size_t found_c = 0;
+  base::TimeTicks start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < kIterations; ++i) {
+    size_t offset = 0;
+    while ((offset = ShellRBSPStream::FindEmulationPreventionByte_C(
+        buffer, size, offset)) < size) {
+      ++found_c;
+      ++offset;
+    }
+  }
+  double total_time_c_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  printf("FindEmulationPreventionByte_C took %.2fms.\n", total_time_c_ms);
+
+#if defined(ARCH_CPU_X86_FAMILY) && defined(__SSE2__)
+  size_t found_sse2 = 0;
+  start = base::TimeTicks::HighResNow();
+  for (int i = 0; i < kIterations; ++i) {
+    size_t offset = 0;
+    while ((offset = ShellRBSPStream::FindEmulationPreventionByte_SSE2(
+        buffer, size, offset)) < size) {
+      ++found_sse2;
+      ++offset;
+    }
+  }
+  double total_time_sse2_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  printf("FindEmulationPreventionByte_SSE2 took %.2fms; which is %.2fx faster"
+         " than FindEmulationPreventionByte_C.\n", total_time_sse2_ms,
+         total_time_c_ms / total_time_sse2_ms);
+  EXPECT_EQ(found_c, found_sse2);
+#endif
+
+  start = base::TimeTicks::HighResNow();
+  uint32 checksum = 0;
+  for (int i = 0; i < kIterations; ++i) {
+    ShellRBSPStream rbsp_stream(buffer, size);
+    uint32 value = 0;
+    while (rbsp_stream.ReadBits(32, value))
+      checksum += value;
+  }
+  double total_time_read_ms =
+      (base::TimeTicks::HighResNow() - start).InMillisecondsF();
+  printf("ReadBits(32) over the stream took %.2fms (checksum %x).\n",
+         total_time_read_ms, checksum);
+}
+
 }  // namespace media
@@ -13,7 +13,9 @@
 #include "base/stl_util.h"
 
 #if defined(__LB_SHELL__)
+#include "media/base/shell_buffer_factory.h"
 #include "media/base/shell_media_platform.h"
+#include "media/base/shell_media_statistics.h"
 #endif
 
 namespace media {
@@ -103,6 +105,11 @@ class SourceBufferRange {
   bool FirstGOPContainsNextBufferPosition() const;
   bool LastGOPContainsNextBufferPosition() const;
 
+  // Indicates whether the GOP at the beginning of the range ends at or before
+  // |timestamp|, or the GOP at the end of the range begins after |timestamp|.
+  bool FirstGOPEndsBefore(base::TimeDelta timestamp) const;
+  bool LastGOPStartsAfter(base::TimeDelta timestamp) const;
+
   // Updates |out_buffer| with the next buffer in presentation order. Seek()
   // must be called before calls to GetNextBuffer(), and buffers are returned
   // in order from the last call to Seek(). Returns true if |out_buffer| is
@@ -295,6 +302,14 @@ static base::TimeDelta kSeekToStartFudgeRoom() {
 static const int kDefaultAudioMemoryLimit = 12 * 1024 * 1024;
 static const int kDefaultVideoMemoryLimit = 150 * 1024 * 1024;
 
+#if defined(__LB_SHELL__)
+// The demuxer allocates the buffers it appends, and the arrays it downloads
+// them into, from the ShellBufferFactory pool shared with every stream. The
+// streams garbage collect until the largest free block of the pool is at least
+// this big, so the demuxer isn't left waiting on allocations.
+static const int kShellBufferPoolReserve = 4 * media::kShellMaxArraySize;
+#endif  // defined(__LB_SHELL__)
+
 namespace media {
 
 #if defined(__LB_SHELL__)
@@ -616,20 +631,61 @@ void SourceBufferStream::GarbageCollectIfNeeded() {
   for (RangeList::iterator itr = ranges_.begin(); itr != ranges_.end(); ++itr)
     ranges_size += (*itr)->size_in_bytes();
 
+  int bytes_to_free = ranges_size - memory_limit_;
+#if defined(__LB_SHELL__)
+  int pool_bytes_to_free = GetShellBufferPoolShortfall();
+  bool pool_pressure = pool_bytes_to_free > bytes_to_free;
+  if (pool_pressure)
+    bytes_to_free = pool_bytes_to_free;
+#endif  // defined(__LB_SHELL__)
+
   // Return if we're under or at the memory limit.
-  if (ranges_size <= memory_limit_)
+  if (bytes_to_free <= 0)
     return;
 
-  int bytes_to_free = ranges_size - memory_limit_;
-
-  // Begin deleting from the front.
+  // Begin deleting from the front, which holds the data furthest behind the
+  // playback position.
   int bytes_freed = FreeBuffers(bytes_to_free, false);
 
-  // Begin deleting from the back.
+  // Begin deleting from the back, which holds the data furthest ahead of it.
   if (bytes_to_free - bytes_freed > 0)
-    FreeBuffers(bytes_to_free - bytes_freed, true);
+    bytes_freed += FreeBuffers(bytes_to_free - bytes_freed, true);
+
+#if defined(__LB_SHELL__)
+  if (bytes_freed > 0) {
+    UPDATE_MEDIA_STATISTICS(STAT_TYPE_SOURCE_BUFFER_EVICTION, bytes_freed);
+    if (pool_pressure) {
+      UPDATE_MEDIA_STATISTICS(STAT_TYPE_SOURCE_BUFFER_POOL_EVICTION,
+                              bytes_freed);
+    }
+  }
+#endif  // defined(__LB_SHELL__)
 }
 
+#if defined(__LB_SHELL__)
+int SourceBufferStream::GetShellBufferPoolShortfall() const {
+  scoped_refptr<ShellBufferFactory> factory = ShellBufferFactory::Instance();
+  if (!factory)
+    return 0;
+  int largest_free_space = static_cast<int>(std::min<size_t>(
+      factory->GetLargestFreeSpace(), kShellBufferPoolReserve));
+  if (largest_free_space >= kShellBufferPoolReserve)
+    return 0;
+
+  // Each stream gives back a share of the shortfall in proportion to its
+  // memory limit, so the audio stream isn't drained to feed the video one.
+  ShellMediaPlatform* platform = ShellMediaPlatform::Instance();
+  int64 combined_memory_limit =
+      platform->GetSourceBufferStreamAudioMemoryLimit() +
+      platform->GetSourceBufferStreamVideoMemoryLimit();
+  if (combined_memory_limit <= 0)
+    return 0;
+  return static_cast<int>(
+      static_cast<int64>(kShellBufferPoolReserve - largest_free_space) *
+      memory_limit_ / combined_memory_limit);
+}
+#endif  // defined(__LB_SHELL__)
+
 int SourceBufferStream::FreeBuffers(int total_bytes_to_free,
                                     bool reverse_direction) {
   DCHECK_GT(total_bytes_to_free, 0);
@@ -645,12 +701,18 @@ int SourceBufferStream::FreeBuffers(int total_bytes_to_free,
     BufferQueue buffers;
     int bytes_deleted = 0;
 
+    // While a seek is pending the GOP that the seek will start from is kept,
+    // like the GOP containing the next buffer of |selected_range_|.
     if (reverse_direction) {
       current_range = ranges_.back();
       if (current_range->LastGOPContainsNextBufferPosition()) {
         DCHECK_EQ(current_range, selected_range_);
         break;
       }
+      if (seek_pending_ &&
+          !current_range->LastGOPStartsAfter(seek_buffer_timestamp_)) {
+        break;
+      }
       bytes_deleted = current_range->DeleteGOPFromBack(&buffers);
     } else {
       current_range = ranges_.front();
@@ -658,6 +720,10 @@ int SourceBufferStream::FreeBuffers(int total_bytes_to_free,
         DCHECK_EQ(current_range, selected_range_);
         break;
       }
+      if (seek_pending_ &&
+          !current_range->FirstGOPEndsBefore(seek_buffer_timestamp_)) {
+        break;
+      }
       bytes_deleted = current_range->DeleteGOPFromFront(&buffers);
     }
 
@@ -1520,6 +1586,23 @@ bool SourceBufferRange::LastGOPContainsNextBufferPosition() const {
       last_gop->second - keyframe_map_index_base_ <= next_buffer_index_;
 }
 
+bool SourceBufferRange::FirstGOPEndsBefore(base::TimeDelta timestamp) const {
+  DCHECK(!keyframe_map_.empty());
+
+  // The first GOP ends where the second one begins, or at the end of the
+  // range if there is only one GOP.
+  KeyframeMap::const_iterator second_gop = keyframe_map_.begin();
+  ++second_gop;
+  if (second_gop == keyframe_map_.end())
+    return GetBufferedEndTimestamp() <= timestamp;
+  return second_gop->first <= timestamp;
+}
+
+bool SourceBufferRange::LastGOPStartsAfter(base::TimeDelta timestamp) const {
+  DCHECK(!keyframe_map_.empty());
+  return keyframe_map_.rbegin()->first > timestamp;
+}
+
 void SourceBufferRange::FreeBufferRange(
     const BufferQueue::iterator& starting_point,
     const BufferQueue::iterator& ending_point) {
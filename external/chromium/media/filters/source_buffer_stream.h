@@ -112,13 +112,23 @@ class MEDIA_EXPORT SourceBufferStream {
 
   void set_memory_limit(int memory_limit) { memory_limit_ = memory_limit; }
 
-  // Frees up space if the SourceBufferStream is taking up too much memory.
+  // Frees up space if the SourceBufferStream is taking up too much memory, or
+  // on LB_SHELL if the ShellBufferFactory pool is running out of room.
   void GarbageCollectIfNeeded();
 
+#if defined(__LB_SHELL__)
+  // Returns this stream's share of the bytes that need freeing for the
+  // ShellBufferFactory pool to have room for the demuxer's allocations, or 0
+  // if it already has.
+  int GetShellBufferPoolShortfall() const;
+#endif  // defined(__LB_SHELL__)
+
   // Attempts to delete approximately |total_bytes_to_free| amount of data
   // |ranges_|, starting at the front of |ranges_| and moving linearly forward
   // through the buffers. Deletes starting from the back if |reverse_direction|
-  // is true. Returns the number of bytes freed.
+  // is true. Buffers are deleted a GOP at a time, and the GOP containing the
+  // next buffer, or the pending seek position, is never deleted. Returns the
+  // number of bytes freed.
   int FreeBuffers(int total_bytes_to_free, bool reverse_direction);
 
   // Appends |new_buffers| into |range_for_new_buffers_itr|, handling start and
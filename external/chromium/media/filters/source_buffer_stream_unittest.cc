@@ -2077,6 +2077,32 @@ TEST_F(SourceBufferStreamTest, GarbageCollection_PendingSeek) {
   CheckExpectedBuffers(30, 34, &kDataA);
 }
 
+TEST_F(SourceBufferStreamTest, GarbageCollection_PendingSeekKeepsNearData) {
+  // Seek to position 100 before there's any data there.
+  Seek(100);
+  CheckNoNextBuffer();
+
+  // Set memory limit to 10 buffers.
+  SetMemoryLimit(10);
+
+  // Append 30 buffers at positions 105 through 134, which can't fulfill the
+  // seek.
+  NewSegmentAppend(105, 30, &kDataA);
+
+  // GC should have deleted the GOPs furthest from the seek position first,
+  // from the back, saving the last GOP appended.
+  CheckExpectedRanges("{ [105,109) [130,134) }");
+
+  // Expand memory limit again so that GC won't be triggered.
+  SetMemoryLimit(100);
+
+  // Append data to fulfill seek, the buffers after it are still there.
+  NewSegmentAppend(100, 5, &kDataA);
+  CheckExpectedRanges("{ [100,109) [130,134) }");
+  CheckExpectedBuffers(100, 109, &kDataA);
+  CheckNoNextBuffer();
+}
+
 TEST_F(SourceBufferStreamTest, GarbageCollection_NeedsMoreData) {
   // Set memory limit to 15 buffers.
   SetMemoryLimit(15);
@@ -28,6 +28,9 @@
 #include "net/disk_cache/experiments.h"
 #include "net/disk_cache/file.h"
 #include "net/disk_cache/mem_backend_impl.h"
+#if defined(__LB_SHELL__)
+#include "net/disk_cache/shell_backend_impl.h"
+#endif
 
 // This has to be defined before including histogram_macros.h from this file.
 #define NET_DISK_CACHE_BACKEND_IMPL_CC_
@@ -264,10 +267,17 @@ int CreateCacheBackend(net::CacheType type, const FilePath& path, int max_bytes,
     *backend = MemBackendImpl::CreateBackend(max_bytes, net_log);
     return *backend ? net::OK : net::ERR_FAILED;
   }
+#if defined(__LB_SHELL__)
+  // The block file cache is too demanding of memory and of flash storage for
+  // lb_shell, which uses its own log structured backend instead.
+  *backend = ShellBackendImpl::CreateBackend(path, max_bytes, net_log);
+  return *backend ? net::OK : net::ERR_FAILED;
+#else
   DCHECK(thread);
 
   return BackendImpl::CreateBackend(path, force, max_bytes, type, kNone, thread,
                                     net_log, backend, callback);
+#endif
 }
 
 // Returns the preferred maximum number of bytes for the cache given the
@@ -0,0 +1,669 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/disk_cache/shell_backend_impl.h"
+
+#include <algorithm>
+
+#include "base/atomicops.h"
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/string_number_conversions.h"
+#include "base/stringprintf.h"
+#include "net/base/net_errors.h"
+#include "net/disk_cache/shell_entry_impl.h"
+
+using base::Time;
+
+namespace {
+
+const int kDefaultCacheSize = 8 * 1024 * 1024;
+
+// Segments are closed once they would grow beyond this, although a record
+// larger than a segment gets a segment to itself.
+const int32 kSegmentSize = 1024 * 1024;
+
+// Appends are written out once this much is buffered, or kFlushDelayMs after
+// the first one, whichever comes first. Flash storage is erased a block at a
+// time, so small scattered writes wear it out much faster than large ones.
+const size_t kWriteBatchSize = 128 * 1024;
+const int kFlushDelayMs = 2000;
+
+const char kSegmentPrefix[] = "segment_";
+
+// Keys longer than this in a record header are taken as corruption.
+const int32 kMaxKeySize = 64 * 1024;
+
+const uint32 kRecordMagic = 0x4c424331;  // "LBC1"
+
+// A record that dooms the last entry with the same key in the log.
+const uint32 kDoomRecordFlag = 1;
+
+// Every record in a segment starts with this header, followed by the key and
+// then the data of each stream.
+struct RecordHeader {
+  uint32 magic;
+  uint32 flags;
+  int32 key_size;
+  int32 data_size[disk_cache::ShellBackendImpl::kNumStreams];
+  int64 last_used;
+  int64 last_modified;
+};
+
+base::subtle::Atomic32 g_hit_count = 0;
+base::subtle::Atomic32 g_miss_count = 0;
+
+bool CompareLastUsed(const disk_cache::ShellBackendImpl::Record* a,
+                     const disk_cache::ShellBackendImpl::Record* b) {
+  return a->last_used < b->last_used;
+}
+
+}  // namespace
+
+namespace disk_cache {
+
+int32 ShellBackendImpl::Record::Length() const {
+  return DataOffset(kNumStreams) - offset;
+}
+
+int32 ShellBackendImpl::Record::DataOffset(int index) const {
+  int32 data_offset = offset + sizeof(RecordHeader) + key.size();
+  for (int i = 0; i < index; ++i)
+    data_offset += data_size[i];
+  return data_offset;
+}
+
+ShellBackendImpl::ShellBackendImpl(const FilePath& path, int max_bytes,
+                                   net::NetLog* net_log)
+    : path_(path),
+      max_size_(max_bytes),
+      net_log_(net_log),
+      disk_size_(0),
+      live_size_(0) {
+}
+
+ShellBackendImpl::~ShellBackendImpl() {
+  DCHECK(open_entries_.empty());
+  FlushWriteBuffer();
+  for (Segments::iterator it = segments_.begin(); it != segments_.end(); ++it)
+    base::ClosePlatformFile(it->second.file);
+  for (Index::iterator it = index_.begin(); it != index_.end(); ++it)
+    delete it->second;
+}
+
+// static
+Backend* ShellBackendImpl::CreateBackend(const FilePath& path, int max_bytes,
+                                         net::NetLog* net_log) {
+  ShellBackendImpl* cache = new ShellBackendImpl(
+      path, max_bytes ? max_bytes : kDefaultCacheSize, net_log);
+  if (cache->Init())
+    return cache;
+
+  delete cache;
+  LOG(ERROR) << "Unable to create cache";
+  return NULL;
+}
+
+bool ShellBackendImpl::Init() {
+  if (max_size_ <= 0 || !file_util::CreateDirectory(path_))
+    return false;
+
+  std::vector<int> sequences;
+  file_util::FileEnumerator enumerator(
+      path_, false, file_util::FileEnumerator::FILES);
+  for (FilePath name = enumerator.Next(); !name.empty();
+       name = enumerator.Next()) {
+    std::string base_name = name.BaseName().MaybeAsASCII();
+    int sequence;
+    if (base_name.compare(0, arraysize(kSegmentPrefix) - 1,
+                          kSegmentPrefix) != 0 ||
+        !base::StringToInt(base_name.substr(arraysize(kSegmentPrefix) - 1),
+                           &sequence) ||
+        sequence < 0) {
+      continue;
+    }
+    sequences.push_back(sequence);
+  }
+  // Later records replace earlier ones, so segments are replayed in order.
+  std::sort(sequences.begin(), sequences.end());
+  for (size_t i = 0; i < sequences.size(); ++i) {
+    if (!LoadSegment(sequences[i])) {
+      DLOG(WARNING) << "Dropping unreadable cache segment " << sequences[i];
+      file_util::Delete(GetSegmentPath(sequences[i]), false);
+    }
+  }
+
+  // Only writes are recorded in the log, so the order entries were last used
+  // in is as of when they were last written.
+  lru_.sort(CompareLastUsed);
+
+  if (segments_.empty() && !StartSegment(0))
+    return false;
+
+  TrimCache();
+  CleanSegments();
+  return true;
+}
+
+// static
+int ShellBackendImpl::GetHitCount() {
+  return base::subtle::NoBarrier_Load(&g_hit_count);
+}
+
+// static
+int ShellBackendImpl::GetMissCount() {
+  return base::subtle::NoBarrier_Load(&g_miss_count);
+}
+
+int ShellBackendImpl::MaxFileSize() const {
+  return max_size_ / 8;
+}
+
+int ShellBackendImpl::ReadRecordData(const Record* record, int index,
+                                     int offset, char* buf, int buf_len) {
+  DCHECK_LE(offset + buf_len, record->data_size[index]);
+  Segments::iterator it = segments_.find(record->segment);
+  DCHECK(it != segments_.end());
+
+  int32 position = record->DataOffset(index) + offset;
+  // Records are always written out whole, so a record in the newest segment
+  // is either entirely on disk or entirely in the write buffer.
+  if (it->first == segments_.rbegin()->first) {
+    int32 flushed_size =
+        it->second.size - static_cast<int32>(write_buffer_.size());
+    if (position >= flushed_size) {
+      memcpy(buf, &write_buffer_[position - flushed_size], buf_len);
+      return buf_len;
+    }
+  }
+
+  int rv = base::ReadPlatformFile(it->second.file, position, buf, buf_len);
+  if (rv != buf_len)
+    return net::ERR_CACHE_READ_FAILURE;
+  return buf_len;
+}
+
+void ShellBackendImpl::OnEntryDoomed(ShellEntryImpl* entry) {
+  // The entry stays usable until it is closed, so it needs its own copy of
+  // its data before the record in the log can go.
+  if (entry->record())
+    entry->LoadData();
+
+  open_entries_.erase(entry->GetKey());
+  Index::iterator it = index_.find(entry->GetKey());
+  if (it != index_.end())
+    RemoveRecord(it->second, true);
+  entry->InternalDoom();
+}
+
+void ShellBackendImpl::OnEntryClosed(ShellEntryImpl* entry) {
+  if (entry->doomed())
+    return;
+
+  open_entries_.erase(entry->GetKey());
+  if (entry->dirty())
+    CommitEntry(entry);
+}
+
+net::CacheType ShellBackendImpl::GetCacheType() const {
+  return net::DISK_CACHE;
+}
+
+int32 ShellBackendImpl::GetEntryCount() const {
+  return static_cast<int32>(index_.size());
+}
+
+int ShellBackendImpl::OpenEntry(const std::string& key, Entry** entry,
+                                const CompletionCallback& callback) {
+  OpenEntries::iterator open = open_entries_.find(key);
+  if (open != open_entries_.end()) {
+    base::subtle::NoBarrier_AtomicIncrement(&g_hit_count, 1);
+    open->second->AddRef();
+    *entry = open->second;
+    return net::OK;
+  }
+
+  Index::iterator it = index_.find(key);
+  if (it == index_.end()) {
+    base::subtle::NoBarrier_AtomicIncrement(&g_miss_count, 1);
+    return net::ERR_FAILED;
+  }
+
+  base::subtle::NoBarrier_AtomicIncrement(&g_hit_count, 1);
+  Record* record = it->second;
+  record->last_used = Time::Now();
+  lru_.splice(lru_.end(), lru_, record->lru_position);
+
+  ShellEntryImpl* new_entry = new ShellEntryImpl(this, key, record);
+  open_entries_[key] = new_entry;
+  *entry = new_entry;
+  return net::OK;
+}
+
+int ShellBackendImpl::CreateEntry(const std::string& key, Entry** entry,
+                                  const CompletionCallback& callback) {
+  if (open_entries_.find(key) != open_entries_.end())
+    return net::ERR_FAILED;
+
+  // Any entry with the same key in the index is replaced when the new one is
+  // committed, or doomed if the new one is.
+  ShellEntryImpl* new_entry = new ShellEntryImpl(this, key, NULL);
+  open_entries_[key] = new_entry;
+  *entry = new_entry;
+  return net::OK;
+}
+
+int ShellBackendImpl::DoomEntry(const std::string& key,
+                                const CompletionCallback& callback) {
+  OpenEntries::iterator open = open_entries_.find(key);
+  if (open != open_entries_.end()) {
+    open->second->Doom();
+    return net::OK;
+  }
+
+  Index::iterator it = index_.find(key);
+  if (it == index_.end())
+    return net::ERR_FAILED;
+
+  RemoveRecord(it->second, true);
+  return net::OK;
+}
+
+int ShellBackendImpl::DoomAllEntries(const CompletionCallback& callback) {
+  while (!open_entries_.empty())
+    open_entries_.begin()->second->Doom();
+
+  for (Index::iterator it = index_.begin(); it != index_.end(); ++it)
+    delete it->second;
+  index_.clear();
+  lru_.clear();
+  live_size_ = 0;
+
+  // With nothing left in the index the whole log is garbage.
+  flush_timer_.Stop();
+  write_buffer_.clear();
+  while (!segments_.empty()) {
+    segments_.begin()->second.live_bytes = 0;
+    DeleteSegment(segments_.begin());
+  }
+  return StartSegment(0) ? net::OK : net::ERR_FAILED;
+}
+
+int ShellBackendImpl::DoomEntriesBetween(const Time initial_time,
+                                         const Time end_time,
+                                         const CompletionCallback& callback) {
+  Time end = end_time.is_null() ? Time::Max() : end_time;
+  std::vector<std::string> keys;
+  for (OpenEntries::iterator it = open_entries_.begin();
+       it != open_entries_.end(); ++it) {
+    Time last_used = it->second->GetLastUsed();
+    if (last_used >= initial_time && last_used < end)
+      keys.push_back(it->first);
+  }
+  for (Index::iterator it = index_.begin(); it != index_.end(); ++it) {
+    Time last_used = it->second->last_used;
+    if (last_used >= initial_time && last_used < end &&
+        open_entries_.find(it->first) == open_entries_.end()) {
+      keys.push_back(it->first);
+    }
+  }
+
+  for (size_t i = 0; i < keys.size(); ++i)
+    DoomEntry(keys[i], CompletionCallback());
+  return net::OK;
+}
+
+int ShellBackendImpl::DoomEntriesSince(const Time initial_time,
+                                       const CompletionCallback& callback) {
+  return DoomEntriesBetween(initial_time, Time::Max(), callback);
+}
+
+int ShellBackendImpl::OpenNextEntry(void** iter, Entry** next_entry,
+                                    const CompletionCallback& callback) {
+  // HttpCache never enumerates its entries.
+  NOTIMPLEMENTED();
+  return net::ERR_NOT_IMPLEMENTED;
+}
+
+void ShellBackendImpl::EndEnumeration(void** iter) {
+}
+
+void ShellBackendImpl::GetStats(
+    std::vector<std::pair<std::string, std::string> >* stats) {
+  stats->push_back(std::make_pair(
+      std::string("Entries"),
+      base::IntToString(static_cast<int>(index_.size()))));
+  stats->push_back(std::make_pair(std::string("Live bytes"),
+                                  base::Int64ToString(live_size_)));
+  stats->push_back(std::make_pair(std::string("Disk bytes"),
+                                  base::Int64ToString(disk_size_)));
+  stats->push_back(std::make_pair(
+      std::string("Segments"),
+      base::IntToString(static_cast<int>(segments_.size()))));
+  stats->push_back(std::make_pair(std::string("Hits"),
+                                  base::IntToString(GetHitCount())));
+  stats->push_back(std::make_pair(std::string("Misses"),
+                                  base::IntToString(GetMissCount())));
+}
+
+void ShellBackendImpl::OnExternalCacheHit(const std::string& key) {
+  Index::iterator it = index_.find(key);
+  if (it == index_.end())
+    return;
+  it->second->last_used = Time::Now();
+  lru_.splice(lru_.end(), lru_, it->second->lru_position);
+}
+
+FilePath ShellBackendImpl::GetSegmentPath(int32 sequence) const {
+  return path_.AppendASCII(
+      base::StringPrintf("%s%08d", kSegmentPrefix, sequence));
+}
+
+bool ShellBackendImpl::LoadSegment(int32 sequence) {
+  base::PlatformFile file = base::CreatePlatformFile(
+      GetSegmentPath(sequence),
+      base::PLATFORM_FILE_OPEN | base::PLATFORM_FILE_READ |
+          base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  if (file == base::kInvalidPlatformFileValue)
+    return false;
+
+  base::PlatformFileInfo info;
+  if (!base::GetPlatformFileInfo(file, &info)) {
+    base::ClosePlatformFile(file);
+    return false;
+  }
+
+  Segment& segment = segments_[sequence];
+  segment.file = file;
+  segment.size = 0;
+  segment.live_bytes = 0;
+
+  // Only the headers and keys are read, the index doesn't need the data.
+  int64 offset = 0;
+  while (offset + static_cast<int64>(sizeof(RecordHeader)) <= info.size) {
+    RecordHeader header;
+    if (base::ReadPlatformFile(file, offset, reinterpret_cast<char*>(&header),
+                               sizeof(header)) !=
+        static_cast<int>(sizeof(header))) {
+      break;
+    }
+    if (header.magic != kRecordMagic || header.key_size < 0 ||
+        header.key_size > kMaxKeySize) {
+      break;
+    }
+    int64 length = sizeof(header) + header.key_size;
+    bool valid_sizes = true;
+    for (int i = 0; i < kNumStreams; ++i) {
+      valid_sizes &= header.data_size[i] >= 0;
+      length += header.data_size[i];
+    }
+    if (!valid_sizes || offset + length > info.size)
+      break;
+
+    std::string key(header.key_size, '\0');
+    if (header.key_size &&
+        base::ReadPlatformFile(file, offset + sizeof(header), &key[0],
+                               header.key_size) != header.key_size) {
+      break;
+    }
+
+    Index::iterator it = index_.find(key);
+    if (it != index_.end())
+      RemoveRecord(it->second, false);
+    if (!(header.flags & kDoomRecordFlag)) {
+      Record* record = new Record;
+      record->key = key;
+      record->segment = sequence;
+      record->offset = static_cast<int32>(offset);
+      for (int i = 0; i < kNumStreams; ++i)
+        record->data_size[i] = header.data_size[i];
+      record->last_used = Time::FromInternalValue(header.last_used);
+      record->last_modified = Time::FromInternalValue(header.last_modified);
+      InsertRecord(record);
+    }
+    offset += length;
+  }
+
+  if (offset < info.size) {
+    // The tail of the segment was not completely written, most likely the
+    // process died in the middle of a flush.
+    DLOG(WARNING) << "Truncating cache segment " << sequence << " from "
+                  << info.size << " to " << offset << " bytes";
+    base::TruncatePlatformFile(file, offset);
+  }
+  segment.size = static_cast<int32>(offset);
+  disk_size_ += offset;
+  return true;
+}
+
+bool ShellBackendImpl::StartSegment(int32 sequence) {
+  base::PlatformFile file = base::CreatePlatformFile(
+      GetSegmentPath(sequence),
+      base::PLATFORM_FILE_CREATE_ALWAYS | base::PLATFORM_FILE_READ |
+          base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  if (file == base::kInvalidPlatformFileValue) {
+    LOG(ERROR) << "Unable to create cache segment " << sequence;
+    return false;
+  }
+
+  Segment& segment = segments_[sequence];
+  segment.file = file;
+  segment.size = 0;
+  segment.live_bytes = 0;
+  return true;
+}
+
+void ShellBackendImpl::DeleteSegment(Segments::iterator it) {
+  DCHECK_EQ(it->second.live_bytes, 0);
+  base::ClosePlatformFile(it->second.file);
+  file_util::Delete(GetSegmentPath(it->first), false);
+  disk_size_ -= it->second.size;
+  segments_.erase(it);
+}
+
+bool ShellBackendImpl::AppendRecord(const std::string& key,
+                                    const std::vector<char>* data,
+                                    Time last_used, Time last_modified,
+                                    int32* segment, int32* offset) {
+  RecordHeader header;
+  header.magic = kRecordMagic;
+  header.flags = data ? 0 : kDoomRecordFlag;
+  header.key_size = key.size();
+  int32 length = sizeof(header) + key.size();
+  for (int i = 0; i < kNumStreams; ++i) {
+    header.data_size[i] = data ? data[i].size() : 0;
+    length += header.data_size[i];
+  }
+  header.last_used = last_used.ToInternalValue();
+  header.last_modified = last_modified.ToInternalValue();
+
+  DCHECK(!segments_.empty());
+  Segments::iterator newest = --segments_.end();
+  if (newest->second.size > 0 && newest->second.size + length > kSegmentSize) {
+    FlushWriteBuffer();
+    if (!StartSegment(newest->first + 1))
+      return false;
+    newest = --segments_.end();
+  }
+
+  *segment = newest->first;
+  *offset = newest->second.size;
+
+  const char* header_bytes = reinterpret_cast<const char*>(&header);
+  write_buffer_.insert(write_buffer_.end(), header_bytes,
+                       header_bytes + sizeof(header));
+  write_buffer_.insert(write_buffer_.end(), key.begin(), key.end());
+  if (data) {
+    for (int i = 0; i < kNumStreams; ++i)
+      write_buffer_.insert(write_buffer_.end(), data[i].begin(), data[i].end());
+  }
+  newest->second.size += length;
+  disk_size_ += length;
+
+  if (write_buffer_.size() >= kWriteBatchSize) {
+    FlushWriteBuffer();
+  } else if (!flush_timer_.IsRunning()) {
+    flush_timer_.Start(FROM_HERE,
+                       base::TimeDelta::FromMilliseconds(kFlushDelayMs),
+                       this, &ShellBackendImpl::FlushWriteBuffer);
+  }
+  return true;
+}
+
+void ShellBackendImpl::FlushWriteBuffer() {
+  flush_timer_.Stop();
+  if (write_buffer_.empty())
+    return;
+
+  Segment& newest = segments_.rbegin()->second;
+  int size = static_cast<int>(write_buffer_.size());
+  int32 offset = newest.size - size;
+  if (base::WritePlatformFile(newest.file, offset, &write_buffer_[0], size) !=
+      size) {
+    // The index still points at the lost records, reading them will fail and
+    // HttpCache dooms entries it can't read.
+    LOG(ERROR) << "Failed to write " << size << " bytes to the cache";
+  }
+  write_buffer_.clear();
+}
+
+void ShellBackendImpl::CommitEntry(ShellEntryImpl* entry) {
+  DCHECK(!entry->record());
+  const std::string& key = entry->GetKey();
+  const std::vector<char>* data = entry->data();
+
+  int32 segment;
+  int32 offset;
+  if (!AppendRecord(key, data, entry->GetLastUsed(), entry->GetLastModified(),
+                    &segment, &offset)) {
+    return;
+  }
+
+  Index::iterator it = index_.find(key);
+  if (it != index_.end())
+    RemoveRecord(it->second, false);
+
+  Record* record = new Record;
+  record->key = key;
+  record->segment = segment;
+  record->offset = offset;
+  for (int i = 0; i < kNumStreams; ++i)
+    record->data_size[i] = data[i].size();
+  record->last_used = entry->GetLastUsed();
+  record->last_modified = entry->GetLastModified();
+  InsertRecord(record);
+
+  TrimCache();
+  CleanSegments();
+}
+
+void ShellBackendImpl::RemoveRecord(Record* record, bool write_doom) {
+  index_.erase(record->key);
+  lru_.erase(record->lru_position);
+  live_size_ -= record->Length();
+  segments_[record->segment].live_bytes -= record->Length();
+
+  if (write_doom) {
+    int32 segment;
+    int32 offset;
+    if (!AppendRecord(record->key, NULL, Time::Now(), Time::Now(), &segment,
+                      &offset)) {
+      LOG(ERROR) << "Failed to doom cache entry " << record->key;
+    }
+  }
+  delete record;
+}
+
+void ShellBackendImpl::InsertRecord(Record* record) {
+  DCHECK(index_.find(record->key) == index_.end());
+  index_[record->key] = record;
+  record->lru_position = lru_.insert(lru_.end(), record);
+  live_size_ += record->Length();
+  segments_[record->segment].live_bytes += record->Length();
+}
+
+void ShellBackendImpl::TrimCache() {
+  if (live_size_ <= max_size_)
+    return;
+
+  // Trim a little further than needed so not every commit has to evict.
+  int64 low_water = max_size_ - max_size_ / 8;
+  std::list<Record*>::iterator it = lru_.begin();
+  while (live_size_ > low_water && it != lru_.end()) {
+    Record* record = *it;
+    ++it;
+    if (open_entries_.find(record->key) != open_entries_.end())
+      continue;
+    RemoveRecord(record, true);
+  }
+}
+
+void ShellBackendImpl::CleanSegments() {
+  // Let a segment's worth of garbage build up before cleaning, and stop once
+  // every segment has been cleaned, at which point there is no garbage left.
+  size_t segments_to_clean = segments_.size();
+  while (disk_size_ > max_size_ + kSegmentSize && segments_.size() > 1 &&
+         segments_to_clean--) {
+    CleanOldestSegment();
+  }
+}
+
+void ShellBackendImpl::CleanOldestSegment() {
+  int32 sequence = segments_.begin()->first;
+
+  std::vector<Record*> records;
+  for (Index::iterator it = index_.begin(); it != index_.end(); ++it) {
+    if (it->second->segment == sequence)
+      records.push_back(it->second);
+  }
+
+  // Doom records in the oldest segment can be dropped, the records they doom
+  // were in older segments which are already gone.
+  for (size_t i = 0; i < records.size(); ++i) {
+    Record* record = records[i];
+    OpenEntries::iterator open = open_entries_.find(record->key);
+    if (open != open_entries_.end() && open->second->record() == record)
+      open->second->LoadData();
+
+    std::vector<char> data[kNumStreams];
+    bool read = true;
+    for (int j = 0; j < kNumStreams && read; ++j) {
+      data[j].resize(record->data_size[j]);
+      if (record->data_size[j]) {
+        read = ReadRecordData(record, j, 0, &data[j][0],
+                              record->data_size[j]) == record->data_size[j];
+      }
+    }
+
+    int32 segment;
+    int32 offset;
+    if (!read || !AppendRecord(record->key, data, record->last_used,
+                               record->last_modified, &segment, &offset)) {
+      RemoveRecord(record, false);
+      continue;
+    }
+    segments_[record->segment].live_bytes -= record->Length();
+    record->segment = segment;
+    record->offset = offset;
+    segments_[record->segment].live_bytes += record->Length();
+  }
+
+  DeleteSegment(segments_.find(sequence));
+}
+
+}  // namespace disk_cache
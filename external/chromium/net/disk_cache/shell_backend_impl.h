@@ -0,0 +1,192 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// See net/disk_cache/disk_cache.h for the public interface of the cache.
+
+#ifndef NET_DISK_CACHE_SHELL_BACKEND_IMPL_H_
+#define NET_DISK_CACHE_SHELL_BACKEND_IMPL_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "base/file_path.h"
+#include "base/hash_tables.h"
+#include "base/platform_file.h"
+#include "base/time.h"
+#include "base/timer.h"
+#include "net/disk_cache/disk_cache.h"
+
+namespace net {
+class NetLog;
+}  // namespace net
+
+namespace disk_cache {
+
+class ShellEntryImpl;
+
+// A small cache backend for lb_shell that is kind to flash storage.
+//
+// Entries are appended to a log of segment files in the cache directory and
+// are never rewritten in place. Only the key and location of each entry are
+// kept in memory, the index is rebuilt from the record headers at startup.
+// Appends are batched in memory and written out a batch at a time, or after
+// a short delay. When the entries outgrow the size limit the least recently
+// used ones are dropped, and once the log holds too much garbage its oldest
+// segment has its remaining entries copied forward and is deleted.
+//
+// Entries are built in memory while they are written and are appended to the
+// log when they are closed. All operations complete synchronously.
+class NET_EXPORT_PRIVATE ShellBackendImpl : public Backend {
+ public:
+  // HttpCache only uses the first three streams of an entry.
+  enum { kNumStreams = 3 };
+
+  // The location and metadata of an entry in the log.
+  struct Record {
+    std::string key;
+    int32 segment;  // sequence number of the segment holding the record
+    int32 offset;   // offset of the record in its segment
+    int32 data_size[kNumStreams];
+    base::Time last_used;
+    base::Time last_modified;
+    // Position of the record in lru_.
+    std::list<Record*>::iterator lru_position;
+
+    // Size of the record in the log, including its header.
+    int32 Length() const;
+    // Offset of the start of a stream's data in the record's segment.
+    int32 DataOffset(int index) const;
+  };
+
+  ShellBackendImpl(const FilePath& path, int max_bytes, net::NetLog* net_log);
+  virtual ~ShellBackendImpl();
+
+  // Returns a backend storing its files in |path|, or NULL if the cache could
+  // not be opened. If zero is passed in as max_bytes, a default is used.
+  static Backend* CreateBackend(const FilePath& path, int max_bytes,
+                                net::NetLog* net_log);
+
+  // Creates the cache directory if needed and loads the index from it.
+  bool Init();
+
+  // Totals of OpenEntry() calls that found an entry and that did not, across
+  // all instances. Safe to call from any thread.
+  static int GetHitCount();
+  static int GetMissCount();
+
+  // Maximum size of a single stream of an entry.
+  int MaxFileSize() const;
+
+  // Reads |buf_len| bytes of stream |index| of |record| starting at |offset|.
+  // Returns the number of bytes read or a net error.
+  int ReadRecordData(const Record* record, int index, int offset, char* buf,
+                     int buf_len);
+
+  // Called by entries.
+  void OnEntryDoomed(ShellEntryImpl* entry);
+  void OnEntryClosed(ShellEntryImpl* entry);
+
+  // Backend interface.
+  virtual net::CacheType GetCacheType() const OVERRIDE;
+  virtual int32 GetEntryCount() const OVERRIDE;
+  virtual int OpenEntry(const std::string& key, Entry** entry,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int CreateEntry(const std::string& key, Entry** entry,
+                          const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntry(const std::string& key,
+                        const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomAllEntries(const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesBetween(const base::Time initial_time,
+                                 const base::Time end_time,
+                                 const CompletionCallback& callback) OVERRIDE;
+  virtual int DoomEntriesSince(const base::Time initial_time,
+                               const CompletionCallback& callback) OVERRIDE;
+  virtual int OpenNextEntry(void** iter, Entry** next_entry,
+                            const CompletionCallback& callback) OVERRIDE;
+  virtual void EndEnumeration(void** iter) OVERRIDE;
+  virtual void GetStats(
+      std::vector<std::pair<std::string, std::string> >* stats) OVERRIDE;
+  virtual void OnExternalCacheHit(const std::string& key) OVERRIDE;
+
+ private:
+  typedef base::hash_map<std::string, Record*> Index;
+  typedef base::hash_map<std::string, ShellEntryImpl*> OpenEntries;
+
+  struct Segment {
+    base::PlatformFile file;
+    // Bytes in the segment, including those still in the write buffer.
+    int32 size;
+    // Bytes of the segment holding records that are still in the index.
+    int32 live_bytes;
+  };
+  // Keyed by sequence number, so the oldest segment comes first.
+  typedef std::map<int32, Segment> Segments;
+
+  FilePath GetSegmentPath(int32 sequence) const;
+  // Adds the records in a segment file to the index.
+  bool LoadSegment(int32 sequence);
+  bool StartSegment(int32 sequence);
+  void DeleteSegment(Segments::iterator it);
+
+  // Appends a record to the write buffer of the newest segment, starting a
+  // new segment first if it is full. |data| holds kNumStreams streams, or is
+  // NULL for a record that dooms the entry |key|. Returns false on failure.
+  bool AppendRecord(const std::string& key, const std::vector<char>* data,
+                    base::Time last_used, base::Time last_modified,
+                    int32* segment, int32* offset);
+  void FlushWriteBuffer();
+
+  // Appends the data of |entry| to the log and points the index at it.
+  void CommitEntry(ShellEntryImpl* entry);
+  // Drops |record| from the index, appending a doom record for it if
+  // |write_doom| is true so it doesn't come back when the index is reloaded.
+  void RemoveRecord(Record* record, bool write_doom);
+  void InsertRecord(Record* record);
+
+  // Evicts least recently used entries until the live data fits in the limit.
+  void TrimCache();
+  // Reclaims the oldest segments while the log is too large.
+  void CleanSegments();
+  void CleanOldestSegment();
+
+  FilePath path_;
+  int32 max_size_;
+  net::NetLog* net_log_;
+
+  Index index_;
+  // Least recently used first.
+  std::list<Record*> lru_;
+  OpenEntries open_entries_;
+
+  Segments segments_;
+  // Total size of all segments.
+  int64 disk_size_;
+  // Total size of the records in the index.
+  int64 live_size_;
+
+  // Records appended to the newest segment that have yet to be written.
+  std::vector<char> write_buffer_;
+  base::OneShotTimer<ShellBackendImpl> flush_timer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShellBackendImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SHELL_BACKEND_IMPL_H_
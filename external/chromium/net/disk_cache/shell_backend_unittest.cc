@@ -0,0 +1,194 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/disk_cache/shell_backend_impl.h"
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/message_loop.h"
+#include "base/platform_file.h"
+#include "base/stringprintf.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace disk_cache {
+
+static const int kCacheSize = 4 * 1024 * 1024;
+
+class ShellBackendTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    OpenCache();
+  }
+
+  // Closes the cache, if it is open, and loads it again from disk.
+  void OpenCache() {
+    cache_.reset();
+    cache_.reset(ShellBackendImpl::CreateBackend(temp_dir_.path(), kCacheSize,
+                                                 NULL));
+    ASSERT_TRUE(cache_.get());
+  }
+
+  // Writes |size| bytes of |fill| to stream 0 of a new entry.
+  void WriteEntry(const std::string& key, int size, char fill) {
+    Entry* entry = NULL;
+    ASSERT_EQ(net::OK,
+              cache_->CreateEntry(key, &entry, net::CompletionCallback()));
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(size));
+    memset(buffer->data(), fill, size);
+    EXPECT_EQ(size, entry->WriteData(0, 0, buffer, size,
+                                     net::CompletionCallback(), true));
+    entry->Close();
+  }
+
+  // Checks that the entry |key| holds |size| bytes of |fill| in stream 0.
+  void ExpectEntry(const std::string& key, int size, char fill) {
+    Entry* entry = NULL;
+    ASSERT_EQ(net::OK,
+              cache_->OpenEntry(key, &entry, net::CompletionCallback()));
+    ASSERT_EQ(size, entry->GetDataSize(0));
+    scoped_refptr<net::IOBuffer> buffer(new net::IOBuffer(size));
+    EXPECT_EQ(size,
+              entry->ReadData(0, 0, buffer, size, net::CompletionCallback()));
+    for (int i = 0; i < size; ++i) {
+      if (buffer->data()[i] != fill) {
+        ADD_FAILURE() << key << " differs at offset " << i;
+        break;
+      }
+    }
+    entry->Close();
+  }
+
+  int64 GetSegmentSize(int sequence) {
+    int64 size = -1;
+    EXPECT_TRUE(file_util::GetFileSize(GetSegmentPath(sequence), &size));
+    return size;
+  }
+
+  FilePath GetSegmentPath(int sequence) {
+    return temp_dir_.path().AppendASCII(
+        base::StringPrintf("segment_%08d", sequence));
+  }
+
+  bool HasEntry(const std::string& key) {
+    Entry* entry = NULL;
+    if (cache_->OpenEntry(key, &entry, net::CompletionCallback()) != net::OK)
+      return false;
+    entry->Close();
+    return true;
+  }
+
+  MessageLoopForIO message_loop_;
+  base::ScopedTempDir temp_dir_;
+  scoped_ptr<Backend> cache_;
+};
+
+TEST_F(ShellBackendTest, EntriesPersist) {
+  WriteEntry("a", 1000, 'a');
+  WriteEntry("b", 20000, 'b');
+  EXPECT_EQ(2, cache_->GetEntryCount());
+
+  OpenCache();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+  ExpectEntry("a", 1000, 'a');
+  ExpectEntry("b", 20000, 'b');
+}
+
+TEST_F(ShellBackendTest, RewriteReplacesEntry) {
+  WriteEntry("a", 1000, 'a');
+  WriteEntry("a", 500, 'c');
+  ExpectEntry("a", 500, 'c');
+
+  OpenCache();
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  ExpectEntry("a", 500, 'c');
+}
+
+TEST_F(ShellBackendTest, DoomedEntriesStayDoomed) {
+  WriteEntry("a", 1000, 'a');
+  WriteEntry("b", 1000, 'b');
+  EXPECT_EQ(net::OK, cache_->DoomEntry("a", net::CompletionCallback()));
+  EXPECT_FALSE(HasEntry("a"));
+
+  OpenCache();
+  EXPECT_FALSE(HasEntry("a"));
+  ExpectEntry("b", 1000, 'b');
+
+  EXPECT_EQ(net::OK, cache_->DoomAllEntries(net::CompletionCallback()));
+  EXPECT_EQ(0, cache_->GetEntryCount());
+  OpenCache();
+  EXPECT_EQ(0, cache_->GetEntryCount());
+}
+
+TEST_F(ShellBackendTest, EvictsLeastRecentlyUsed) {
+  const int kEntrySize = 256 * 1024;
+  const int kNumEntries = 2 * kCacheSize / kEntrySize;
+  WriteEntry("first", kEntrySize, 'f');
+  for (int i = 0; i < kNumEntries; ++i) {
+    // Keep "first" recently used.
+    ASSERT_TRUE(HasEntry("first"));
+    WriteEntry(base::StringPrintf("entry%d", i), kEntrySize, 'e');
+  }
+
+  EXPECT_LT(cache_->GetEntryCount(), kNumEntries + 1);
+  EXPECT_FALSE(HasEntry("entry0"));
+  ExpectEntry("first", kEntrySize, 'f');
+  ExpectEntry(base::StringPrintf("entry%d", kNumEntries - 1), kEntrySize, 'e');
+
+  // Cleaning the log must not lose the entries that survived.
+  int count = cache_->GetEntryCount();
+  OpenCache();
+  EXPECT_EQ(count, cache_->GetEntryCount());
+  ExpectEntry("first", kEntrySize, 'f');
+}
+
+TEST_F(ShellBackendTest, TornTailIsTruncated) {
+  WriteEntry("a", 1000, 'a');
+  cache_.reset();
+  int64 intact_size = GetSegmentSize(0);
+
+  OpenCache();
+  WriteEntry("b", 20000, 'b');
+  cache_.reset();
+  int64 full_size = GetSegmentSize(0);
+  ASSERT_GT(full_size, intact_size);
+
+  // Lose the end of the last record, as if the process died while flushing.
+  base::PlatformFile file = base::CreatePlatformFile(
+      GetSegmentPath(0), base::PLATFORM_FILE_OPEN | base::PLATFORM_FILE_WRITE,
+      NULL, NULL);
+  ASSERT_NE(base::kInvalidPlatformFileValue, file);
+  EXPECT_TRUE(base::TruncatePlatformFile(file, full_size - 100));
+  base::ClosePlatformFile(file);
+
+  OpenCache();
+  EXPECT_EQ(1, cache_->GetEntryCount());
+  ExpectEntry("a", 1000, 'a');
+  EXPECT_FALSE(HasEntry("b"));
+  EXPECT_EQ(intact_size, GetSegmentSize(0));
+
+  // New records go after the last intact one.
+  WriteEntry("c", 500, 'c');
+  OpenCache();
+  EXPECT_EQ(2, cache_->GetEntryCount());
+  ExpectEntry("a", 1000, 'a');
+  ExpectEntry("c", 500, 'c');
+}
+
+}  // namespace disk_cache
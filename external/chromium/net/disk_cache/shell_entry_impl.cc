@@ -0,0 +1,177 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "net/disk_cache/shell_entry_impl.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "net/base/io_buffer.h"
+#include "net/base/net_errors.h"
+
+using base::Time;
+
+namespace disk_cache {
+
+ShellEntryImpl::ShellEntryImpl(ShellBackendImpl* backend,
+                               const std::string& key,
+                               ShellBackendImpl::Record* record)
+    : backend_(backend),
+      key_(key),
+      record_(record),
+      last_used_(Time::Now()),
+      last_modified_(record ? record->last_modified : last_used_),
+      ref_count_(1),
+      dirty_(!record),
+      doomed_(false) {
+}
+
+ShellEntryImpl::~ShellEntryImpl() {
+}
+
+bool ShellEntryImpl::LoadData() {
+  DCHECK(record_);
+  bool loaded = true;
+  for (int i = 0; i < ShellBackendImpl::kNumStreams && loaded; ++i) {
+    int size = record_->data_size[i];
+    data_[i].resize(size);
+    if (size)
+      loaded = backend_->ReadRecordData(record_, i, 0, &data_[i][0], size) ==
+               size;
+  }
+  if (!loaded) {
+    for (int i = 0; i < ShellBackendImpl::kNumStreams; ++i)
+      data_[i].clear();
+  }
+  record_ = NULL;
+  return loaded;
+}
+
+void ShellEntryImpl::InternalDoom() {
+  doomed_ = true;
+}
+
+void ShellEntryImpl::Doom() {
+  if (doomed_)
+    return;
+  backend_->OnEntryDoomed(this);
+}
+
+void ShellEntryImpl::Close() {
+  DCHECK_GT(ref_count_, 0);
+  if (--ref_count_ > 0)
+    return;
+  backend_->OnEntryClosed(this);
+  delete this;
+}
+
+std::string ShellEntryImpl::GetKey() const {
+  return key_;
+}
+
+Time ShellEntryImpl::GetLastUsed() const {
+  return last_used_;
+}
+
+Time ShellEntryImpl::GetLastModified() const {
+  return last_modified_;
+}
+
+int32 ShellEntryImpl::GetDataSize(int index) const {
+  if (index < 0 || index >= ShellBackendImpl::kNumStreams)
+    return 0;
+  if (record_)
+    return record_->data_size[index];
+  return static_cast<int32>(data_[index].size());
+}
+
+int ShellEntryImpl::ReadData(int index, int offset, IOBuffer* buf, int buf_len,
+                             const CompletionCallback& callback) {
+  if (index < 0 || index >= ShellBackendImpl::kNumStreams)
+    return net::ERR_INVALID_ARGUMENT;
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int size = GetDataSize(index);
+  if (offset >= size || !buf_len)
+    return 0;
+  buf_len = std::min(buf_len, size - offset);
+
+  last_used_ = Time::Now();
+  if (record_)
+    return backend_->ReadRecordData(record_, index, offset, buf->data(),
+                                    buf_len);
+  memcpy(buf->data(), &data_[index][offset], buf_len);
+  return buf_len;
+}
+
+int ShellEntryImpl::WriteData(int index, int offset, IOBuffer* buf,
+                              int buf_len, const CompletionCallback& callback,
+                              bool truncate) {
+  if (index < 0 || index >= ShellBackendImpl::kNumStreams)
+    return net::ERR_INVALID_ARGUMENT;
+  if (offset < 0 || buf_len < 0)
+    return net::ERR_INVALID_ARGUMENT;
+
+  int max_file_size = backend_->MaxFileSize();
+  if (offset > max_file_size || buf_len > max_file_size ||
+      offset + buf_len > max_file_size) {
+    return net::ERR_FAILED;
+  }
+
+  // The data is copied out of the log the first time the entry is modified,
+  // and written back as a whole when it is closed.
+  if (record_ && !LoadData())
+    return net::ERR_CACHE_READ_FAILURE;
+
+  std::vector<char>& stream = data_[index];
+  int size = static_cast<int>(stream.size());
+  // Writing past the end of the stream fills the gap with zeros, and a
+  // truncating write drops everything after it.
+  if (truncate || offset + buf_len > size)
+    stream.resize(offset + buf_len);
+  if (buf_len)
+    memcpy(&stream[offset], buf->data(), buf_len);
+
+  last_used_ = last_modified_ = Time::Now();
+  dirty_ = true;
+  return buf_len;
+}
+
+int ShellEntryImpl::ReadSparseData(int64 offset, IOBuffer* buf, int buf_len,
+                                   const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int ShellEntryImpl::WriteSparseData(int64 offset, IOBuffer* buf, int buf_len,
+                                    const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+int ShellEntryImpl::GetAvailableRange(int64 offset, int len, int64* start,
+                                      const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+bool ShellEntryImpl::CouldBeSparse() const {
+  return false;
+}
+
+int ShellEntryImpl::ReadyForSparseIO(const CompletionCallback& callback) {
+  return net::ERR_CACHE_OPERATION_NOT_SUPPORTED;
+}
+
+}  // namespace disk_cache
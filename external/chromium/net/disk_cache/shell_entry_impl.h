@@ -0,0 +1,100 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NET_DISK_CACHE_SHELL_ENTRY_IMPL_H_
+#define NET_DISK_CACHE_SHELL_ENTRY_IMPL_H_
+
+#include <string>
+#include <vector>
+
+#include "base/compiler_specific.h"
+#include "net/disk_cache/disk_cache.h"
+#include "net/disk_cache/shell_backend_impl.h"
+
+namespace disk_cache {
+
+// This class implements the Entry interface for ShellBackendImpl.
+//
+// An entry opened from the log reads straight from it until it is written
+// to, at which point all of its data is copied into memory. Entries that are
+// created, written to or doomed keep their data in memory, and the backend
+// appends it to the log when the entry is closed. Opening an entry that is
+// already open returns the same object with another reference.
+class ShellEntryImpl : public Entry {
+ public:
+  // Creates an entry for |record|, or a new empty entry if |record| is NULL.
+  ShellEntryImpl(ShellBackendImpl* backend, const std::string& key,
+                 ShellBackendImpl::Record* record);
+
+  void AddRef() { ++ref_count_; }
+
+  // The record in the log that the entry reads from, NULL once its data is in
+  // memory.
+  ShellBackendImpl::Record* record() const { return record_; }
+  bool dirty() const { return dirty_; }
+  bool doomed() const { return doomed_; }
+  const std::vector<char>* data() const { return data_; }
+
+  // Copies the entry's data from the log into memory, after which it no
+  // longer reads from record(). Returns false, leaving the entry empty, if
+  // the data couldn't be read.
+  bool LoadData();
+
+  // Marks the entry doomed without notifying the backend.
+  void InternalDoom();
+
+  // Entry interface.
+  virtual void Doom() OVERRIDE;
+  virtual void Close() OVERRIDE;
+  virtual std::string GetKey() const OVERRIDE;
+  virtual base::Time GetLastUsed() const OVERRIDE;
+  virtual base::Time GetLastModified() const OVERRIDE;
+  virtual int32 GetDataSize(int index) const OVERRIDE;
+  virtual int ReadData(int index, int offset, IOBuffer* buf, int buf_len,
+                       const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteData(int index, int offset, IOBuffer* buf, int buf_len,
+                        const CompletionCallback& callback,
+                        bool truncate) OVERRIDE;
+  virtual int ReadSparseData(int64 offset, IOBuffer* buf, int buf_len,
+                             const CompletionCallback& callback) OVERRIDE;
+  virtual int WriteSparseData(int64 offset, IOBuffer* buf, int buf_len,
+                              const CompletionCallback& callback) OVERRIDE;
+  virtual int GetAvailableRange(int64 offset, int len, int64* start,
+                                const CompletionCallback& callback) OVERRIDE;
+  virtual bool CouldBeSparse() const OVERRIDE;
+  virtual void CancelSparseIO() OVERRIDE {}
+  virtual int ReadyForSparseIO(const CompletionCallback& callback) OVERRIDE;
+
+ private:
+  virtual ~ShellEntryImpl();
+
+  ShellBackendImpl* backend_;
+  std::string key_;
+  ShellBackendImpl::Record* record_;
+  // The entry's streams, valid once record_ is NULL.
+  std::vector<char> data_[ShellBackendImpl::kNumStreams];
+  base::Time last_used_;
+  base::Time last_modified_;
+  int ref_count_;
+  bool dirty_;
+  bool doomed_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShellEntryImpl);
+};
+
+}  // namespace disk_cache
+
+#endif  // NET_DISK_CACHE_SHELL_ENTRY_IMPL_H_
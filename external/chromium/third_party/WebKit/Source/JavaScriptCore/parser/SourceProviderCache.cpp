@@ -26,6 +26,10 @@
 #include "config.h"
 #include "SourceProviderCache.h"
 
+#if defined(__LB_SHELL__)
+#include "Identifier.h"
+#endif
+
 namespace JSC {
 
 SourceProviderCache::~SourceProviderCache()
@@ -50,4 +54,176 @@ void SourceProviderCache::add(int sourcePosition, PassOwnPtr<SourceProviderCache
     m_contentByteSize += size;
 }
 
+#if defined(__LB_SHELL__)
+// Serialized caches start with a header of four 32 bit words: the magic, the
+// format version, the length of the source and the number of items. Each item
+// is its open brace position, function start, close brace line, close brace
+// position and flags, followed by its used and then its written variables,
+// each preceded by their count. A variable is its length with the top bit set
+// if its characters are 8 bit, followed by its characters.
+static const uint32_t serializedCacheMagic = 0x4a535043; // 'JSPC'
+static const uint32_t serializedCacheVersion = 1;
+
+enum {
+    NeedsFullActivationFlag = 1 << 0,
+    UsesEvalFlag = 1 << 1,
+    StrictModeFlag = 1 << 2
+};
+
+static const uint32_t eightBitVariableFlag = 1U << 31;
+
+static void appendUInt32(Vector<char>& data, uint32_t value)
+{
+    data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void appendVariables(Vector<char>& data, const Vector<RefPtr<StringImpl> >& variables)
+{
+    appendUInt32(data, variables.size());
+    for (size_t i = 0; i < variables.size(); ++i) {
+        StringImpl* variable = variables[i].get();
+        if (variable->is8Bit()) {
+            appendUInt32(data, variable->length() | eightBitVariableFlag);
+            data.append(reinterpret_cast<const char*>(variable->characters8()), variable->length());
+        } else {
+            appendUInt32(data, variable->length());
+            data.append(reinterpret_cast<const char*>(variable->characters16()), variable->length() * sizeof(UChar));
+        }
+    }
+}
+
+class SerializedCacheReader {
+public:
+    explicit SerializedCacheReader(const Vector<char>& data)
+        : m_position(data.data())
+        , m_end(data.data() + data.size())
+    {
+    }
+
+    bool atEnd() const { return m_position == m_end; }
+
+    bool read(void* buffer, size_t size)
+    {
+        if (static_cast<size_t>(m_end - m_position) < size)
+            return false;
+        memcpy(buffer, m_position, size);
+        m_position += size;
+        return true;
+    }
+
+    bool readUInt32(uint32_t& value) { return read(&value, sizeof(value)); }
+
+    bool readVariables(JSGlobalData* globalData, Vector<RefPtr<StringImpl> >& variables)
+    {
+        uint32_t count;
+        if (!readUInt32(count))
+            return false;
+        // Every variable takes at least its length, so a count that doesn't fit is corrupt.
+        if (count > static_cast<size_t>(m_end - m_position) / sizeof(uint32_t))
+            return false;
+        variables.reserveInitialCapacity(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t length;
+            if (!readUInt32(length))
+                return false;
+            bool is8Bit = length & eightBitVariableFlag;
+            length &= ~eightBitVariableFlag;
+            if (length > static_cast<size_t>(m_end - m_position) / (is8Bit ? sizeof(LChar) : sizeof(UChar)))
+                return false;
+            if (is8Bit) {
+                Vector<LChar> characters(length);
+                read(characters.data(), length * sizeof(LChar));
+                variables.append(Identifier(globalData, characters.data(), length).impl());
+            } else {
+                Vector<UChar> characters(length);
+                read(characters.data(), length * sizeof(UChar));
+                variables.append(Identifier(globalData, characters.data(), length).impl());
+            }
+        }
+        return true;
+    }
+
+private:
+    const char* m_position;
+    const char* m_end;
+};
+
+void SourceProviderCache::serialize(const String& source, int firstLine, Vector<char>& data) const
+{
+    appendUInt32(data, serializedCacheMagic);
+    appendUInt32(data, serializedCacheVersion);
+    appendUInt32(data, source.length());
+    appendUInt32(data, m_map.size());
+    HashMap<int, OwnPtr<SourceProviderCacheItem> >::const_iterator end = m_map.end();
+    for (HashMap<int, OwnPtr<SourceProviderCacheItem> >::const_iterator it = m_map.begin(); it != end; ++it) {
+        const SourceProviderCacheItem* item = it->value.get();
+        uint32_t flags = 0;
+        if (item->needsFullActivation)
+            flags |= NeedsFullActivationFlag;
+        if (item->usesEval)
+            flags |= UsesEvalFlag;
+        if (item->strictMode)
+            flags |= StrictModeFlag;
+        appendUInt32(data, it->key);
+        appendUInt32(data, item->functionStart);
+        appendUInt32(data, item->closeBraceLine - firstLine);
+        appendUInt32(data, item->closeBracePos);
+        appendUInt32(data, flags);
+        appendVariables(data, item->usedVariables);
+        appendVariables(data, item->writtenVariables);
+    }
+}
+
+bool SourceProviderCache::deserialize(JSGlobalData* globalData, const String& source, int firstLine, const Vector<char>& data)
+{
+    ASSERT(isEmpty());
+    SerializedCacheReader reader(data);
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sourceLength;
+    uint32_t count;
+    if (!reader.readUInt32(magic) || magic != serializedCacheMagic
+        || !reader.readUInt32(version) || version != serializedCacheVersion
+        || !reader.readUInt32(sourceLength) || sourceLength != source.length()
+        || !reader.readUInt32(count))
+        return false;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t openBracePos;
+        uint32_t functionStart;
+        uint32_t closeBraceLine;
+        uint32_t closeBracePos;
+        uint32_t flags;
+        if (!reader.readUInt32(openBracePos) || !reader.readUInt32(functionStart)
+            || !reader.readUInt32(closeBraceLine) || !reader.readUInt32(closeBracePos)
+            || !reader.readUInt32(flags)) {
+            clear();
+            return false;
+        }
+        // The parser skips straight from the open brace to the close brace,
+        // so both have to be where they were when the items were saved.
+        if (functionStart >= openBracePos || openBracePos >= closeBracePos || closeBracePos >= sourceLength
+            || source[openBracePos] != '{' || source[closeBracePos] != '}' || m_map.contains(openBracePos)) {
+            clear();
+            return false;
+        }
+        OwnPtr<SourceProviderCacheItem> item = adoptPtr(new SourceProviderCacheItem(functionStart, closeBraceLine + firstLine, closeBracePos));
+        item->needsFullActivation = flags & NeedsFullActivationFlag;
+        item->usesEval = flags & UsesEvalFlag;
+        item->strictMode = flags & StrictModeFlag;
+        if (!reader.readVariables(globalData, item->usedVariables) || !reader.readVariables(globalData, item->writtenVariables)) {
+            clear();
+            return false;
+        }
+        unsigned size = item->approximateByteSize();
+        add(openBracePos, item.release(), size);
+    }
+    if (!reader.atEnd()) {
+        clear();
+        return false;
+    }
+    return true;
+}
+#endif
+
 }
@@ -30,9 +30,16 @@
 #include <wtf/HashMap.h>
 #include <wtf/OwnPtr.h>
 #include <wtf/PassOwnPtr.h>
+#if defined(__LB_SHELL__)
+#include <wtf/Vector.h>
+#endif
 
 namespace JSC {
 
+#if defined(__LB_SHELL__)
+class JSGlobalData;
+#endif
+
 class SourceProviderCache {
     WTF_MAKE_FAST_ALLOCATED;
 public:
@@ -44,6 +51,19 @@ public:
     void add(int sourcePosition, PassOwnPtr<SourceProviderCacheItem>, unsigned size);
     const SourceProviderCacheItem* get(int sourcePosition) const { return m_map.get(sourcePosition); }
 
+#if defined(__LB_SHELL__)
+    bool isEmpty() const { return m_map.isEmpty(); }
+
+    // Appends the items of the cache for |source| to |data|. Lines are saved
+    // relative to |firstLine|, so the same text may start elsewhere when the
+    // items are read back.
+    JS_EXPORT_PRIVATE void serialize(const String& source, int firstLine, Vector<char>& data) const;
+    // Adds the items in |data| to this empty cache, checking them against
+    // |source|. Returns false and leaves the cache empty if |data| was not
+    // written by serialize() for the same text.
+    JS_EXPORT_PRIVATE bool deserialize(JSGlobalData*, const String& source, int firstLine, const Vector<char>& data);
+#endif
+
 private:
     HashMap<int, OwnPtr<SourceProviderCacheItem> > m_map;
     unsigned m_contentByteSize;
@@ -33,10 +33,27 @@
 #include "StrongInlines.h"
 #include "UnlinkedCodeBlock.h"
 
+#if defined(__LB_SHELL__)
+#include "PersistentCodeCacheStore.h"
+#include <wtf/SHA1.h>
+#endif
+
 namespace JSC {
 
+#if defined(__LB_SHELL__)
+static PersistentCodeCacheStore* s_persistentStore;
+
+void setPersistentCodeCacheStore(PersistentCodeCacheStore* store)
+{
+    s_persistentStore = store;
+}
+#endif
+
 CodeCache::CodeCache()
 {
+#if defined(__LB_SHELL__)
+    m_cachedCodeBlocks.setCostLimit(kMaxRootCodeBlockSourceLength);
+#endif
 }
 
 CodeCache::~CodeCache()
@@ -48,6 +65,52 @@ CodeCache::CodeBlockKey CodeCache::makeCodeBlockKey(const SourceCode& source, Co
     return std::make_pair(source.toString(), (type << 1) | strictness);
 }
 
+#if defined(__LB_SHELL__)
+static CString sourceDigest(const String& source)
+{
+    SHA1 sha1;
+    if (source.is8Bit())
+        sha1.addBytes(source.characters8(), source.length());
+    else
+        sha1.addBytes(reinterpret_cast<const uint8_t*>(source.characters16()), source.length() * sizeof(UChar));
+    return sha1.computeHexDigest();
+}
+
+bool CodeCache::loadPersistentFunctionInfo(JSGlobalData& globalData, const SourceCode& source, CString& key)
+{
+    if (!s_persistentStore || source.length() < kMinPersistentSourceLength)
+        return false;
+    // Function info is kept by the provider, by position in its text, so only
+    // programs that are the whole of their provider's text are kept.
+    SourceProvider* provider = source.provider();
+    const String& text = provider->source();
+    if (source.startOffset() || source.endOffset() != static_cast<int>(text.length()))
+        return false;
+    // Either it was loaded already, or the program has been parsed before.
+    SourceProviderCache* cache = provider->cache();
+    if (!cache->isEmpty())
+        return false;
+
+    key = sourceDigest(text);
+    Vector<char> data;
+    if (!s_persistentStore->load(key.data(), data))
+        return true;
+    unsigned oldSize = cache->byteSize();
+    if (!cache->deserialize(&globalData, text, source.firstLine(), data))
+        return true;
+    provider->notifyCacheSizeChanged(cache->byteSize() - oldSize);
+    return false;
+}
+
+void CodeCache::storePersistentFunctionInfo(const SourceCode& source, const CString& key)
+{
+    SourceProvider* provider = source.provider();
+    Vector<char> data;
+    provider->cache()->serialize(provider->source(), source.firstLine(), data);
+    s_persistentStore->store(key.data(), data);
+}
+#endif
+
 template <typename T> struct CacheTypes { };
 
 template <> struct CacheTypes<UnlinkedProgramCodeBlock> {
@@ -66,10 +129,6 @@ UnlinkedCodeBlockType* CodeCache::getCodeBlock(JSGlobalData& globalData, Executa
     CodeBlockKey key = makeCodeBlockKey(source, CacheTypes<UnlinkedCodeBlockType>::codeType, strictness);
     bool storeInCache = false;
 
-    // Leanback webpage generates many unique JavaScript code fragment over
-    // time. Since the cache is only cleared during a navigation event, this
-    // causes it to grow indefinitely.
-#if !defined(__LB_SHELL__)
     if (debuggerMode == DebuggerOff && profilerMode == ProfilerOff) {
         const Strong<UnlinkedCodeBlock>* result = m_cachedCodeBlocks.find(key);
         if (result) {
@@ -80,6 +139,10 @@ UnlinkedCodeBlockType* CodeCache::getCodeBlock(JSGlobalData& globalData, Executa
         }
         storeInCache = true;
     }
+
+#if defined(__LB_SHELL__)
+    CString persistentCacheKey;
+    bool storePersistently = CacheTypes<UnlinkedCodeBlockType>::codeType == ProgramType && loadPersistentFunctionInfo(globalData, source, persistentCacheKey);
 #endif
 
     typedef typename CacheTypes<UnlinkedCodeBlockType>::RootNode RootNode;
@@ -97,7 +160,11 @@ UnlinkedCodeBlockType* CodeCache::getCodeBlock(JSGlobalData& globalData, Executa
         return 0;
 
     if (storeInCache)
-        m_cachedCodeBlocks.add(key, Strong<UnlinkedCodeBlock>(globalData, unlinkedCode));
+        m_cachedCodeBlocks.add(key, Strong<UnlinkedCodeBlock>(globalData, unlinkedCode), key.first.length());
+#if defined(__LB_SHELL__)
+    if (storePersistently)
+        storePersistentFunctionInfo(source, persistentCacheKey);
+#endif
 
     return unlinkedCode;
 }
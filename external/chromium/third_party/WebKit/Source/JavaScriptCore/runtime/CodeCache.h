@@ -53,12 +53,19 @@ struct ParserError;
 class SourceCode;
 class SourceProvider;
 
+// Holds at most CacheSize entries, replacing a random entry when full.
+// Each entry may also be given a cost, in which case entries are evicted at
+// random until the total cost of the entries fits in the cost limit.
 template <typename KeyType, typename EntryType, int CacheSize> class CacheMap {
     typedef typename HashMap<KeyType, unsigned>::iterator iterator;
 public:
     CacheMap()
         : m_randomGenerator((static_cast<uint32_t>(randomNumber() * std::numeric_limits<uint32_t>::max())))
+        , m_totalCost(0)
+        , m_costLimit(std::numeric_limits<size_t>::max())
     {
+        for (size_t i = 0; i < CacheSize; i++)
+            m_costs[i] = 0;
     }
     const EntryType* find(const KeyType& key)
     {
@@ -67,19 +74,34 @@ public:
             return 0;
         return &m_data[result->value].second;
     }
-    void add(const KeyType& key, const EntryType& value)
+    void add(const KeyType& key, const EntryType& value, size_t cost = 0)
     {
+        if (cost > m_costLimit)
+            return;
         iterator result = m_map.find(key);
         if (result != m_map.end()) {
-            m_data[result->value].second = value;
-            return;
+            // The entry's old cost no longer counts. Making room for the new
+            // one may evict the entry itself, in which case it is added anew.
+            size_t index = result->value;
+            m_totalCost -= m_costs[index];
+            m_costs[index] = 0;
+            evictToFit(cost);
+            if (m_data[index].second) {
+                m_data[index].second = value;
+                m_costs[index] = cost;
+                m_totalCost += cost;
+                return;
+            }
         }
+        evictToFit(cost);
         size_t newIndex = m_randomGenerator.getUint32() % CacheSize;
         if (m_data[newIndex].second)
-            m_map.remove(m_data[newIndex].first);
+            evictAt(newIndex);
         m_map.add(key, newIndex);
         m_data[newIndex].first = key;
         m_data[newIndex].second = value;
+        m_costs[newIndex] = cost;
+        m_totalCost += cost;
         ASSERT(m_map.size() <= CacheSize);
     }
 
@@ -89,14 +111,46 @@ public:
         for (size_t i = 0; i < CacheSize; i++) {
             m_data[i].first = KeyType();
             m_data[i].second = EntryType();
+            m_costs[i] = 0;
         }
+        m_totalCost = 0;
     }
 
+    void setCostLimit(size_t costLimit) { m_costLimit = costLimit; }
+    size_t totalCost() const { return m_totalCost; }
 
 private:
+    // Returns the first occupied slot at or after index, wrapping around.
+    // Only called when the total cost is non-zero, so there is one.
+    size_t findOccupiedIndexFrom(size_t index)
+    {
+        ASSERT(m_totalCost);
+        while (!m_data[index].second)
+            index = (index + 1) % CacheSize;
+        return index;
+    }
+
+    void evictToFit(size_t cost)
+    {
+        while (m_totalCost + cost > m_costLimit)
+            evictAt(findOccupiedIndexFrom(m_randomGenerator.getUint32() % CacheSize));
+    }
+
+    void evictAt(size_t index)
+    {
+        m_map.remove(m_data[index].first);
+        m_data[index].first = KeyType();
+        m_data[index].second = EntryType();
+        m_totalCost -= m_costs[index];
+        m_costs[index] = 0;
+    }
+
     HashMap<KeyType, unsigned> m_map;
     FixedArray<std::pair<KeyType, EntryType>, CacheSize> m_data;
+    FixedArray<size_t, CacheSize> m_costs;
     WeakRandom m_randomGenerator;
+    size_t m_totalCost;
+    size_t m_costLimit;
 };
 
 class CodeCache {
@@ -129,6 +183,13 @@ private:
     template <class UnlinkedCodeBlockType, class ExecutableType> inline UnlinkedCodeBlockType* getCodeBlock(JSGlobalData&, ExecutableType*, const SourceCode&, JSParserStrictness, DebuggerMode, ProfilerMode, ParserError&);
     CodeBlockKey makeCodeBlockKey(const SourceCode&, CodeType, JSParserStrictness);
     GlobalFunctionKey makeGlobalFunctionKey(const SourceCode&, const String&);
+#if defined(__LB_SHELL__)
+    // Loads the function info of a program from the persistent store before
+    // it is parsed. Returns true if it should be stored once the program has
+    // been parsed, with |key| set to the key to store it under.
+    bool loadPersistentFunctionInfo(JSGlobalData&, const SourceCode&, CString& key);
+    void storePersistentFunctionInfo(const SourceCode&, const CString& key);
+#endif
 
     enum {
         kMaxRootCodeBlockEntries = 1024,
@@ -142,6 +203,17 @@ private:
         kMaxFunctionCodeBlocks = kMaxRootCodeBlockEntries * 8
     };
 
+#if defined(__LB_SHELL__)
+    // Leanback generates many unique JavaScript fragments over time and the
+    // cache is only cleared on navigation, so root code blocks are limited by
+    // the total length of their source as well as by count. The source is
+    // held by the cache key, and the bytecode generated for it grows with it.
+    static const size_t kMaxRootCodeBlockSourceLength = 4 * 1024 * 1024;
+    // Smaller programs are quick enough to parse that keeping what was
+    // learned about their functions isn't worth a file.
+    static const int kMinPersistentSourceLength = 64 * 1024;
+#endif
+
     CacheMap<CodeBlockKey, Strong<UnlinkedCodeBlock>, kMaxRootCodeBlockEntries> m_cachedCodeBlocks;
     CacheMap<GlobalFunctionKey, Strong<UnlinkedFunctionExecutable>, kMaxFunctionCodeBlocks> m_cachedGlobalFunctions;
     CacheMap<UnlinkedFunctionCodeBlock*, Strong<UnlinkedFunctionCodeBlock>, kMaxFunctionCodeBlocks> m_recentlyUsedFunctionCode;
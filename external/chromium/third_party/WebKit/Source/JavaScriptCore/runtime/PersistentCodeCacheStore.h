@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2014 Google Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY APPLE INC. AND ITS CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL APPLE INC. OR ITS CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PersistentCodeCacheStore_h
+#define PersistentCodeCacheStore_h
+
+#include <wtf/Vector.h>
+
+namespace JSC {
+
+// Keeps what the parser learned about the functions of large programs across
+// launches, so that parsing the same program again can skip over the bodies
+// of its functions. Implemented by the embedder, which decides where the data
+// lives and how much of it is kept. Keys are hex digests of program text.
+class PersistentCodeCacheStore {
+public:
+    virtual ~PersistentCodeCacheStore() { }
+
+    // Fills |data| with what was stored under |key| and returns true, or
+    // returns false if nothing was.
+    virtual bool load(const char* key, Vector<char>& data) = 0;
+    virtual void store(const char* key, const Vector<char>& data) = 0;
+};
+
+// Sets the store used by every CodeCache, or 0 for none. The store is not
+// owned, and is only used on threads running JavaScript.
+JS_EXPORT_PRIVATE void setPersistentCodeCacheStore(PersistentCodeCacheStore*);
+
+}
+
+#endif // PersistentCodeCacheStore_h
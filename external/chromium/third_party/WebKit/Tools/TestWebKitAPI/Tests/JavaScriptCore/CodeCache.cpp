@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2014 Google Inc. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY APPLE INC. AND ITS CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL APPLE INC. OR ITS CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "config.h"
+
+#include "CodeCache.h"
+#include "Identifier.h"
+#include "InitializeThreading.h"
+#include "JSGlobalData.h"
+#include "JSLock.h"
+#include "SourceProviderCache.h"
+
+namespace TestWebKitAPI {
+
+using namespace JSC;
+
+// Entries are ints so that 0 is an empty slot, and keys start at 1 since 0 is
+// the empty key of HashMap<int>.
+typedef CacheMap<int, int, 64> IntCacheMap;
+
+static size_t countEntries(IntCacheMap& cache, int lastKey)
+{
+    size_t count = 0;
+    for (int key = 1; key <= lastKey; ++key) {
+        if (cache.find(key))
+            ++count;
+    }
+    return count;
+}
+
+TEST(JavaScriptCore, CacheMapEvictsToFitCostLimit)
+{
+    IntCacheMap cache;
+    cache.setCostLimit(100);
+    for (int key = 1; key <= 20; ++key) {
+        cache.add(key, key, 30);
+        // The newest entry is always kept, and older ones make room for it.
+        ASSERT_TRUE(cache.find(key));
+        EXPECT_EQ(key, *cache.find(key));
+        EXPECT_LE(cache.totalCost(), 100u);
+        EXPECT_EQ(30 * countEntries(cache, key), cache.totalCost());
+    }
+}
+
+TEST(JavaScriptCore, CacheMapSkipsEntriesOverCostLimit)
+{
+    IntCacheMap cache;
+    cache.setCostLimit(100);
+    cache.add(1, 1, 60);
+    cache.add(2, 2, 101);
+    EXPECT_FALSE(cache.find(2));
+    // Nothing was evicted for an entry that could never fit.
+    EXPECT_TRUE(cache.find(1));
+    EXPECT_EQ(60u, cache.totalCost());
+}
+
+TEST(JavaScriptCore, CacheMapKeepsAtMostCacheSizeEntries)
+{
+    CacheMap<int, int, 4> cache;
+    for (int key = 1; key <= 100; ++key)
+        cache.add(key, key);
+    size_t count = 0;
+    for (int key = 1; key <= 100; ++key) {
+        if (cache.find(key))
+            ++count;
+    }
+    EXPECT_LE(count, 4u);
+    EXPECT_TRUE(cache.find(100));
+}
+
+TEST(JavaScriptCore, CacheMapReplacingAnEntryUpdatesItsCost)
+{
+    IntCacheMap cache;
+    cache.setCostLimit(100);
+    cache.add(1, 1, 60);
+    cache.add(1, 2, 20);
+    ASSERT_TRUE(cache.find(1));
+    EXPECT_EQ(2, *cache.find(1));
+    EXPECT_EQ(20u, cache.totalCost());
+
+    // Growing an entry makes room for it like adding one does.
+    cache.add(2, 2, 40);
+    cache.add(1, 3, 90);
+    ASSERT_TRUE(cache.find(1));
+    EXPECT_EQ(3, *cache.find(1));
+    EXPECT_FALSE(cache.find(2));
+    EXPECT_EQ(90u, cache.totalCost());
+}
+
+TEST(JavaScriptCore, CacheMapClearResetsCost)
+{
+    IntCacheMap cache;
+    cache.setCostLimit(100);
+    cache.add(1, 1, 50);
+    cache.add(2, 2, 50);
+    cache.clear();
+    EXPECT_EQ(0u, cache.totalCost());
+    EXPECT_FALSE(cache.find(1));
+    EXPECT_FALSE(cache.find(2));
+
+    // The whole budget is available again.
+    cache.add(3, 3, 100);
+    EXPECT_TRUE(cache.find(3));
+}
+
+#if defined(__LB_SHELL__)
+TEST(JavaScriptCore, SourceProviderCacheSerialization)
+{
+    initializeThreading();
+    RefPtr<JSGlobalData> globalData = JSGlobalData::create();
+    JSLockHolder lock(globalData.get());
+
+    String source("function f() { var a = 1; b = a; return a + b; }");
+    unsigned openBracePos = source.find('{');
+    unsigned closeBracePos = source.reverseFind('}');
+
+    SourceProviderCache cache;
+    OwnPtr<SourceProviderCacheItem> item = adoptPtr(new SourceProviderCacheItem(0, 12, closeBracePos));
+    item->needsFullActivation = false;
+    item->usesEval = true;
+    item->strictMode = false;
+    item->usedVariables.append(Identifier(globalData.get(), "a").impl());
+    item->writtenVariables.append(Identifier(globalData.get(), "b").impl());
+    cache.add(openBracePos, item.release(), 0);
+
+    Vector<char> data;
+    cache.serialize(source, 10, data);
+
+    // The same text, ten lines further down.
+    SourceProviderCache loaded;
+    ASSERT_TRUE(loaded.deserialize(globalData.get(), source, 20, data));
+    const SourceProviderCacheItem* loadedItem = loaded.get(openBracePos);
+    ASSERT_TRUE(loadedItem);
+    unsigned functionStart = loadedItem->functionStart;
+    unsigned closeBraceLine = loadedItem->closeBraceLine;
+    unsigned loadedCloseBracePos = loadedItem->closeBracePos;
+    EXPECT_EQ(0u, functionStart);
+    EXPECT_EQ(22u, closeBraceLine);
+    EXPECT_EQ(closeBracePos, loadedCloseBracePos);
+    EXPECT_FALSE(loadedItem->needsFullActivation);
+    EXPECT_TRUE(loadedItem->usesEval);
+    EXPECT_FALSE(loadedItem->strictMode);
+    // The parser compares variables by pointer, so they must be the
+    // identifiers themselves.
+    ASSERT_EQ(1u, loadedItem->usedVariables.size());
+    EXPECT_EQ(Identifier(globalData.get(), "a").impl(), loadedItem->usedVariables[0].get());
+    ASSERT_EQ(1u, loadedItem->writtenVariables.size());
+    EXPECT_EQ(Identifier(globalData.get(), "b").impl(), loadedItem->writtenVariables[0].get());
+}
+
+TEST(JavaScriptCore, SourceProviderCacheRejectsOtherText)
+{
+    initializeThreading();
+    RefPtr<JSGlobalData> globalData = JSGlobalData::create();
+    JSLockHolder lock(globalData.get());
+
+    String source("function f() { var a = 1; b = a; return a + b; }");
+    SourceProviderCache cache;
+    OwnPtr<SourceProviderCacheItem> item = adoptPtr(new SourceProviderCacheItem(0, 0, source.reverseFind('}')));
+    item->needsFullActivation = false;
+    item->usesEval = false;
+    item->strictMode = false;
+    cache.add(source.find('{'), item.release(), 0);
+    Vector<char> data;
+    cache.serialize(source, 0, data);
+
+    // Text of another length.
+    SourceProviderCache loaded;
+    EXPECT_FALSE(loaded.deserialize(globalData.get(), source + " ", 0, data));
+    EXPECT_TRUE(loaded.isEmpty());
+
+    // Text of the same length with the braces elsewhere.
+    String moved("function f(){  var a = 1; b = a; return a + b; }");
+    ASSERT_EQ(source.length(), moved.length());
+    EXPECT_FALSE(loaded.deserialize(globalData.get(), moved, 0, data));
+    EXPECT_TRUE(loaded.isEmpty());
+
+    // Data that was cut short.
+    Vector<char> truncated(data);
+    truncated.shrink(truncated.size() - 1);
+    EXPECT_FALSE(loaded.deserialize(globalData.get(), source, 0, truncated));
+    EXPECT_TRUE(loaded.isEmpty());
+
+    EXPECT_TRUE(loaded.deserialize(globalData.get(), source, 0, data));
+    EXPECT_FALSE(loaded.isEmpty());
+}
+#endif
+
+} // namespace TestWebKitAPI
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_code_cache_store.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/file_util.h"
+#include "base/logging.h"
+#include "base/time.h"
+#include "lb_globals.h"
+
+namespace {
+
+const FilePath::CharType kCodeCacheDirectory[] =
+    FILE_PATH_LITERAL("js_code_cache");
+
+// Entries are written here first and renamed once complete, so an entry is
+// never seen half written.
+const FilePath::CharType kTempExtension[] = FILE_PATH_LITERAL("tmp");
+
+bool IsValidKey(const char* key) {
+  if (!*key)
+    return false;
+  for (const char* c = key; *c; ++c) {
+    if (!((*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'f')))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+const int64 LBCodeCacheStore::kDefaultMaxSize;
+
+// static
+FilePath LBCodeCacheStore::GetDefaultDirectory() {
+  return FilePath(GetGlobalsPtr()->cache_path).Append(kCodeCacheDirectory);
+}
+
+LBCodeCacheStore::LBCodeCacheStore(const FilePath& directory, int64 max_size)
+    : directory_(directory)
+    , max_size_(max_size) {
+}
+
+bool LBCodeCacheStore::load(const char* key, WTF::Vector<char>& data) {
+  if (!IsValidKey(key))
+    return false;
+  FilePath path = GetPath(key);
+  std::string contents;
+  if (!file_util::ReadFileToString(path, &contents))
+    return false;
+  // The modification time orders entries by use for Trim().
+  base::Time now = base::Time::Now();
+  file_util::TouchFile(path, now, now);
+  data.append(contents.data(), contents.size());
+  return true;
+}
+
+void LBCodeCacheStore::store(const char* key, const WTF::Vector<char>& data) {
+  if (!IsValidKey(key) || static_cast<int64>(data.size()) > max_size_)
+    return;
+  if (!file_util::CreateDirectory(directory_)) {
+    DLOG(WARNING) << "Could not create " << directory_.value();
+    return;
+  }
+  FilePath path = GetPath(key);
+  FilePath temp_path = path.AddExtension(kTempExtension);
+  int size = static_cast<int>(data.size());
+  if (file_util::WriteFile(temp_path, data.data(), size) != size ||
+      !file_util::Move(temp_path, path)) {
+    DLOG(WARNING) << "Could not write " << path.value();
+    file_util::Delete(temp_path, false);
+    return;
+  }
+  Trim(path);
+}
+
+FilePath LBCodeCacheStore::GetPath(const char* key) const {
+  return directory_.AppendASCII(key);
+}
+
+void LBCodeCacheStore::Trim(const FilePath& keep) {
+  typedef std::pair<base::Time, std::pair<int64, FilePath> > Entry;
+  std::vector<Entry> entries;
+  int64 total_size = 0;
+  file_util::FileEnumerator enumerator(directory_, false,
+                                       file_util::FileEnumerator::FILES);
+  for (FilePath path = enumerator.Next(); !path.empty();
+       path = enumerator.Next()) {
+    file_util::FileEnumerator::FindInfo info;
+    enumerator.GetFindInfo(&info);
+    int64 size = file_util::FileEnumerator::GetFilesize(info);
+    total_size += size;
+    if (path != keep) {
+      entries.push_back(std::make_pair(
+          file_util::FileEnumerator::GetLastModifiedTime(info),
+          std::make_pair(size, path)));
+    }
+  }
+
+  // Oldest first.
+  std::sort(entries.begin(), entries.end());
+  for (size_t i = 0; i < entries.size() && total_size > max_size_; ++i) {
+    if (file_util::Delete(entries[i].second.second, false))
+      total_size -= entries[i].second.first;
+  }
+}
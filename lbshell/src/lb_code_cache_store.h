@@ -0,0 +1,55 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Keeps what JavaScriptCore learned about the functions of large scripts in
+// files in the cache directory, so that the next launch parses them faster.
+
+#ifndef SRC_LB_CODE_CACHE_STORE_H_
+#define SRC_LB_CODE_CACHE_STORE_H_
+
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/file_path.h"
+// required before PersistentCodeCacheStore.h
+#include "external/chromium/third_party/WebKit/Source/JavaScriptCore/runtime/JSExportMacros.h"
+#include "external/chromium/third_party/WebKit/Source/JavaScriptCore/runtime/PersistentCodeCacheStore.h"
+
+class LBCodeCacheStore : public JSC::PersistentCodeCacheStore {
+ public:
+  // The store in the cache directory used by the app.
+  static const int64 kDefaultMaxSize = 4 * 1024 * 1024;
+  static FilePath GetDefaultDirectory();
+
+  // Keeps entries in files in |directory|, deleting the least recently used
+  // ones when together they take more than |max_size| bytes.
+  LBCodeCacheStore(const FilePath& directory, int64 max_size);
+
+  // JSC::PersistentCodeCacheStore implementation.
+  virtual bool load(const char* key, WTF::Vector<char>& data) OVERRIDE;
+  virtual void store(const char* key, const WTF::Vector<char>& data) OVERRIDE;
+
+ private:
+  FilePath GetPath(const char* key) const;
+  // Deletes the least recently used entries other than |keep| until the rest
+  // fit in |max_size_|.
+  void Trim(const FilePath& keep);
+
+  FilePath directory_;
+  int64 max_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(LBCodeCacheStore);
+};
+
+#endif  // SRC_LB_CODE_CACHE_STORE_H_
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_code_cache_store.h"
+
+#include <string>
+
+#include "base/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/memory/scoped_ptr.h"
+#include "base/time.h"
+#include "external/chromium/testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+const int64 kMaxSize = 1024;
+
+WTF::Vector<char> MakeData(char value, size_t size) {
+  WTF::Vector<char> data;
+  data.fill(value, size);
+  return data;
+}
+
+class LBCodeCacheStoreTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(temp_dir_.CreateUniqueTempDir());
+    directory_ = temp_dir_.path().AppendASCII("js_code_cache");
+    store_.reset(new LBCodeCacheStore(directory_, kMaxSize));
+  }
+
+  bool Exists(const char* key) {
+    return file_util::PathExists(directory_.AppendASCII(key));
+  }
+
+  // Makes the entry under |key| look as if it was last used |age| ago.
+  void SetAge(const char* key, const base::TimeDelta& age) {
+    base::Time time = base::Time::Now() - age;
+    ASSERT_TRUE(file_util::TouchFile(directory_.AppendASCII(key), time, time));
+  }
+
+  base::ScopedTempDir temp_dir_;
+  FilePath directory_;
+  scoped_ptr<LBCodeCacheStore> store_;
+};
+
+}  // namespace
+
+TEST_F(LBCodeCacheStoreTest, RoundTrip) {
+  WTF::Vector<char> data;
+  EXPECT_FALSE(store_->load("0123abcd", data));
+
+  store_->store("0123abcd", MakeData('a', 100));
+  ASSERT_TRUE(store_->load("0123abcd", data));
+  EXPECT_TRUE(data == MakeData('a', 100));
+
+  // A new store on the same directory, as on the next launch.
+  LBCodeCacheStore next_store(directory_, kMaxSize);
+  WTF::Vector<char> next_data;
+  ASSERT_TRUE(next_store.load("0123abcd", next_data));
+  EXPECT_TRUE(next_data == MakeData('a', 100));
+
+  // Storing again replaces the entry.
+  next_store.store("0123abcd", MakeData('b', 10));
+  next_data.clear();
+  ASSERT_TRUE(next_store.load("0123abcd", next_data));
+  EXPECT_TRUE(next_data == MakeData('b', 10));
+}
+
+TEST_F(LBCodeCacheStoreTest, KeysThatAreNotDigestsAreRefused) {
+  store_->store("../escape", MakeData('a', 10));
+  store_->store("", MakeData('a', 10));
+  store_->store("ABCD", MakeData('a', 10));
+  EXPECT_FALSE(file_util::PathExists(temp_dir_.path().AppendASCII("escape")));
+  EXPECT_FALSE(file_util::PathExists(directory_) &&
+               !file_util::IsDirectoryEmpty(directory_));
+}
+
+TEST_F(LBCodeCacheStoreTest, LeastRecentlyUsedEntriesAreDeleted) {
+  store_->store("01", MakeData('a', 400));
+  store_->store("02", MakeData('b', 400));
+  SetAge("01", base::TimeDelta::FromHours(2));
+  SetAge("02", base::TimeDelta::FromHours(1));
+
+  // Loading the older entry makes it the most recently used.
+  WTF::Vector<char> data;
+  ASSERT_TRUE(store_->load("01", data));
+
+  // The third entry goes over the budget, so the least recently used is
+  // deleted.
+  store_->store("03", MakeData('c', 400));
+  EXPECT_TRUE(Exists("01"));
+  EXPECT_FALSE(Exists("02"));
+  EXPECT_TRUE(Exists("03"));
+}
+
+TEST_F(LBCodeCacheStoreTest, NewEntryIsKept) {
+  store_->store("01", MakeData('a', 600));
+  // Even if the clock says the new entry is the older one, it is not the
+  // one deleted.
+  SetAge("01", -base::TimeDelta::FromHours(1));
+  store_->store("02", MakeData('b', 600));
+  EXPECT_FALSE(Exists("01"));
+  EXPECT_TRUE(Exists("02"));
+}
+
+TEST_F(LBCodeCacheStoreTest, EntriesOverTheBudgetAreNotStored) {
+  store_->store("01", MakeData('a', 100));
+  store_->store("02", MakeData('b', kMaxSize + 1));
+  EXPECT_TRUE(Exists("01"));
+  EXPECT_FALSE(Exists("02"));
+}
@@ -15,6 +15,8 @@
  */
 #include "lb_console_values.h"
 
+#include <time.h>
+
 #include <sstream>
 
 namespace LB {
@@ -39,9 +41,14 @@ class AutoPthreadLock {
 ConsoleValueManager* ConsoleValueManager::instance_ = NULL;
 pthread_mutex_t ConsoleValueManager::instance_lock_ = PTHREAD_MUTEX_INITIALIZER;
 
-ConsoleValueManager::ConsoleValueManager() {
+ConsoleValueManager::ConsoleValueManager(int collection_interval_ms)
+    : collection_interval_ms_(collection_interval_ms)
+    , collector_started_(false)
+    , stop_collector_(false) {
   pthread_mutex_init(&hooks_mutex_, NULL);
   pthread_mutex_init(&cvals_mutex_, NULL);
+  pthread_mutex_init(&collector_mutex_, NULL);
+  pthread_cond_init(&collector_cond_, NULL);
 
   // Allocate these dynamically since ConsoleValueManager may live across
   // DLL boundaries and so this allows its size to be more consistent (and
@@ -49,12 +56,29 @@ ConsoleValueManager::ConsoleValueManager() {
   registered_vars_ = new NameVarMap();
   on_changed_hook_set_ = new CValSetType<OnChangedHook*>();
 
-  AutoPthreadLock lock(&instance_lock_);
-  assert(instance_ == NULL);
-  instance_ = this;
+  {
+    AutoPthreadLock lock(&instance_lock_);
+    assert(instance_ == NULL);
+    instance_ = this;
+  }
+
+  if (collection_interval_ms_ > 0) {
+    collector_started_ = pthread_create(&collector_thread_, NULL,
+                                        &CollectorThreadEntry, this) == 0;
+    assert(collector_started_);
+  }
 }
 
 ConsoleValueManager::~ConsoleValueManager() {
+  if (collector_started_) {
+    {
+      AutoPthreadLock lock(&collector_mutex_);
+      stop_collector_ = true;
+      pthread_cond_signal(&collector_cond_);
+    }
+    pthread_join(collector_thread_, NULL);
+  }
+
   {
     AutoPthreadLock lock(&instance_lock_);
     assert(instance_ == this);
@@ -64,10 +88,40 @@ ConsoleValueManager::~ConsoleValueManager() {
   delete on_changed_hook_set_;
   delete registered_vars_;
 
+  pthread_cond_destroy(&collector_cond_);
+  pthread_mutex_destroy(&collector_mutex_);
   pthread_mutex_destroy(&cvals_mutex_);
   pthread_mutex_destroy(&hooks_mutex_);
 }
 
+// static
+void* ConsoleValueManager::CollectorThreadEntry(void* manager) {
+  static_cast<ConsoleValueManager*>(manager)->CollectorLoop();
+  return NULL;
+}
+
+void ConsoleValueManager::CollectorLoop() {
+  pthread_mutex_lock(&collector_mutex_);
+  while (!stop_collector_) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    int64_t nsec = deadline.tv_nsec +
+                   static_cast<int64_t>(collection_interval_ms_) * 1000000;
+    deadline.tv_sec += nsec / 1000000000;
+    deadline.tv_nsec = nsec % 1000000000;
+    // A spurious wakeup only makes a collection happen early.
+    pthread_cond_timedwait(&collector_cond_, &collector_mutex_, &deadline);
+    if (stop_collector_) {
+      break;
+    }
+
+    pthread_mutex_unlock(&collector_mutex_);
+    CollectChanges();
+    pthread_mutex_lock(&collector_mutex_);
+  }
+  pthread_mutex_unlock(&collector_mutex_);
+}
+
 void ConsoleValueManager::RegisterCVal(const CValDetail::CValBase* cval) {
   AutoPthreadLock lock(&cvals_mutex_);
 
@@ -89,14 +143,43 @@ void ConsoleValueManager::UnregisterCVal(const CValDetail::CValBase* cval) {
   }
 }
 
-void ConsoleValueManager::PushValueChangedEvent(
-    const CValDetail::CValBase* cval, const ConsoleGenericValue& value) {
-  AutoPthreadLock lock(&hooks_mutex_);
+void ConsoleValueManager::CollectChanges() {
+  AutoPthreadLock hooks_lock(&hooks_mutex_);
+  bool has_hooks = !on_changed_hook_set_->empty();
+
+  // Snapshot the changed values, then release cvals_mutex_ before calling
+  // the hooks so that they are free to query CVals.
+  typedef std::vector<std::pair<std::string, ConsoleGenericValue*> > Changes;
+  Changes changes;
+  {
+    AutoPthreadLock cvals_lock(&cvals_mutex_);
+    for (NameVarMap::const_iterator iter = registered_vars_->begin();
+         iter != registered_vars_->end(); ++iter) {
+      const CValDetail::CValBase* cval = iter->second;
+      // The acquire load orders the snapshot below after the change.
+      uint32_t change_count =
+          LB::Platform::atomic_load_acquire_32(&cval->change_count_);
+      if (change_count == cval->collected_count_) {
+        continue;
+      }
+      cval->collected_count_ = change_count;
+      // Changes made while nobody is listening are dropped, as a hook only
+      // hears about changes made after it was attached.
+      if (has_hooks) {
+        changes.push_back(
+            std::make_pair(iter->first, cval->CreateValueSnapshot()));
+      }
+    }
+  }
 
-  // Iterate through the hooks sending each of them the value changed event.
-  for (OnChangeHookSet::iterator iter = on_changed_hook_set_->begin();
-       iter != on_changed_hook_set_->end(); ++iter) {
-    (*iter)->OnValueChanged(cval->GetName(), value);
+  // Iterate through the hooks sending each of them the value changed events.
+  for (Changes::iterator change = changes.begin(); change != changes.end();
+       ++change) {
+    for (OnChangeHookSet::iterator iter = on_changed_hook_set_->begin();
+         iter != on_changed_hook_set_->end(); ++iter) {
+      (*iter)->OnValueChanged(change->first, *change->second);
+    }
+    delete change->second;
   }
 }
 
@@ -19,6 +19,7 @@
 #include <assert.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <string.h>
 
 #if defined(__LB_LINUX__) || defined(__LB_ANDROID__)
 #include <map>
@@ -37,6 +38,8 @@
 #include <string>
 #include <vector>
 
+#include "lb_platform.h"
+
 // The console value system allows you to mark certain variables to be part
 // of the console system and therefore analyzable and trackable by other
 // systems.  All modifications to marked variables will trigger an event
@@ -73,6 +76,15 @@
 // hook in to the singleton ConsoleValueManager object, which must exist
 // at that point.
 //
+// Modifying a 32-bit integer CVal never takes a lock once the CVal is
+// registered: the new value is stored, or atomically added to, and a per-CVal
+// change counter is atomically incremented.  Other types take a per-CVal lock
+// around the store so that concurrent += and -= are not lost.
+// The ConsoleValueManager runs a collector thread that periodically looks for
+// CVals whose counter moved and delivers their latest values to the hooks, so
+// hooks are called on the collector thread, and a CVal that changes several
+// times between two collections is only reported once with its latest value.
+//
 
 namespace LB {
 
@@ -384,6 +396,8 @@ class LB_BASE_EXPORT ConsoleGenericValue {
       : type_(type)
       , generic_value_(value_mem) {
   }
+
+ public:
   virtual ~ConsoleGenericValue() {}
 
  private:
@@ -431,7 +445,13 @@ class SpecificValue : public ConsoleGenericValue {
 // exist at a time.
 class LB_BASE_EXPORT ConsoleValueManager {
  public:
-  ConsoleValueManager();
+  // How often the collector thread delivers CVal changes to the hooks.
+  static const int kDefaultCollectionIntervalMs = 50;
+
+  // If |collection_interval_ms| is 0 no collector thread is started, and
+  // changes are only delivered when CollectChanges() is called.
+  explicit ConsoleValueManager(
+      int collection_interval_ms = kDefaultCollectionIntervalMs);
   ~ConsoleValueManager();
   static ConsoleValueManager* GetInstance() {
     return instance_;
@@ -469,6 +489,11 @@ class LB_BASE_EXPORT ConsoleValueManager {
   // i.e. 100000000 = 100M
   ValueQueryResults GetValueAsPrettyString(const std::string& name);
 
+  // Delivers the latest value of every CVal that changed since the last
+  // collection to all hooks, on the calling thread.  This is what the
+  // collector thread does periodically, and can be called to flush changes
+  // immediately.
+  void CollectChanges();
 
  private:
   // Called in CVal constructors to register/deregister themselves with the
@@ -476,10 +501,8 @@ class LB_BASE_EXPORT ConsoleValueManager {
   void RegisterCVal(const CValDetail::CValBase* cval);
   void UnregisterCVal(const CValDetail::CValBase* cval);
 
-  // Called whenever a CVal is modified, and does the work of notifying all
-  // hooks.
-  void PushValueChangedEvent(const CValDetail::CValBase* cval,
-                             const ConsoleGenericValue& value);
+  static void* CollectorThreadEntry(void* manager);
+  void CollectorLoop();
 
   // Helper function to remove code duplication between GetValueAsString
   // and GetValueAsPrettyString.
@@ -513,8 +536,9 @@ class LB_BASE_EXPORT ConsoleValueManager {
     ConsoleValueManager* manager_;
   };
 
-  // Mutex that protects against changes to hooks
-  pthread_mutex_t hooks_mutex_;  // TODO: (Optimize) Make a RW lock
+  // Mutex that protects against changes to hooks.  It is held for a whole
+  // collection, so that hooks see the changes of each CVal in order.
+  pthread_mutex_t hooks_mutex_;
 
   // Mutex that protects against CVals being registered/deregistered
   pthread_mutex_t cvals_mutex_;  // TODO: (Optimize) Make a RW lock
@@ -527,6 +551,14 @@ class LB_BASE_EXPORT ConsoleValueManager {
   typedef CValSetType<OnChangedHook*> OnChangeHookSet;
   OnChangeHookSet* on_changed_hook_set_;
 
+  int collection_interval_ms_;
+  bool collector_started_;
+  pthread_t collector_thread_;
+  // Guards stop_collector_ and wakes the collector thread to stop it.
+  pthread_mutex_t collector_mutex_;
+  pthread_cond_t collector_cond_;
+  bool stop_collector_;
+
   template <typename T>
   friend class CVal;
 };
@@ -539,7 +571,9 @@ class CValBase {
            const std::string& description)
       : name_(name)
       , description_(description)
-      , type_(type) {
+      , type_(type)
+      , change_count_(0)
+      , collected_count_(0) {
   }
 
   const std::string& GetName() const { return name_; }
@@ -549,10 +583,224 @@ class CValBase {
   virtual std::string GetValueAsString() const = 0;
   virtual std::string GetValueAsPrettyString() const = 0;
 
+ protected:
+  // Returns a copy of the current value for the hooks.
+  virtual ConsoleGenericValue* CreateValueSnapshot() const = 0;
+
+  // Called by the modifying thread after storing a new value.
+  void MarkChanged() {
+    LB::Platform::atomic_inc_32(&change_count_);
+  }
+
  private:
   std::string name_;
   std::string description_;
   ConsoleValType type_;
+
+  // Incremented every time the value changes.  Mutable so that the collector
+  // can read it atomically through a const CValBase.
+  mutable uint32_t change_count_;
+  // The value of change_count_ at the last collection.  Only accessed by the
+  // ConsoleValueManager, with its cvals_mutex_ held.
+  mutable uint32_t collected_count_;
+
+  friend class LB::ConsoleValueManager;
+};
+
+// Holds the value of a CVal.  Set() returns whether the value changed, so
+// that CVal::operator=() can compare and store in one step.  Add() and
+// Subtract() must not lose concurrent updates.  Numerical values the
+// platform has atomics of the size of are kept in an integer of that size
+// and updated without locking, see AtomicValueStorage.  Any other value is
+// guarded by a mutex.
+template <typename T, bool IsNumerical>
+class ValueStorage {
+ public:
+  ValueStorage() : value_() {
+    pthread_mutex_init(&mutex_, NULL);
+  }
+  explicit ValueStorage(const T& value) : value_(value) {
+    pthread_mutex_init(&mutex_, NULL);
+  }
+  ~ValueStorage() {
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  T Get() const {
+    pthread_mutex_lock(&mutex_);
+    T value = value_;
+    pthread_mutex_unlock(&mutex_);
+    return value;
+  }
+  bool Set(const T& value) {
+    pthread_mutex_lock(&mutex_);
+    bool changed = value_ != value;
+    value_ = value;
+    pthread_mutex_unlock(&mutex_);
+    return changed;
+  }
+  void Add(const T& delta) {
+    pthread_mutex_lock(&mutex_);
+    value_ += delta;
+    pthread_mutex_unlock(&mutex_);
+  }
+  void Subtract(const T& delta) {
+    pthread_mutex_lock(&mutex_);
+    value_ -= delta;
+    pthread_mutex_unlock(&mutex_);
+  }
+
+ private:
+  T value_;
+  mutable pthread_mutex_t mutex_;
+};
+
+inline uint32_t AtomicLoad(const uint32_t* bits) {
+  return LB::Platform::atomic_load_acquire_32(bits);
+}
+inline uint64_t AtomicLoad(const uint64_t* bits) {
+  return LB::Platform::atomic_load_acquire_64(bits);
+}
+inline uint32_t AtomicCompareAndSwap(uint32_t* bits, uint32_t old_bits,
+                                     uint32_t new_bits) {
+  return LB::Platform::atomic_cas_32(bits, old_bits, new_bits);
+}
+inline uint64_t AtomicCompareAndSwap(uint64_t* bits, uint64_t old_bits,
+                                     uint64_t new_bits) {
+  return LB::Platform::atomic_cas_64(bits, old_bits, new_bits);
+}
+
+// Keeps a T in the unsigned integer Bits of the same size, and updates it
+// with a compare-and-swap loop.  Integers are kept as their two's complement
+// bits and floating point values are bit cast.  Values are compared as T, so
+// that a floating point CVal set to a NaN still counts as changed.
+template <typename T, typename Bits>
+class AtomicValueStorage {
+ public:
+  AtomicValueStorage() : bits_(ToBits(T())) {}
+  explicit AtomicValueStorage(const T& value) : bits_(ToBits(value)) {}
+
+  T Get() const { return FromBits(AtomicLoad(&bits_)); }
+  bool Set(const T& value) {
+    Bits new_bits = ToBits(value);
+    Bits old_bits = AtomicLoad(&bits_);
+    while (FromBits(old_bits) != value) {
+      Bits found_bits = AtomicCompareAndSwap(&bits_, old_bits, new_bits);
+      if (found_bits == old_bits)
+        return true;
+      old_bits = found_bits;
+    }
+    return false;
+  }
+  void Add(const T& delta) {
+    Bits old_bits = AtomicLoad(&bits_);
+    while (true) {
+      Bits found_bits = AtomicCompareAndSwap(
+          &bits_, old_bits, ToBits(FromBits(old_bits) + delta));
+      if (found_bits == old_bits)
+        return;
+      old_bits = found_bits;
+    }
+  }
+  void Subtract(const T& delta) { Add(-delta); }
+
+ private:
+  // If you get a compiler error here, Bits is not the size of T.
+  typedef char BitsMustBeTheSizeOfT[sizeof(T) == sizeof(Bits) ? 1 : -1];
+
+  static Bits ToBits(const T& value) {
+    Bits bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+  }
+  static T FromBits(Bits bits) {
+    T value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  Bits bits_;
+};
+template <>
+class ValueStorage<uint32_t, true>
+    : public AtomicValueStorage<uint32_t, uint32_t> {
+ public:
+  ValueStorage() {}
+  explicit ValueStorage(const uint32_t& value)
+      : AtomicValueStorage<uint32_t, uint32_t>(value) {}
+};
+template <>
+class ValueStorage<int32_t, true>
+    : public AtomicValueStorage<int32_t, uint32_t> {
+ public:
+  ValueStorage() {}
+  explicit ValueStorage(const int32_t& value)
+      : AtomicValueStorage<int32_t, uint32_t>(value) {}
+};
+template <>
+class ValueStorage<float, true> : public AtomicValueStorage<float, uint32_t> {
+ public:
+  ValueStorage() {}
+  explicit ValueStorage(const float& value)
+      : AtomicValueStorage<float, uint32_t>(value) {}
+};
+#if defined(__LP64__)
+// 64-bit atomics are only native on 64-bit hosts.
+template <>
+class ValueStorage<uint64_t, true>
+    : public AtomicValueStorage<uint64_t, uint64_t> {
+ public:
+  ValueStorage() {}
+  explicit ValueStorage(const uint64_t& value)
+      : AtomicValueStorage<uint64_t, uint64_t>(value) {}
+};
+template <>
+class ValueStorage<int64_t, true>
+    : public AtomicValueStorage<int64_t, uint64_t> {
+ public:
+  ValueStorage() {}
+  explicit ValueStorage(const int64_t& value)
+      : AtomicValueStorage<int64_t, uint64_t>(value) {}
+};
+template <>
+class ValueStorage<double, true>
+    : public AtomicValueStorage<double, uint64_t> {
+ public:
+  ValueStorage() {}
+  explicit ValueStorage(const double& value)
+      : AtomicValueStorage<double, uint64_t>(value) {}
+};
+#endif  // defined(__LP64__)
+template <typename T>
+class ValueStorage<T, false> {
+ public:
+  ValueStorage() {
+    pthread_mutex_init(&mutex_, NULL);
+  }
+  explicit ValueStorage(const T& value) : value_(value) {
+    pthread_mutex_init(&mutex_, NULL);
+  }
+  ~ValueStorage() {
+    pthread_mutex_destroy(&mutex_);
+  }
+
+  T Get() const {
+    pthread_mutex_lock(&mutex_);
+    T value = value_;
+    pthread_mutex_unlock(&mutex_);
+    return value;
+  }
+  bool Set(const T& value) {
+    pthread_mutex_lock(&mutex_);
+    bool changed = value_ != value;
+    value_ = value;
+    pthread_mutex_unlock(&mutex_);
+    return changed;
+  }
+
+ private:
+  T value_;
+  mutable pthread_mutex_t mutex_;
 };
 
 }  // namespace CValDetail
@@ -560,7 +808,8 @@ class CValBase {
 // This is a wrapper class that marks that we wish to track a value through
 // the console value system.  If a CVal is created before the singleton
 // ConsoleValueManager instance, it will register itself the next time it is
-// modified and the ConsoleValueManager instance exists.
+// modified and the ConsoleValueManager instance exists.  Until then every
+// modification takes the ConsoleValueManager instance lock.
 template <typename T>
 class CVal : public CValDetail::CValBase {
  public:
@@ -579,7 +828,7 @@ class CVal : public CValDetail::CValBase {
     CommonConstructor();
   }
   ~CVal() {
-    if (registered_) {
+    if (IsRegistered()) {
       ConsoleValueManager::LockedReference manager;
       // Unregister ourselves with the system
       if (manager.get()) {
@@ -589,43 +838,46 @@ class CVal : public CValDetail::CValBase {
   }
 
   operator T() const {
-    return value_;
+    return value_.Get();
   }
   const CVal<T>& operator =(const T& rhs) {
-    if (value_ != rhs) {
-      value_ = rhs;
+    if (value_.Set(rhs))
       OnValueChanged();
-    }
 
     return *this;
   }
 
   const CVal<T>& operator +=(const T& rhs) {
-    value_ += rhs;
+    value_.Add(rhs);
     OnValueChanged();
     return *this;
   }
 
   const CVal<T>& operator -=(const T& rhs) {
-    value_ -= rhs;
+    value_.Subtract(rhs);
     OnValueChanged();
     return *this;
   }
 
   std::string GetValueAsString() const {
     // Can be called to get the value of a CVal without knowing the type first.
-    return CValDetail::ValToString<T>(value_);
+    return CValDetail::ValToString<T>(value_.Get());
   }
 
   std::string GetValueAsPrettyString() const {
     // Similar to GetValueAsString(), but it will also format the string to
     // do things like make very large numbers more readable.
-    return CValDetail::ValToPrettyString<T>(value_);
+    return CValDetail::ValToPrettyString<T>(value_.Get());
+  }
+
+ protected:
+  ConsoleGenericValue* CreateValueSnapshot() const {
+    return new CValDetail::SpecificValue<T>(value_.Get());
   }
 
  private:
   void CommonConstructor() {
-    registered_ = false;
+    registered_ = 0;
     ConsoleValueManager::LockedReference manager;
     TryToRegisterWithManager(&manager);
   }
@@ -633,26 +885,32 @@ class CVal : public CValDetail::CValBase {
   void TryToRegisterWithManager(ConsoleValueManager::LockedReference* manager) {
     if (manager->get()) {
       // Only register if we haven't already.
-      if (!registered_) {
+      if (!IsRegistered()) {
         manager->get()->RegisterCVal(this);
-        registered_ = true;
+        LB::Platform::atomic_inc_32(&registered_);
       }
     }
   }
 
+  // registered_ only goes from 0 to 1, with the ConsoleValueManager instance
+  // lock held, but it is checked without the lock on every change.
+  bool IsRegistered() const {
+    return LB::Platform::atomic_load_acquire_32(&registered_) != 0;
+  }
+
   void OnValueChanged() {
-    ConsoleValueManager::LockedReference manager;
-    // If we're still not attached to a manager, try again now.  This might
-    // happen if the CVal is a global variable.
-    TryToRegisterWithManager(&manager);
-    if (manager.get()) {
-      manager.get()->PushValueChangedEvent(
-          this, CValDetail::SpecificValue<T>(value_));
+    if (!IsRegistered()) {
+      ConsoleValueManager::LockedReference manager;
+      // If we're still not attached to a manager, try again now.  This might
+      // happen if the CVal is a global variable.
+      TryToRegisterWithManager(&manager);
     }
+    // The collector picks up the new value the next time it runs.
+    MarkChanged();
   }
 
-  T value_;
-  mutable bool registered_;
+  CValDetail::ValueStorage<T, CValDetail::Traits<T>::kIsNumerical> value_;
+  mutable uint32_t registered_;
 };
 
 #else  // #if defined(__LB_SHELL__ENABLE_CONSOLE__)
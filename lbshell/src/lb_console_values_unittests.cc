@@ -16,7 +16,10 @@
 
 #include "lb_console_values.h"
 
+#include <unistd.h>
+
 #include <string>
+#include <vector>
 
 #include "external/chromium/testing/gmock/include/gmock/gmock.h"
 #include "external/chromium/testing/gtest/include/gtest/gtest.h"
@@ -68,6 +71,7 @@ TEST(ConsoleValueTest, HookReceiver) {
     TestHook test_hook;
 
     cval_a = 15;
+    manager.CollectChanges();
 
     EXPECT_EQ(test_hook.value_changed_count_, 1);
   }
@@ -93,6 +97,7 @@ TEST(ConsoleValueTest, HookReceiver) {
     TestHook test_hook;
 
     cval_a = 20;
+    manager.CollectChanges();
 
     EXPECT_EQ(test_hook.value_changed_count_, 1);
   }
@@ -119,6 +124,7 @@ TEST(ConsoleValueTest, HookReceiver) {
 
     LB::CVal<std::string> cval_b("cval_b", "foo", "");
     cval_b = "bar";
+    manager.CollectChanges();
 
     EXPECT_EQ(test_hook.value_changed_count_, 1);
   }
@@ -180,6 +186,7 @@ TEST(ConsoleValueTest, ConvertFromInt) {
 
   LB::CVal<size_t> cv_size_t("cv_size_t", 10, "");
   cv_size_t = 15;
+  manager.CollectChanges();
 
   EXPECT_EQ(test_hook.value_changed_count_, 7);
 }
@@ -213,6 +220,7 @@ TEST(ConsoleValueTest, ConvertFromFloat) {
 
   LB::CVal<double> cv_double("cv_double", 10.0, "");
   cv_double = 0.25;
+  manager.CollectChanges();
 
   EXPECT_EQ(test_hook.value_changed_count_, 2);
 }
@@ -243,6 +251,7 @@ TEST(ConsoleValueTest, ConvertFromString) {
 
   LB::CVal<std::string> cv_string("cv_string", "foo", "");
   cv_string = "bar";
+  manager.CollectChanges();
 
   EXPECT_EQ(test_hook.value_changed_count_, 1);
 }
@@ -277,6 +286,116 @@ TEST(ConsoleValueTest, NativeType) {
 
   LB::CVal<int32_t> cv_int32_t("cv_int32_t", 10, "");
   cv_int32_t = 15;
+  manager.CollectChanges();
+
+  EXPECT_EQ(test_hook.value_changed_count_, 1);
+}
+
+TEST(ConsoleValueTest, ChangesAreCoalesced) {
+  LB::ConsoleValueManager manager(0);
+  class TestHook : public LB::ConsoleValueManager::OnChangedHook {
+   public:
+    TestHook() : value_changed_count_(0) {}
+
+    virtual void OnValueChanged(
+        const std::string& name,
+        const LB::ConsoleGenericValue& value) {
+      EXPECT_EQ(name, "cval_a");
+      EXPECT_EQ(value.AsString(), "3");
+
+      ++value_changed_count_;
+    }
+
+    int value_changed_count_;
+  };
+  TestHook test_hook;
+
+  LB::CVal<int32_t> cval_a("cval_a", 0, "");
+  cval_a = 1;
+  cval_a += 5;
+  cval_a -= 3;
+  EXPECT_EQ(test_hook.value_changed_count_, 0);
+
+  manager.CollectChanges();
+  EXPECT_EQ(test_hook.value_changed_count_, 1);
 
+  // Nothing changed since the last collection.
+  manager.CollectChanges();
   EXPECT_EQ(test_hook.value_changed_count_, 1);
 }
+
+TEST(ConsoleValueTest, CollectorThread) {
+  LB::ConsoleValueManager manager(1);
+  class TestHook : public LB::ConsoleValueManager::OnChangedHook {
+   public:
+    TestHook() : value_changed_count_(0) {}
+
+    virtual void OnValueChanged(
+        const std::string& name,
+        const LB::ConsoleGenericValue& value) {
+      EXPECT_EQ(name, "cval_a");
+      EXPECT_EQ(value.AsString(), "15");
+
+      LB::Platform::atomic_inc_32(&value_changed_count_);
+    }
+
+    uint32_t value_changed_count() {
+      return LB::Platform::atomic_add_32(&value_changed_count_, 0);
+    }
+
+   private:
+    uint32_t value_changed_count_;
+  };
+  TestHook test_hook;
+
+  LB::CVal<int32_t> cval_a("cval_a", 10, "");
+  cval_a = 15;
+
+  // Give the collector thread up to a few seconds to deliver the change.
+  for (int i = 0; i < 1000 && !test_hook.value_changed_count(); ++i) {
+    usleep(5000);
+  }
+  EXPECT_EQ(test_hook.value_changed_count(), 1);
+}
+
+namespace {
+
+const int kAddsPerThread = 100000;
+
+template <typename T>
+void* AddToCVal(void* cval) {
+  LB::CVal<T>* value = static_cast<LB::CVal<T>*>(cval);
+  for (int i = 0; i < kAddsPerThread; ++i) {
+    *value += 3;
+    *value -= 1;
+  }
+  return NULL;
+}
+
+template <typename T>
+T AddFromThreads(int thread_count) {
+  LB::CVal<T> cval("cval_concurrent", 0, "");
+  std::vector<pthread_t> threads(thread_count);
+  for (int i = 0; i < thread_count; ++i) {
+    pthread_create(&threads[i], NULL, &AddToCVal<T>, &cval);
+  }
+  for (int i = 0; i < thread_count; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  return cval;
+}
+
+}  // namespace
+
+TEST(ConsoleValueTest, ConcurrentAddsAreNotLost) {
+  LB::ConsoleValueManager manager(0);
+  const int kThreads = 4;
+  EXPECT_EQ(AddFromThreads<int32_t>(kThreads), 2 * kAddsPerThread * kThreads);
+  EXPECT_EQ(AddFromThreads<uint32_t>(kThreads),
+            static_cast<uint32_t>(2 * kAddsPerThread * kThreads));
+  EXPECT_EQ(AddFromThreads<int64_t>(kThreads), 2 * kAddsPerThread * kThreads);
+  EXPECT_EQ(AddFromThreads<uint64_t>(kThreads),
+            static_cast<uint64_t>(2 * kAddsPerThread * kThreads));
+  EXPECT_EQ(AddFromThreads<float>(kThreads), 2.0f * kAddsPerThread * kThreads);
+  EXPECT_EQ(AddFromThreads<double>(kThreads), 2.0 * kAddsPerThread * kThreads);
+}
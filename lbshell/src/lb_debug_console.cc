@@ -26,13 +26,16 @@
 
 #include "Platform.h"
 
+#include "base/format_macros.h"
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/message_pump_shell.h"
+#include "base/string_number_conversions.h"
 #include "base/string_util.h"
 #include "base/stringprintf.h"
 #include "base/sys_string_conversions.h"
 #include "base/utf_string_conversions.h"
+#include "media/base/shell_media_statistics.h"
 #include "net/cookies/canonical_cookie.h"
 #include "skia/ext/SkMemory_new_handler.h"
 #include "sql/statement.h"
@@ -1029,6 +1032,51 @@ class LBCommandLogToTelnet : public LBCommand {
   }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// LBCommandMediaStats
+
+class LBCommandMediaStats : public LBCommand {
+ public:
+  explicit LBCommandMediaStats(LBDebugConsole *console) : LBCommand(console) {
+    command_syntax_ = "mediastats [json]";
+    help_summary_ = "Print percentiles of the media statistics.\n";
+    help_details_ = "mediastats usage:\n"
+                    "  mediastats [json]\n"
+                    "Prints the sample count, p50, p95 and p99 of each media\n"
+                    "statistic recorded since the playback began, as a\n"
+                    "table or as JSON.  Durations are in microseconds.\n";
+  }
+
+ protected:
+  virtual void DoCommand(
+      LBConsoleConnection *connection,
+      const std::vector<std::string> &tokens) OVERRIDE {
+    const media::ShellMediaStatistics& stats =
+        media::ShellMediaStatistics::Instance();
+    if (tokens.size() > 1 && tokens[1] == "json") {
+      connection->Output(stats.GetPercentilesAsJSON() + "\n");
+      return;
+    }
+
+    std::string output = base::StringPrintf(
+        "%-28s %10s %10s %10s %10s\n", "stat", "count", "p50", "p95", "p99");
+    for (int i = 0; i < media::ShellMediaStatistics::STAT_TYPE_MAX; ++i) {
+      media::ShellMediaStatistics::StatType type =
+          static_cast<media::ShellMediaStatistics::StatType>(i);
+      int64 count = stats.GetCount(type);
+      if (count == 0)
+        continue;
+      base::StringAppendF(
+          &output, "%-28s %10" PRId64 " %10" PRId64 " %10" PRId64
+          " %10" PRId64 "\n",
+          media::ShellMediaStatistics::GetStatName(type), count,
+          stats.GetPercentile(type, 50), stats.GetPercentile(type, 95),
+          stats.GetPercentile(type, 99));
+    }
+    connection->Output(output);
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // LBCommandMemDump
 class LBCommandMemDump : public LBCommand {
@@ -1196,6 +1244,37 @@ class LBCommandPerimeter : public LBCommand {
 };
 #endif
 
+////////////////////////////////////////////////////////////////////////////////
+// LBCommandPreconnect
+
+class LBCommandPreconnect : public LBCommand {
+ public:
+  explicit LBCommandPreconnect(LBDebugConsole *console) : LBCommand(console) {
+    command_syntax_ = "preconnect <url> [count]";
+    help_summary_ = "Open idle connections to the origin of a URL.\n";
+    help_details_ = "preconnect usage:\n"
+                    "  preconnect <url> [count]\n"
+                    "Looks up the host and opens count (default 1) connections "
+                    "to it,\nwhich the next requests to it will use.\n";
+  }
+
+ protected:
+  virtual void DoCommand(
+      LBConsoleConnection *connection,
+      const std::vector<std::string> &tokens) OVERRIDE {
+    GURL url(tokens[1]);
+    int count = 1;
+    if (!url.is_valid()) {
+      connection->Output(tokens[1] + ": bad url.\n");
+    } else if (tokens.size() > 2 &&
+               (!base::StringToInt(tokens[2], &count) || count < 1)) {
+      connection->Output(help_details_);
+    } else {
+      LBResourceLoaderBridge::Preconnect(url, count);
+    }
+  }
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // LBCommandReload
 
@@ -1526,11 +1605,13 @@ void LBDebugConsole::Init(LBShell * shell) {
   RegisterCommand(new LBCommandLayerBackingsInfo(this));
   RegisterCommand(new LBCommandLocation(this));
   RegisterCommand(new LBCommandLogToTelnet(this));
+  RegisterCommand(new LBCommandMediaStats(this));
   RegisterCommand(new LBCommandMemInfo(this));
   RegisterCommand(new LBCommandNav(this));
 #if !defined(__LB_SHELL__FOR_RELEASE__)
   RegisterCommand(new LBCommandPerimeter(this));
 #endif
+  RegisterCommand(new LBCommandPreconnect(this));
   RegisterCommand(new LBCommandReload(this));
 #if defined(__LB_SHELL__ENABLE_SCREENSHOT__)
   RegisterCommand(new LBCommandScreenshot(this));
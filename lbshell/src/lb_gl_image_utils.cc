@@ -61,6 +61,68 @@ const char* kQuadFragmentShaderFileName = "fragment_quad_drawer.glsl";
 #error Platform not supported yet.
 #endif
 
+#if defined(__LB_ANDROID__) || defined(__LB_LINUX__) || defined(__LB_XB1__) || \
+    defined(__LB_XB360__)
+#define LB_QUAD_DRAWER_SUPPORTS_YUV 1
+#else
+#define LB_QUAD_DRAWER_SUPPORTS_YUV 0
+#endif
+
+#if LB_QUAD_DRAWER_SUPPORTS_YUV
+// The YUV program is only used for video, so rather than shipping two more
+// shader files with the game content it is compiled from source here.  The
+// vertex shader takes the same offset, scale and rotation uniforms as
+// kQuadVertexShaderFileName.
+const char* kQuadYUVVertexShaderSource =
+    "attribute vec2 a_position;\n"
+    "attribute vec2 a_texCoord;\n"
+    "uniform vec2 offset;\n"
+    "uniform vec2 scale;\n"
+    "uniform float rotation;\n"
+    "varying vec2 v_texCoord;\n"
+    "void main() {\n"
+    "  float s = sin(rotation);\n"
+    "  float c = cos(rotation);\n"
+    "  vec2 pos = a_position * scale;\n"
+    "  pos = vec2(c * pos.x - s * pos.y, s * pos.x + c * pos.y);\n"
+    "  gl_Position = vec4(pos + offset, 0.0, 1.0);\n"
+    "  v_texCoord = a_texCoord;\n"
+    "}\n";
+
+const char* kQuadYUVFragmentShaderSource =
+    "precision mediump float;\n"
+    "uniform sampler2D y_tex;\n"
+    "uniform sampler2D u_tex;\n"
+    "uniform sampler2D v_tex;\n"
+    "uniform mat3 yuv_matrix;\n"
+    "uniform vec3 yuv_bias;\n"
+    "varying vec2 v_texCoord;\n"
+    "void main() {\n"
+    "  vec3 yuv = vec3(texture2D(y_tex, v_texCoord).r,\n"
+    "                  texture2D(u_tex, v_texCoord).r,\n"
+    "                  texture2D(v_tex, v_texCoord).r);\n"
+    "  gl_FragColor = vec4(yuv_matrix * (yuv + yuv_bias), 1.0);\n"
+    "}\n";
+#endif  // LB_QUAD_DRAWER_SUPPORTS_YUV
+
+// Limited (video) range YUV to RGB matrices, stored column major as expected
+// by uniformMatrix3fv().  The columns are the Y, U and V coefficients.
+const float kBT601Matrix[9] = {
+  1.164f, 1.164f, 1.164f,
+  0.0f, -0.391f, 2.018f,
+  1.596f, -0.813f, 0.0f,
+};
+
+const float kBT709Matrix[9] = {
+  1.164f, 1.164f, 1.164f,
+  0.0f, -0.213f, 2.112f,
+  1.793f, -0.533f, 0.0f,
+};
+
+// Added to the sampled YUV before the matrix is applied, moves black to 0
+// and the chroma planes to be centered around 0.
+const float kYUVBias[3] = { -16.0f / 255.0f, -0.5f, -0.5f };
+
 enum {
   kPositionAttrib = 0,
   kTexcoordAttrib = 1,
@@ -259,12 +321,27 @@ QuadDrawer::QuadDrawer(LBGraphics* graphics, LBWebGraphicsContext3D* context) {
   color_mult_uniform_ = -1;
   quad_program_ = -1;
   quad_vbo_ = -1;
+  yuv_initialized_ = false;
+  yuv_offset_uniform_ = -1;
+  yuv_scale_uniform_ = -1;
+  yuv_rotation_uniform_ = -1;
+  yuv_matrix_uniform_ = -1;
+  yuv_bias_uniform_ = -1;
+  yuv_program_ = -1;
 }
 
 QuadDrawer::~QuadDrawer() {
   if (initialized_) {
     context_->deleteBuffer(quad_vbo_);
   }
+  if (yuv_initialized_) {
+    context_->deleteProgram(yuv_program_);
+  }
+}
+
+// static
+bool QuadDrawer::SupportsYUV() {
+  return LB_QUAD_DRAWER_SUPPORTS_YUV;
 }
 
 void QuadDrawer::DrawQuad(int texture_handle,
@@ -307,6 +384,73 @@ void QuadDrawer::DrawQuadColorMult(int texture_handle,
                    color_mult_r, color_mult_g, color_mult_b, color_mult_a);
 }
 
+void QuadDrawer::DrawQuadYUV(const int plane_texture_handles[3],
+                             float offset_x, float offset_y,
+                             float scale_x, float scale_y,
+                             float rotation_ccw,
+                             const Coord texture_crop_coords[4],
+                             YUVColorSpace color_space) {
+  DCHECK(SupportsYUV());
+  if (!yuv_initialized_) {
+    yuv_initialized_ = true;
+    InitializeYUVShaders();
+  }
+
+  context_->useProgram(yuv_program_);
+
+  int quad_vbo = CreateQuadVertexBufferTex(context_, texture_crop_coords);
+  context_->bindBuffer(GraphicsContext3D::ARRAY_BUFFER, quad_vbo);
+  {
+    ScopedVertexAttribBinding position_binding(
+        context_,
+        kPositionAttrib, 2, GraphicsContext3D::FLOAT, false,
+        sizeof(QuadVertex), offsetof(QuadVertex, pos));
+    ScopedVertexAttribBinding texcoord_binding(
+        context_,
+        kTexcoordAttrib, 2, GraphicsContext3D::FLOAT, false,
+        sizeof(QuadVertex), offsetof(QuadVertex, texCoord));
+
+    float offset_array[2];
+    offset_array[0] = offset_x;
+    offset_array[1] = offset_y;
+    float scale_array[2];
+    scale_array[0] = scale_x;
+    scale_array[1] = scale_y;
+
+    context_->uniform2fv(yuv_offset_uniform_, 1, offset_array);
+    context_->uniform2fv(yuv_scale_uniform_, 1, scale_array);
+    context_->uniform1f(yuv_rotation_uniform_, rotation_ccw);
+    context_->uniformMatrix3fv(yuv_matrix_uniform_, 1, false,
+                               color_space == kYUVColorSpaceBT709 ?
+                                   kBT709Matrix : kBT601Matrix);
+    context_->uniform3fv(yuv_bias_uniform_, 1, kYUVBias);
+
+    for (int i = 0; i < 3; ++i) {
+      context_->activeTexture(GraphicsContext3D::TEXTURE0 + i);
+      context_->bindTexture(GraphicsContext3D::TEXTURE_2D,
+                            plane_texture_handles[i]);
+      context_->texParameteri(GraphicsContext3D::TEXTURE_2D,
+                              GraphicsContext3D::TEXTURE_MIN_FILTER,
+                              GraphicsContext3D::LINEAR);
+      context_->texParameteri(GraphicsContext3D::TEXTURE_2D,
+                              GraphicsContext3D::TEXTURE_MAG_FILTER,
+                              GraphicsContext3D::LINEAR);
+      context_->texParameteri(GraphicsContext3D::TEXTURE_2D,
+                              GraphicsContext3D::TEXTURE_WRAP_S,
+                              GraphicsContext3D::CLAMP_TO_EDGE);
+      context_->texParameteri(GraphicsContext3D::TEXTURE_2D,
+                              GraphicsContext3D::TEXTURE_WRAP_T,
+                              GraphicsContext3D::CLAMP_TO_EDGE);
+    }
+
+    context_->drawArrays(GraphicsContext3D::TRIANGLE_STRIP, 0, 4);
+  }
+
+  // Leave texture unit 0 active, DrawQuadInternal() expects it.
+  context_->activeTexture(GraphicsContext3D::TEXTURE0);
+  context_->deleteBuffer(quad_vbo);
+}
+
 void QuadDrawer::DrawQuadInternal(int texture_handle,
                                   float offset_x, float offset_y,
                                   float scale_x, float scale_y,
@@ -460,4 +604,50 @@ void QuadDrawer::InitializeShaders() {
   context_->useProgram(0);
 }
 
+void QuadDrawer::InitializeYUVShaders() {
+#if LB_QUAD_DRAWER_SUPPORTS_YUV
+  yuv_program_ = context_->createProgram();
+
+  unsigned int vs = context_->createShader(GraphicsContext3D::VERTEX_SHADER);
+  context_->shaderSource(vs, kQuadYUVVertexShaderSource);
+  context_->compileShader(vs);
+
+  unsigned int fs = context_->createShader(GraphicsContext3D::FRAGMENT_SHADER);
+  context_->shaderSource(fs, kQuadYUVFragmentShaderSource);
+  context_->compileShader(fs);
+
+  context_->attachShader(yuv_program_, vs);
+  context_->attachShader(yuv_program_, fs);
+
+  context_->bindAttribLocation(yuv_program_,
+                               kPositionAttrib,
+                               "a_position");
+  context_->bindAttribLocation(yuv_program_,
+                               kTexcoordAttrib,
+                               "a_texCoord");
+
+  context_->linkProgram(yuv_program_);
+  // The program keeps the shaders alive for as long as they are attached.
+  context_->deleteShader(vs);
+  context_->deleteShader(fs);
+
+  yuv_offset_uniform_ = context_->getUniformLocation(yuv_program_, "offset");
+  yuv_scale_uniform_ = context_->getUniformLocation(yuv_program_, "scale");
+  yuv_rotation_uniform_ =
+      context_->getUniformLocation(yuv_program_, "rotation");
+  yuv_matrix_uniform_ =
+      context_->getUniformLocation(yuv_program_, "yuv_matrix");
+  yuv_bias_uniform_ = context_->getUniformLocation(yuv_program_, "yuv_bias");
+
+  // Sample the Y, U and V planes from texture units 0, 1 and 2.
+  context_->useProgram(yuv_program_);
+  context_->uniform1i(context_->getUniformLocation(yuv_program_, "y_tex"), 0);
+  context_->uniform1i(context_->getUniformLocation(yuv_program_, "u_tex"), 1);
+  context_->uniform1i(context_->getUniformLocation(yuv_program_, "v_tex"), 2);
+  context_->useProgram(0);
+#else
+  NOTREACHED();
+#endif  // LB_QUAD_DRAWER_SUPPORTS_YUV
+}
+
 }  // namespace LB
@@ -82,9 +82,19 @@ class ScopedVertexAttribBinding {
 // using the given context.
 class QuadDrawer {
  public:
+  // Matrices used by DrawQuadYUV() to convert limited range YUV to RGB.
+  enum YUVColorSpace {
+    kYUVColorSpaceBT601,
+    kYUVColorSpaceBT709,
+  };
+
   QuadDrawer(LBGraphics* graphics, LBWebGraphicsContext3D* context);
   ~QuadDrawer();
 
+  // Returns true if DrawQuadYUV() is available on this platform.  It needs a
+  // runtime compiled shader, so it is only available on GLSL platforms.
+  static bool SupportsYUV();
+
   // Draws a textured quad centered at the specified offset.  The vertices used
   // are the signed unit square (-1 to 1 along each dimension).  The size of the
   // quad can be adjusted by setting the scale.  Rotation around the center
@@ -112,8 +122,19 @@ class QuadDrawer {
                          float color_mult_r, float color_mult_g,
                          float color_mult_b, float color_mult_a);
 
+  // Draws a quad with the given cropped texture, sampling the Y, U and V
+  // planes of a video frame from three single channel (LUMINANCE) textures
+  // and converting them to RGB in the fragment shader.
+  void DrawQuadYUV(const int plane_texture_handles[3],
+                   float offset_x, float offset_y,
+                   float scale_x, float scale_y,
+                   float rotation_ccw,
+                   const Coord texture_crop_coords[4],
+                   YUVColorSpace color_space);
+
  private:
   void InitializeShaders();
+  void InitializeYUVShaders();
 
   void DrawQuadInternal(int texture_handle,
                         float offset_x, float offset_y,
@@ -134,6 +155,15 @@ class QuadDrawer {
   int color_mult_uniform_;
   int quad_program_;
   int quad_vbo_;
+
+  // Created on the first call to DrawQuadYUV().
+  bool yuv_initialized_;
+  int yuv_offset_uniform_;
+  int yuv_scale_uniform_;
+  int yuv_rotation_uniform_;
+  int yuv_matrix_uniform_;
+  int yuv_bias_uniform_;
+  int yuv_program_;
 };
 int CreatePositionTextureVertexBuffer(LBWebGraphicsContext3D* context);
 void BindPositionTextureVertexBuffer(int buffer_handle,
@@ -23,6 +23,9 @@ typedef struct {
   const char* screenshot_output_path;
   const char* logging_output_path;
   const char* tmp_path;
+  // For caches that should survive the app being relaunched, but which the
+  // system may clear to free up space.
+  const char* cache_path;
   uint32_t lifetime;  // In milliseconds
 } global_values_t;
 
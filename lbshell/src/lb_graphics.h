@@ -22,6 +22,7 @@
 #include "base/callback.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/time.h"
 
 class LBWebGraphicsContext3D;
 class LBWebViewHost;
@@ -49,6 +50,10 @@ class LBGraphics {
   virtual void UpdateAndDrawFrame() = 0;
   // This method will not return until a buffer flip occurs.
   virtual void BlockUntilFlip() = 0;
+  // Returns the time of the last buffer flip, which video presentation uses
+  // to predict when the frame being drawn will be displayed.  Platforms that
+  // don't track their flips return a null time.
+  virtual base::TimeTicks GetLastFlipTime() const { return base::TimeTicks(); }
 
   // show or hide the spinner
   virtual void ShowSpinner() = 0;
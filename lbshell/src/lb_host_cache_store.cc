@@ -0,0 +1,224 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_host_cache_store.h"
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/bind_helpers.h"
+#include "base/logging.h"
+#include "base/string_split.h"
+#include "base/time.h"
+#include "lb_savegame_syncer.h"
+#include "net/base/address_list.h"
+#include "net/base/host_cache.h"
+#include "net/base/host_port_pair.h"
+#include "net/base/host_resolver.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_log.h"
+#include "net/base/net_util.h"
+#include "sql/statement.h"
+
+namespace {
+
+const int kLatestHostCacheSchemaVersion = 1;
+
+// Saved entries only hold addresses, the port is filled in by the request.
+const int kPrefetchPort = 80;
+
+void OnPrefetchComplete(net::AddressList* addresses, int result) {
+  DVLOG(1) << "Host cache prefetch completed: " << net::ErrorToString(result);
+}
+
+std::string AddressListToString(const net::AddressList& addresses) {
+  std::string result;
+  for (size_t i = 0; i < addresses.size(); ++i) {
+    if (i > 0)
+      result += " ";
+    result += net::IPAddressToString(addresses[i].address());
+  }
+  return result;
+}
+
+bool StringToAddressList(const std::string& value,
+                         net::AddressList* addresses) {
+  std::vector<std::string> tokens;
+  base::SplitString(value, ' ', &tokens);
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    net::IPAddressNumber address;
+    if (!net::ParseIPLiteralToNumber(tokens[i], &address))
+      return false;
+    addresses->push_back(net::IPEndPoint(address, 0));
+  }
+  return !addresses->empty();
+}
+
+}  // namespace
+
+// static
+void LBHostCacheStore::Init() {
+  int version = LBSavegameSyncer::GetSchemaVersion("HostCacheTable");
+  if (version == LBSavegameSyncer::kSchemaTableIsNew ||
+      version == LBSavegameSyncer::kSchemaVersionLost) {
+    // The table is only a cache, so it is simply started over.
+    sql::Statement drop_table(LBSavegameSyncer::connection()->
+        GetUniqueStatement("DROP TABLE HostCacheTable"));
+    bool ok = drop_table.Run();
+    DCHECK(ok);
+    version = LBSavegameSyncer::kNoSuchTable;
+  }
+
+  if (version == LBSavegameSyncer::kNoSuchTable) {
+    bool ok = CreateTable(LBSavegameSyncer::connection());
+    DCHECK(ok);
+    LBSavegameSyncer::ReportCreatedTable();
+    LBSavegameSyncer::UpdateSchemaVersion("HostCacheTable",
+                                          kLatestHostCacheSchemaVersion);
+  }
+}
+
+// static
+bool LBHostCacheStore::CreateTable(sql::Connection* conn) {
+  sql::Statement create_table(conn->GetUniqueStatement(
+      "CREATE TABLE HostCacheTable ("
+      "hostname TEXT, "
+      "address_family INTEGER, "
+      "flags INTEGER, "
+      "addresses TEXT, "
+      "expiration INTEGER, "
+      "UNIQUE(hostname, address_family, flags) ON CONFLICT REPLACE)"));
+  return create_table.Run();
+}
+
+// static
+void LBHostCacheStore::Load(net::HostResolver* resolver) {
+  if (!resolver->GetHostCache())
+    return;
+
+  Init();
+  LoadFrom(LBSavegameSyncer::connection(), resolver, base::Time::Now(),
+           base::TimeTicks::Now());
+}
+
+// static
+void LBHostCacheStore::Save(net::HostResolver* resolver) {
+  if (!resolver->GetHostCache())
+    return;
+  // The savegame is reloaded when user data is cleared.
+  if (!LBSavegameSyncer::TimedWaitForLoad(base::TimeDelta()))
+    return;
+
+  Init();
+  SaveTo(LBSavegameSyncer::connection(), resolver, base::Time::Now(),
+         base::TimeTicks::Now());
+}
+
+// static
+void LBHostCacheStore::LoadFrom(sql::Connection* conn,
+                                net::HostResolver* resolver,
+                                const base::Time& now,
+                                const base::TimeTicks& now_ticks) {
+  net::HostCache* cache = resolver->GetHostCache();
+  if (!cache)
+    return;
+
+  int loaded = 0;
+  int prefetched = 0;
+
+  sql::Statement get_all(conn->GetCachedStatement(SQL_FROM_HERE,
+      "SELECT hostname, address_family, flags, addresses, expiration "
+      "FROM HostCacheTable"));
+  while (get_all.Step()) {
+    std::string hostname = get_all.ColumnString(0);
+    net::AddressFamily address_family =
+        static_cast<net::AddressFamily>(get_all.ColumnInt(1));
+    net::HostResolverFlags flags = get_all.ColumnInt(2);
+    base::Time expiration =
+        base::Time::FromInternalValue(get_all.ColumnInt64(4));
+
+    net::AddressList addresses;
+    if (!StringToAddressList(get_all.ColumnString(3), &addresses)) {
+      DLOG(WARNING) << "Dropping bad host cache entry for " << hostname;
+      continue;
+    }
+
+    if (expiration > now) {
+      base::TimeDelta ttl = expiration - now;
+      cache->Set(net::HostCache::Key(hostname, address_family, flags),
+                 net::HostCache::Entry(net::OK, addresses, ttl),
+                 now_ticks, ttl);
+      ++loaded;
+      continue;
+    }
+
+    // Expired addresses are never used, but the host is likely needed again
+    // soon, so look it up alongside everything else starting up.
+    net::HostResolver::RequestInfo info(
+        net::HostPortPair(hostname, kPrefetchPort));
+    info.set_address_family(address_family);
+    info.set_host_resolver_flags(flags);
+    info.set_is_speculative(true);
+    net::AddressList* prefetch_addresses = new net::AddressList;
+    resolver->Resolve(info, prefetch_addresses,
+                      base::Bind(&OnPrefetchComplete,
+                                 base::Owned(prefetch_addresses)),
+                      NULL, net::BoundNetLog());
+    ++prefetched;
+  }
+  DLOG(INFO) << "Host cache: loaded " << loaded << " entries, prefetching "
+             << prefetched << " expired ones.";
+}
+
+// static
+void LBHostCacheStore::SaveTo(sql::Connection* conn,
+                              net::HostResolver* resolver,
+                              const base::Time& now,
+                              const base::TimeTicks& now_ticks) {
+  net::HostCache* cache = resolver->GetHostCache();
+  if (!cache)
+    return;
+
+  sql::Statement delete_all(conn->GetCachedStatement(SQL_FROM_HERE,
+      "DELETE FROM HostCacheTable"));
+  bool ok = delete_all.Run();
+  DCHECK(ok);
+
+  // The cache expires entries in TimeTicks, which don't carry over to the
+  // next launch.
+  for (net::HostCache::EntryMap::Iterator it(cache->entries()); it.HasNext();
+       it.Advance()) {
+    const net::HostCache::Entry& entry = it.value();
+    if (entry.error != net::OK || entry.addrlist.empty())
+      continue;
+
+    // Expired entries are saved too, so that their hosts are looked up early
+    // on the next launch.
+    base::Time expiration = now + (it.expiration() - now_ticks);
+    sql::Statement insert_entry(conn->GetCachedStatement(SQL_FROM_HERE,
+        "INSERT INTO HostCacheTable ("
+        "hostname, address_family, flags, addresses, expiration"
+        ") VALUES (?, ?, ?, ?, ?)"));
+    insert_entry.BindString(0, it.key().hostname);
+    insert_entry.BindInt(1, it.key().address_family);
+    insert_entry.BindInt(2, it.key().host_resolver_flags);
+    insert_entry.BindString(3, AddressListToString(entry.addrlist));
+    insert_entry.BindInt64(4, expiration.ToInternalValue());
+    ok = insert_entry.Run();
+    DCHECK(ok);
+  }
+}
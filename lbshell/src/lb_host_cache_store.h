@@ -0,0 +1,66 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Persists the host resolver's cache on top of LBSavegameSyncer and sqlite,
+// so that the hosts the app talks to are known before its first request.
+
+#ifndef SRC_LB_HOST_CACHE_STORE_H_
+#define SRC_LB_HOST_CACHE_STORE_H_
+
+#include "base/basictypes.h"
+#include "base/time.h"
+
+namespace net {
+class HostResolver;
+}
+
+namespace sql {
+class Connection;
+}
+
+class LBHostCacheStore {
+ public:
+  // Fills the cache of |resolver| with the saved entries that have not
+  // expired yet, and starts resolving the hosts of the expired ones again so
+  // that they are cached by the time they are needed.  The savegame must
+  // have been loaded.
+  static void Load(net::HostResolver* resolver);
+
+  // Replaces the saved entries with the successful lookups in the cache of
+  // |resolver|, to be written out by the next LBSavegameSyncer::ForceSync().
+  // Does nothing while the savegame is being loaded.
+  static void Save(net::HostResolver* resolver);
+
+  // Creates the table entries are saved in on |conn|.
+  static bool CreateTable(sql::Connection* conn);
+
+  // The work of Load() and Save() on the table in |conn|, taking |now| and
+  // |now_ticks| as the current time.  Exposed for tests.
+  static void LoadFrom(sql::Connection* conn,
+                       net::HostResolver* resolver,
+                       const base::Time& now,
+                       const base::TimeTicks& now_ticks);
+  static void SaveTo(sql::Connection* conn,
+                     net::HostResolver* resolver,
+                     const base::Time& now,
+                     const base::TimeTicks& now_ticks);
+
+ private:
+  static void Init();
+
+  DISALLOW_IMPLICIT_CONSTRUCTORS(LBHostCacheStore);
+};
+
+#endif  // SRC_LB_HOST_CACHE_STORE_H_
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_host_cache_store.h"
+
+#include "base/time.h"
+#include "external/chromium/testing/gtest/include/gtest/gtest.h"
+#include "net/base/address_list.h"
+#include "net/base/host_cache.h"
+#include "net/base/mock_host_resolver.h"
+#include "net/base/net_errors.h"
+#include "net/base/net_util.h"
+#include "sql/connection.h"
+#include "sql/statement.h"
+
+namespace {
+
+net::HostCache::Key MakeKey(const std::string& hostname) {
+  return net::HostCache::Key(hostname, net::ADDRESS_FAMILY_UNSPECIFIED, 0);
+}
+
+net::AddressList MakeAddressList(const char* address) {
+  net::IPAddressNumber number;
+  EXPECT_TRUE(net::ParseIPLiteralToNumber(address, &number));
+  return net::AddressList::CreateFromIPAddress(number, 0);
+}
+
+class LBHostCacheStoreTest : public testing::Test {
+ protected:
+  virtual void SetUp() OVERRIDE {
+    ASSERT_TRUE(db_.OpenInMemory());
+    ASSERT_TRUE(LBHostCacheStore::CreateTable(&db_));
+    now_ = base::Time::Now();
+    now_ticks_ = base::TimeTicks::Now();
+  }
+
+  void InsertRow(const std::string& hostname,
+                 const std::string& addresses,
+                 const base::Time& expiration) {
+    sql::Statement insert(db_.GetUniqueStatement(
+        "INSERT INTO HostCacheTable ("
+        "hostname, address_family, flags, addresses, expiration"
+        ") VALUES (?, ?, 0, ?, ?)"));
+    insert.BindString(0, hostname);
+    insert.BindInt(1, net::ADDRESS_FAMILY_UNSPECIFIED);
+    insert.BindString(2, addresses);
+    insert.BindInt64(3, expiration.ToInternalValue());
+    ASSERT_TRUE(insert.Run());
+  }
+
+  int CountRows() {
+    sql::Statement count(db_.GetUniqueStatement(
+        "SELECT COUNT(*) FROM HostCacheTable"));
+    EXPECT_TRUE(count.Step());
+    return count.ColumnInt(0);
+  }
+
+  sql::Connection db_;
+  base::Time now_;
+  base::TimeTicks now_ticks_;
+};
+
+}  // namespace
+
+TEST_F(LBHostCacheStoreTest, RoundTripKeepsRemainingTTL) {
+  net::MockCachingHostResolver saving_resolver;
+  net::HostCache* saving_cache = saving_resolver.GetHostCache();
+  const base::TimeDelta ttl = base::TimeDelta::FromSeconds(60);
+  saving_cache->Set(MakeKey("a.example"),
+                    net::HostCache::Entry(net::OK, MakeAddressList("10.0.0.1")),
+                    now_ticks_, ttl);
+  saving_cache->Set(MakeKey("failed.example"),
+                    net::HostCache::Entry(net::ERR_NAME_NOT_RESOLVED,
+                                          net::AddressList()),
+                    now_ticks_, ttl);
+  LBHostCacheStore::SaveTo(&db_, &saving_resolver, now_, now_ticks_);
+  // Failed lookups are not worth keeping.
+  EXPECT_EQ(1, CountRows());
+
+  // The next launch is 20 seconds later, on a clock of ticks that has
+  // nothing to do with the last one.
+  const base::TimeDelta elapsed = base::TimeDelta::FromSeconds(20);
+  base::TimeTicks load_ticks =
+      now_ticks_ + base::TimeDelta::FromDays(1);
+  net::MockCachingHostResolver loading_resolver;
+  LBHostCacheStore::LoadFrom(&db_, &loading_resolver, now_ + elapsed,
+                             load_ticks);
+  net::HostCache* cache = loading_resolver.GetHostCache();
+  EXPECT_EQ(1U, cache->size());
+
+  const net::HostCache::Entry* entry =
+      cache->Lookup(MakeKey("a.example"), load_ticks);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(net::OK, entry->error);
+  ASSERT_EQ(1U, entry->addrlist.size());
+  EXPECT_EQ("10.0.0.1",
+            net::IPAddressToString(entry->addrlist[0].address()));
+
+  // Only what was left of the TTL carries over.
+  base::TimeDelta remaining = ttl - elapsed;
+  EXPECT_TRUE(cache->Lookup(MakeKey("a.example"), load_ticks + remaining -
+                            base::TimeDelta::FromSeconds(1)));
+  EXPECT_FALSE(cache->Lookup(MakeKey("a.example"), load_ticks + remaining +
+                             base::TimeDelta::FromSeconds(1)));
+}
+
+TEST_F(LBHostCacheStoreTest, SaveReplacesPreviousEntries) {
+  InsertRow("old.example", "10.0.0.2", now_ + base::TimeDelta::FromHours(1));
+
+  net::MockCachingHostResolver resolver;
+  resolver.GetHostCache()->Set(
+      MakeKey("new.example"),
+      net::HostCache::Entry(net::OK, MakeAddressList("10.0.0.3")),
+      now_ticks_, base::TimeDelta::FromSeconds(60));
+  LBHostCacheStore::SaveTo(&db_, &resolver, now_, now_ticks_);
+  EXPECT_EQ(1, CountRows());
+
+  net::MockCachingHostResolver loading_resolver;
+  LBHostCacheStore::LoadFrom(&db_, &loading_resolver, now_, now_ticks_);
+  net::HostCache* cache = loading_resolver.GetHostCache();
+  EXPECT_FALSE(cache->Lookup(MakeKey("old.example"), now_ticks_));
+  EXPECT_TRUE(cache->Lookup(MakeKey("new.example"), now_ticks_));
+}
+
+TEST_F(LBHostCacheStoreTest, ExpiredEntriesAreResolvedAgain) {
+  InsertRow("expired.example", "10.0.0.4",
+            now_ - base::TimeDelta::FromSeconds(1));
+
+  net::MockCachingHostResolver resolver;
+  resolver.set_synchronous_mode(true);
+  resolver.rules()->AddRule("expired.example", "10.0.0.5");
+  LBHostCacheStore::LoadFrom(&db_, &resolver, now_, now_ticks_);
+
+  // The saved address is never used, the cached one comes from the new
+  // lookup.
+  const net::HostCache::Entry* entry = resolver.GetHostCache()->Lookup(
+      MakeKey("expired.example"), base::TimeTicks::Now());
+  ASSERT_TRUE(entry);
+  ASSERT_EQ(1U, entry->addrlist.size());
+  EXPECT_EQ("10.0.0.5",
+            net::IPAddressToString(entry->addrlist[0].address()));
+}
+
+TEST_F(LBHostCacheStoreTest, BadRowsAreDropped) {
+  const base::Time expiration = now_ + base::TimeDelta::FromHours(1);
+  InsertRow("empty.example", "", expiration);
+  InsertRow("garbage.example", "10.0.0.6 not-an-address", expiration);
+  InsertRow("good.example", "10.0.0.7 ::1", expiration);
+
+  net::MockCachingHostResolver resolver;
+  LBHostCacheStore::LoadFrom(&db_, &resolver, now_, now_ticks_);
+  net::HostCache* cache = resolver.GetHostCache();
+  EXPECT_EQ(1U, cache->size());
+  EXPECT_FALSE(cache->Lookup(MakeKey("empty.example"), now_ticks_));
+  EXPECT_FALSE(cache->Lookup(MakeKey("garbage.example"), now_ticks_));
+
+  const net::HostCache::Entry* entry =
+      cache->Lookup(MakeKey("good.example"), now_ticks_);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(2U, entry->addrlist.size());
+}
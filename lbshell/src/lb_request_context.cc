@@ -19,6 +19,7 @@
 #include "lb_request_context.h"
 
 #include "build/build_config.h"
+#include "base/bind.h"
 #include "base/command_line.h"
 #include "base/compiler_specific.h"
 #include "base/file_path.h"
@@ -31,7 +32,10 @@
 #include "net/base/ssl_config_service_defaults.h"
 #include "net/cookies/cookie_monster.h"
 #include "net/http/http_auth_handler_factory.h"
+#include "net/http/http_cache.h"
 #include "net/http/http_network_session.h"
+#include "net/http/http_request_info.h"
+#include "net/http/http_stream_factory.h"
 #include "net/http/http_server_properties_impl.h"
 #include "net/proxy/proxy_config_service.h"
 #include "net/proxy/proxy_config_service_fixed.h"
@@ -49,20 +53,36 @@
 #endif
 
 #include "chromium/net/proxy/proxy_config_service_shell.h"
+#include "lb_globals.h"
+#include "lb_host_cache_store.h"
 #include "lb_network_helpers.h"
 #include "lb_resource_loader_bridge.h"
+#include "lb_savegame_syncer.h"
 #include "lb_shell_switches.h"
 #include "lb_webblobregistry_impl.h"
 
+namespace {
+
+const FilePath::CharType kHttpCacheDirectory[] =
+    FILE_PATH_LITERAL("http_cache");
+const int kHttpCacheSize = 16 * 1024 * 1024;
+
+// How often the host cache is written in to the savegame.
+const int kHostCacheSaveIntervalSeconds = 60;
+
+}  // namespace
+
 LBRequestContext::LBRequestContext()
-    : ALLOW_THIS_IN_INITIALIZER_LIST(storage_(this)) {
+    : ALLOW_THIS_IN_INITIALIZER_LIST(storage_(this))
+    , ALLOW_THIS_IN_INITIALIZER_LIST(weak_ptr_factory_(this)) {
   Init(NULL, false);
 }
 
 LBRequestContext::LBRequestContext(
     net::CookieMonster::PersistentCookieStore *persistent_cookie_store,
     bool no_proxy)
-    : ALLOW_THIS_IN_INITIALIZER_LIST(storage_(this)) {
+    : ALLOW_THIS_IN_INITIALIZER_LIST(storage_(this))
+    , ALLOW_THIS_IN_INITIALIZER_LIST(weak_ptr_factory_(this)) {
   Init(persistent_cookie_store, no_proxy);
 }
 
@@ -107,6 +127,17 @@ void LBRequestContext::Init(
   options.enable_caching = true;
   storage_.set_host_resolver(
       net::HostResolver::CreateSystemResolver(options, NULL));
+  // Start from the lookups of the last launch.  The host cache is kept in
+  // the savegame along with the cookies, so contexts without a persistent
+  // cookie store don't have one.  The savegame may still be loading, which
+  // is waited for off the I/O thread so that requests can start meanwhile.
+  if (persistent_cookie_store_) {
+    base::WorkerPool::PostTaskAndReply(FROM_HERE,
+        base::Bind(&LBSavegameSyncer::WaitForLoad),
+        base::Bind(&LBRequestContext::OnSavegameLoaded,
+                   weak_ptr_factory_.GetWeakPtr()),
+        true /* task_is_slow */);
+  }
 
   storage_.set_cert_verifier(new net::MultiThreadedCertVerifier(
       net::CertVerifyProc::CreateDefault()));
@@ -140,10 +171,15 @@ void LBRequestContext::Init(
 #endif
 
 #if !__LB_ENABLE_NATIVE_HTTP_STACK__
-  // disable caching
-  net::HttpCache::DefaultBackend* backend = NULL;
+  // The cache is kept in the persistent cache directory so that it survives
+  // restarts of the app, and the app's own scripts, styles and images aren't
+  // downloaded again on every launch.
+  FilePath cache_path =
+      FilePath(GetGlobalsPtr()->cache_path).Append(kHttpCacheDirectory);
+  net::HttpCache::DefaultBackend* backend =
+      new net::HttpCache::DefaultBackend(net::DISK_CACHE, cache_path,
+                                         kHttpCacheSize, NULL);
   net::HttpCache* cache = new net::HttpCache(params, backend);
-  cache->set_mode(net::HttpCache::DISABLE);
   storage_.set_http_transaction_factory(cache);
 #else
   net::HttpTransactionFactory* transaction_factory =
@@ -160,6 +196,37 @@ void LBRequestContext::ResetCookieMonster() {
       new net::CookieMonster(persistent_cookie_store_, NULL));
 }
 
+void LBRequestContext::Preconnect(const GURL& url, int num_streams) {
+  if (!url.is_valid() || !(url.SchemeIs("http") || url.SchemeIs("https")))
+    return;
+  // The native HTTP stack has no socket pools to warm up.
+  net::HttpNetworkSession* session = http_transaction_factory()->GetSession();
+  if (!session)
+    return;
+
+  net::HttpRequestInfo request_info;
+  request_info.url = url;
+  request_info.method = "GET";
+  request_info.motivation = net::HttpRequestInfo::PRECONNECT_MOTIVATED;
+  request_info.priority = net::LOWEST;
+
+  net::SSLConfig ssl_config;
+  session->ssl_config_service()->GetSSLConfig(&ssl_config);
+  session->http_stream_factory()->PreconnectStreams(
+      num_streams, request_info, ssl_config, ssl_config);
+}
+
+void LBRequestContext::OnSavegameLoaded() {
+  LBHostCacheStore::Load(host_resolver());
+  host_cache_save_timer_.Start(FROM_HERE,
+      base::TimeDelta::FromSeconds(kHostCacheSaveIntervalSeconds),
+      this, &LBRequestContext::SaveHostCache);
+}
+
+void LBRequestContext::SaveHostCache() {
+  LBHostCacheStore::Save(host_resolver());
+}
+
 LBRequestContext::~LBRequestContext() {
   if (blob_storage_controller_) {
     // LBRequestContext must be destroyed on the I/O thread
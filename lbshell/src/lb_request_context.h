@@ -19,7 +19,10 @@
 #ifndef SRC_LB_REQUEST_CONTEXT_H_
 #define SRC_LB_REQUEST_CONTEXT_H_
 
+#include "base/memory/weak_ptr.h"
 #include "base/threading/thread.h"
+#include "base/timer.h"
+#include "googleurl/src/gurl.h"
 #include "net/cookies/cookie_monster.h"
 #include "net/url_request/url_request_context.h"
 #include "net/url_request/url_request_context_storage.h"
@@ -51,14 +54,27 @@ class LBRequestContext : public net::URLRequestContext {
   // flushed to storage.
   void ResetCookieMonster();
 
+  // Opens |num_streams| connections to the origin of |url| and leaves them
+  // idle in the socket pools, so that the next requests to it don't have to
+  // wait for DNS, TCP or SSL handshakes.
+  void Preconnect(const GURL& url, int num_streams);
+
  private:
   void Init(net::CookieMonster::PersistentCookieStore *persistent_cookie_store,
             bool no_proxy);
+  // Fills the host cache from the savegame once it has loaded, and starts
+  // saving it back periodically.
+  void OnSavegameLoaded();
+  void SaveHostCache();
 
   net::URLRequestContextStorage storage_;
   scoped_ptr<webkit_blob::BlobStorageController> blob_storage_controller_;
   scoped_refptr<net::CookieMonster::PersistentCookieStore>
       persistent_cookie_store_;
+  // The savegame is only written by the app's syncs, so the host cache is
+  // written in to it while the app runs rather than on shutdown.
+  base::RepeatingTimer<LBRequestContext> host_cache_save_timer_;
+  base::WeakPtrFactory<LBRequestContext> weak_ptr_factory_;
 };
 
 #endif  // SRC_LB_REQUEST_CONTEXT_H_
@@ -0,0 +1,224 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_request_scheduler.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "net/base/load_flags.h"
+
+namespace LB {
+
+const int RequestScheduler::kMaxMediaRequests;
+const int RequestScheduler::kMaxDelayableRequests;
+const int RequestScheduler::kMaxBackgroundRequestsPerHost;
+const int RequestScheduler::kMaxBackgroundRequestsWhileMediaBufferLow;
+
+RequestScheduler::Stats::Stats()
+    : started_requests(0)
+    , queued_requests(0) {
+}
+
+RequestScheduler::RequestScheduler()
+    : running_media_requests_(0)
+    , running_delayable_requests_(0)
+    , running_background_requests_(0)
+    , media_buffer_low_(false) {
+}
+
+RequestScheduler::~RequestScheduler() {
+  DLOG_IF(WARNING, !requests_.empty())
+      << requests_.size() << " requests still scheduled";
+}
+
+// static
+RequestScheduler::Priority RequestScheduler::GetPriority(
+    ResourceType::Type type, int load_flags) {
+  if (load_flags & net::LOAD_IGNORE_LIMITS)
+    return kPriorityCritical;
+  if (load_flags & net::LOAD_PREFETCH)
+    return kPriorityBackground;
+
+  switch (type) {
+    case ResourceType::MAIN_FRAME:
+    case ResourceType::SUB_FRAME:
+    case ResourceType::STYLESHEET:
+    case ResourceType::SCRIPT:
+    case ResourceType::FONT_RESOURCE:
+    case ResourceType::WORKER:
+    case ResourceType::SHARED_WORKER:
+      return kPriorityCritical;
+    case ResourceType::MEDIA:
+      return kPriorityMedia;
+    case ResourceType::IMAGE:
+    case ResourceType::PREFETCH:
+    case ResourceType::FAVICON:
+      return kPriorityBackground;
+    default:
+      return kPriorityNormal;
+  }
+}
+
+// static
+net::RequestPriority RequestScheduler::GetNetPriority(Priority priority) {
+  switch (priority) {
+    case kPriorityCritical:
+      return net::HIGHEST;
+    case kPriorityMedia:
+      return net::MEDIUM;
+    case kPriorityNormal:
+      return net::LOW;
+    case kPriorityBackground:
+      return net::IDLE;
+    default:
+      NOTREACHED();
+      return net::LOWEST;
+  }
+}
+
+void RequestScheduler::AddRequest(Request* request, Priority priority,
+                                  const std::string& host) {
+  DCHECK_GE(priority, 0);
+  DCHECK_LT(priority, kNumPriorities);
+  DCHECK(requests_.find(request) == requests_.end());
+
+  RequestInfo& info = requests_[request];
+  info.priority = priority;
+  info.host = host;
+  info.running = false;
+
+  if (queues_[priority].empty() && CanStart(info)) {
+    Start(request, &info);
+    return;
+  }
+
+  // Requests that were queued before this one go first, unless they are
+  // held back by limits that don't apply to this one.
+  info.queue_time = base::TimeTicks::Now();
+  queues_[priority].push_back(request);
+  if (CanStart(info))
+    StartQueuedRequests();
+}
+
+void RequestScheduler::RemoveRequest(Request* request) {
+  RequestMap::iterator it = requests_.find(request);
+  if (it == requests_.end())
+    return;
+
+  const RequestInfo& info = it->second;
+  if (info.running) {
+    if (info.priority == kPriorityMedia)
+      --running_media_requests_;
+    if (info.priority >= kPriorityNormal)
+      --running_delayable_requests_;
+    if (info.priority == kPriorityBackground) {
+      --running_background_requests_;
+      if (--running_background_requests_per_host_[info.host] == 0)
+        running_background_requests_per_host_.erase(info.host);
+    }
+  } else {
+    std::deque<Request*>& queue = queues_[info.priority];
+    queue.erase(std::find(queue.begin(), queue.end(), request));
+  }
+  requests_.erase(it);
+
+  StartQueuedRequests();
+}
+
+void RequestScheduler::SetMediaBufferLow(bool low) {
+  if (media_buffer_low_ == low)
+    return;
+  media_buffer_low_ = low;
+  if (!low)
+    StartQueuedRequests();
+}
+
+bool RequestScheduler::CanStart(const RequestInfo& info) const {
+  if (info.priority == kPriorityCritical)
+    return true;
+  if (info.priority == kPriorityMedia)
+    return running_media_requests_ < kMaxMediaRequests;
+  if (running_delayable_requests_ >= kMaxDelayableRequests)
+    return false;
+  if (info.priority < kPriorityBackground)
+    return true;
+
+  if (media_buffer_low_ &&
+      running_background_requests_ >=
+          kMaxBackgroundRequestsWhileMediaBufferLow) {
+    return false;
+  }
+  std::map<std::string, int>::const_iterator host =
+      running_background_requests_per_host_.find(info.host);
+  return host == running_background_requests_per_host_.end() ||
+         host->second < kMaxBackgroundRequestsPerHost;
+}
+
+void RequestScheduler::Start(Request* request, RequestInfo* info) {
+  DCHECK(!info->running);
+  info->running = true;
+  if (info->priority == kPriorityMedia)
+    ++running_media_requests_;
+  if (info->priority >= kPriorityNormal)
+    ++running_delayable_requests_;
+  if (info->priority == kPriorityBackground) {
+    ++running_background_requests_;
+    ++running_background_requests_per_host_[info->host];
+  }
+
+  Stats& stats = stats_[info->priority];
+  ++stats.started_requests;
+  if (!info->queue_time.is_null()) {
+    base::TimeDelta delay = base::TimeTicks::Now() - info->queue_time;
+    ++stats.queued_requests;
+    stats.total_queue_delay += delay;
+    stats.max_queue_delay = std::max(stats.max_queue_delay, delay);
+  }
+
+  // The request may remove itself from within the callback, so |info| must
+  // not be used past this point.
+  request->OnRequestScheduled();
+}
+
+void RequestScheduler::StartQueuedRequests() {
+  for (int priority = kPriorityMedia; priority < kNumPriorities;
+       ++priority) {
+    std::deque<Request*>& queue = queues_[priority];
+    // Background requests held back by the per host limit don't hold back
+    // the ones to other hosts, so the whole queue is looked at.
+    size_t i = 0;
+    while (i < queue.size()) {
+      Request* request = queue[i];
+      RequestInfo& info = requests_[request];
+      if (!CanStart(info)) {
+        ++i;
+        continue;
+      }
+      queue.erase(queue.begin() + i);
+      Start(request, &info);
+      // Starting may have added or removed requests, so look again from the
+      // front.
+      i = 0;
+    }
+    // Lower priorities wait for all of the higher priority requests that are
+    // only waiting for a free slot.
+    if (running_delayable_requests_ >= kMaxDelayableRequests)
+      return;
+  }
+}
+
+}  // namespace LB
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SRC_LB_REQUEST_SCHEDULER_H_
+#define SRC_LB_REQUEST_SCHEDULER_H_
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "base/basictypes.h"
+#include "base/time.h"
+#include "net/base/request_priority.h"
+#include "webkit/glue/resource_type.h"
+
+namespace LB {
+
+// Decides when the requests made by the resource loader bridge may start.
+// Requests that block rendering always start right away.  Media downloads
+// have slots of their own, so that they neither wait for nor take slots from
+// the other requests.  Everything else, XHRs included, is delayable: only a
+// limited number of delayable requests run at once, and background requests
+// such as images and prefetches are further limited per host and held back
+// while a playing video is short of data.
+// Queued requests start in priority order, then in the order they were added.
+// Must only be used on the IO thread.
+class RequestScheduler {
+ public:
+  enum Priority {
+    // Documents, stylesheets, scripts, fonts and synchronous loads.
+    kPriorityCritical,
+    // Media downloads.
+    kPriorityMedia,
+    // Anything else WebKit asks for.
+    kPriorityNormal,
+    // Images, prefetches and favicons.
+    kPriorityBackground,
+    kNumPriorities
+  };
+
+  // Media requests running at once.  A playing video uses one, the others
+  // let more videos preload.
+  static const int kMaxMediaRequests = 4;
+  // Delayable requests running at once, across all hosts.
+  static const int kMaxDelayableRequests = 10;
+  // Background requests running at once to the same host.
+  static const int kMaxBackgroundRequestsPerHost = 4;
+  // Background requests running at once while the media buffer is low.  One
+  // is let through so that they can't be starved by a stalled video.
+  static const int kMaxBackgroundRequestsWhileMediaBufferLow = 1;
+
+  class Request {
+   public:
+    // Called once the request may start, possibly from within AddRequest().
+    virtual void OnRequestScheduled() = 0;
+
+   protected:
+    virtual ~Request() {}
+  };
+
+  struct Stats {
+    Stats();
+
+    // Requests of the class that have been started.
+    int64 started_requests;
+    // Those of them that had to wait in the queue.
+    int64 queued_requests;
+    // Time spent in the queue, summed over all started requests.
+    base::TimeDelta total_queue_delay;
+    base::TimeDelta max_queue_delay;
+  };
+
+  RequestScheduler();
+  ~RequestScheduler();
+
+  // Maps the type of a request and the hints in its load flags to a
+  // priority class.  LOAD_IGNORE_LIMITS makes a request critical and
+  // LOAD_PREFETCH makes it a background request.
+  static Priority GetPriority(ResourceType::Type type, int load_flags);
+
+  // The priority given to the network stack for requests of |priority|.
+  static net::RequestPriority GetNetPriority(Priority priority);
+
+  // Schedules |request|, which runs until it is passed to RemoveRequest().
+  // |host| is the host the request is sent to.
+  void AddRequest(Request* request, Priority priority,
+                  const std::string& host);
+
+  // Forgets |request|, whether it is still queued or running, and starts the
+  // queued requests this makes room for.
+  void RemoveRequest(Request* request);
+
+  // Holds background requests back while |low| is true.
+  void SetMediaBufferLow(bool low);
+
+  const Stats& stats(Priority priority) const { return stats_[priority]; }
+  bool media_buffer_low() const { return media_buffer_low_; }
+
+ private:
+  struct RequestInfo {
+    Priority priority;
+    std::string host;
+    bool running;
+    // When the request was queued, null if it started right away.
+    base::TimeTicks queue_time;
+  };
+  typedef std::map<Request*, RequestInfo> RequestMap;
+
+  bool CanStart(const RequestInfo& info) const;
+  void Start(Request* request, RequestInfo* info);
+  void StartQueuedRequests();
+
+  RequestMap requests_;
+  // Queued requests of each priority class, oldest first.
+  std::deque<Request*> queues_[kNumPriorities];
+
+  int running_media_requests_;
+  int running_delayable_requests_;
+  int running_background_requests_;
+  std::map<std::string, int> running_background_requests_per_host_;
+  bool media_buffer_low_;
+
+  Stats stats_[kNumPriorities];
+
+  DISALLOW_COPY_AND_ASSIGN(RequestScheduler);
+};
+
+}  // namespace LB
+
+#endif  // SRC_LB_REQUEST_SCHEDULER_H_
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_request_scheduler.h"
+
+#include "base/compiler_specific.h"
+#include "base/memory/scoped_vector.h"
+#include "external/chromium/testing/gtest/include/gtest/gtest.h"
+#include "net/base/load_flags.h"
+
+namespace {
+
+using LB::RequestScheduler;
+
+class TestRequest : public RequestScheduler::Request {
+ public:
+  TestRequest() : started_(false) {}
+  virtual ~TestRequest() {}
+
+  virtual void OnRequestScheduled() OVERRIDE {
+    EXPECT_FALSE(started_);
+    started_ = true;
+  }
+
+  bool started() const { return started_; }
+
+ private:
+  bool started_;
+};
+
+// Adds |count| requests of |priority| to |host|, and returns the first one.
+TestRequest* AddRequests(RequestScheduler* scheduler,
+                         ScopedVector<TestRequest>* requests,
+                         RequestScheduler::Priority priority,
+                         const std::string& host, int count) {
+  size_t first = requests->size();
+  for (int i = 0; i < count; ++i) {
+    requests->push_back(new TestRequest);
+    scheduler->AddRequest(requests->back(), priority, host);
+  }
+  return (*requests)[first];
+}
+
+int CountStarted(const ScopedVector<TestRequest>& requests) {
+  int started = 0;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (requests[i]->started())
+      ++started;
+  }
+  return started;
+}
+
+}  // namespace
+
+TEST(RequestSchedulerTest, Priorities) {
+  EXPECT_EQ(RequestScheduler::kPriorityCritical,
+            RequestScheduler::GetPriority(ResourceType::SCRIPT, 0));
+  EXPECT_EQ(RequestScheduler::kPriorityMedia,
+            RequestScheduler::GetPriority(ResourceType::MEDIA, 0));
+  EXPECT_EQ(RequestScheduler::kPriorityNormal,
+            RequestScheduler::GetPriority(ResourceType::XHR, 0));
+  EXPECT_EQ(RequestScheduler::kPriorityNormal,
+            RequestScheduler::GetPriority(ResourceType::OBJECT, 0));
+  EXPECT_EQ(RequestScheduler::kPriorityBackground,
+            RequestScheduler::GetPriority(ResourceType::IMAGE, 0));
+  EXPECT_EQ(RequestScheduler::kPriorityBackground,
+            RequestScheduler::GetPriority(ResourceType::PREFETCH, 0));
+  EXPECT_EQ(RequestScheduler::kPriorityBackground,
+            RequestScheduler::GetPriority(ResourceType::XHR,
+                                          net::LOAD_PREFETCH));
+  EXPECT_EQ(RequestScheduler::kPriorityCritical,
+            RequestScheduler::GetPriority(ResourceType::IMAGE,
+                                          net::LOAD_IGNORE_LIMITS));
+}
+
+TEST(RequestSchedulerTest, CriticalRequestsAreNeverQueued) {
+  RequestScheduler scheduler;
+  ScopedVector<TestRequest> requests;
+  AddRequests(&scheduler, &requests, RequestScheduler::kPriorityNormal,
+              "a.com", RequestScheduler::kMaxDelayableRequests);
+  scheduler.SetMediaBufferLow(true);
+  AddRequests(&scheduler, &requests, RequestScheduler::kPriorityCritical,
+              "a.com", 20);
+  EXPECT_EQ(static_cast<int>(requests.size()), CountStarted(requests));
+  EXPECT_EQ(0, scheduler.stats(RequestScheduler::kPriorityCritical)
+                   .queued_requests);
+
+  for (size_t i = 0; i < requests.size(); ++i)
+    scheduler.RemoveRequest(requests[i]);
+}
+
+TEST(RequestSchedulerTest, MediaRequestsHaveTheirOwnSlots) {
+  RequestScheduler scheduler;
+  ScopedVector<TestRequest> requests;
+  // Delayable requests don't hold media requests back.
+  AddRequests(&scheduler, &requests, RequestScheduler::kPriorityNormal,
+              "a.com", RequestScheduler::kMaxDelayableRequests);
+  scheduler.SetMediaBufferLow(true);
+  TestRequest* first = AddRequests(
+      &scheduler, &requests, RequestScheduler::kPriorityMedia, "a.com",
+      RequestScheduler::kMaxMediaRequests);
+  TestRequest* queued = AddRequests(
+      &scheduler, &requests, RequestScheduler::kPriorityMedia, "a.com", 1);
+  EXPECT_EQ(RequestScheduler::kMaxDelayableRequests +
+                RequestScheduler::kMaxMediaRequests,
+            CountStarted(requests));
+  EXPECT_FALSE(queued->started());
+
+  // Nor do media requests take slots from delayable ones.
+  TestRequest* normal = AddRequests(
+      &scheduler, &requests, RequestScheduler::kPriorityNormal, "a.com", 1);
+  scheduler.RemoveRequest(requests[0]);
+  EXPECT_TRUE(normal->started());
+  EXPECT_FALSE(queued->started());
+
+  scheduler.RemoveRequest(first);
+  EXPECT_TRUE(queued->started());
+  EXPECT_EQ(1, scheduler.stats(RequestScheduler::kPriorityMedia)
+                   .queued_requests);
+
+  for (size_t i = 1; i < requests.size(); ++i) {
+    if (requests[i] != first)
+      scheduler.RemoveRequest(requests[i]);
+  }
+}
+
+TEST(RequestSchedulerTest, DelayableRequestsStartInPriorityOrder) {
+  RequestScheduler scheduler;
+  ScopedVector<TestRequest> running;
+  AddRequests(&scheduler, &running, RequestScheduler::kPriorityNormal,
+              "a.com", RequestScheduler::kMaxDelayableRequests);
+  EXPECT_EQ(RequestScheduler::kMaxDelayableRequests, CountStarted(running));
+
+  ScopedVector<TestRequest> queued;
+  TestRequest* background = AddRequests(
+      &scheduler, &queued, RequestScheduler::kPriorityBackground, "b.com", 1);
+  TestRequest* normal = AddRequests(
+      &scheduler, &queued, RequestScheduler::kPriorityNormal, "b.com", 1);
+  EXPECT_EQ(0, CountStarted(queued));
+
+  scheduler.RemoveRequest(running[0]);
+  EXPECT_TRUE(normal->started());
+  EXPECT_FALSE(background->started());
+  scheduler.RemoveRequest(running[1]);
+  EXPECT_TRUE(background->started());
+
+  const RequestScheduler::Stats& stats =
+      scheduler.stats(RequestScheduler::kPriorityNormal);
+  EXPECT_EQ(RequestScheduler::kMaxDelayableRequests + 1,
+            stats.started_requests);
+  EXPECT_EQ(1, stats.queued_requests);
+
+  for (size_t i = 2; i < running.size(); ++i)
+    scheduler.RemoveRequest(running[i]);
+  for (size_t i = 0; i < queued.size(); ++i)
+    scheduler.RemoveRequest(queued[i]);
+}
+
+TEST(RequestSchedulerTest, BackgroundRequestsAreLimitedPerHost) {
+  RequestScheduler scheduler;
+  ScopedVector<TestRequest> requests;
+  TestRequest* first = AddRequests(
+      &scheduler, &requests, RequestScheduler::kPriorityBackground, "a.com",
+      RequestScheduler::kMaxBackgroundRequestsPerHost + 1);
+  TestRequest* other_host = AddRequests(
+      &scheduler, &requests, RequestScheduler::kPriorityBackground, "b.com",
+      1);
+  EXPECT_EQ(RequestScheduler::kMaxBackgroundRequestsPerHost + 1,
+            CountStarted(requests));
+  EXPECT_TRUE(other_host->started());
+  EXPECT_FALSE(requests[RequestScheduler::kMaxBackgroundRequestsPerHost]->
+                   started());
+
+  scheduler.RemoveRequest(first);
+  EXPECT_TRUE(requests[RequestScheduler::kMaxBackgroundRequestsPerHost]->
+                  started());
+
+  for (size_t i = 1; i < requests.size(); ++i)
+    scheduler.RemoveRequest(requests[i]);
+}
+
+TEST(RequestSchedulerTest, LowMediaBufferHoldsBackgroundRequests) {
+  RequestScheduler scheduler;
+  scheduler.SetMediaBufferLow(true);
+
+  ScopedVector<TestRequest> requests;
+  TestRequest* first = AddRequests(
+      &scheduler, &requests, RequestScheduler::kPriorityBackground, "a.com",
+      1);
+  AddRequests(&scheduler, &requests, RequestScheduler::kPriorityBackground,
+              "b.com", 2);
+  TestRequest* normal = AddRequests(
+      &scheduler, &requests, RequestScheduler::kPriorityNormal, "a.com", 1);
+  EXPECT_TRUE(first->started());
+  EXPECT_TRUE(normal->started());
+  EXPECT_EQ(RequestScheduler::kMaxBackgroundRequestsWhileMediaBufferLow + 1,
+            CountStarted(requests));
+
+  scheduler.SetMediaBufferLow(false);
+  EXPECT_EQ(static_cast<int>(requests.size()), CountStarted(requests));
+
+  for (size_t i = 0; i < requests.size(); ++i)
+    scheduler.RemoveRequest(requests[i]);
+}
+
+TEST(RequestSchedulerTest, RemovingQueuedRequestDoesNotStartIt) {
+  RequestScheduler scheduler;
+  ScopedVector<TestRequest> running;
+  AddRequests(&scheduler, &running, RequestScheduler::kPriorityNormal,
+              "a.com", RequestScheduler::kMaxDelayableRequests);
+
+  ScopedVector<TestRequest> queued;
+  TestRequest* cancelled = AddRequests(
+      &scheduler, &queued, RequestScheduler::kPriorityNormal, "a.com", 1);
+  TestRequest* next = AddRequests(
+      &scheduler, &queued, RequestScheduler::kPriorityNormal, "a.com", 1);
+  scheduler.RemoveRequest(cancelled);
+  scheduler.RemoveRequest(running[0]);
+  EXPECT_FALSE(cancelled->started());
+  EXPECT_TRUE(next->started());
+
+  for (size_t i = 1; i < running.size(); ++i)
+    scheduler.RemoveRequest(running[i]);
+  scheduler.RemoveRequest(next);
+}
@@ -46,13 +46,16 @@
 
 #include "lb_resource_loader_bridge.h"
 
+#include "base/atomicops.h"
 #include "base/bind.h"
 #include "base/compiler_specific.h"
 #include "base/debug/trace_event.h"
 #include "base/file_path.h"
 #include "base/file_util.h"
 #include "base/logging.h"
+#include "base/memory/aligned_memory.h"
 #include "base/memory/ref_counted.h"
+#include "base/memory/scoped_vector.h"
 #include "base/message_loop.h"
 #include "base/message_loop_proxy.h"
 #include "base/string_util.h"
@@ -61,10 +64,12 @@
 #include "base/threading/thread.h"
 #include "base/time.h"
 #include "base/timer.h"
+#include "lb_console_values.h"
 #include "lb_http_user_agent_settings.h"
 #include "lb_memory_manager.h"
 #include "lb_on_screen_display.h"
 #include "lb_request_context.h"
+#include "lb_request_scheduler.h"
 #include "lb_resource_loader_check.h"
 #include "lb_shell/lb_shell_constants.h"
 #if defined(__LB_XB1__)
@@ -122,6 +127,18 @@ struct LBRequestContextParams {
 
 bool g_accept_all_cookies = false;
 
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+base::subtle::Atomic32 g_response_bytes_copied = 0;
+#endif
+
+// Counts response data copied rather than handed to the peer in the buffer
+// it was read into.
+void CountResponseBytesCopied(int size) {
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+  base::subtle::NoBarrier_AtomicIncrement(&g_response_bytes_copied, size);
+#endif
+}
+
 StaticCookiePolicy::Type ComputeCookiePolicyType() {
   if (!LBResourceLoaderBridge::GetCookiesEnabled()) {
     return StaticCookiePolicy::BLOCK_ALL_COOKIES;
@@ -227,6 +244,69 @@ struct FileOverHTTPParams {
 
 FileOverHTTPParams* g_file_over_http_params = NULL;
 
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+// Publishes how many requests of each priority class start, and how long
+// those that can be held back wait for the request scheduler.
+class RequestSchedulerCVals {
+ public:
+  RequestSchedulerCVals() {
+    static const char* kPriorityNames[] = {
+      "Critical", "Media", "Normal", "Background"
+    };
+    COMPILE_ASSERT(arraysize(kPriorityNames) ==
+                       LB::RequestScheduler::kNumPriorities,
+                   priority_names_mismatch);
+    for (int i = 0; i < LB::RequestScheduler::kNumPriorities; ++i) {
+      std::string prefix =
+          base::StringPrintf("Net.Scheduler.%s.", kPriorityNames[i]);
+      started_requests_.push_back(new LB::CVal<int>(
+          prefix + "Started", 0,
+          "Requests started by the request scheduler"));
+      // Critical requests never wait.
+      if (i == LB::RequestScheduler::kPriorityCritical) {
+        queued_requests_.push_back(NULL);
+        average_queue_delay_.push_back(NULL);
+        max_queue_delay_.push_back(NULL);
+        continue;
+      }
+      queued_requests_.push_back(new LB::CVal<int>(
+          prefix + "Queued", 0,
+          "Requests that waited for the request scheduler"));
+      average_queue_delay_.push_back(new LB::CVal<double>(
+          prefix + "AverageQueueDelay", 0,
+          "Average time in ms started requests waited for the request "
+          "scheduler"));
+      max_queue_delay_.push_back(new LB::CVal<double>(
+          prefix + "MaxQueueDelay", 0,
+          "Longest time in ms a request waited for the request scheduler"));
+    }
+  }
+
+  void Update(const LB::RequestScheduler& scheduler,
+              LB::RequestScheduler::Priority priority) {
+    const LB::RequestScheduler::Stats& stats = scheduler.stats(priority);
+    *started_requests_[priority] = static_cast<int>(stats.started_requests);
+    if (!queued_requests_[priority])
+      return;
+    *queued_requests_[priority] = static_cast<int>(stats.queued_requests);
+    *average_queue_delay_[priority] =
+        stats.total_queue_delay.InMillisecondsF() / stats.started_requests;
+    *max_queue_delay_[priority] = stats.max_queue_delay.InMillisecondsF();
+  }
+
+ private:
+  ScopedVector<LB::CVal<int> > started_requests_;
+  ScopedVector<LB::CVal<int> > queued_requests_;
+  ScopedVector<LB::CVal<double> > average_queue_delay_;
+  ScopedVector<LB::CVal<double> > max_queue_delay_;
+};
+
+RequestSchedulerCVals* g_request_scheduler_cvals = NULL;
+#endif  // !defined(__LB_SHELL__FOR_RELEASE__)
+
+// Decides when the requests made on the IO thread may start.
+LB::RequestScheduler* g_request_scheduler = NULL;
+
 //-----------------------------------------------------------------------------
 
 class IOThread : public base::Thread {
@@ -254,6 +334,10 @@ class IOThread : public base::Thread {
     g_network_delegate = new LBNetworkDelegate();
     g_request_context->set_network_delegate(g_network_delegate);
     g_request_context->set_http_user_agent_settings(g_user_agent_settings);
+    g_request_scheduler = new LB::RequestScheduler();
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+    g_request_scheduler_cvals = new RequestSchedulerCVals();
+#endif
 
     RegisterBlobProtocol();
   }
@@ -301,6 +385,12 @@ class IOThread : public base::Thread {
 
   virtual void CleanUp() {
     // In reverse order of initialization.
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+    delete g_request_scheduler_cvals;
+    g_request_scheduler_cvals = NULL;
+#endif
+    delete g_request_scheduler;
+    g_request_scheduler = NULL;
     if (g_request_context) {
       g_request_context->set_network_delegate(NULL);
       delete g_request_context;
@@ -337,17 +427,24 @@ static const int kUpdateUploadProgressIntervalMsec = 33;
 
 // The RequestProxy does most of its work on the IO thread.  The Start and
 // Cancel methods are proxied over to the IO thread, where an net::URLRequest
-// object is instantiated.
+// object is instantiated once g_request_scheduler lets the request start.
 class RequestProxy : public net::URLRequest::Delegate,
+                     public LB::RequestScheduler::Request,
                      public base::RefCountedThreadSafe<RequestProxy> {
  public:
   // Takes ownership of the params.
   RequestProxy()
-     : owner_loop_(NULL),
+     : priority_(LB::RequestScheduler::kPriorityNormal),
+       scheduled_(false),
+       chunk_flushed_(0),
+       next_chunk_size_(kMinChunkSize),
+       received_bytes_(0),
+       chunks_in_flight_(0),
+       read_pending_(false),
+       waiting_for_consumer_(false),
+       owner_loop_(NULL),
        peer_(NULL),
-       buf_(new ProxyIOBuffer<kDataSize>),
-       last_upload_position_(0),
-       internal_buffer_data_size_(0) {
+       last_upload_position_(0) {
     TRACE_EVENT0("lb_net", "RequestProxy::RequestProxy");
   }
 
@@ -380,12 +477,20 @@ class RequestProxy : public net::URLRequest::Delegate,
 
  protected:
   friend class base::RefCountedThreadSafe<RequestProxy>;
+  friend class LBResourceLoaderBridge;
 
   virtual ~RequestProxy() {
     TRACE_EVENT0("lb_net", "RequestProxy::~RequestProxy");
     // If we have a request, then we'd better be on the io thread!
     DCHECK(!request_.get() ||
            MessageLoop::current() == g_io_thread->message_loop());
+    // The request was dropped while it was queued or running, and must not
+    // hold on to its slot.
+    if (scheduled_) {
+      DCHECK(MessageLoop::current() == g_io_thread->message_loop());
+      if (g_request_scheduler)
+        g_request_scheduler->RemoveRequest(this);
+    }
   }
 
   // --------------------------------------------------------------------------
@@ -417,45 +522,28 @@ class RequestProxy : public net::URLRequest::Delegate,
       peer_->OnReceivedResponse(info);
   }
 
-  void NotifyReceivedData(int bytes_read) {
+  void NotifyReceivedData(scoped_refptr<net::IOBuffer> chunk,
+                          int offset,
+                          int size) {
     TRACE_EVENT0("lb_net", "RequestProxy::NotifyReceivedData");
 
+    // Let the IO thread read on before notifying our peer, even if there is
+    // none left, or the IO thread would wait for this chunk forever.
+    // Note: Doing this first ensures our load events get dispatched in a
+    // manner consistent with DumpRenderTree (and also avoids a race
+    // condition).  If the order were reversed, the peer could generate new
+    // requests in reponse to the received data, which when run on the io
+    // thread, could race against this function in doing another InvokeLater.
+    g_io_thread->message_loop()->PostTask(
+        FROM_HERE,
+        base::Bind(&RequestProxy::AsyncChunkConsumed, this));
+
     if (!peer_)
       return;
 
-    // Swap buffer
-    DCHECK_LE(bytes_read, kDataSize);
-    buf_->Swap();
-
-    // Continue reading more data into buf_
-    // Note: Doing this before notifying our peer ensures our load events get
-    // dispatched in a manner consistent with DumpRenderTree (and also avoids a
-    // race condition).  If the order of the next 2 functions were reversed, the
-    // peer could generate new requests in reponse to the received data, which
-    // when run on the io thread, could race against this function in doing
-    // another InvokeLater.
-    g_io_thread->message_loop()->PostTask(
-        FROM_HERE,
-        base::Bind(&RequestProxy::AsyncReadData, this));
-
-    // Copy to buffer. Send to peer when buffer is full.
-    int size_to_copy = std::min(bytes_read,
-                                kDataSize - internal_buffer_data_size_);
-    memcpy(internal_buffer_ + internal_buffer_data_size_, buf_->BackData(),
-           size_to_copy);
-    internal_buffer_data_size_ += size_to_copy;
-    // If buffer is full, send it out.
-    if (internal_buffer_data_size_ == kDataSize) {
-      peer_->OnReceivedData(internal_buffer_, kDataSize, -1);
-
-      // copy the data left in incoming buffer
-      internal_buffer_data_size_ = bytes_read - size_to_copy;
-      DCHECK_LT(internal_buffer_data_size_, kDataSize);
-      if (internal_buffer_data_size_) {
-        memcpy(internal_buffer_, buf_->BackData() + size_to_copy,
-               internal_buffer_data_size_);
-      }
-    }
+    // The chunk is the buffer the IO thread read into, so the data reaches
+    // the peer without being copied on the way.
+    peer_->OnReceivedData(chunk->data() + offset, size, -1);
   }
 
   void NotifyCompletedRequest(int error_code,
@@ -463,12 +551,6 @@ class RequestProxy : public net::URLRequest::Delegate,
                               const base::TimeTicks& complete_time) {
     TRACE_EVENT0("lb_net", "RequestProxy::NotifyCompletedRequest");
     if (peer_) {
-      // Send the cached data
-      if (internal_buffer_data_size_) {
-        peer_->OnReceivedData(internal_buffer_, internal_buffer_data_size_, -1);
-        internal_buffer_data_size_ = 0;
-      }
-
       peer_->OnCompletedRequest(
           error_code, false, security_info, complete_time);
       DropPeer();  // ensure no further notifications
@@ -486,7 +568,23 @@ class RequestProxy : public net::URLRequest::Delegate,
 
   void AsyncStart(RequestParams* params) {
     TRACE_EVENT0("lb_net", "RequestProxy::AsyncStart");
+    DCHECK(!params_.get());
+    params_.reset(params);
+    priority_ = GetPriority(*params);
+    // Set first, the request may start and be done within AddRequest().
+    scheduled_ = true;
+    g_request_scheduler->AddRequest(this, priority_, params->url.host());
+  }
+
+  // LB::RequestScheduler::Request implementation.
+  virtual void OnRequestScheduled() OVERRIDE {
+    TRACE_EVENT0("lb_net", "RequestProxy::OnRequestScheduled");
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+    g_request_scheduler_cvals->Update(*g_request_scheduler, priority_);
+#endif
+    scoped_ptr<RequestParams> params(params_.Pass());
     request_.reset(new net::URLRequest(params->url, this, g_request_context));
+    request_->set_priority(LB::RequestScheduler::GetNetPriority(priority_));
     request_->set_method(params->method);
     request_->set_first_party_for_cookies(params->first_party_for_cookies);
     request_->set_referrer(params->referrer.spec());
@@ -509,13 +607,19 @@ class RequestProxy : public net::URLRequest::Delegate,
           base::TimeDelta::FromMilliseconds(kUpdateUploadProgressIntervalMsec),
           this, &RequestProxy::MaybeUpdateUploadProgress);
     }
-
-    delete params;
   }
 
   void AsyncCancel() {
     TRACE_EVENT0("lb_net", "RequestProxy::AsyncCancel");
 
+    // The request hasn't been let start yet.
+    if (params_.get()) {
+      Unschedule();
+      params_.reset();
+      OnCompletedRequest(net::ERR_ABORTED, std::string(), base::TimeTicks());
+      return;
+    }
+
     // This can be null in cases where the request is already done.
     if (!request_.get())
       return;
@@ -537,22 +641,56 @@ class RequestProxy : public net::URLRequest::Delegate,
     request_->FollowDeferredRedirect();
   }
 
+  // Reads into the current chunk until it is full, then hands it to the
+  // owner's thread and starts another.  Reading stops while the owner's
+  // thread is behind by kMaxChunksInFlight chunks, see AsyncChunkConsumed().
   void AsyncReadData() {
     TRACE_EVENT0("lb_net", "RequestProxy::AsyncReadData");
 
     // This can be null in cases where the request is already done.
     if (!request_.get())
       return;
+    DCHECK(!read_pending_);
+
+    while (request_->status().is_success()) {
+      if (chunks_in_flight_ >= kMaxChunksInFlight) {
+        waiting_for_consumer_ = true;
+        return;
+      }
+      if (!chunk_buffer_)
+        StartChunk();
 
-    if (request_->status().is_success()) {
       int bytes_read;
-      if (request_->Read(buf_, kDataSize, &bytes_read) && bytes_read) {
-        OnReceivedData(bytes_read);
-      } else if (!request_->status().is_io_pending()) {
-        Done();
-      }  // else wait for OnReadCompleted
-    } else {
-      Done();
+      if (!request_->Read(chunk_buffer_, chunk_buffer_->BytesRemaining(),
+                          &bytes_read)) {
+        if (!request_->status().is_io_pending())
+          break;
+        read_pending_ = true;
+        // Rather than have the data wait for the rest of the chunk, hand
+        // what there is over if the owner's thread has nothing else to do.
+        // The pending read goes on into the rest of the chunk.
+        if (chunks_in_flight_ == 0)
+          FlushChunk();
+        return;  // wait for OnReadCompleted
+      }
+      if (bytes_read == 0)
+        break;
+      OnChunkDataRead(bytes_read);
+    }
+    Done();
+  }
+
+  // Called once the owner's thread has passed a chunk to the peer.
+  void AsyncChunkConsumed() {
+    TRACE_EVENT0("lb_net", "RequestProxy::AsyncChunkConsumed");
+    DCHECK_GT(chunks_in_flight_, 0);
+    --chunks_in_flight_;
+
+    if (waiting_for_consumer_) {
+      waiting_for_consumer_ = false;
+      AsyncReadData();
+    } else if (read_pending_ && chunks_in_flight_ == 0) {
+      FlushChunk();
     }
   }
 
@@ -581,11 +719,13 @@ class RequestProxy : public net::URLRequest::Delegate,
         base::Bind(&RequestProxy::NotifyReceivedResponse, this, info));
   }
 
-  virtual void OnReceivedData(int bytes_read) {
+  virtual void OnReceivedData(net::IOBuffer* chunk, int offset, int size) {
     TRACE_EVENT0("lb_net", "RequestProxy::OnReceivedData");
+    ++chunks_in_flight_;
     owner_loop_->PostTask(
         FROM_HERE,
-        base::Bind(&RequestProxy::NotifyReceivedData, this, bytes_read));
+        base::Bind(&RequestProxy::NotifyReceivedData, this,
+                   make_scoped_refptr(chunk), offset, size));
   }
 
   virtual void OnCompletedRequest(int error_code,
@@ -662,8 +802,11 @@ class RequestProxy : public net::URLRequest::Delegate,
   virtual void OnReadCompleted(net::URLRequest* request,
                                int bytes_read) OVERRIDE {
     TRACE_EVENT0("lb_net", "RequestProxy::OnReadCompleted");
+    DCHECK(read_pending_);
+    read_pending_ = false;
     if (request->status().is_success() && bytes_read > 0) {
-      OnReceivedData(bytes_read);
+      OnChunkDataRead(bytes_read);
+      AsyncReadData();
     } else {
       Done();
     }
@@ -679,6 +822,12 @@ class RequestProxy : public net::URLRequest::Delegate,
       upload_progress_timer_.reset();
     }
     DCHECK(request_.get());
+    // The data read so far goes out ahead of the completion.
+    FlushChunk();
+    chunk_ = NULL;
+    chunk_buffer_ = NULL;
+    read_pending_ = false;
+    waiting_for_consumer_ = false;
     // If |failed_file_request_status_| is not empty, which means the request
     // was a file request and encountered an error, then we need to use the
     // |failed_file_request_status_|. Otherwise use request_'s status.
@@ -687,6 +836,68 @@ class RequestProxy : public net::URLRequest::Delegate,
                        request_->status().error(),
                        std::string(), base::TimeTicks());
     request_.reset();  // destroy on the io thread
+    Unschedule();
+  }
+
+  // Gives the request's slot back to the scheduler.
+  void Unschedule() {
+    if (!scheduled_)
+      return;
+    scheduled_ = false;
+    g_request_scheduler->RemoveRequest(this);
+  }
+
+  // Allocates the chunk the next reads go to.  Chunks double in size every
+  // time one fills up, so large responses are handed over in few large
+  // pieces, but are never much larger than what is left of the response.
+  void StartChunk() {
+    DCHECK(!chunk_buffer_);
+    int size = next_chunk_size_;
+    int64 expected_size = request_->GetExpectedContentSize();
+    if (expected_size > received_bytes_) {
+      // Leave room for the read that finds the end of the response.
+      int64 remaining = expected_size - received_bytes_ + 1;
+      remaining = (remaining + kNetworkIOBufferAlign - 1) &
+                  ~static_cast<int64>(kNetworkIOBufferAlign - 1);
+      size = static_cast<int>(
+          std::min<int64>(size, std::max<int64>(remaining, kMinChunkSize)));
+    }
+    chunk_ = new ResponseChunk(size);
+    chunk_buffer_ = new net::DrainableIOBuffer(chunk_, size);
+    chunk_flushed_ = 0;
+  }
+
+  void OnChunkDataRead(int bytes_read) {
+    DCHECK_GT(bytes_read, 0);
+    received_bytes_ += bytes_read;
+    chunk_buffer_->DidConsume(bytes_read);
+    if (chunk_buffer_->BytesRemaining() == 0) {
+      if (next_chunk_size_ < kMaxChunkSize)
+        next_chunk_size_ *= 2;
+      FlushChunk();
+      chunk_ = NULL;
+      chunk_buffer_ = NULL;
+    }
+  }
+
+  // Hands the data read into the current chunk since it was last flushed to
+  // OnReceivedData().  The chunk itself is left alone, as a pending read may
+  // still be filling the rest of it.
+  void FlushChunk() {
+    if (!chunk_buffer_)
+      return;
+    int size = chunk_buffer_->BytesConsumed() - chunk_flushed_;
+    if (size == 0)
+      return;
+    OnReceivedData(chunk_, chunk_flushed_, size);
+    chunk_flushed_ += size;
+  }
+
+  // The class the scheduler puts the request described by |params| in.
+  virtual LB::RequestScheduler::Priority GetPriority(
+      const RequestParams& params) const {
+    return LB::RequestScheduler::GetPriority(params.request_type,
+                                             params.load_flags);
   }
 
   // Called on the IO thread.
@@ -816,52 +1027,55 @@ class RequestProxy : public net::URLRequest::Delegate,
     return true;
   }
 
-  // Using double buffer IOBuffer to avoid memcpy.
-  template<int buffer_size>
-  class ProxyIOBuffer : public net::IOBuffer {
+  // A buffer that response data is read into and then handed to the peer
+  // as is, aligned like the socket buffers.
+  class ResponseChunk : public net::IOBuffer {
    public:
-    ProxyIOBuffer() : net::IOBuffer(AlignedBuffer(0)), buffer_index_(0) {
-    }
-
-    ~ProxyIOBuffer() {
-      data_ = NULL;  // To avoid delete of memory blocks
-    }
-
-    void Swap() {
-      buffer_index_ = 1 - buffer_index_;
-      data_ = AlignedBuffer(buffer_index_);
-    }
-
-    const char* BackData() const {
-      return (const char*)AlignedBuffer(1 - buffer_index_);
+    explicit ResponseChunk(int size)
+        : net::IOBuffer(static_cast<char*>(
+              base::AlignedAlloc(size, kNetworkIOBufferAlign))) {
     }
 
    private:
-    char* AlignedBuffer(int index) const {
-      uintptr_t buffer = (uintptr_t)(buffers_[index]);
-      uintptr_t aligned_buf =
-          buffer + (kNetworkIOBufferAlign - 1) &
-          ~((uintptr_t)kNetworkIOBufferAlign - 1);
-      DCHECK_EQ(aligned_buf % kNetworkIOBufferAlign, 0);
-      DCHECK_GE(aligned_buf, buffer);
-      DCHECK_LT(aligned_buf, buffer + kNetworkIOBufferAlign);
-      return reinterpret_cast<char*>(aligned_buf);
+    virtual ~ResponseChunk() {
+      base::AlignedFree(data_);
+      data_ = NULL;  // To avoid delete of memory blocks
     }
-    int buffer_index_;
-    char buffers_[2][buffer_size + kNetworkIOBufferAlign];
   };
 
   scoped_ptr<net::URLRequest> request_;
 
-  // Size of our async IO data buffers
-  static const int kDataSize =
+  // Held from AsyncStart() until the scheduler lets the request start.
+  scoped_ptr<RequestParams> params_;
+  LB::RequestScheduler::Priority priority_;
+  // Whether the request is known to g_request_scheduler, from AsyncStart()
+  // until it is cancelled or done.
+  bool scheduled_;
+
+  // Size of the first chunk of a response, and of the largest.
+  static const int kMinChunkSize =
       net::TCPClientSocketShell::kReceiveBufferSize &
       ~(kNetworkIOBufferAlign - 1);
-  COMPILE_ASSERT((kDataSize % kNetworkIOBufferAlign) == 0,
+  static const int kMaxChunkSize = kMinChunkSize * 16;
+  COMPILE_ASSERT((kMinChunkSize % kNetworkIOBufferAlign) == 0,
       _IO_Buffer_size_not_multiple_of_alignment_);
-
-  // read buffer for async IO
-  scoped_refptr<ProxyIOBuffer<kDataSize> > buf_;
+  // Chunks handed to the owner's thread that it hasn't passed to the peer
+  // yet.  Reading waits when there are this many.
+  static const int kMaxChunksInFlight = 2;
+
+  // The chunk being read into, and the buffer reads are made through, whose
+  // offset is the end of the data read.  Both are null between chunks.
+  scoped_refptr<net::IOBuffer> chunk_;
+  scoped_refptr<net::DrainableIOBuffer> chunk_buffer_;
+  // How much of the chunk has been handed to OnReceivedData().
+  int chunk_flushed_;
+  int next_chunk_size_;
+  int64 received_bytes_;
+  int chunks_in_flight_;
+  // Whether a read is waiting for OnReadCompleted.
+  bool read_pending_;
+  // Whether reading stopped for the owner's thread to catch up.
+  bool waiting_for_consumer_;
 
   MessageLoop* owner_loop_;
 
@@ -882,11 +1096,6 @@ class RequestProxy : public net::URLRequest::Delegate,
   std::string file_url_prefix_;
   // Save a failed file request status to pass it to webkit.
   scoped_ptr<net::URLRequestStatus> failed_file_request_status_;
-
-  // Only notify peer when we have a full buffer, to reduce number of memory
-  // blocks and make it easier to reuse the blocks.
-  int internal_buffer_data_size_;
-  char internal_buffer_[kDataSize];
 };
 
 //-----------------------------------------------------------------------------
@@ -901,6 +1110,12 @@ class SyncRequestProxy : public RequestProxy {
     event_.Wait();
   }
 
+  // The WebKit thread is blocked until the request completes.
+  virtual LB::RequestScheduler::Priority GetPriority(
+      const RequestParams& params) const OVERRIDE {
+    return LB::RequestScheduler::kPriorityCritical;
+  }
+
   // --------------------------------------------------------------------------
   // Event hooks that run on the IO thread:
 
@@ -923,9 +1138,9 @@ class SyncRequestProxy : public RequestProxy {
     *static_cast<ResourceResponseInfo*>(result_) = info;
   }
 
-  virtual void OnReceivedData(int bytes_read) {
-      result_->data.append(buf_->data(), bytes_read);
-    AsyncReadData();  // read more (may recurse)
+  virtual void OnReceivedData(net::IOBuffer* chunk, int offset, int size) {
+    result_->data.append(chunk->data() + offset, size);
+    CountResponseBytesCopied(size);
   }
 
   virtual void OnCompletedRequest(
@@ -1137,6 +1352,18 @@ class CookiePurger : public base::RefCountedThreadSafe<CookiePurger> {
   base::Closure completed_cb_;
 };
 
+void PreconnectOnIOThread(const GURL& url, int num_streams) {
+  TRACE_EVENT0("lb_net", "PreconnectOnIOThread");
+  DCHECK(MessageLoop::current() == g_io_thread->message_loop());
+  g_request_context->Preconnect(url, num_streams);
+}
+
+void SetMediaBufferLowOnIOThread(bool low) {
+  TRACE_EVENT0("lb_net", "SetMediaBufferLowOnIOThread");
+  DCHECK(MessageLoop::current() == g_io_thread->message_loop());
+  g_request_scheduler->SetMediaBufferLow(low);
+}
+
 }  // anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -1266,6 +1493,32 @@ void LBResourceLoaderBridge::PurgeCookies(
       base::Bind(&CookiePurger::Purge, purger.get()));
 }
 
+// static
+void LBResourceLoaderBridge::Preconnect(const GURL& url, int num_streams) {
+  TRACE_EVENT0("lb_net", "LBResourceLoaderBridge::Preconnect");
+  if (!EnsureIOThread()) {
+    NOTREACHED();
+    return;
+  }
+
+  g_io_thread->message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&PreconnectOnIOThread, url, num_streams));
+}
+
+// static
+void LBResourceLoaderBridge::SetMediaBufferLow(bool low) {
+  TRACE_EVENT0("lb_net", "LBResourceLoaderBridge::SetMediaBufferLow");
+  if (!EnsureIOThread()) {
+    NOTREACHED();
+    return;
+  }
+
+  g_io_thread->message_loop()->PostTask(
+      FROM_HERE,
+      base::Bind(&SetMediaBufferLowOnIOThread, low));
+}
+
 // static
 bool LBResourceLoaderBridge::GetCookiesEnabled() {
 #if defined(__LB_XB1__)
@@ -1360,3 +1613,15 @@ void LBResourceLoaderBridge::OutputError(const std::string& error) {
 #endif
   DLOG(WARNING) << error;
 }
+
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+// static
+int LBResourceLoaderBridge::GetResponseBytesCopied() {
+  return base::subtle::NoBarrier_Load(&g_response_bytes_copied);
+}
+
+// static
+int LBResourceLoaderBridge::GetMinResponseChunkSize() {
+  return RequestProxy::kMinChunkSize;
+}
+#endif
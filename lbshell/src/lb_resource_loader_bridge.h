@@ -66,6 +66,16 @@ class LB_SHELL_EXPORT LBResourceLoaderBridge {
   // has been cleared. Does not delete cookies saved to disk.
   static void PurgeCookies(const base::Closure& cookies_cleared_cb);
 
+  // Opens |num_streams| idle connections to the origin of |url| ahead of the
+  // requests that will need them.  May be called from any thread.
+  static void Preconnect(const GURL& url, int num_streams);
+
+  // Tells the request scheduler whether a playing video has less data
+  // buffered than it wants, in which case background requests are held back
+  // so that they don't take bandwidth from it.  May be called from any
+  // thread.
+  static void SetMediaBufferLow(bool low);
+
   static bool EnsureIOThread();
   static void SetAcceptAllCookies(bool accept_all_cookies);
 
@@ -109,6 +119,12 @@ class LB_SHELL_EXPORT LBResourceLoaderBridge {
 
   static bool PerimeterLogEnabled() { return perimeter_log_enabled_; }
   static bool PerimeterCheckEnabled() { return perimeter_check_enabled_; }
+
+  // For tests: the number of response bytes copied on their way from the
+  // network to the peers since startup, and the size of the first piece a
+  // response is handed to its peer in.  Later pieces grow from there.
+  static int GetResponseBytesCopied();
+  static int GetMinResponseChunkSize();
 #endif
 
  private:
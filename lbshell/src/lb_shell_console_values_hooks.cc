@@ -76,6 +76,10 @@ void ShellConsoleValueHooks::Whitelist::RestoreToDefaultInternal() {
   values_.insert("Memory.PS4.DirectBytesMapped");
   values_.insert("Memory.PS4.FlexibleBytesMapped");
 
+  values_.insert("Media.Video.Presentation.Drops");
+  values_.insert("Media.Video.Presentation.JitterHistogram");
+  values_.insert("Media.Video.Presentation.Repeats");
+
   values_.insert("Skia.Memory");
   values_.insert("Telnet.Port");
   values_.insert("VersionInfo.LB.BuildId");
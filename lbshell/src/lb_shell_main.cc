@@ -32,6 +32,7 @@
 #include "external/chromium/base/string_split.h"
 #include "external/chromium/base/threading/platform_thread.h"
 #include "external/chromium/base/threading/thread.h"
+#include "external/chromium/googleurl/src/gurl.h"
 #include "external/chromium/media/base/shell_buffer_factory.h"
 #include "external/chromium/net/base/net_util.h"
 #include "external/chromium/net/dial/dial_service.h"
@@ -43,6 +44,9 @@
 #include "external/chromium/third_party/WebKit/Source/JavaScriptCore/runtime/JSExportMacros.h"
 #include "external/chromium/third_party/WebKit/Source/JavaScriptCore/runtime/InitializeThreading.h"
 #endif
+#ifdef __LB_SHELL_USE_JSC__
+#include "lb_code_cache_store.h"
+#endif
 #include "lb_console_values.h"
 #include "lb_cookie_store.h"
 #include "lb_globals.h"
@@ -109,6 +113,9 @@
 
 static const char* LB_URL = "https://www.youtube.com/tv";
 
+// Connections opened to the startup URL's origin while the app starts up.
+static const int kStartupPreconnectStreams = 2;
+
 // Get the URL to load. If it's not present, default to LB_URL.
 static std::string GetUrlToLoad() {
 #if defined(__LB_SHELL__FOR_RELEASE__)
@@ -157,6 +164,9 @@ class WebKitInstance {
 
   scoped_ptr<LBShellWebKitInit> webkit_init_;
   scoped_ptr<webkit_glue::WebThemeEngineImpl> engine_;
+#ifdef __LB_SHELL_USE_JSC__
+  scoped_ptr<LBCodeCacheStore> code_cache_store_;
+#endif
 };
 
 WebKitInstance::WebKitInstance()
@@ -181,6 +191,11 @@ void WebKitInstance::InitializeOnWebKitThread() {
   // Initialize the JavaScriptCore threading model.
   // Must be called from main thread and AFTER WebKit init.
   JSC::initializeThreading();
+
+  code_cache_store_.reset(new LBCodeCacheStore(
+      LBCodeCacheStore::GetDefaultDirectory(),
+      LBCodeCacheStore::kDefaultMaxSize));
+  JSC::setPersistentCodeCacheStore(code_cache_store_.get());
 #endif
 
   engine_.reset(new webkit_glue::WebThemeEngineImpl());
@@ -205,6 +220,10 @@ WebKitInstance::~WebKitInstance() {
 void WebKitInstance::ShutdownOnWebKitThread() {
   engine_.reset(NULL);
   webkit_init_.reset(NULL);
+#ifdef __LB_SHELL_USE_JSC__
+  JSC::setPersistentCodeCacheStore(NULL);
+  code_cache_store_.reset(NULL);
+#endif
 }
 
 }  // namespace
@@ -232,8 +251,9 @@ static void RunLayoutTests(const CommandLine& command_line,
 
 #else
 
-static void RunLBShell(WebKitInstance* webkit_instance) {
-  LBShell shell(GetUrlToLoad(), webkit_instance->message_loop());
+static void RunLBShell(const std::string& url,
+                       WebKitInstance* webkit_instance) {
+  LBShell shell(url, webkit_instance->message_loop());
   shell.Show(WebKit::WebNavigationPolicyNewWindow);
 
 #if defined(__LB_WIIU__) && !defined(__LB_SHELL__FOR_RELEASE__)
@@ -296,6 +316,9 @@ int main(int argc, char **argv) {
     printf("      Overrides the system's proxy settings.\n");
     printf("      Also puts perimeter checks into warning mode.\n");
     printf("\n");
+    printf("  --separate-audio-streams    Play each audio stream through\n");
+    printf("      its own PulseAudio stream instead of mixing them.\n");
+    printf("\n");
     printf("  --user-agent=USER_AGENT    Override the User-Agent string.\n");
     printf("\n");
     printf("  --version    Print the version number and exit.\n");
@@ -423,6 +446,13 @@ int main(int argc, char **argv) {
 
       LBResourceLoaderBridge::SetAcceptAllCookies(true);
 
+#if !defined(__LB_LAYOUT_TESTS__)
+      // The DNS lookup and handshakes for the startup URL run on the IO
+      // thread while the rest of the app and WebKit are initialized.
+      std::string url = GetUrlToLoad();
+      LBResourceLoaderBridge::Preconnect(GURL(url), kStartupPreconnectStreams);
+#endif
+
       LBShellPlatformDelegate::PlatformUpdateDuringStartup();
       if (!LBShellPlatformDelegate::ExitGameRequested()) {
         // load ICU data tables
@@ -443,7 +473,7 @@ int main(int argc, char **argv) {
 #if defined(__LB_LAYOUT_TESTS__)
           RunLayoutTests(*cl, &webkit_instance);
 #else
-          RunLBShell(&webkit_instance);
+          RunLBShell(url, &webkit_instance);
 #endif
         }
 
@@ -64,6 +64,10 @@ const char kVersion[] = "version";
 
 // Print a list of options and exit.
 const char kHelp[] = "help";
+
+// Play each audio stream through its own PulseAudio stream instead of mixing
+// them into one.
+const char kSeparateAudioStreams[] = "separate-audio-streams";
 #endif
 
 #if defined(__LB_XB1__) || defined(__LB_XB360__)
@@ -40,6 +40,7 @@ LB_SHELL_EXTERN const char kErrorTest[];
 #if defined(__LB_LINUX__)
 LB_SHELL_EXTERN const char kVersion[];
 LB_SHELL_EXTERN const char kHelp[];
+LB_SHELL_EXTERN const char kSeparateAudioStreams[];
 #endif
 
 #if defined(__LB_XB1__) || defined(__LB_XB360__)
@@ -22,6 +22,7 @@
 #if !defined(__LB_XB1__)
 #include "media/base/shell_media_statistics.h"
 #endif  // !defined(__LB_XB1__)
+#include "net/disk_cache/shell_backend_impl.h"
 #include "skia/ext/SkMemory_new_handler.h"
 #include "third_party/WebKit/Source/WTF/wtf/ExportMacros.h"  // needed before InspectorCounters.
 #include "third_party/WebKit/Source/WebKit/chromium/src/WebInspectorExports.h"
@@ -113,6 +114,13 @@ SystemStatsTracker::SystemStatsTracker(MessageLoop* message_loop)
                        "build.")
     , app_lifetime_("LB.Lifetime", 0,
                     "Application lifetime in milliseconds.")
+    , http_cache_hits_("Net.HttpCache.Hits", 0,
+                       "HTTP cache lookups that found an entry.")
+    , http_cache_misses_("Net.HttpCache.Misses", 0,
+                         "HTTP cache lookups that found no entry.")
+    , http_cache_hit_rate_("Net.HttpCache.HitRate", 0,
+                           "Fraction of HTTP cache lookups that found an "
+                           "entry.")
 #if !defined(__LB_XB1__)
     , media_time_elapsed_("Media.TimeElapsed", 0, "Playback Time Elapsed")
     , media_decrypt_load_("Media.DecryptLoad", 0,
@@ -138,6 +146,26 @@ SystemStatsTracker::SystemStatsTracker(MessageLoop* message_loop)
     , media_video_decoder_min_backlog_("Media.Video.MinBacklog", 0,
                                        "Video Renderer Backlog")
     , media_late_frames_("Media.Video.LateFrames", 0, "Late Frames")
+    , media_video_decoder_threads_("Media.Video.DecoderThreads", 0,
+                                   "Number of Video Decoder Threads")
+    , media_video_decode_thread_time_(
+          "Media.Video.DecodeThreadTime", 0,
+          "Average CPU Time A Video Decoder Spends On One Frame")
+    , media_video_decode_thread_load_(
+          "Media.Video.DecodeThreadLoad", 0,
+          "Total CPU Time Spent In Video Decoder Threads")
+    , media_video_frame_pool_hits_("Media.Video.FramePoolHits", 0,
+                                   "Decoded Frames With Recycled Planes")
+    , media_video_frame_pool_misses_("Media.Video.FramePoolMisses", 0,
+                                     "Decoded Frames With New Planes")
+    , media_source_buffer_evictions_("Media.SourceBuffer.Evictions", 0,
+                                     "Source Buffer Garbage Collections")
+    , media_source_buffer_evicted_bytes_(
+          "Media.SourceBuffer.EvictedBytes", 0,
+          "Bytes Freed By Source Buffer Garbage Collection")
+    , media_source_buffer_pool_evictions_(
+          "Media.SourceBuffer.PoolEvictions", 0,
+          "Source Buffer Garbage Collections For Shell Buffer Space")
 #endif  // !defined(__LB_XB1__)
     // Initialize this to minus one kMemUpdatePeriod in order to force an
     // immediate update.
@@ -186,6 +214,16 @@ void SystemStatsTracker::Update() {
   GetGlobalsPtr()->lifetime = static_cast<int>(lifetime.InMilliseconds());
   app_lifetime_ = GetGlobalsPtr()->lifetime;
 
+  int http_cache_hits = disk_cache::ShellBackendImpl::GetHitCount();
+  int http_cache_misses = disk_cache::ShellBackendImpl::GetMissCount();
+  http_cache_hits_ = http_cache_hits;
+  http_cache_misses_ = http_cache_misses;
+  if (http_cache_hits + http_cache_misses > 0) {
+    double hit_rate = static_cast<double>(http_cache_hits) /
+                      (http_cache_hits + http_cache_misses);
+    http_cache_hit_rate_ = static_cast<int>(hit_rate * 100) / 100.0;
+  }
+
 #if !defined(__LB_XB1__)
   const ShellMediaStatistics& stat = ShellMediaStatistics::Instance();
 
@@ -225,6 +263,24 @@ void SystemStatsTracker::Update() {
       ShellMediaStatistics::STAT_TYPE_VIDEO_RENDERER_BACKLOG);
   media_late_frames_ = stat.GetTimes(
       ShellMediaStatistics::STAT_TYPE_VIDEO_FRAME_LATE);
+  media_video_decoder_threads_ = stat.GetCurrent(
+      ShellMediaStatistics::STAT_TYPE_VIDEO_DECODER_THREADS);
+  media_video_decode_thread_time_ = stat.GetAverageDuration(
+      ShellMediaStatistics::STAT_TYPE_VIDEO_DECODE_THREAD_TIME);
+  load = stat.GetTotalDuration(
+      ShellMediaStatistics::STAT_TYPE_VIDEO_DECODE_THREAD_TIME) /
+      stat.GetElapsedTime();
+  media_video_decode_thread_load_ = static_cast<int>(load * 100) / 100.0;
+  media_video_frame_pool_hits_ = stat.GetTimes(
+      ShellMediaStatistics::STAT_TYPE_VIDEO_FRAME_POOL_HIT);
+  media_video_frame_pool_misses_ = stat.GetTimes(
+      ShellMediaStatistics::STAT_TYPE_VIDEO_FRAME_POOL_MISS);
+  media_source_buffer_evictions_ = stat.GetTimes(
+      ShellMediaStatistics::STAT_TYPE_SOURCE_BUFFER_EVICTION);
+  media_source_buffer_evicted_bytes_ = stat.GetTotal(
+      ShellMediaStatistics::STAT_TYPE_SOURCE_BUFFER_EVICTION);
+  media_source_buffer_pool_evictions_ = stat.GetTimes(
+      ShellMediaStatistics::STAT_TYPE_SOURCE_BUFFER_POOL_EVICTION);
 #endif  // !defined(__LB_XB1__)
 }
 
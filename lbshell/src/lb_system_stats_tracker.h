@@ -95,6 +95,12 @@ class SystemStatsTracker {
 
   LB::CVal<uint32_t> app_lifetime_;
 
+  // HTTP cache lookups that found an entry and that did not.
+  LB::CVal<int> http_cache_hits_;
+  LB::CVal<int> http_cache_misses_;
+  // Hits / lookups.
+  LB::CVal<double> http_cache_hit_rate_;
+
 #if !defined(__LB_XB1__)
   // How much time has been elapsed in the playback of the current video.
   LB::CVal<double> media_time_elapsed_;
@@ -122,6 +128,19 @@ class SystemStatsTracker {
   LB::CVal<double> media_video_decoder_min_backlog_;
   // The frame that arrives late to the video renderer.
   LB::CVal<double> media_late_frames_;
+  LB::CVal<int> media_video_decoder_threads_;
+  // Average CPU time a video decoder and its threads spend on one frame.
+  LB::CVal<double> media_video_decode_thread_time_;
+  // CPU time spent by all decoder threads / time elapsed.
+  LB::CVal<double> media_video_decode_thread_load_;
+  // Decoded frames that reused or allocated their planes.
+  LB::CVal<int> media_video_frame_pool_hits_;
+  LB::CVal<int> media_video_frame_pool_misses_;
+  // Garbage collections of buffered MSE data, the bytes they freed and the
+  // ones made because the shell buffer pool was running out of room.
+  LB::CVal<int> media_source_buffer_evictions_;
+  LB::CVal<size_t> media_source_buffer_evicted_bytes_;
+  LB::CVal<int> media_source_buffer_pool_evictions_;
 #endif  // !defined(__LB_XB1__)
 
   double last_mem_update_time_;
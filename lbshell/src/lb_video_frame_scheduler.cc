@@ -0,0 +1,174 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_video_frame_scheduler.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+// Until enough flips have been seen the display is assumed to run at 60Hz.
+const int64 kDefaultRefreshIntervalInMicroseconds =
+    base::Time::kMicrosecondsPerSecond / 60;
+// Refresh intervals outside of this range are treated as bogus flip times.
+const int64 kMinRefreshIntervalInMicroseconds =
+    base::Time::kMicrosecondsPerSecond / 240;
+const int64 kMaxRefreshIntervalInMicroseconds =
+    base::Time::kMicrosecondsPerSecond / 20;
+// A gap between two flips longer than this many refreshes is a stall, not a
+// run of missed vsyncs, and tells nothing about the refresh interval.
+const int64 kMaxMissedRefreshes = 4;
+// Each flip moves the refresh interval estimate this fraction of the way to
+// the measured interval, which filters out the scheduling noise on the flip
+// times.
+const int64 kRefreshIntervalFilterWeight = 8;
+
+}  // namespace
+
+namespace LB {
+
+const int VideoFrameScheduler::kJitterBucketLimitsInMilliseconds[] = {
+  2, 4, 8, 16, 33
+};
+
+VideoFrameScheduler::Stats::Stats()
+    : presented_frames(0)
+    , dropped_frames(0)
+    , repeated_frames(0) {
+  for (int i = 0; i < kJitterBuckets; ++i)
+    jitter_histogram[i] = 0;
+}
+
+VideoFrameScheduler::VideoFrameScheduler()
+    : refresh_interval_(base::TimeDelta::FromMicroseconds(
+          kDefaultRefreshIntervalInMicroseconds))
+    , has_current_frame_(false)
+    , frame_duration_(refresh_interval_) {
+}
+
+void VideoFrameScheduler::OnFlip(base::TimeTicks flip_time) {
+  if (flip_time.is_null() || flip_time <= last_flip_time_)
+    return;
+
+  if (!last_flip_time_.is_null()) {
+    int64 elapsed = (flip_time - last_flip_time_).InMicroseconds();
+    int64 interval = refresh_interval_.InMicroseconds();
+    // Flips can skip vsyncs when a display frame takes too long, so the time
+    // since the last flip is a whole number of refreshes.
+    int64 refreshes = (elapsed + interval / 2) / interval;
+    if (refreshes >= 1 && refreshes <= kMaxMissedRefreshes) {
+      int64 measured = elapsed / refreshes;
+      interval += (measured - interval) / kRefreshIntervalFilterWeight;
+      interval = std::max(interval, kMinRefreshIntervalInMicroseconds);
+      interval = std::min(interval, kMaxRefreshIntervalInMicroseconds);
+      refresh_interval_ = base::TimeDelta::FromMicroseconds(interval);
+    }
+  }
+  last_flip_time_ = flip_time;
+}
+
+base::TimeTicks VideoFrameScheduler::PredictNextFlip(
+    base::TimeTicks now) const {
+  if (last_flip_time_.is_null() || now < last_flip_time_)
+    return now + refresh_interval_;
+  int64 refreshes = (now - last_flip_time_) / refresh_interval_ + 1;
+  return last_flip_time_ + refresh_interval_ * refreshes;
+}
+
+int VideoFrameScheduler::SelectFrame(
+    const std::vector<base::TimeDelta>& timestamps,
+    base::TimeDelta media_time) {
+  if (timestamps.size() >= 2) {
+    base::TimeDelta duration =
+        timestamps[timestamps.size() - 1] - timestamps[timestamps.size() - 2];
+    if (duration > base::TimeDelta())
+      frame_duration_ = duration;
+  }
+
+  // The refresh is on screen for [media_time, refresh_end), show the frame
+  // that covers most of it.
+  base::TimeDelta refresh_end = media_time + refresh_interval_;
+  int selected = -1;
+  base::TimeDelta best_coverage;
+  for (size_t i = 0; i < timestamps.size(); ++i) {
+    if (timestamps[i] >= refresh_end)
+      break;
+    base::TimeDelta frame_end = i + 1 < timestamps.size() ?
+        timestamps[i + 1] : timestamps[i] + frame_duration_;
+    base::TimeDelta coverage = std::min(frame_end, refresh_end) -
+                               std::max(timestamps[i], media_time);
+    if (coverage > best_coverage) {
+      best_coverage = coverage;
+      selected = i;
+    }
+  }
+  // When every queued frame is already over, the newest one is the least
+  // wrong.
+  if (selected == -1 && !timestamps.empty() &&
+      timestamps.back() + frame_duration_ <= media_time) {
+    selected = timestamps.size() - 1;
+  }
+
+  if (selected == -1 ||
+      (has_current_frame_ && timestamps[selected] == current_timestamp_)) {
+    // The frame on screen stays, which is only a repeat when it should have
+    // been replaced already.
+    if (has_current_frame_) {
+      base::TimeDelta current_end = current_timestamp_ + frame_duration_;
+      for (size_t i = 0; i < timestamps.size(); ++i) {
+        if (timestamps[i] > current_timestamp_) {
+          current_end = timestamps[i];
+          break;
+        }
+      }
+      if (current_end <= media_time)
+        ++stats_.repeated_frames;
+    }
+    return selected;
+  }
+
+  for (int i = 0; i < selected; ++i) {
+    if (!has_current_frame_ || timestamps[i] != current_timestamp_)
+      ++stats_.dropped_frames;
+  }
+  RecordPresentation(timestamps[selected], media_time);
+  return selected;
+}
+
+void VideoFrameScheduler::Reset() {
+  has_current_frame_ = false;
+}
+
+void VideoFrameScheduler::RecordPresentation(base::TimeDelta timestamp,
+                                             base::TimeDelta media_time) {
+  has_current_frame_ = true;
+  current_timestamp_ = timestamp;
+  ++stats_.presented_frames;
+
+  base::TimeDelta jitter = media_time > timestamp ?
+      media_time - timestamp : timestamp - media_time;
+  stats_.total_jitter += jitter;
+  int bucket = 0;
+  while (bucket < kJitterBuckets - 1 &&
+         jitter.InMilliseconds() >= kJitterBucketLimitsInMilliseconds[bucket]) {
+    ++bucket;
+  }
+  ++stats_.jitter_histogram[bucket];
+}
+
+}  // namespace LB
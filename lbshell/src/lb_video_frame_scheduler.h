@@ -0,0 +1,99 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SRC_LB_VIDEO_FRAME_SCHEDULER_H_
+#define SRC_LB_VIDEO_FRAME_SCHEDULER_H_
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/time.h"
+
+namespace LB {
+
+// Decides which video frame is shown on each display refresh.  The refresh
+// interval is learnt from the times the buffers flip, and each refresh shows
+// the frame that covers most of the media time the refresh stays on screen
+// for.  This is what gives 24fps content a steady 3:2 cadence on a 60Hz
+// display, instead of showing whichever frame happens to be due when the
+// display frame is drawn.
+class VideoFrameScheduler {
+ public:
+  enum { kJitterBuckets = 6 };
+  // Upper bounds of the jitter histogram buckets, the last bucket holds
+  // everything larger.
+  static const int kJitterBucketLimitsInMilliseconds[kJitterBuckets - 1];
+
+  struct Stats {
+    Stats();
+
+    // Frames that have been put on screen.
+    int presented_frames;
+    // Frames released without ever being put on screen.
+    int dropped_frames;
+    // Refreshes that kept a frame on screen after its time was over because
+    // the next frame wasn't ready.
+    int repeated_frames;
+    // Sum of the differences between the media time a frame appeared at and
+    // its timestamp.
+    base::TimeDelta total_jitter;
+    int jitter_histogram[kJitterBuckets];
+  };
+
+  VideoFrameScheduler();
+
+  // Tells the scheduler that the buffers flipped at |flip_time|.  Null times
+  // and times that were already reported are ignored, so the last flip time
+  // can be passed in on every display frame.
+  void OnFlip(base::TimeTicks flip_time);
+
+  // Returns the time of the first flip expected after |now|.
+  base::TimeTicks PredictNextFlip(base::TimeTicks now) const;
+
+  // Picks the frame to show on the refresh that starts at |media_time|.
+  // |timestamps| holds the timestamps of the queued frames in presentation
+  // order, and may start with the frame currently on screen.  Returns the
+  // index of the frame to show, the frames before it can be released, or -1
+  // if the frame on screen should stay there.
+  int SelectFrame(const std::vector<base::TimeDelta>& timestamps,
+                  base::TimeDelta media_time);
+
+  // Forgets the frame on screen, used when the queued frames are flushed.
+  void Reset();
+
+  base::TimeDelta refresh_interval() const { return refresh_interval_; }
+  const Stats& stats() const { return stats_; }
+
+ private:
+  void RecordPresentation(base::TimeDelta timestamp,
+                          base::TimeDelta media_time);
+
+  base::TimeDelta refresh_interval_;
+  base::TimeTicks last_flip_time_;
+
+  bool has_current_frame_;
+  base::TimeDelta current_timestamp_;
+  // The time between the last two queued frames, which is how long the last
+  // queued frame is assumed to last.
+  base::TimeDelta frame_duration_;
+
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(VideoFrameScheduler);
+};
+
+}  // namespace LB
+
+#endif  // SRC_LB_VIDEO_FRAME_SCHEDULER_H_
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lb_video_frame_scheduler.h"
+
+#include <vector>
+
+#include "external/chromium/testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using base::TimeDelta;
+using base::TimeTicks;
+
+const int64 k60HzInMicroseconds = base::Time::kMicrosecondsPerSecond / 60;
+
+TimeDelta Microseconds(int64 microseconds) {
+  return TimeDelta::FromMicroseconds(microseconds);
+}
+
+// Plays the frames in |timestamps| through |scheduler| with a refresh every
+// |refresh_interval| starting at |media_time|, and returns how many refreshes
+// each frame stayed on screen for.
+std::vector<int> Play(LB::VideoFrameScheduler* scheduler,
+                      std::vector<TimeDelta> timestamps,
+                      TimeDelta media_time, TimeDelta refresh_interval,
+                      int refreshes) {
+  std::vector<int> shown;
+  for (int i = 0; i < refreshes; ++i) {
+    int selected = scheduler->SelectFrame(timestamps, media_time);
+    if (selected >= 0) {
+      timestamps.erase(timestamps.begin(), timestamps.begin() + selected);
+      if (shown.empty() || selected > 0)
+        shown.push_back(0);
+    }
+    if (!shown.empty())
+      ++shown.back();
+    media_time += refresh_interval;
+  }
+  return shown;
+}
+
+std::vector<TimeDelta> Frames(int count, int64 frame_duration) {
+  std::vector<TimeDelta> timestamps;
+  for (int i = 0; i < count; ++i)
+    timestamps.push_back(Microseconds(i * frame_duration));
+  return timestamps;
+}
+
+}  // namespace
+
+TEST(VideoFrameSchedulerTest, LearnsRefreshIntervalFromFlips) {
+  LB::VideoFrameScheduler scheduler;
+  EXPECT_EQ(k60HzInMicroseconds,
+            scheduler.refresh_interval().InMicroseconds());
+
+  // A 50Hz display that misses a vsync every fifth flip.
+  const int64 k50HzInMicroseconds = 20000;
+  TimeTicks flip_time = TimeTicks() + Microseconds(1000000);
+  for (int i = 0; i < 200; ++i) {
+    scheduler.OnFlip(flip_time);
+    // Reporting the same flip again changes nothing.
+    scheduler.OnFlip(flip_time);
+    flip_time += Microseconds(i % 5 == 4 ? 2 * k50HzInMicroseconds :
+                                           k50HzInMicroseconds);
+  }
+  EXPECT_NEAR(k50HzInMicroseconds,
+              scheduler.refresh_interval().InMicroseconds(), 100);
+
+  // Stalls don't affect the estimate.
+  flip_time += Microseconds(1000000);
+  scheduler.OnFlip(flip_time);
+  EXPECT_NEAR(k50HzInMicroseconds,
+              scheduler.refresh_interval().InMicroseconds(), 100);
+}
+
+TEST(VideoFrameSchedulerTest, PredictsNextFlip) {
+  LB::VideoFrameScheduler scheduler;
+  TimeTicks now = TimeTicks() + Microseconds(1000000);
+  EXPECT_EQ(now + scheduler.refresh_interval(),
+            scheduler.PredictNextFlip(now));
+
+  TimeTicks flip_time = now;
+  scheduler.OnFlip(flip_time);
+  TimeDelta interval = scheduler.refresh_interval();
+  EXPECT_EQ(flip_time + interval,
+            scheduler.PredictNextFlip(flip_time + Microseconds(1000)));
+  EXPECT_EQ(flip_time + interval * 3,
+            scheduler.PredictNextFlip(flip_time + interval * 2 +
+                                      Microseconds(1000)));
+}
+
+TEST(VideoFrameSchedulerTest, Plays24FpsIn3To2Cadence) {
+  LB::VideoFrameScheduler scheduler;
+  const int kFrames = 48;
+  std::vector<int> shown = Play(
+      &scheduler, Frames(kFrames, base::Time::kMicrosecondsPerSecond / 24),
+      Microseconds(1000), Microseconds(k60HzInMicroseconds),
+      kFrames * 5 / 2);
+
+  ASSERT_EQ(kFrames, shown.size());
+  // The last frame stays up as long as the test runs.
+  for (int i = 1; i < kFrames - 2; ++i) {
+    EXPECT_TRUE(shown[i] == 2 || shown[i] == 3) << i;
+    EXPECT_EQ(5, shown[i] + shown[i + 1]) << i;
+  }
+  EXPECT_EQ(kFrames, scheduler.stats().presented_frames);
+  EXPECT_EQ(0, scheduler.stats().dropped_frames);
+  EXPECT_EQ(0, scheduler.stats().repeated_frames);
+  // No frame appears more than half a refresh away from its timestamp.
+  EXPECT_EQ(0, scheduler.stats().jitter_histogram[
+      LB::VideoFrameScheduler::kJitterBuckets - 1]);
+  EXPECT_LE(scheduler.stats().total_jitter,
+            Microseconds(kFrames * k60HzInMicroseconds / 2));
+}
+
+TEST(VideoFrameSchedulerTest, Plays60FpsWithoutDropsOrRepeats) {
+  LB::VideoFrameScheduler scheduler;
+  std::vector<int> shown = Play(
+      &scheduler, Frames(60, k60HzInMicroseconds), Microseconds(0),
+      Microseconds(k60HzInMicroseconds), 59);
+  ASSERT_EQ(59, shown.size());
+  for (size_t i = 0; i < shown.size(); ++i)
+    EXPECT_EQ(1, shown[i]) << i;
+  EXPECT_EQ(0, scheduler.stats().dropped_frames);
+  EXPECT_EQ(0, scheduler.stats().repeated_frames);
+  EXPECT_EQ(59, scheduler.stats().jitter_histogram[0]);
+}
+
+TEST(VideoFrameSchedulerTest, CountsDropsAndRepeats) {
+  LB::VideoFrameScheduler scheduler;
+  const int64 kFrameDuration = 33333;
+  std::vector<TimeDelta> timestamps = Frames(10, kFrameDuration);
+
+  EXPECT_EQ(0, scheduler.SelectFrame(timestamps, Microseconds(0)));
+
+  // Media time jumped ahead, the frames it skipped are dropped.
+  EXPECT_EQ(4, scheduler.SelectFrame(timestamps,
+                                     Microseconds(4 * kFrameDuration)));
+  EXPECT_EQ(3, scheduler.stats().dropped_frames);
+  timestamps.erase(timestamps.begin(), timestamps.begin() + 4);
+
+  // Frames that are not due yet keep the current frame on screen.
+  EXPECT_EQ(0, scheduler.SelectFrame(timestamps,
+                                     Microseconds(4 * kFrameDuration + 1000)));
+  EXPECT_EQ(0, scheduler.stats().repeated_frames);
+
+  // The queue ran dry, the frame on screen outstays its duration.
+  timestamps.clear();
+  EXPECT_EQ(-1, scheduler.SelectFrame(timestamps,
+                                      Microseconds(6 * kFrameDuration)));
+  EXPECT_EQ(-1, scheduler.SelectFrame(timestamps,
+                                      Microseconds(7 * kFrameDuration)));
+  EXPECT_EQ(2, scheduler.stats().repeated_frames);
+
+  // A late frame is still shown, and its lateness is recorded.
+  timestamps.push_back(Microseconds(5 * kFrameDuration));
+  EXPECT_EQ(0, scheduler.SelectFrame(timestamps,
+                                     Microseconds(8 * kFrameDuration)));
+  EXPECT_EQ(3, scheduler.stats().presented_frames);
+  EXPECT_EQ(1, scheduler.stats().jitter_histogram[
+      LB::VideoFrameScheduler::kJitterBuckets - 1]);
+
+  // After a flush the first frame is a new one, not a drop.
+  scheduler.Reset();
+  timestamps = Frames(2, kFrameDuration);
+  EXPECT_EQ(0, scheduler.SelectFrame(timestamps, Microseconds(0)));
+  EXPECT_EQ(3, scheduler.stats().dropped_frames);
+  EXPECT_EQ(4, scheduler.stats().presented_frames);
+}
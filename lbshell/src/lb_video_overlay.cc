@@ -17,8 +17,10 @@
 #include "lb_video_overlay.h"
 
 #include <math.h>
+#include <string.h>
 
 #include "base/logging.h"
+#include "base/stringprintf.h"
 #include "lb_globals.h"
 #include "media/base/pipeline.h"
 
@@ -26,6 +28,23 @@ namespace {
 
 LB::VideoOverlay* s_instance;
 
+// GL_WRITE_ONLY_OES, the only access mode mapTexSubImage2DCHROMIUM() accepts.
+const int kWriteOnly = 0x88B9;
+
+// Frames taller than standard definition are assumed to be BT.709 encoded,
+// the decoders don't pass the colour space of the stream along.
+const int kMaxBT601Height = 576;
+
+// Returns true if the planes of |frame| are in system memory and can be
+// drawn with QuadDrawer::DrawQuadYUV().
+bool IsSoftwareYUVFrame(const scoped_refptr<media::VideoFrame>& frame) {
+  if (!LB::QuadDrawer::SupportsYUV())
+    return false;
+  return frame->format() == media::VideoFrame::YV12 ||
+         frame->format() == media::VideoFrame::YV16 ||
+         frame->format() == media::VideoFrame::I420;
+}
+
 void FillTextureCoords(const gfx::Rect& visible_rect,
                        const gfx::Size& coded_size, LB::Coord (&coords)[4]) {
   float coded_width = coded_size.width();
@@ -73,21 +92,36 @@ void CalculateScale(float context_width, float context_height,
 namespace LB {
 
 VideoOverlay::VideoOverlay(LBGraphics* graphics,
-                           LBWebGraphicsContext3D* context) {
+                           LBWebGraphicsContext3D* context)
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+    : presented_frames_("Media.Video.Presentation.Frames", 0,
+                        "Video frames put on screen")
+    , dropped_frames_("Media.Video.Presentation.Drops", 0,
+                      "Video frames released without being put on screen")
+    , repeated_frames_("Media.Video.Presentation.Repeats", 0,
+                       "Refreshes that showed a video frame past its time")
+    , average_jitter_("Media.Video.Presentation.Jitter", 0,
+                      "Average distance in ms between the time video frames "
+                      "were put on screen and their timestamps")
+    , jitter_histogram_("Media.Video.Presentation.JitterHistogram", "",
+                        "Number of video frames put on screen per jitter "
+                        "range")
+    , refresh_rate_("Media.Video.Presentation.RefreshRate", 0,
+                    "Display refresh rate in Hz measured from buffer flips")
+#endif  // !defined(__LB_SHELL__FOR_RELEASE__)
+{
   DCHECK(!s_instance);
   s_instance = this;
   graphics_ = graphics;
   context_ = context;
   quad_drawer_.reset(new QuadDrawer(graphics_, context_));
-
-#if !defined(__LB_SHELL__FOR_RELEASE__)
-  dropped_frames_ = 0;
-  max_delay_in_microseconds_ = 0;
-#endif  // !defined(__LB_SHELL__FOR_RELEASE__)
+  for (size_t i = 0; i < arraysize(plane_textures_); ++i)
+    plane_textures_[i] = 0;
 }
 
 VideoOverlay::~VideoOverlay() {
   DCHECK_EQ(s_instance, this);
+  DeletePlaneTextures();
   s_instance = NULL;
 }
 
@@ -97,38 +131,27 @@ VideoOverlay* VideoOverlay::Instance() {
 }
 
 void VideoOverlay::Render() {
-  const int kEpsilonInMicroseconds =
-      base::Time::kMicrosecondsPerSecond / 60 / 2;
+  // The frame drawn now is displayed on the next flip, so pick the frame for
+  // the media time at that flip rather than the current one.
+  scheduler_.OnFlip(graphics_->GetLastFlipTime());
+  base::TimeTicks now = base::TimeTicks::HighResNow();
+  base::TimeDelta media_time = media::Pipeline::GetCurrentTime() +
+                               (scheduler_.PredictNextFlip(now) - now);
 
   base::AutoLock auto_lock(frames_lock_);
 
-  base::TimeDelta media_time = media::Pipeline::GetCurrentTime();
-  while (!frames_.empty()) {
-    int64_t frame_time = frames_[0]->GetTimestamp().InMicroseconds();
-    if (frame_time >= media_time.InMicroseconds())
-      break;
-    if (current_frame_ != frames_[0] &&
-        frame_time + kEpsilonInMicroseconds >= media_time.InMicroseconds())
-      break;
+  frame_timestamps_.clear();
+  for (size_t i = 0; i < frames_.size(); ++i)
+    frame_timestamps_.push_back(frames_[i]->GetTimestamp());
+  int selected = scheduler_.SelectFrame(frame_timestamps_, media_time);
+  if (selected >= 0) {
+    frames_.erase(frames_.begin(), frames_.begin() + selected);
+    current_frame_ = frames_[0];
+  }
 #if !defined(__LB_SHELL__FOR_RELEASE__)
-    if (current_frame_ != frames_[0]) {
-      ++dropped_frames_;
-      if (media_time.InMicroseconds() - frame_time > max_delay_in_microseconds_)
-        max_delay_in_microseconds_ = media_time.InMicroseconds() - frame_time;
-      DLOG(WARNING)
-          << "VideoOverlay::Render() : dropped one frame with timestamp "
-          << frames_[0]->GetTimestamp().InMicroseconds()
-          << " at media time " << media_time.InMicroseconds()
-          << " total dropped " << dropped_frames_
-          << " frames with a max delay of " << max_delay_in_microseconds_
-          << " ms";
-    }
+  UpdatePresentationStats();
 #endif  // !defined(__LB_SHELL__FOR_RELEASE__)
 
-    frames_.erase(frames_.begin());
-  }
-  if (!frames_.empty())
-    current_frame_ = frames_[0];
   if (current_frame_)
     DrawCurrentFrame();
 }
@@ -141,8 +164,11 @@ void VideoOverlay::AddFrame(const scoped_refptr<media::VideoFrame>& frame) {
 void VideoOverlay::ClearFrames(bool stopped) {
   base::AutoLock auto_lock(frames_lock_);
   frames_.clear();
-  if (stopped)
+  scheduler_.Reset();
+  if (stopped) {
     current_frame_ = NULL;
+    uploaded_frame_ = NULL;
+  }
 }
 
 void VideoOverlay::DrawCurrentFrame() {
@@ -166,8 +192,116 @@ void VideoOverlay::DrawCurrentFrame() {
                  current_frame_->visible_rect().height(),
                  scales);
 
-  quad_drawer_->DrawQuadTex(current_frame_->texture_id(), 0, 0,
-                            scales[0], scales[1], 0, coords);
+  if (!IsSoftwareYUVFrame(current_frame_)) {
+    quad_drawer_->DrawQuadTex(current_frame_->texture_id(), 0, 0,
+                              scales[0], scales[1], 0, coords);
+    return;
+  }
+
+  if (uploaded_frame_ != current_frame_)
+    UploadFramePlanes(current_frame_);
+
+  QuadDrawer::YUVColorSpace color_space =
+      current_frame_->visible_rect().height() > kMaxBT601Height ?
+          QuadDrawer::kYUVColorSpaceBT709 : QuadDrawer::kYUVColorSpaceBT601;
+  quad_drawer_->DrawQuadYUV(plane_textures_, 0, 0,
+                            scales[0], scales[1], 0, coords, color_space);
+}
+
+void VideoOverlay::UploadFramePlanes(
+    const scoped_refptr<media::VideoFrame>& frame) {
+  // Plane rows are tightly packed in the transfer memory.
+  context_->pixelStorei(GraphicsContext3D::UNPACK_ALIGNMENT, 1);
+
+  for (size_t plane = 0; plane < arraysize(plane_textures_); ++plane) {
+    int width = frame->row_bytes(plane);
+    int height = frame->rows(plane);
+    const uint8* source = frame->data(plane);
+    int stride = frame->stride(plane);
+
+    if (!plane_textures_[plane])
+      plane_textures_[plane] = context_->createTexture();
+    context_->bindTexture(GraphicsContext3D::TEXTURE_2D,
+                          plane_textures_[plane]);
+    if (plane_texture_sizes_[plane] != gfx::Size(width, height)) {
+      context_->texImage2D(GraphicsContext3D::TEXTURE_2D, 0,
+                           GraphicsContext3D::LUMINANCE, width, height, 0,
+                           GraphicsContext3D::LUMINANCE,
+                           GraphicsContext3D::UNSIGNED_BYTE, NULL);
+      plane_texture_sizes_[plane] = gfx::Size(width, height);
+    }
+
+    // Write the plane straight into the command buffer's transfer memory,
+    // which saves texSubImage2D() copying it there itself.
+    uint8* dest = static_cast<uint8*>(context_->mapTexSubImage2DCHROMIUM(
+        GraphicsContext3D::TEXTURE_2D, 0, 0, 0, width, height,
+        GraphicsContext3D::LUMINANCE, GraphicsContext3D::UNSIGNED_BYTE,
+        kWriteOnly));
+    if (dest) {
+      for (int row = 0; row < height; ++row)
+        memcpy(dest + row * width, source + row * stride, width);
+      context_->unmapTexSubImage2DCHROMIUM(dest);
+    } else if (stride == width) {
+      context_->texSubImage2D(GraphicsContext3D::TEXTURE_2D, 0, 0, 0,
+                              width, height, GraphicsContext3D::LUMINANCE,
+                              GraphicsContext3D::UNSIGNED_BYTE, source);
+    } else {
+      for (int row = 0; row < height; ++row) {
+        context_->texSubImage2D(GraphicsContext3D::TEXTURE_2D, 0, 0, row,
+                                width, 1, GraphicsContext3D::LUMINANCE,
+                                GraphicsContext3D::UNSIGNED_BYTE,
+                                source + row * stride);
+      }
+    }
+  }
+
+  context_->bindTexture(GraphicsContext3D::TEXTURE_2D, 0);
+  context_->pixelStorei(GraphicsContext3D::UNPACK_ALIGNMENT, 4);
+  uploaded_frame_ = frame;
+}
+
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+void VideoOverlay::UpdatePresentationStats() {
+  const VideoFrameScheduler::Stats& stats = scheduler_.stats();
+  if (stats.presented_frames == presented_frames_ &&
+      stats.dropped_frames == dropped_frames_ &&
+      stats.repeated_frames == repeated_frames_) {
+    return;
+  }
+
+  refresh_rate_ = 1.0 / scheduler_.refresh_interval().InSecondsF();
+  presented_frames_ = stats.presented_frames;
+  dropped_frames_ = stats.dropped_frames;
+  repeated_frames_ = stats.repeated_frames;
+  if (stats.presented_frames) {
+    average_jitter_ =
+        stats.total_jitter.InMillisecondsF() / stats.presented_frames;
+  }
+
+  std::string histogram;
+  for (int i = 0; i < VideoFrameScheduler::kJitterBuckets; ++i) {
+    if (i < VideoFrameScheduler::kJitterBuckets - 1) {
+      base::StringAppendF(
+          &histogram, "<%dms:%d ",
+          VideoFrameScheduler::kJitterBucketLimitsInMilliseconds[i],
+          stats.jitter_histogram[i]);
+    } else {
+      base::StringAppendF(
+          &histogram, ">=%dms:%d",
+          VideoFrameScheduler::kJitterBucketLimitsInMilliseconds[i - 1],
+          stats.jitter_histogram[i]);
+    }
+  }
+  jitter_histogram_ = histogram;
+}
+#endif  // !defined(__LB_SHELL__FOR_RELEASE__)
+
+void VideoOverlay::DeletePlaneTextures() {
+  for (size_t i = 0; i < arraysize(plane_textures_); ++i) {
+    if (plane_textures_[i])
+      context_->deleteTexture(plane_textures_[i]);
+    plane_textures_[i] = 0;
+  }
 }
 
 }  // namespace LB
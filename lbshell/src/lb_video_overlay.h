@@ -16,13 +16,17 @@
 #ifndef SRC_LB_VIDEO_OVERLAY_H_
 #define SRC_LB_VIDEO_OVERLAY_H_
 
+#include <string>
 #include <vector>
 #include "base/synchronization/lock.h"
 #include "base/memory/scoped_ptr.h"
+#include "lb_console_values.h"
 #include "lb_gl_image_utils.h"
 #include "lb_graphics.h"
+#include "lb_video_frame_scheduler.h"
 #include "lb_web_graphics_context_3d.h"
 #include "media/base/video_frame.h"
+#include "ui/gfx/size.h"
 
 namespace LB {
 
@@ -41,6 +45,14 @@ class VideoOverlay {
 
  private:
   void DrawCurrentFrame();
+  // Copies the planes of a software decoded frame into plane_textures_
+  // through mapped transfer memory, so no colour conversion happens on the
+  // CPU and the planes are only copied once on their way to the GPU.
+  void UploadFramePlanes(const scoped_refptr<media::VideoFrame>& frame);
+  void DeletePlaneTextures();
+#if !defined(__LB_SHELL__FOR_RELEASE__)
+  void UpdatePresentationStats();
+#endif  // !defined(__LB_SHELL__FOR_RELEASE__)
 
   LBGraphics* graphics_;
   LBWebGraphicsContext3D* context_;  // The context we write our commands to
@@ -49,10 +61,26 @@ class VideoOverlay {
   base::Lock frames_lock_;
   std::vector<scoped_refptr<media::VideoFrame> > frames_;
   scoped_refptr<media::VideoFrame> current_frame_;
+  // Picks the frame to show on each refresh, only used by Render().
+  VideoFrameScheduler scheduler_;
+  // The timestamps of frames_, kept around to save an allocation per Render().
+  std::vector<base::TimeDelta> frame_timestamps_;
+
+  // LUMINANCE textures holding the Y, U and V planes of uploaded_frame_,
+  // 0 until they are first needed.
+  int plane_textures_[3];
+  gfx::Size plane_texture_sizes_[3];
+  // The software decoded frame last uploaded to plane_textures_.  A frame
+  // stays current for several Render() calls but is only uploaded once.
+  scoped_refptr<media::VideoFrame> uploaded_frame_;
 
 #if !defined(__LB_SHELL__FOR_RELEASE__)
-  int dropped_frames_;
-  int max_delay_in_microseconds_;
+  LB::CVal<int> presented_frames_;
+  LB::CVal<int> dropped_frames_;
+  LB::CVal<int> repeated_frames_;
+  LB::CVal<double> average_jitter_;
+  LB::CVal<std::string> jitter_histogram_;
+  LB::CVal<double> refresh_rate_;
 #endif  // !defined(__LB_SHELL__FOR_RELEASE__)
 };
 
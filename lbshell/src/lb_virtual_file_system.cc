@@ -16,16 +16,72 @@
 
 #include "lb_virtual_file_system.h"
 
+#include <algorithm>
+
+#include "base/hash.h"
 #include "base/logging.h"
 
 namespace {
 // Update this any time the serialization format changes.
 const char *kVersion = "SAV0";
+const char *kTrailerVersion = "SID0";
+const char *kJournalVersion = "JNL0";
+
+// Flags of a file's journal entry.
+const unsigned int kJournalFileCreated = 1;
+const unsigned int kJournalFileDeleted = 2;
+
+// The journal is not worth compacting before it reaches this size.
+const int kMinJournalCompactionSize = 64 * 1024;
+
+unsigned int FourCC(const char *tag) {
+  DCHECK_EQ(strlen(tag), 4);
+  unsigned int value;
+  memcpy(&value, tag, sizeof(value));
+  return value;
+}
+
+void AppendToBuffer(char *buffer, int *position, const void *src, size_t size,
+                    bool dry_run) {
+  if (!dry_run)
+    memcpy(buffer + *position, src, size);
+  *position += size;
+}
+
+bool ReadFromBuffer(void *dst, const char *buffer, int size, int *position,
+                    size_t bytes) {
+  if (static_cast<int>(bytes) > size - *position)
+    return false;
+  memcpy(dst, buffer + *position, bytes);
+  *position += bytes;
+  return true;
 }
 
+// Returns the number of bytes of the journal entry of a deleted file.
+int SerializeDeletedFile(const std::string &name, char *buffer,
+                         bool dry_run) {
+  int position = 0;
+  size_t name_length = name.length();
+  AppendToBuffer(buffer, &position, &name_length, sizeof(size_t), dry_run);
+  AppendToBuffer(buffer, &position, name.data(), name_length, dry_run);
+  AppendToBuffer(buffer, &position, &kJournalFileDeleted,
+                 sizeof(kJournalFileDeleted), dry_run);
+  size_t zero = 0;
+  AppendToBuffer(buffer, &position, &zero, sizeof(size_t), dry_run);  // size
+  AppendToBuffer(buffer, &position, &zero, sizeof(size_t), dry_run);  // pages
+  return position;
+}
+
+}  // namespace
+
 // ---------------- LBVirtualFile Methods -------------------
 
-LBVirtualFile::LBVirtualFile(const std::string &name) : size_(0) {
+const size_t LBVirtualFile::kPageSize;
+
+LBVirtualFile::LBVirtualFile(const std::string &name)
+    : size_(0)
+    , created_(true)
+    , size_changed_(false) {
   name_.assign(name);
 }
 
@@ -47,11 +103,20 @@ int LBVirtualFile::Write(const void *data, const size_t bytes,
 
   memcpy(&buffer_[offset], data, bytes);
   size_ = std::max<int>(size_, offset + bytes);
+  if (bytes > 0) {
+    for (size_t page = offset / kPageSize;
+         page <= (offset + bytes - 1) / kPageSize; ++page) {
+      dirty_pages_.insert(page);
+    }
+  }
   return bytes;
 }
 
 int LBVirtualFile::Truncate(const size_t size) {
-  size_ = std::min(size_, size);
+  if (size < size_) {
+    size_ = size;
+    size_changed_ = true;
+  }
   return size_;
 }
 
@@ -106,6 +171,101 @@ int LBVirtualFile::Deserialize(const void *buffer) {
   return serialize_position_;
 }
 
+int LBVirtualFile::SerializeChanges(void *buffer, const bool dry_run) {
+  serialize_position_ = 0;
+
+  size_t name_length = name_.length();
+  DCHECK_LT(name_length, MAX_VFS_PATHNAME);
+  WriteBuffer(buffer, &name_length, sizeof(size_t), dry_run);
+  WriteBuffer(buffer, name_.data(), name_length, dry_run);
+
+  unsigned int flags = created_ ? kJournalFileCreated : 0;
+  WriteBuffer(buffer, &flags, sizeof(flags), dry_run);
+  WriteBuffer(buffer, &size_, sizeof(size_t), dry_run);
+
+  // Pages that were truncated away since they were written are left out.
+  size_t page_count = 0;
+  for (std::set<size_t>::const_iterator itr = dirty_pages_.begin();
+       itr != dirty_pages_.end() && *itr * kPageSize < size_; ++itr) {
+    ++page_count;
+  }
+  WriteBuffer(buffer, &page_count, sizeof(size_t), dry_run);
+
+  std::set<size_t>::const_iterator itr = dirty_pages_.begin();
+  for (size_t i = 0; i < page_count; ++i, ++itr) {
+    size_t page = *itr;
+    size_t offset = page * kPageSize;
+    WriteBuffer(buffer, &page, sizeof(size_t), dry_run);
+    WriteBuffer(buffer, &buffer_[offset], std::min(kPageSize, size_ - offset),
+                dry_run);
+  }
+
+  return serialize_position_;
+}
+
+// static
+int LBVirtualFile::DeserializeChanges(LBVirtualFileSystem *vfs,
+                                      const char *buffer, int size) {
+  int position = 0;
+
+  size_t name_length;
+  char name[MAX_VFS_PATHNAME];
+  unsigned int flags;
+  size_t file_size;
+  size_t page_count;
+  if (!ReadFromBuffer(&name_length, buffer, size, &position, sizeof(size_t)) ||
+      name_length >= sizeof(name) ||
+      !ReadFromBuffer(name, buffer, size, &position, name_length) ||
+      !ReadFromBuffer(&flags, buffer, size, &position, sizeof(flags)) ||
+      !ReadFromBuffer(&file_size, buffer, size, &position, sizeof(size_t)) ||
+      !ReadFromBuffer(&page_count, buffer, size, &position, sizeof(size_t))) {
+    return -1;
+  }
+  std::string filename(name, name_length);
+
+  if (flags & kJournalFileDeleted) {
+    if (vfs)
+      vfs->Delete(filename);
+    return position;
+  }
+
+  LBVirtualFile *file = vfs ? vfs->Open(filename) : NULL;
+  if (file && (flags & kJournalFileCreated)) {
+    // The file was deleted and created again after the previous record, none
+    // of its old contents are left.
+    file->buffer_.clear();
+    file->size_ = 0;
+  }
+
+  for (size_t i = 0; i < page_count; ++i) {
+    size_t page;
+    if (!ReadFromBuffer(&page, buffer, size, &position, sizeof(size_t)))
+      return -1;
+    size_t offset = page * kPageSize;
+    if (offset >= file_size)
+      return -1;
+    size_t bytes = std::min(kPageSize, file_size - offset);
+    if (static_cast<int>(bytes) > size - position)
+      return -1;
+    if (file)
+      file->Write(buffer + position, bytes, offset);
+    position += bytes;
+  }
+
+  if (!file)
+    return position;
+  if (file->buffer_.size() < file_size)
+    file->buffer_.resize(file_size);
+  file->size_ = file_size;
+  return position;
+}
+
+void LBVirtualFile::ClearDirtyState() {
+  dirty_pages_.clear();
+  created_ = false;
+  size_changed_ = false;
+}
+
 void LBVirtualFile::WriteBuffer(void *buffer, const void *src, size_t size,
                                 bool dry_run) {
   if (!dry_run)
@@ -121,7 +281,12 @@ void LBVirtualFile::ReadBuffer(void *dst, const void *buffer, size_t size) {
 
 // ---------------- LBVirtualFileSystem Methods -------------------
 
-LBVirtualFileSystem::LBVirtualFileSystem() { }
+LBVirtualFileSystem::LBVirtualFileSystem()
+    : snapshot_id_(0)
+    , snapshot_size_(0)
+    , next_sequence_number_(0)
+    , journal_size_(0) {
+}
 
 LBVirtualFileSystem::~LBVirtualFileSystem() {
   for (FileTable::iterator itr = table_.begin(); itr != table_.end(); ++itr) {
@@ -134,6 +299,8 @@ LBVirtualFile* LBVirtualFileSystem::Open(std::string filename) {
   if (!result) {
     result = new LBVirtualFile(filename);
     table_[filename] = result;
+    // The created file's journal entry replaces any deleted one.
+    deleted_files_.erase(filename);
   }
   return result;
 }
@@ -142,6 +309,7 @@ void LBVirtualFileSystem::Delete(std::string filename) {
   if (table_.find(filename) != table_.end()) {
     delete table_[filename];
     table_.erase(filename);
+    deleted_files_.insert(filename);
   }
 }
 
@@ -157,6 +325,16 @@ int LBVirtualFileSystem::Serialize(char *buffer, const bool dry_run) {
     buffer += bytes;
   }
 
+  SerializedTrailer trailer;
+  if (!dry_run) {
+    trailer.version = FourCC(kTrailerVersion);
+    trailer.snapshot_id = base::Hash(original + sizeof(SerializedHeader),
+                                     buffer - original -
+                                         sizeof(SerializedHeader));
+    memcpy(buffer, &trailer, sizeof(SerializedTrailer));
+  }
+  buffer += sizeof(SerializedTrailer);
+
   if (!dry_run) {
     // Now we can write the header to the beginning of the buffer.
     SerializedHeader header;
@@ -164,6 +342,9 @@ int LBVirtualFileSystem::Serialize(char *buffer, const bool dry_run) {
     header.file_count = table_.size();
     header.file_size = buffer - original;
     memcpy(original, &header, sizeof(SerializedHeader));
+
+    // Everything is in the snapshot now, so the journal starts over.
+    StartJournal(trailer.snapshot_id, header.file_size);
   }
 
   return buffer - original;
@@ -178,7 +359,11 @@ void LBVirtualFileSystem::Deserialize(const char *buffer) {
   }
   table_.clear();
 
+  // Without a snapshot, there is no journal to apply.
+  StartJournal(0, 0);
+
   // Read in expected number of files
+  const char *original = buffer;
   SerializedHeader header;
   memcpy(&header, buffer, sizeof(SerializedHeader));
   buffer += sizeof(SerializedHeader);
@@ -207,18 +392,156 @@ void LBVirtualFileSystem::Deserialize(const char *buffer) {
         delete itr->second;
       }
       table_.clear();
-      break;
+      return;
     }
 
     buffer += bytes;
 
     table_[file->name_] = file;
   }
+
+  // Snapshots written before the trailer existed are identified by their
+  // contents instead.
+  SerializedTrailer trailer;
+  size_t read_size = buffer - original;
+  unsigned int files_size = read_size - sizeof(SerializedHeader);
+  if (header.file_size >= read_size + sizeof(SerializedTrailer)) {
+    memcpy(&trailer, buffer, sizeof(SerializedTrailer));
+  } else {
+    trailer.version = 0;
+  }
+  if (trailer.version != FourCC(kTrailerVersion)) {
+    trailer.snapshot_id =
+        base::Hash(original + sizeof(SerializedHeader), files_size);
+  }
+  StartJournal(trailer.snapshot_id, header.file_size);
+}
+
+int LBVirtualFileSystem::SerializeJournalRecord(char *buffer,
+                                                const bool dry_run) {
+  int position = sizeof(JournalRecordHeader);
+  unsigned int entry_count = 0;
+
+  for (std::set<std::string>::iterator itr = deleted_files_.begin();
+       itr != deleted_files_.end(); ++itr) {
+    position += SerializeDeletedFile(*itr, buffer + position, dry_run);
+    ++entry_count;
+  }
+  for (FileTable::iterator itr = table_.begin(); itr != table_.end(); ++itr) {
+    if (itr->second->dirty()) {
+      position += itr->second->SerializeChanges(buffer + position, dry_run);
+      ++entry_count;
+    }
+  }
+
+  if (entry_count == 0)
+    return 0;
+
+  if (!dry_run) {
+    JournalRecordHeader header;
+    header.version = FourCC(kJournalVersion);
+    header.snapshot_id = snapshot_id_;
+    header.sequence_number = next_sequence_number_;
+    header.entry_count = entry_count;
+    header.payload_size = position - sizeof(JournalRecordHeader);
+    header.checksum = base::Hash(buffer + sizeof(JournalRecordHeader),
+                                 header.payload_size);
+    memcpy(buffer, &header, sizeof(JournalRecordHeader));
+
+    ++next_sequence_number_;
+    journal_size_ += position;
+    deleted_files_.clear();
+    for (FileTable::iterator itr = table_.begin(); itr != table_.end();
+         ++itr) {
+      itr->second->ClearDirtyState();
+    }
+  }
+
+  return position;
+}
+
+int LBVirtualFileSystem::ApplyJournal(const char *buffer, int size) {
+  if (!snapshot_size_)
+    return 0;
+
+  int position = 0;
+  while (size - position >= static_cast<int>(sizeof(JournalRecordHeader))) {
+    JournalRecordHeader header;
+    memcpy(&header, buffer + position, sizeof(JournalRecordHeader));
+    if (header.version != FourCC(kJournalVersion) ||
+        header.snapshot_id != snapshot_id_ ||
+        header.sequence_number != next_sequence_number_) {
+      // Left over from an older snapshot, or garbage.
+      break;
+    }
+
+    const char *payload = buffer + position + sizeof(JournalRecordHeader);
+    int payload_size = header.payload_size;
+    if (payload_size < 0 ||
+        payload_size > size - position -
+                       static_cast<int>(sizeof(JournalRecordHeader)) ||
+        base::Hash(payload, payload_size) != header.checksum) {
+      DLOG(WARNING) << "Dropping a torn or corrupt savegame journal record.";
+      break;
+    }
+
+    // The checksum can still match a bad record by chance, so the entries
+    // are all checked before any of them is applied.
+    if (!IsValidJournalPayload(payload, payload_size, header.entry_count)) {
+      DLOG(WARNING) << "Dropping a savegame journal record that doesn't parse.";
+      break;
+    }
+    int offset = 0;
+    for (unsigned int i = 0; i < header.entry_count; ++i) {
+      offset += LBVirtualFile::DeserializeChanges(
+          this, payload + offset, payload_size - offset);
+    }
+
+    position += sizeof(JournalRecordHeader) + payload_size;
+    ++next_sequence_number_;
+  }
+
+  // The replayed changes are already saved.
+  journal_size_ = position;
+  deleted_files_.clear();
+  for (FileTable::iterator itr = table_.begin(); itr != table_.end(); ++itr)
+    itr->second->ClearDirtyState();
+  return position;
+}
+
+// static
+bool LBVirtualFileSystem::IsValidJournalPayload(const char *payload,
+                                                int size,
+                                                unsigned int entry_count) {
+  int offset = 0;
+  for (unsigned int i = 0; i < entry_count; ++i) {
+    int bytes = LBVirtualFile::DeserializeChanges(NULL, payload + offset,
+                                                  size - offset);
+    if (bytes < 0)
+      return false;
+    offset += bytes;
+  }
+  return offset == size;
+}
+
+bool LBVirtualFileSystem::JournalNeedsCompaction() const {
+  if (!snapshot_size_)
+    return true;
+  return journal_size_ > std::max(kMinJournalCompactionSize,
+                                  snapshot_size_ / 2);
+}
+
+void LBVirtualFileSystem::StartJournal(unsigned int snapshot_id,
+                                       int snapshot_size) {
+  snapshot_id_ = snapshot_id;
+  snapshot_size_ = snapshot_size;
+  next_sequence_number_ = 0;
+  journal_size_ = 0;
+  deleted_files_.clear();
+  for (FileTable::iterator itr = table_.begin(); itr != table_.end(); ++itr)
+    itr->second->ClearDirtyState();
 }
 
 unsigned int LBVirtualFileSystem::GetVersion() const {
-  DCHECK_EQ(strlen(kVersion), 4);
-  int version;
-  memcpy(&version, kVersion, sizeof(version));
-  return version;
+  return FourCC(kVersion);
 }
@@ -20,8 +20,15 @@
 // These classes implement a simple virtual filesystem, primarily intended to
 // be used for simulating a filesystem that SQLite can write to, and allowing
 // that filesystem to be saved out into a single memory buffer.
+//
+// Besides full snapshots, the filesystem can save out journal records which
+// only hold the pages written since the last snapshot or record.  Records are
+// meant to be appended to a journal next to the snapshot, and are checksummed
+// and tied to the snapshot they follow, so a torn append or a journal left
+// over from an older snapshot is ignored when the journal is replayed.
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -33,6 +40,9 @@ class LBVirtualFileSystem;
 
 class LBVirtualFile {
  public:
+  // Writes are tracked in pages of this size for the journal.
+  static const size_t kPageSize = 4096;
+
   int Read(void *out, const size_t bytes, const int offset) const;
   int Write(const void *data, const size_t bytes, const int offset);
 
@@ -48,6 +58,20 @@ class LBVirtualFile {
   int Serialize(void *buffer, const bool dry_run);
   int Deserialize(const void *buffer);
 
+  // Same as above for the journal entry of this file, which holds its size
+  // and the pages written since the dirty state was last cleared.
+  int SerializeChanges(void *buffer, const bool dry_run);
+  // Applies a journal entry read from |buffer|, or only checks that it
+  // parses if |vfs| is NULL.  Returns the number of bytes read, or -1 if the
+  // entry doesn't fit in |size| bytes.
+  static int DeserializeChanges(LBVirtualFileSystem *vfs, const char *buffer,
+                                int size);
+
+  bool dirty() const {
+    return created_ || size_changed_ || !dirty_pages_.empty();
+  }
+  void ClearDirtyState();
+
   void WriteBuffer(void *buffer, const void *src, size_t size, bool dry_run);
   void ReadBuffer(void *dst, const void *buffer, size_t size);
 
@@ -58,6 +82,12 @@ class LBVirtualFile {
 
   int serialize_position_;
 
+  // Pages written, whether the file was created, and whether it was
+  // truncated since the dirty state was last cleared.
+  std::set<size_t> dirty_pages_;
+  bool created_;
+  bool size_changed_;
+
   friend class LBVirtualFileSystem;
   DISALLOW_COPY_AND_ASSIGN(LBVirtualFile);
 };
@@ -71,6 +101,25 @@ class LBVirtualFileSystem {
     unsigned int file_count;
   };
 
+  // Follows the files in a snapshot and identifies it to the journal records
+  // written after it.  Snapshots written before it existed don't have one.
+  struct SerializedTrailer {
+    unsigned int version;
+    unsigned int snapshot_id;
+  };
+
+  struct JournalRecordHeader {
+    unsigned int version;
+    // The snapshot the record applies to, and the position of the record in
+    // the journal of that snapshot.
+    unsigned int snapshot_id;
+    unsigned int sequence_number;
+    unsigned int entry_count;
+    // Size and checksum of the entries following the header.
+    unsigned int payload_size;
+    unsigned int checksum;
+  };
+
   LBVirtualFileSystem();
   ~LBVirtualFileSystem();
 
@@ -82,6 +131,22 @@ class LBVirtualFileSystem {
   // Deserializes a file system from a memory buffer
   void Deserialize(const char *buffer);
 
+  // Serializes a journal record with the changes made since the last
+  // snapshot or record was serialized, or returns 0 if there are none.
+  // A dry run only calculates the number of bytes needed.  Returns the number
+  // of bytes written.
+  int SerializeJournalRecord(char *buffer, const bool dry_run);
+
+  // Replays the journal records in |buffer| on top of the last deserialized
+  // snapshot, stopping at the first record that is torn, corrupt or doesn't
+  // follow the previous one.  Returns the number of bytes of valid records,
+  // which is where the next record should be appended.
+  int ApplyJournal(const char *buffer, int size);
+
+  // Returns true once the journal has grown large enough relative to the
+  // snapshot that a new snapshot should be written instead of another record.
+  bool JournalNeedsCompaction() const;
+
   // Simple file open. Will create a file if it does not exist, and files are
   // always readable and writable.
   LBVirtualFile* Open(std::string filename);
@@ -91,8 +156,27 @@ class LBVirtualFileSystem {
  private:
   unsigned int GetVersion() const;
 
+  // Returns true if the |size| bytes at |payload| are exactly |entry_count|
+  // journal entries.
+  static bool IsValidJournalPayload(const char *payload, int size,
+                                    unsigned int entry_count);
+
+  // Marks every file clean and starts the journal of a new snapshot.
+  void StartJournal(unsigned int snapshot_id, int snapshot_size);
+
   typedef std::map<std::string, LBVirtualFile *> FileTable;
   FileTable table_;
+
+  // Files deleted since the last snapshot or journal record.
+  std::set<std::string> deleted_files_;
+
+  unsigned int snapshot_id_;
+  int snapshot_size_;
+  unsigned int next_sequence_number_;
+  // Total size of the journal records of the current snapshot.
+  int journal_size_;
+
+  friend class LBVirtualFile;
 };
 
 #endif  // SRC_LB_VIRTUAL_FILE_SYSTEM_H_
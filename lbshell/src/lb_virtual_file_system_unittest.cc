@@ -16,7 +16,10 @@
 
 #include "lb_virtual_file_system.h"
 
+#include <vector>
+
 #include "base/compiler_specific.h"
+#include "base/hash.h"
 #include "external/chromium/testing/gtest/include/gtest/gtest.h"
 
 #if defined(__LB_PS4__) || defined(__LB_XB360__)
@@ -147,4 +150,123 @@ TEST_F(VirtualFileSystemTest, SerializeDeserialize) {
 
   delete [] buffer;
 }
+TEST_F(VirtualFileSystemTest, JournalReplaysChanges) {
+  LBVirtualFile *file = vfs_->Open("file1.tmp");
+  std::vector<char> data(3 * LBVirtualFile::kPageSize, 'a');
+  file->Write(&data[0], data.size(), 0);
+  vfs_->Open("file2.tmp")->Write("xyz", 3, 0);
+
+  std::vector<char> snapshot(vfs_->Serialize(NULL, true /*dry run*/));
+  vfs_->Serialize(&snapshot[0], false /*dry run*/);
+  EXPECT_EQ(0, vfs_->SerializeJournalRecord(NULL, true /*dry run*/));
+
+  // Change one page of file1, delete file2 and create file3.
+  file->Write("bb", 2, LBVirtualFile::kPageSize + 10);
+  vfs_->Delete("file2.tmp");
+  vfs_->Open("file3.tmp")->Write("new", 3, 0);
+
+  std::vector<char> journal(vfs_->SerializeJournalRecord(NULL, true));
+  vfs_->SerializeJournalRecord(&journal[0], false);
+  // Only the written page is in the record.
+  EXPECT_LT(journal.size(), 2 * LBVirtualFile::kPageSize);
+
+  file->Truncate(LBVirtualFile::kPageSize + 11);
+  int first_record_size = journal.size();
+  journal.resize(first_record_size + vfs_->SerializeJournalRecord(NULL, true));
+  vfs_->SerializeJournalRecord(&journal[first_record_size], false);
+
+  LBVirtualFileSystem new_vfs;
+  new_vfs.Deserialize(&snapshot[0]);
+  EXPECT_EQ(journal.size(), new_vfs.ApplyJournal(&journal[0], journal.size()));
+
+  char file_contents[16];
+  file = new_vfs.Open("file1.tmp");
+  EXPECT_EQ(LBVirtualFile::kPageSize + 11, file->Size());
+  EXPECT_EQ(3, file->Read(file_contents, sizeof(file_contents),
+                          LBVirtualFile::kPageSize + 8));
+  EXPECT_EQ(0, memcmp(file_contents, "aab", 3));
+  file = new_vfs.Open("file2.tmp");
+  EXPECT_EQ(0, file->Size());
+  file = new_vfs.Open("file3.tmp");
+  EXPECT_EQ(3, file->Read(file_contents, sizeof(file_contents), 0));
+  EXPECT_EQ(0, memcmp(file_contents, "new", 3));
+}
+
+TEST_F(VirtualFileSystemTest, JournalStopsAtBadRecord) {
+  LBVirtualFile *file = vfs_->Open("file1.tmp");
+  file->Write("abc", 3, 0);
+  std::vector<char> snapshot(vfs_->Serialize(NULL, true /*dry run*/));
+  vfs_->Serialize(&snapshot[0], false /*dry run*/);
+
+  file->Write("d", 1, 3);
+  std::vector<char> journal(vfs_->SerializeJournalRecord(NULL, true));
+  vfs_->SerializeJournalRecord(&journal[0], false);
+  int first_record_size = journal.size();
+  file->Write("e", 1, 4);
+  journal.resize(first_record_size + vfs_->SerializeJournalRecord(NULL, true));
+  vfs_->SerializeJournalRecord(&journal[first_record_size], false);
+
+  // A torn append loses only the torn record.
+  LBVirtualFileSystem new_vfs;
+  new_vfs.Deserialize(&snapshot[0]);
+  EXPECT_EQ(first_record_size,
+            new_vfs.ApplyJournal(&journal[0], journal.size() - 1));
+  EXPECT_EQ(4, new_vfs.Open("file1.tmp")->Size());
+
+  // So does a corrupt one.
+  journal.back() ^= 1;
+  new_vfs.Deserialize(&snapshot[0]);
+  EXPECT_EQ(first_record_size,
+            new_vfs.ApplyJournal(&journal[0], journal.size()));
+  EXPECT_EQ(4, new_vfs.Open("file1.tmp")->Size());
+
+  // A journal doesn't apply to a different snapshot.
+  vfs_->Open("file2.tmp");
+  snapshot.resize(vfs_->Serialize(NULL, true /*dry run*/));
+  vfs_->Serialize(&snapshot[0], false /*dry run*/);
+  new_vfs.Deserialize(&snapshot[0]);
+  EXPECT_EQ(0, new_vfs.ApplyJournal(&journal[0], journal.size()));
+  EXPECT_FALSE(new_vfs.JournalNeedsCompaction());
+}
+
+TEST_F(VirtualFileSystemTest, JournalStopsAtRecordThatDoesNotParse) {
+  LBVirtualFile *file = vfs_->Open("file1.tmp");
+  file->Write("abc", 3, 0);
+  std::vector<char> snapshot(vfs_->Serialize(NULL, true /*dry run*/));
+  vfs_->Serialize(&snapshot[0], false /*dry run*/);
+
+  file->Write("d", 1, 3);
+  std::vector<char> journal(vfs_->SerializeJournalRecord(NULL, true));
+  vfs_->SerializeJournalRecord(&journal[0], false);
+  int first_record_size = journal.size();
+  file->Write("e", 1, 4);
+  vfs_->Open("file2.tmp")->Write("f", 1, 0);
+  journal.resize(first_record_size + vfs_->SerializeJournalRecord(NULL, true));
+  vfs_->SerializeJournalRecord(&journal[first_record_size], false);
+
+  // Give the second entry of the second record a name too long to read, and
+  // a checksum that matches anyway, as a hash collision would.
+  LBVirtualFileSystem::JournalRecordHeader header;
+  char *record = &journal[first_record_size];
+  memcpy(&header, record, sizeof(header));
+  ASSERT_EQ(2U, header.entry_count);
+  char *payload = record + sizeof(header);
+  size_t first_entry_size = 0;
+  memcpy(&first_entry_size, payload, sizeof(first_entry_size));
+  first_entry_size += sizeof(size_t) + sizeof(unsigned int) +
+                      3 * sizeof(size_t) + 5;
+  size_t bad_name_length = header.payload_size;
+  memcpy(payload + first_entry_size, &bad_name_length,
+         sizeof(bad_name_length));
+  header.checksum = base::Hash(payload, header.payload_size);
+  memcpy(record, &header, sizeof(header));
+
+  // None of the bad record is applied, and the journal is cut before it.
+  LBVirtualFileSystem new_vfs;
+  new_vfs.Deserialize(&snapshot[0]);
+  EXPECT_EQ(first_record_size,
+            new_vfs.ApplyJournal(&journal[0], journal.size()));
+  EXPECT_EQ(4, new_vfs.Open("file1.tmp")->Size());
+  EXPECT_EQ(0, new_vfs.Open("file2.tmp")->Size());
+}
 #endif  // __LB_PS4__
@@ -61,6 +61,8 @@ class LBWebAudioDeviceImpl
   virtual bool PullFrames(uint32_t* offset_in_frame,
                           uint32_t* total_frames) OVERRIDE;
   void ConsumeFrames(uint32_t frame_played);
+  virtual uint32_t GetReadableRegion(uint32_t skip_frames,
+                                     uint32_t* offset_in_frame) OVERRIDE;
   virtual const media::AudioParameters& GetAudioParameters() const OVERRIDE;
   virtual media::AudioBus* GetAudioBus() OVERRIDE;
 
@@ -244,6 +246,15 @@ void LBWebAudioDeviceImpl::ConsumeFrames(uint32_t frame_played) {
   rendered_frame_cursor_ += frame_played;
 }
 
+uint32_t LBWebAudioDeviceImpl::GetReadableRegion(uint32_t skip_frames,
+                                                 uint32_t* offset_in_frame) {
+  uint32_t total_frames = buffered_frame_cursor_ - rendered_frame_cursor_;
+  skip_frames = std::min(skip_frames, total_frames);
+  *offset_in_frame = (rendered_frame_cursor_ + skip_frames) % kFramesPerChannel;
+  return std::min<uint32_t>(total_frames - skip_frames,
+                            kFramesPerChannel - *offset_in_frame);
+}
+
 const media::AudioParameters& LBWebAudioDeviceImpl::GetAudioParameters() const {
   return audio_parameters_;
 }
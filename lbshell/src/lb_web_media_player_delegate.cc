@@ -16,13 +16,22 @@
 
 #include "lb_web_media_player_delegate.h"
 
+#include <algorithm>
+
 #include "third_party/WebKit/Source/WebKit/chromium/public/WebMediaPlayer.h"
 
 #include "lb_graphics.h"
+#include "lb_resource_loader_bridge.h"
 #include "lb_web_view_host.h"
 
 namespace {
 
+// Playing players that have less than this buffered ahead of their current
+// time hold back background network requests.
+const float kMediaBufferTargetInSeconds = 10.0f;
+// How often the buffers of the playing players are looked at.
+const int kMediaBufferCheckIntervalInMilliseconds = 500;
+
 MessageLoop* GetWebKitMessageLoop() {
   DCHECK(LBWebViewHost::Get());
   return LBWebViewHost::Get()->webkit_message_loop();
@@ -34,7 +43,8 @@ namespace webkit_media {
 
 LBWebMediaPlayerDelegate* LBWebMediaPlayerDelegate::instance_ = NULL;
 
-LBWebMediaPlayerDelegate::LBWebMediaPlayerDelegate() {
+LBWebMediaPlayerDelegate::LBWebMediaPlayerDelegate()
+    : media_buffer_low_(false) {
 }
 
 // static
@@ -65,6 +75,7 @@ void LBWebMediaPlayerDelegate::DidPlay(WebKit::WebMediaPlayer* player) {
   // add or update player map with this instance of the player
   player_map_[player] = true;
   SetDimmingState();
+  UpdateMediaBufferTimer();
 }
 
 void LBWebMediaPlayerDelegate::DidPause(WebKit::WebMediaPlayer* player) {
@@ -72,6 +83,7 @@ void LBWebMediaPlayerDelegate::DidPause(WebKit::WebMediaPlayer* player) {
 
   player_map_[player] = false;
   SetDimmingState();
+  UpdateMediaBufferTimer();
 }
 
 void LBWebMediaPlayerDelegate::PlayerGone(WebKit::WebMediaPlayer* player) {
@@ -83,6 +95,7 @@ void LBWebMediaPlayerDelegate::PlayerGone(WebKit::WebMediaPlayer* player) {
     player_map_.erase(it);
   }
   SetDimmingState();
+  UpdateMediaBufferTimer();
 }
 
 void LBWebMediaPlayerDelegate::PauseActivePlayers() {
@@ -134,5 +147,58 @@ void LBWebMediaPlayerDelegate::SetDimmingState() {
   }
 }
 
-}  // namespace webkit_media
+void LBWebMediaPlayerDelegate::UpdateMediaBufferTimer() {
+  bool any_playing = false;
+  for (PlayerMap::iterator it = player_map_.begin();
+       it != player_map_.end(); ++it) {
+    if (it->second) {
+      any_playing = true;
+      break;
+    }
+  }
+
+  if (!any_playing) {
+    media_buffer_timer_.Stop();
+    SetMediaBufferLow(false);
+  } else if (!media_buffer_timer_.IsRunning()) {
+    media_buffer_timer_.Start(FROM_HERE,
+        base::TimeDelta::FromMilliseconds(
+            kMediaBufferCheckIntervalInMilliseconds),
+        this, &LBWebMediaPlayerDelegate::CheckMediaBuffers);
+  }
+}
 
+void LBWebMediaPlayerDelegate::CheckMediaBuffers() {
+  DCHECK_EQ(MessageLoop::current(), GetWebKitMessageLoop());
+
+  bool low = false;
+  for (PlayerMap::iterator it = player_map_.begin();
+       it != player_map_.end() && !low; ++it) {
+    if (!it->second)
+      continue;
+    WebKit::WebMediaPlayer* player = it->first;
+    float current_time = player->currentTime();
+    // Nothing more can be buffered close to the end.
+    float target = std::min(current_time + kMediaBufferTargetInSeconds,
+                            player->duration());
+    float buffered_until = current_time;
+    const WebKit::WebTimeRanges& buffered = player->buffered();
+    for (size_t i = 0; i < buffered.size(); ++i) {
+      if (buffered[i].start <= current_time &&
+          buffered[i].end > buffered_until) {
+        buffered_until = buffered[i].end;
+      }
+    }
+    low = buffered_until < target;
+  }
+  SetMediaBufferLow(low);
+}
+
+void LBWebMediaPlayerDelegate::SetMediaBufferLow(bool low) {
+  if (media_buffer_low_ == low)
+    return;
+  media_buffer_low_ = low;
+  LBResourceLoaderBridge::SetMediaBufferLow(low);
+}
+
+}  // namespace webkit_media
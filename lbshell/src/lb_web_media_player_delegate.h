@@ -22,6 +22,7 @@
 
 #include "external/chromium/base/compiler_specific.h"
 #include "external/chromium/base/memory/weak_ptr.h"
+#include "external/chromium/base/timer.h"
 #include "external/chromium/webkit/media/webmediaplayer_delegate.h"
 
 #include <map>
@@ -58,12 +59,22 @@ class LB_SHELL_EXPORT LBWebMediaPlayerDelegate
   virtual ~LBWebMediaPlayerDelegate();
 
   void SetDimmingState();
+  // Checks the buffers of the playing players while there are any, see
+  // CheckMediaBuffers().
+  void UpdateMediaBufferTimer();
+  // Lets LBResourceLoaderBridge know whether any playing player has less
+  // media buffered ahead of its current time than it wants.
+  void CheckMediaBuffers();
+  void SetMediaBufferLow(bool low);
 
   // PlayerMap maps players to paused/play state (false/true)
   typedef std::map<WebKit::WebMediaPlayer*, bool> PlayerMap;
   PlayerMap player_map_;
   typedef std::list<WebKit::WebMediaPlayer*> PlayerList;
   PlayerList force_paused_list_;
+  base::RepeatingTimer<LBWebMediaPlayerDelegate> media_buffer_timer_;
+  // The last state reported to LBResourceLoaderBridge.
+  bool media_buffer_low_;
   static LBWebMediaPlayerDelegate* instance_;
 };
 
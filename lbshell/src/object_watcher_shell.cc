@@ -15,14 +15,23 @@
  */
 #include "object_watcher_shell.h"
 
+#if defined(__LB_LINUX__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
 #include <sys/poll.h>
+#endif
 
+#include <algorithm>
 #include <map>
 #include <stack>
 #include <vector>
 
 #include "base/bind.h"
+#include "base/hash_tables.h"
 #include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
 #include "base/synchronization/lock.h"
 #include "base/synchronization/waitable_event.h"
 #include "base/threading/simple_thread.h"
@@ -60,6 +69,188 @@ static void WatchTask(Watch * watch) {
   delete watch;
 }
 
+// Signals |watch| to run in the original thread context of the calling
+// thread message loop.  The watch will be posted as a task to the MessageLoop
+// which will take ownership of the object and delete it.
+static void SignalWatch(Watch * watch) {
+  watch->did_signal = true;
+  watch->origin_loop->PostTask(FROM_HERE, base::Bind(WatchTask, watch));
+}
+
+#if defined(__LB_LINUX__)
+// -----------------------------------------------------------------------------
+// ObjectWatchMultiplexer
+// this object runs an internal thread that blocks in epoll_wait() on every
+// watched file descriptor.  Watches are registered with epoll_ctl() straight
+// from the thread calling AddWatch(), so they take effect immediately and
+// adding or removing one never rebuilds anything.  An eventfd is registered
+// alongside them to wake the thread up for exit.
+//
+// Watches are one-shot, so each fd is registered with EPOLLONESHOT and only
+// re-armed while it still has watches left.  Re-arming with EPOLL_CTL_MOD
+// re-checks the fd's readiness, so a watch added after the fd became ready is
+// signaled right away rather than waiting for the next edge.
+class ObjectWatchMultiplexer : public base::SimpleThread {
+ public:
+  ObjectWatchMultiplexer() :
+      base::SimpleThread("ObjectWatchMultiplexer Thread",
+          base::SimpleThread::Options(kObjectWatcherThreadStackSize,
+                                      kObjectWatcherThreadPriority,
+                                      kNetworkIOThreadAffinity)),
+      epoll_fd_(epoll_create(kMaxEvents)),
+      wakeup_fd_(eventfd(0, EFD_NONBLOCK)),
+      exit_(false) {
+    DPCHECK(epoll_fd_ >= 0);
+    DPCHECK(wakeup_fd_ >= 0);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = wakeup_fd_;
+    int result = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event);
+    DPCHECK(result == 0);
+  }
+
+  ~ObjectWatchMultiplexer() {
+    HANDLE_EINTR(close(wakeup_fd_));
+    HANDLE_EINTR(close(epoll_fd_));
+  }
+
+  // blocking call to exit the internal thread
+  void Join() {
+    {
+      base::AutoLock lock(lock_);
+      exit_ = true;
+    }
+    uint64 value = 1;
+    ssize_t result = HANDLE_EINTR(write(wakeup_fd_, &value, sizeof(value)));
+    DPCHECK(result == sizeof(value));
+    base::SimpleThread::Join();
+  }
+
+  // although you can add different watches with the same file descriptor all
+  // day long, please don't add the same watch twice it will create an error.
+  void AddWatch(Watch * watch) {
+    DCHECK(watch);
+    base::AutoLock lock(lock_);
+    WatchList &watches = watch_map_[watch->object];
+    watches.push_back(watch);
+    Arm(watch->object, watches);
+  }
+
+  void RemoveWatch(Watch * watch) {
+    DCHECK(watch);
+    base::AutoLock lock(lock_);
+    WatchMap::iterator it = watch_map_.find(watch->object);
+    if (it == watch_map_.end())
+      return;
+    WatchList &watches = it->second;
+    WatchList::iterator found =
+        std::find(watches.begin(), watches.end(), watch);
+    if (found == watches.end())
+      return;
+    watches.erase(found);
+    if (watches.empty()) {
+      Disarm(watch->object);
+      watch_map_.erase(it);
+    }
+    // Otherwise the remaining watches are a superset of what is armed, which
+    // at worst wakes the thread up for an event nobody wants any more.
+  }
+
+ private:
+  typedef std::vector<Watch*> WatchList;
+  typedef base::hash_map<int, WatchList> WatchMap;
+
+  // the internal thread runloop
+  void Run() {
+    epoll_event events[kMaxEvents];
+    while (true) {
+      int event_count =
+          HANDLE_EINTR(epoll_wait(epoll_fd_, events, kMaxEvents, -1));
+      if (event_count < 0) {
+        DPLOG(ERROR) << "epoll_wait";
+        continue;
+      }
+
+      // The watches are signaled under the lock, so that StopWatching()
+      // can't delete one while it is being posted.
+      base::AutoLock lock(lock_);
+      if (exit_)
+        return;
+      for (int i = 0; i < event_count; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == wakeup_fd_)
+          continue;
+        WatchMap::iterator it = watch_map_.find(fd);
+        if (it == watch_map_.end())
+          continue;
+
+        // Errors and hangups are reported to both readers and writers, who
+        // find out what happened from their next read or write.
+        uint32 revents = events[i].events;
+        bool readable = revents & (EPOLLIN | EPOLLERR | EPOLLHUP);
+        bool writable = revents & (EPOLLOUT | EPOLLERR | EPOLLHUP);
+        WatchList &watches = it->second;
+        WatchList remaining;
+        for (size_t j = 0; j < watches.size(); ++j) {
+          if ((readable && (watches[j]->mode & MessagePumpShell::WATCH_READ)) ||
+              (writable &&
+               (watches[j]->mode & MessagePumpShell::WATCH_WRITE))) {
+            SignalWatch(watches[j]);
+          } else {
+            remaining.push_back(watches[j]);
+          }
+        }
+        if (remaining.empty()) {
+          Disarm(fd);
+          watch_map_.erase(it);
+        } else {
+          watches.swap(remaining);
+          Arm(fd, watches);
+        }
+      }
+    }
+  }
+
+  // Registers |fd| for one event matching any of |watches|.
+  void Arm(int fd, const WatchList &watches) {
+    lock_.AssertAcquired();
+    epoll_event event;
+    event.events = EPOLLONESHOT;
+    for (size_t i = 0; i < watches.size(); ++i) {
+      if (watches[i]->mode & MessagePumpShell::WATCH_READ)
+        event.events |= EPOLLIN;
+      if (watches[i]->mode & MessagePumpShell::WATCH_WRITE)
+        event.events |= EPOLLOUT;
+    }
+    event.data.fd = fd;
+    // The fd may be new to epoll, or may have been dropped from it when it
+    // was closed, and a new fd may since have been opened with its number.
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) != 0 &&
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+      DPLOG(ERROR) << "Failed to watch fd " << fd;
+    }
+  }
+
+  void Disarm(int fd) {
+    lock_.AssertAcquired();
+    // Fails harmlessly if the fd was closed, which already unregistered it.
+    epoll_event event;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &event);
+  }
+
+  // The most events handled per epoll_wait().
+  static const int kMaxEvents = 64;
+
+  int epoll_fd_;
+  int wakeup_fd_;
+
+  // this lock protects watch_map_ and exit_
+  base::Lock lock_;
+  WatchMap watch_map_;
+  bool exit_;
+};
+
+#else  // defined(__LB_LINUX__)
 // -----------------------------------------------------------------------------
 // ObjectWatchMultiplexer
 // this object runs an internal thread to block on the aggregate of all watched
@@ -209,14 +400,8 @@ class ObjectWatchMultiplexer : public base::SimpleThread {
         // deleted due to a call to ObjectWatcher::StopWatching that could
         // occur while the watch is on this callback stack
         while (!watch_callback_stack.empty()) {
-          Watch * watch = watch_callback_stack.top();
+          SignalWatch(watch_callback_stack.top());
           watch_callback_stack.pop();
-          // signal this watch to run in the original thread context
-          // of the calling thread message loop.  The watch will be
-          // posted as a task to the MessageLoop which will take
-          // ownership of the object and delete it
-          watch->did_signal = true;
-          watch->origin_loop->PostTask(FROM_HERE, base::Bind(WatchTask, watch));
         }
         // if we're going to signal something we should recompose
         // the array as we are going to be removing watches
@@ -332,6 +517,7 @@ class ObjectWatchMultiplexer : public base::SimpleThread {
 
   bool exit_;
 };
+#endif  // defined(__LB_LINUX__)
 
 // our singleton instance pointer
 static ObjectWatchMultiplexer * OWMuxInstance = NULL;
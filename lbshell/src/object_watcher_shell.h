@@ -27,8 +27,8 @@ namespace steel {
 
 // A class that provides a means to asynchronously wait for a file descriptor to
 // become signaled.  It uses an internal thread on a singleton object that
-// blocks on poll() calls to an internal list of fds, each represented by an
-// instance of the ObjectWatcher class.
+// blocks on epoll_wait() (on Linux) or poll() calls to an internal list of
+// fds, each represented by an instance of the ObjectWatcher class.
 // It provides a notification callback, OnObjectSignaled, that runs back on
 // the origin thread (i.e., the thread that called StartWatching).
 //
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "object_watcher_shell.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "base/cancelable_callback.h"
+#include "base/compiler_specific.h"
+#include "base/logging.h"
+#include "base/memory/scoped_vector.h"
+#include "base/message_loop.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/time.h"
+#include "external/chromium/testing/gtest/include/gtest/gtest.h"
+
+#if defined(__LB_LINUX__)
+namespace {
+
+using base::steel::ObjectWatcher;
+
+// One end of a connected socket pair, watched for reads of a byte sent from
+// the other end.
+class SocketReader : public ObjectWatcher::Delegate {
+ public:
+  // |pending| is decremented on every signal, and the message loop quits
+  // when it reaches 0.
+  explicit SocketReader(int *pending)
+      : pending_(pending)
+      , signal_count_(0) {
+    int fds[2];
+    PCHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    read_fd_ = fds[0];
+    write_fd_ = fds[1];
+  }
+
+  virtual ~SocketReader() {
+    watcher_.StopWatching();
+    HANDLE_EINTR(close(read_fd_));
+    HANDLE_EINTR(close(write_fd_));
+  }
+
+  void Watch() {
+    EXPECT_TRUE(watcher_.StartWatching(
+        read_fd_, base::MessagePumpShell::WATCH_READ, this));
+  }
+
+  void StopWatching() {
+    EXPECT_TRUE(watcher_.StopWatching());
+  }
+
+  void Send() {
+    send_time_ = base::TimeTicks::Now();
+    char byte = 0;
+    EXPECT_EQ(1, HANDLE_EINTR(write(write_fd_, &byte, 1)));
+  }
+
+  virtual void OnObjectSignaled(int object) OVERRIDE {
+    latency_ = base::TimeTicks::Now() - send_time_;
+    EXPECT_EQ(read_fd_, object);
+    char byte;
+    EXPECT_EQ(1, HANDLE_EINTR(read(read_fd_, &byte, 1)));
+    ++signal_count_;
+    if (--*pending_ == 0)
+      MessageLoop::current()->Quit();
+  }
+
+  int signal_count() const { return signal_count_; }
+  base::TimeDelta latency() const { return latency_; }
+
+ private:
+  int *pending_;
+  int signal_count_;
+  int read_fd_;
+  int write_fd_;
+  ObjectWatcher watcher_;
+  base::TimeTicks send_time_;
+  base::TimeDelta latency_;
+};
+
+class ObjectWatcherTest : public testing::Test {
+ protected:
+  ObjectWatcherTest() : pending_(0) {}
+
+  virtual void SetUp() OVERRIDE {
+    ObjectWatcher::InitializeObjectWatcherSystem();
+  }
+
+  virtual void TearDown() OVERRIDE {
+    ObjectWatcher::TeardownObjectWatcherSystem();
+  }
+
+  // Runs the message loop until every expected signal arrived, or gives up
+  // after |timeout|.
+  void RunUntilSignaled(base::TimeDelta timeout) {
+    base::CancelableClosure quit(MessageLoop::QuitClosure());
+    message_loop_.PostDelayedTask(FROM_HERE, quit.callback(), timeout);
+    message_loop_.Run();
+  }
+
+  MessageLoop message_loop_;
+  int pending_;
+};
+
+}  // namespace
+
+TEST_F(ObjectWatcherTest, SignalsWhenReadable) {
+  SocketReader reader(&pending_);
+  reader.Watch();
+  pending_ = 1;
+  reader.Send();
+  RunUntilSignaled(base::TimeDelta::FromSeconds(5));
+  EXPECT_EQ(1, reader.signal_count());
+}
+
+TEST_F(ObjectWatcherTest, SignalsWatchStartedAfterReady) {
+  SocketReader reader(&pending_);
+  pending_ = 1;
+  reader.Send();
+  reader.Watch();
+  RunUntilSignaled(base::TimeDelta::FromSeconds(5));
+  EXPECT_EQ(1, reader.signal_count());
+
+  // The fd is watched again once the first watch has fired.
+  pending_ = 1;
+  reader.Watch();
+  reader.Send();
+  RunUntilSignaled(base::TimeDelta::FromSeconds(5));
+  EXPECT_EQ(2, reader.signal_count());
+}
+
+TEST_F(ObjectWatcherTest, StoppedWatchIsNotSignaled) {
+  SocketReader reader(&pending_);
+  reader.Watch();
+  reader.StopWatching();
+  pending_ = 1;
+  reader.Send();
+  RunUntilSignaled(base::TimeDelta::FromMilliseconds(100));
+  EXPECT_EQ(0, reader.signal_count());
+}
+
+// Measures how long a watch takes to be signaled after its socket becomes
+// readable, with many sockets watched at once.
+TEST_F(ObjectWatcherTest, LoopbackLatencyAndThroughput) {
+  const int kSockets = 256;
+  const int kRounds = 20;
+
+  ScopedVector<SocketReader> readers;
+  for (int i = 0; i < kSockets; ++i)
+    readers.push_back(new SocketReader(&pending_));
+
+  base::TimeDelta total_latency;
+  base::TimeDelta max_latency;
+  base::TimeTicks start = base::TimeTicks::Now();
+  for (int round = 0; round < kRounds; ++round) {
+    pending_ = kSockets;
+    for (int i = 0; i < kSockets; ++i) {
+      readers[i]->Watch();
+      readers[i]->Send();
+    }
+    RunUntilSignaled(base::TimeDelta::FromSeconds(5));
+    ASSERT_EQ(0, pending_);
+    for (int i = 0; i < kSockets; ++i) {
+      total_latency += readers[i]->latency();
+      max_latency = std::max(max_latency, readers[i]->latency());
+    }
+  }
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start;
+
+  const int kSignals = kSockets * kRounds;
+  LOG(INFO) << kSockets << " sockets: mean wakeup latency "
+            << total_latency.InMicroseconds() / kSignals << " us, max "
+            << max_latency.InMicroseconds() << " us, "
+            << kSignals * base::Time::kMicrosecondsPerSecond /
+                   std::max<int64>(elapsed.InMicroseconds(), 1)
+            << " signals/s";
+}
+#endif  // defined(__LB_LINUX__)
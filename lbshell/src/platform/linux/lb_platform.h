@@ -74,6 +74,37 @@ static inline uint32_t atomic_sub_32(uint32_t *addend, uint32_t sub) {
   return __sync_sub_and_fetch(addend, sub);
 }
 
+// Loads *value, ordered before the loads and stores that follow it.
+static inline uint32_t atomic_load_acquire_32(const uint32_t *value) {
+#if defined(__ATOMIC_ACQUIRE)
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#else
+  uint32_t result = *(const volatile uint32_t *)value;
+  __sync_synchronize();
+  return result;
+#endif
+}
+
+static inline uint64_t atomic_load_acquire_64(const uint64_t *value) {
+#if defined(__ATOMIC_ACQUIRE)
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#else
+  return __sync_val_compare_and_swap((uint64_t *)value, 0, 0);
+#endif
+}
+
+// Stores new_value in *value if it holds old_value.
+// Returns the value *value held before.
+static inline uint32_t atomic_cas_32(uint32_t *value, uint32_t old_value,
+                                     uint32_t new_value) {
+  return __sync_val_compare_and_swap(value, old_value, new_value);
+}
+
+static inline uint64_t atomic_cas_64(uint64_t *value, uint64_t old_value,
+                                     uint64_t new_value) {
+  return __sync_val_compare_and_swap(value, old_value, new_value);
+}
+
 // Increment addend by 1 if the existing value is not 0.
 // Returns the original value of addend.
 static inline uint32_t atomic_conditional_inc(uint32_t *addend) {
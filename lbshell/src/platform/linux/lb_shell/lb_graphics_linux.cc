@@ -465,6 +465,11 @@ void LBGraphicsLinux::BlockUntilFlip() {
   graphics_message_loop_->PostTask(FROM_HERE,
       base::Bind(&base::WaitableEvent::Signal, base::Unretained(&wait_event)));
   wait_event.Wait();
+  last_flip_time_ = base::TimeTicks::HighResNow();
+}
+
+base::TimeTicks LBGraphicsLinux::GetLastFlipTime() const {
+  return last_flip_time_;
 }
 
 LBWebGraphicsContext3D* LBGraphicsLinux::GetCompositorContext() {
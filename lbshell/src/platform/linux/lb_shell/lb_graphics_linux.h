@@ -51,6 +51,7 @@ class LBGraphicsLinux : public LBGraphics {
   virtual void UpdateAndDrawFrame() OVERRIDE;
   // This method will not return until a buffer flip occurs.
   virtual void BlockUntilFlip() OVERRIDE;
+  virtual base::TimeTicks GetLastFlipTime() const OVERRIDE;
 
   // show or hide the spinner
   virtual void ShowSpinner() OVERRIDE;
@@ -99,6 +100,9 @@ class LBGraphicsLinux : public LBGraphics {
 
   base::Thread graphics_thread_;
   MessageLoop* graphics_message_loop_;
+  // Set by BlockUntilFlip(), once the swap posted by UpdateAndDrawFrame() has
+  // been done on the graphics thread.  Only used on the main loop thread.
+  base::TimeTicks last_flip_time_;
 
   LBWebViewHost* web_view_host_;
 
@@ -15,11 +15,17 @@
  */
 #include "lb_pulse_audio.h"
 
+#include <algorithm>
+
 #include "base/bind.h"
 
 LBPulseAudioStream::LBPulseAudioStream()
     : context_(NULL),
+      profile_(kDefaultLatency),
+      min_latency_(kMinLatency),
+      max_latency_(kMaxLatency),
       latency_(kMinLatency),
+      underflow_count_(0),
       stream_(NULL),
       last_request_size_(0),
       host_(NULL) {
@@ -29,15 +35,25 @@ LBPulseAudioStream::~LBPulseAudioStream() {
   if (stream_) {
     pa_stream_set_write_callback(stream_, NULL, NULL);
     pa_stream_set_underflow_callback(stream_, NULL, NULL);
+    pa_stream_set_state_callback(stream_, NULL, NULL);
+    pa_stream_set_buffer_attr_callback(stream_, NULL, NULL);
     pa_stream_disconnect(stream_);
     pa_stream_unref(stream_);
   }
 }
 
 bool LBPulseAudioStream::Initialize(LBPulseAudioContext* context, Host* host,
-                                    int rate, int channel) {
+                                    int rate, int channel,
+                                    LatencyProfile profile) {
   context_ = context;
   host_ = host;
+  profile_ = profile;
+  if (profile_ == kLowLatency) {
+    min_latency_ = kMinLowLatency;
+    max_latency_ = kMaxLowLatency;
+  }
+  latency_ = min_latency_;
+  last_latency_change_ = base::TimeTicks::Now();
   sample_spec_.rate = rate;
   sample_spec_.channels = channel;
   sample_spec_.format = PA_SAMPLE_FLOAT32LE;
@@ -49,12 +65,13 @@ bool LBPulseAudioStream::Initialize(LBPulseAudioContext* context, Host* host,
 
   pa_stream_set_write_callback(stream_, RequestCallback, this);
   pa_stream_set_underflow_callback(stream_, UnderflowCallback, this);
-  buf_attr_.fragsize = ~0;
-  buf_attr_.maxlength = pa_usec_to_bytes(latency_, &sample_spec_);
-  buf_attr_.minreq = pa_usec_to_bytes(0, &sample_spec_);
-  buf_attr_.prebuf = ~0;
-  buf_attr_.tlength = buf_attr_.maxlength;
+  pa_stream_set_state_callback(stream_, StateCallback, this);
+  pa_stream_set_buffer_attr_callback(stream_, BufferAttrCallback, this);
+  UpdateBufferAttr();
 
+  // The buffer attributes are only a request.  With PA_STREAM_ADJUST_LATENCY
+  // the server also configures the sink for them, and what it actually grants
+  // is read back once the stream is ready.
   const pa_stream_flags_t kNoLatency =
       static_cast<pa_stream_flags_t>(PA_STREAM_INTERPOLATE_TIMING |
                                      PA_STREAM_AUTO_TIMING_UPDATE |
@@ -91,7 +108,22 @@ uint64 LBPulseAudioStream::GetPlaybackCursorInMicroSeconds() {
   return 0;
 }
 
+uint64 LBPulseAudioStream::GetLatencyInMicroSeconds() {
+  pa_usec_t usec = 0;
+  int negative = 0;
+  if (pa_stream_get_latency(stream_, &usec, &negative) == 0 && !negative)
+    return usec;
+  return 0;
+}
+
 void LBPulseAudioStream::RequestFrame() {
+  if (profile_ == kLowLatency && latency_ > min_latency_) {
+    base::TimeTicks now = base::TimeTicks::Now();
+    if (now - last_latency_change_ >=
+        base::TimeDelta::FromSeconds(kStableIntervalInSeconds)) {
+      SetLatency(latency_ - latency_ / 4);
+    }
+  }
   host_->RequestFrame(
       last_request_size_, base::Bind(&LBPulseAudioStream::WriteFrame,
                                      base::Unretained(this)));
@@ -113,13 +145,73 @@ void LBPulseAudioStream::UnderflowCallback(pa_stream* s, void* userdata) {
 }
 
 void LBPulseAudioStream::HandleUnderflow() {
-  if (latency_ < kMaxLatency) {
-    latency_ *= 2;
-    if (latency_ > kMaxLatency)
-      latency_ = kMaxLatency;
-    buf_attr_.maxlength = pa_usec_to_bytes(latency_, &sample_spec_);
-    buf_attr_.tlength = buf_attr_.maxlength;
-    pa_stream_set_buffer_attr(stream_, &buf_attr_, NULL, NULL);
+  ++underflow_count_;
+  if (latency_ < max_latency_)
+    SetLatency(latency_ * 2);
+}
+
+void LBPulseAudioStream::SetLatency(int latency) {
+  latency = std::max(min_latency_, std::min(latency, max_latency_));
+  last_latency_change_ = base::TimeTicks::Now();
+  if (latency == latency_)
+    return;
+  latency_ = latency;
+  UpdateBufferAttr();
+  pa_stream_set_buffer_attr(stream_, &buf_attr_, SetBufferAttrCallback, this);
+}
+
+void LBPulseAudioStream::StateCallback(pa_stream* s, void* userdata) {
+  if (pa_stream_get_state(s) != PA_STREAM_READY)
+    return;
+  LBPulseAudioStream* stream = static_cast<LBPulseAudioStream*>(userdata);
+  stream->HandleBufferAttr(true);
+}
+
+void LBPulseAudioStream::BufferAttrCallback(pa_stream* s, void* userdata) {
+  LBPulseAudioStream* stream = static_cast<LBPulseAudioStream*>(userdata);
+  stream->HandleBufferAttr(false);
+}
+
+void LBPulseAudioStream::SetBufferAttrCallback(pa_stream* s, int success,
+                                               void* userdata) {
+  LBPulseAudioStream* stream = static_cast<LBPulseAudioStream*>(userdata);
+  stream->HandleBufferAttr(false);
+}
+
+void LBPulseAudioStream::HandleBufferAttr(bool initial) {
+  const pa_buffer_attr* attr = pa_stream_get_buffer_attr(stream_);
+  if (!attr)
+    return;
+  // Keep tlength and minreq as granted, so the requests we get are the ones
+  // the server is actually going to make.
+  buf_attr_ = *attr;
+  // The server won't go below the smallest latency the sink supports.  Size
+  // for what it granted, and when that is what the initial request came back
+  // as, never ask for less again.
+  int granted = static_cast<int>(pa_bytes_to_usec(attr->tlength,
+                                                  &sample_spec_));
+  if (granted <= latency_)
+    return;
+  latency_ = std::min(granted, max_latency_);
+  if (initial)
+    min_latency_ = latency_;
+}
+
+void LBPulseAudioStream::UpdateBufferAttr() {
+  // Let the server pick these for the new length rather than resending the
+  // ones it granted for the old one.
+  buf_attr_.fragsize = ~0;
+  buf_attr_.prebuf = ~0;
+  buf_attr_.maxlength = pa_usec_to_bytes(latency_, &sample_spec_);
+  buf_attr_.tlength = buf_attr_.maxlength;
+  if (profile_ == kLowLatency) {
+    // Ask for data about once per hardware period instead of whenever there
+    // is any room, and leave headroom above tlength so a late write doesn't
+    // get dropped.
+    buf_attr_.maxlength *= 2;
+    buf_attr_.minreq = pa_usec_to_bytes(latency_ / 4, &sample_spec_);
+  } else {
+    buf_attr_.minreq = pa_usec_to_bytes(0, &sample_spec_);
   }
 }
 
@@ -142,7 +234,14 @@ void LBPulseAudioStream::WriteFrame(const uint8* data, size_t size) {
 LBPulseAudioContext::LBPulseAudioContext()
     : mainloop_(NULL),
       context_(NULL),
-      pulse_thread_("PulseAudioThread") {
+      pulse_thread_("PulseAudioThread"),
+      output_latency_("Media.Audio.Pulse.Latency", 0,
+                      "Measured PulseAudio output latency in ms"),
+      target_latency_("Media.Audio.Pulse.BufferSize", 0,
+                      "PulseAudio buffer size in ms"),
+      underflow_count_("Media.Audio.Pulse.Underflow", 0,
+                       "PulseAudio underflow count"),
+      destroyed_streams_underflow_count_(0) {
 }
 
 LBPulseAudioContext::~LBPulseAudioContext() {
@@ -200,14 +299,33 @@ void LBPulseAudioContext::Iterate() {
        iter != streams_.end(); ++iter) {
     (*iter)->RequestFrame();
   }
+  UpdateStats();
+}
+
+void LBPulseAudioContext::UpdateStats() {
+  int output_latency = 0;
+  int target_latency = 0;
+  int underflow_count = destroyed_streams_underflow_count_;
+  for (Streams::iterator iter = streams_.begin();
+       iter != streams_.end(); ++iter) {
+    output_latency = std::max<int>(
+        output_latency, (*iter)->GetLatencyInMicroSeconds() / 1000);
+    target_latency = std::max(target_latency,
+                              (*iter)->target_latency() / 1000);
+    underflow_count += (*iter)->underflow_count();
+  }
+  output_latency_ = output_latency;
+  target_latency_ = target_latency;
+  underflow_count_ = underflow_count;
 }
 
 LBPulseAudioStream* LBPulseAudioContext::CreateStream(
-    LBPulseAudioStream::Host* host, int rate, int channel) {
+    LBPulseAudioStream::Host* host, int rate, int channel,
+    LBPulseAudioStream::LatencyProfile profile) {
   base::AutoLock lock(lock_);
 
   LBPulseAudioStream* stream = new LBPulseAudioStream;
-  DCHECK(stream->Initialize(this, host, rate, channel));
+  DCHECK(stream->Initialize(this, host, rate, channel, profile));
   streams_.insert(stream);
   return stream;
 }
@@ -216,6 +334,7 @@ void LBPulseAudioContext::DestroyStream(LBPulseAudioStream* stream) {
   base::AutoLock lock(lock_);
   DCHECK(streams_.find(stream) != streams_.end());
   streams_.erase(streams_.find(stream));
+  destroyed_streams_underflow_count_ += stream->underflow_count();
   delete stream;
 }
 
@@ -22,6 +22,8 @@
 
 #include "base/synchronization/lock.h"
 #include "base/threading/thread.h"
+#include "base/time.h"
+#include "lb_console_values.h"
 
 // TODO(xiaomings) : put these decoder/streamer classes into namespace LB
 
@@ -36,14 +38,28 @@ class LBPulseAudioStream {
     virtual void RequestFrame(size_t length, WriteFunc write) = 0;
   };
 
+  // The default profile buffers between 1 and 4 seconds, which is fine for
+  // movies.  The low latency profile starts with a buffer of a few hardware
+  // periods, grows it when the stream underflows and shrinks it back once
+  // the output has been stable for a while.
+  enum LatencyProfile {
+    kDefaultLatency,
+    kLowLatency
+  };
+
   LBPulseAudioStream();
   ~LBPulseAudioStream();
 
   bool Initialize(LBPulseAudioContext* context, Host* host, int rate,
-                  int channel);
+                  int channel, LatencyProfile profile);
   bool Play();
   bool Pause();
   uint64 GetPlaybackCursorInMicroSeconds();
+  // Time until a frame written now is heard, as measured by PulseAudio.
+  uint64 GetLatencyInMicroSeconds();
+  // The latency the buffer is currently sized for.
+  int target_latency() const { return latency_; }
+  int underflow_count() const { return underflow_count_; }
   void RequestFrame();
 
  private:
@@ -53,20 +69,42 @@ class LBPulseAudioStream {
     kFailure
   };
 
+  // Latencies are in microseconds.  The minimums are only the initial
+  // request, the server may grant more.
   static const int kMinLatency = 1000000;
   static const int kMaxLatency = 4000000;
+  static const int kMinLowLatency = 20000;
+  static const int kMaxLowLatency = 500000;
+  // The low latency buffer shrinks by a quarter after this long without an
+  // underflow.
+  static const int kStableIntervalInSeconds = 10;
 
   static void RequestCallback(pa_stream* s, size_t length, void* userdata);
   void HandleRequest(size_t length);
   static void UnderflowCallback(pa_stream* s, void* userdata);
   void HandleUnderflow();
   static void SuccessCallback(pa_stream* s, int success, void* userdata);
+  static void StateCallback(pa_stream* s, void* userdata);
+  static void BufferAttrCallback(pa_stream* s, void* userdata);
+  static void SetBufferAttrCallback(pa_stream* s, int success,
+                                    void* userdata);
+  // Reads back the buffer attributes the server granted.  |initial| is set
+  // for the attributes the stream was opened with.
+  void HandleBufferAttr(bool initial);
   bool Cork(bool pause);
+  void SetLatency(int latency);
+  void UpdateBufferAttr();
 
   void WriteFrame(const uint8* data, size_t size);
 
   LBPulseAudioContext* context_;
+  LatencyProfile profile_;
+  int min_latency_;
+  int max_latency_;
   int latency_;
+  int underflow_count_;
+  // The last time the buffer size was changed.
+  base::TimeTicks last_latency_change_;
   pa_buffer_attr buf_attr_;
   pa_sample_spec sample_spec_;
   pa_stream* stream_;
@@ -85,8 +123,10 @@ class LBPulseAudioContext {
   pa_context* GetContext();
   void Iterate();
 
-  LBPulseAudioStream* CreateStream(LBPulseAudioStream::Host* host,
-                                   int rate, int channel);
+  LBPulseAudioStream* CreateStream(
+      LBPulseAudioStream::Host* host, int rate, int channel,
+      LBPulseAudioStream::LatencyProfile profile =
+          LBPulseAudioStream::kDefaultLatency);
   void DestroyStream(LBPulseAudioStream* stream);
 
   base::Lock& lock() { return lock_; }
@@ -100,6 +140,7 @@ class LBPulseAudioContext {
   };
 
   static void StateCallback(pa_context* c, void* userdata);
+  void UpdateStats();
 
   pa_mainloop* mainloop_;
   pa_context* context_;
@@ -108,6 +149,14 @@ class LBPulseAudioContext {
   Streams streams_;
   base::Lock lock_;
 
+  // Largest measured output latency and target buffer size of the streams,
+  // in milliseconds.
+  LB::CVal<int> output_latency_;
+  LB::CVal<int> target_latency_;
+  // Underflows of the streams, including those already destroyed.
+  LB::CVal<int> underflow_count_;
+  int destroyed_streams_underflow_count_;
+
   DISALLOW_COPY_AND_ASSIGN(LBPulseAudioContext);
 };
 
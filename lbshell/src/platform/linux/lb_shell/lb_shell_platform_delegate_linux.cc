@@ -58,6 +58,19 @@ void LBShellPlatformDelegate::PlatformInit() {
   global_values->tmp_path = strdup("/tmp/steel");
   mkdir(global_values->tmp_path, 0700);
 
+  // Unlike /tmp, the user's cache directory isn't emptied on reboot.
+  const char* home = getenv("HOME");
+  std::string cache_dir;
+  if (home && *home) {
+    cache_dir = std::string(home) + "/.cache";
+    mkdir(cache_dir.c_str(), 0700);
+    cache_dir += "/steel";
+  } else {
+    cache_dir = std::string(global_values->tmp_path) + "/cache";
+  }
+  global_values->cache_path = strdup(cache_dir.c_str());
+  mkdir(global_values->cache_path, 0700);
+
 #if defined (__LB_SHELL__ENABLE_SCREENSHOT__)
   global_values->screenshot_output_path = strdup("/tmp/steel/screenshot");
   mkdir(global_values->screenshot_output_path, 0700);
@@ -100,11 +113,13 @@ void LBShellPlatformDelegate::PlatformTeardown() {
   free(const_cast<char*>(global_values->screenshot_output_path));
   free(const_cast<char*>(global_values->logging_output_path));
   free(const_cast<char*>(global_values->tmp_path));
+  free(const_cast<char*>(global_values->cache_path));
   global_values->dir_source_root = NULL;
   global_values->game_content_path = NULL;
   global_values->screenshot_output_path = NULL;
   global_values->logging_output_path = NULL;
   global_values->tmp_path = NULL;
+  global_values->cache_path = NULL;
 }
 
 // static
@@ -16,9 +16,13 @@
 
 #include "shell_audio_streamer_linux.h"
 
+#include <vector>
+
+#include "base/command_line.h"
 #include "base/logging.h"
 #include "lb_platform.h"
 #include "lb_pulse_audio.h"
+#include "lb_shell_switches.h"
 #include "media/audio/audio_parameters.h"
 #include "media/base/audio_bus.h"
 #include "media/mp4/aac.h"
@@ -27,6 +31,10 @@ namespace {
 
 ShellAudioStreamerLinux* instance = NULL;
 
+// Format of the mixed Pulse stream.
+const int kMixerSampleRate = 48000;
+const int kMixerChannels = 2;
+
 }  // namespace
 
 class PulseAudioHost : public LBPulseAudioStream::Host {
@@ -51,6 +59,24 @@ class PulseAudioHost : public LBPulseAudioStream::Host {
   LBPulseAudioStream* pulse_audio_stream_;
 };
 
+// Plays the output of a ShellAudioMixer through a single Pulse stream.
+class PulseAudioMixerHost : public LBPulseAudioStream::Host {
+ public:
+  PulseAudioMixerHost(LBPulseAudioContext* pulse_audio_context,
+                      media::ShellAudioMixer* mixer);
+  ~PulseAudioMixerHost();
+  virtual void RequestFrame(size_t length, WriteFunc write) OVERRIDE;
+
+ private:
+  LBPulseAudioContext* pulse_audio_context_;
+  media::ShellAudioMixer* mixer_;
+  uint64 played_frames_;  // frames played by the audio driver
+  uint64 written_frames_;  // frames written to the audio driver
+  bool running_;
+  LBPulseAudioStream* pulse_audio_stream_;
+  std::vector<float> mix_buffer_;
+};
+
 namespace media {
 
 void ShellAudioStreamer::Initialize() {
@@ -98,6 +124,17 @@ bool ShellAudioStreamerLinux::AddStream(media::ShellAudioStream* stream) {
   DCHECK(params.channels() == 1 || params.channels() == 2);
   DCHECK_EQ(params.bits_per_sample(), 32);
 
+  if (use_mixer_) {
+    if (!mixer_) {
+      mixer_.reset(new media::ShellAudioMixer(GetConfig(), kMixerChannels,
+                                              kMixerSampleRate));
+    }
+    mixer_->AddStream(stream);
+    if (!mixer_host_)
+      mixer_host_ = new PulseAudioMixerHost(pulse_audio_context_, mixer_.get());
+    return true;
+  }
+
   media::AudioBus* audio_bus = stream->GetAudioBus();
   const media::AudioParameters& audio_parameters = stream->GetAudioParameters();
   const int frames_per_channel = audio_bus->frames();
@@ -112,13 +149,23 @@ bool ShellAudioStreamerLinux::AddStream(media::ShellAudioStream* stream) {
 void ShellAudioStreamerLinux::RemoveStream(media::ShellAudioStream* stream) {
   base::AutoLock lock(streams_lock_);
 
-  StreamMap::iterator it = streams_.find(stream);
-  if (it == streams_.end())
-    return;
-  delete it->second;
-  streams_.erase(it);
+  if (use_mixer_) {
+    if (!mixer_ || !mixer_->HasStream(stream))
+      return;
+    mixer_->RemoveStream(stream);
+    if (!mixer_->empty())
+      return;
+    delete mixer_host_;
+    mixer_host_ = NULL;
+  } else {
+    StreamMap::iterator it = streams_.find(stream);
+    if (it == streams_.end())
+      return;
+    delete it->second;
+    streams_.erase(it);
+  }
 
-  if (streams_.empty()) {
+  if (streams_.empty() && !mixer_host_) {
     delete pulse_audio_context_;
     pulse_audio_context_ = NULL;
   }
@@ -126,11 +173,17 @@ void ShellAudioStreamerLinux::RemoveStream(media::ShellAudioStream* stream) {
 
 bool ShellAudioStreamerLinux::HasStream(media::ShellAudioStream* stream) const {
   base::AutoLock lock(streams_lock_);
+  if (use_mixer_)
+    return mixer_ && mixer_->HasStream(stream);
   return streams_.find(stream) != streams_.end();
 }
 
 bool ShellAudioStreamerLinux::SetVolume(media::ShellAudioStream* stream,
                                         double volume) {
+  if (use_mixer_) {
+    base::AutoLock lock(streams_lock_);
+    return mixer_ && mixer_->SetVolume(stream, volume);
+  }
   if (volume != 1.0) {
     NOTIMPLEMENTED();
   }
@@ -138,7 +191,10 @@ bool ShellAudioStreamerLinux::SetVolume(media::ShellAudioStream* stream,
 }
 
 ShellAudioStreamerLinux::ShellAudioStreamerLinux()
-    : pulse_audio_context_(NULL) {
+    : pulse_audio_context_(NULL),
+      use_mixer_(!CommandLine::ForCurrentProcess()->HasSwitch(
+          LB::switches::kSeparateAudioStreams)),
+      mixer_host_(NULL) {
   instance = this;
 }
 
@@ -168,7 +224,6 @@ void PulseAudioHost::RequestFrame(size_t length, WriteFunc write) {
   int sample_rate = lb_audio_stream_->GetAudioParameters().sample_rate();
   uint64 frames_played = time_played * sample_rate / 1000000;
   uint32 frame_consumed = 0;
-  uint32 frame_pulled;
 
   if (frames_played > written_frames_)
     frames_played = written_frames_;
@@ -183,17 +238,14 @@ void PulseAudioHost::RequestFrame(size_t length, WriteFunc write) {
   const media::AudioBus* audio_bus = lb_audio_stream_->GetAudioBus();
 
   lb_audio_stream_->ConsumeFrames(frame_consumed);
-  lb_audio_stream_->PullFrames(NULL, &frame_pulled);
-
-  if (played_frames_ + frame_pulled > written_frames_ && length) {
-    frame_pulled = played_frames_ + frame_pulled - written_frames_;
-    frame_pulled = std::min<size_t>(frame_pulled, length);
-
-    uint32 frames = audio_bus->frames() / 2;
-    uint32 frame_offset = written_frames_ % frames;
-
-    uint32 frame_to_write =
-        std::min<size_t>(frame_pulled, frames - frame_offset);
+  lb_audio_stream_->PullFrames(NULL, NULL);
+
+  // Frames up to written_frames_ have already been handed to PulseAudio.
+  uint32 frame_offset;
+  uint32 frame_to_write = lb_audio_stream_->GetReadableRegion(
+      written_frames_ - played_frames_, &frame_offset);
+  frame_to_write = std::min<size_t>(frame_to_write, length);
+  if (frame_to_write) {
     const float* buffer = audio_bus->channel(0) + frame_offset * 2;
     write.Run(reinterpret_cast<const uint8*>(buffer),
               frame_to_write * kBytesPerFrame);
@@ -218,3 +270,58 @@ void PulseAudioHost::RequestFrame(size_t length, WriteFunc write) {
   }
 }
 
+PulseAudioMixerHost::PulseAudioMixerHost(
+    LBPulseAudioContext* pulse_audio_context, media::ShellAudioMixer* mixer)
+    : pulse_audio_context_(pulse_audio_context),
+      mixer_(mixer),
+      played_frames_(0),
+      written_frames_(0),
+      running_(false) {
+  // The mix carries web audio and UI sounds as well as media, so it uses the
+  // low latency profile.  Media sinks keep their own buffer, and the Pulse
+  // buffer grows if the output underflows.
+  pulse_audio_stream_ = pulse_audio_context->CreateStream(
+      this, mixer->output_sample_rate(), mixer->output_channels(),
+      LBPulseAudioStream::kLowLatency);
+}
+
+PulseAudioMixerHost::~PulseAudioMixerHost() {
+  if (pulse_audio_stream_) {
+    pulse_audio_context_->DestroyStream(pulse_audio_stream_);
+  }
+}
+
+void PulseAudioMixerHost::RequestFrame(size_t length, WriteFunc write) {
+  uint64 time_played = pulse_audio_stream_->GetPlaybackCursorInMicroSeconds();
+  uint64 frames_played =
+      time_played * mixer_->output_sample_rate() / 1000000;
+  if (frames_played > written_frames_)
+    frames_played = written_frames_;
+  if (frames_played > played_frames_) {
+    mixer_->OnFramesPlayed(frames_played - played_frames_);
+    played_frames_ = frames_played;
+  }
+
+  const int kBytesPerFrame = sizeof(float) * mixer_->output_channels();
+  DCHECK_EQ(length % kBytesPerFrame, 0);
+  // Only mix while the stream is running, but let the streams pull data from
+  // their renderers either way so they can buffer up before playing.
+  int frames = running_ ? length / kBytesPerFrame : 0;
+  mix_buffer_.resize(frames * mixer_->output_channels());
+  bool playing = mixer_->Mix(frames, frames ? &mix_buffer_[0] : NULL);
+  if (frames) {
+    write.Run(reinterpret_cast<const uint8*>(&mix_buffer_[0]),
+              frames * kBytesPerFrame);
+    written_frames_ += frames;
+  }
+
+  // The stream is corked while none of the streams are playing, so it stops
+  // waking up to play silence.
+  if (playing && !running_) {
+    pulse_audio_stream_->Play();
+    running_ = true;
+  } else if (!playing && running_) {
+    pulse_audio_stream_->Pause();
+    running_ = false;
+  }
+}
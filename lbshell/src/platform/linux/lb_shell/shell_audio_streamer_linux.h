@@ -19,11 +19,14 @@
 
 #include <map>
 
+#include "base/memory/scoped_ptr.h"
 #include "base/synchronization/lock.h"
 #include "lb_pulse_audio.h"
+#include "media/audio/shell_audio_mixer.h"
 #include "media/audio/shell_audio_streamer.h"
 
 class PulseAudioHost;
+class PulseAudioMixerHost;
 
 class ShellAudioStreamerLinux : public media::ShellAudioStreamer {
  public:
@@ -43,6 +46,13 @@ class ShellAudioStreamerLinux : public media::ShellAudioStreamer {
   mutable base::Lock streams_lock_;
   LBPulseAudioContext* pulse_audio_context_;
 
+  // Unless separate streams are requested on the command line, all streams
+  // are mixed by mixer_ and played through the one Pulse stream owned by
+  // mixer_host_, instead of one PulseAudioHost each.
+  bool use_mixer_;
+  scoped_ptr<media::ShellAudioMixer> mixer_;
+  PulseAudioMixerHost* mixer_host_;
+
   DISALLOW_COPY_AND_ASSIGN(ShellAudioStreamerLinux);
 };
 
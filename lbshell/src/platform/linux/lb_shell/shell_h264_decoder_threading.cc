@@ -0,0 +1,96 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shell_h264_decoder_threading.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace {
+
+const int kProfileIDCBaseline = 66;
+const int kNALTypeSlice = 1;
+const int kNALTypeIDRSlice = 5;
+const int kNALTypeSPS = 7;
+
+}  // namespace
+
+namespace media {
+
+int GetH264MaxMacroblocksPerSecond(int level_idc) {
+  switch (level_idc) {
+    case 10: return 1485;
+    case 11: return 3000;
+    case 12: return 6000;
+    case 13: return 11880;
+    case 20: return 11880;
+    case 21: return 19800;
+    case 22: return 20250;
+    case 30: return 40500;
+    case 31: return 108000;
+    case 32: return 216000;
+    case 40: return 245760;
+    case 41: return 245760;
+    case 42: return 522240;
+    case 50: return 589824;
+    case 51: return 983040;
+    case 52: return 2073600;
+    default:
+      DVLOG(1) << "Unknown H.264 level: " << level_idc;
+  }
+  return 0;
+}
+
+bool FindH264ProfileAndLevel(const uint8* data, size_t size,
+                             int* profile_idc, int* level_idc) {
+  for (size_t i = 0; i + 6 < size; ++i) {
+    if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1)
+      continue;
+    int nal_type = data[i + 3] & 0x1f;
+    if (nal_type == kNALTypeSPS) {
+      // profile_idc, constraint flags, level_idc
+      *profile_idc = data[i + 4];
+      *level_idc = data[i + 6];
+      return true;
+    }
+    if (nal_type == kNALTypeSlice || nal_type == kNALTypeIDRSlice)
+      break;
+  }
+  return false;
+}
+
+int GetH264DecoderThreadCount(int level_idc, const gfx::Size& coded_size,
+                              int processor_count) {
+  int macroblocks_per_second = GetH264MaxMacroblocksPerSecond(level_idc);
+  if (!macroblocks_per_second) {
+    int width_in_mbs = (coded_size.width() + 15) / 16;
+    int height_in_mbs = (coded_size.height() + 15) / 16;
+    macroblocks_per_second =
+        width_in_mbs * height_in_mbs * kH264AssumedFrameRate;
+  }
+  int thread_count = std::min(processor_count - 1, kMaxH264DecoderThreads);
+  thread_count = std::min(thread_count,
+      (macroblocks_per_second + kH264MacroblocksPerSecondPerThread - 1) /
+      kH264MacroblocksPerSecondPerThread);
+  return std::max(thread_count, 1);
+}
+
+bool ShouldUseH264SliceThreading(int profile_idc) {
+  return profile_idc == kProfileIDCBaseline;
+}
+
+}  // namespace media
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_PLATFORM_LINUX_LB_SHELL_SHELL_H264_DECODER_THREADING_H_
+#define SRC_PLATFORM_LINUX_LB_SHELL_SHELL_H264_DECODER_THREADING_H_
+
+#include "base/basictypes.h"
+#include "ui/gfx/size.h"
+
+namespace media {
+
+// Frame threading decodes consecutive frames in parallel at the cost of one
+// frame of latency and one frame of memory per thread. Slice threading adds
+// no latency but only helps streams with several slices per frame, which is
+// how low-delay Baseline profile streams are usually encoded.
+const int kMaxH264DecoderThreads = 16;
+// Macroblocks per second budgeted for one decoding thread. The thread count
+// is sized to spread the worst case macroblock rate allowed by the stream's
+// level over enough threads.
+const int kH264MacroblocksPerSecondPerThread = 60000;
+// Frame rate assumed for the macroblock rate when the level isn't known.
+const int kH264AssumedFrameRate = 60;
+
+// Returns the maximum macroblocks per second allowed by an H.264 level_idc,
+// from table A-1 of the spec, or 0 if the level is unknown.
+int GetH264MaxMacroblocksPerSecond(int level_idc);
+
+// Looks for a SPS in the Annex B prepend of a keyframe and returns the
+// profile_idc and level_idc from its header. Stops at the first slice.
+bool FindH264ProfileAndLevel(const uint8* data, size_t size,
+                             int* profile_idc, int* level_idc);
+
+// Returns how many threads to decode a stream with, given its level_idc, which
+// may be 0 if not known, and the number of processors. One processor is kept
+// for the renderer and the rest of the app.
+int GetH264DecoderThreadCount(int level_idc, const gfx::Size& coded_size,
+                              int processor_count);
+
+// Returns true if the stream is best decoded with slice threading rather
+// than frame threading.
+bool ShouldUseH264SliceThreading(int profile_idc);
+
+}  // namespace media
+
+#endif  // SRC_PLATFORM_LINUX_LB_SHELL_SHELL_H264_DECODER_THREADING_H_
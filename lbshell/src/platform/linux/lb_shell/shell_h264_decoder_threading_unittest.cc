@@ -0,0 +1,92 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shell_h264_decoder_threading.h"
+
+#include "external/chromium/testing/gtest/include/gtest/gtest.h"
+
+namespace media {
+
+namespace {
+
+const int kManyProcessors = 64;
+
+}  // namespace
+
+TEST(ShellH264DecoderThreadingTest, FindsProfileAndLevelInSPS) {
+  // AUD, then a High profile (100) level 4.1 (41) SPS.
+  const uint8 kPrepend[] = {
+    0x00, 0x00, 0x00, 0x01, 0x09, 0xf0,
+    0x00, 0x00, 0x00, 0x01, 0x67, 0x64, 0x00, 0x29, 0xac, 0x2b,
+  };
+  int profile_idc = 0;
+  int level_idc = 0;
+  ASSERT_TRUE(FindH264ProfileAndLevel(kPrepend, sizeof(kPrepend),
+                                      &profile_idc, &level_idc));
+  EXPECT_EQ(100, profile_idc);
+  EXPECT_EQ(41, level_idc);
+}
+
+TEST(ShellH264DecoderThreadingTest, StopsAtTheFirstSlice) {
+  // An IDR slice followed by bytes that look like a SPS.
+  const uint8 kFrame[] = {
+    0x00, 0x00, 0x01, 0x65, 0x88, 0x84,
+    0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1e, 0xab, 0xcd,
+  };
+  int profile_idc = 0;
+  int level_idc = 0;
+  EXPECT_FALSE(FindH264ProfileAndLevel(kFrame, sizeof(kFrame),
+                                       &profile_idc, &level_idc));
+  // A SPS cut off before its level isn't read either.
+  const uint8 kTruncated[] = { 0x00, 0x00, 0x01, 0x67, 0x42, 0x00 };
+  EXPECT_FALSE(FindH264ProfileAndLevel(kTruncated, sizeof(kTruncated),
+                                       &profile_idc, &level_idc));
+}
+
+TEST(ShellH264DecoderThreadingTest, ThreadCountFollowsTheLevel) {
+  gfx::Size coded_size(1920, 1088);
+  // Level 3.0 allows 40500 macroblocks per second.
+  EXPECT_EQ(1, GetH264DecoderThreadCount(30, coded_size, kManyProcessors));
+  // Level 4.1 allows 245760, which needs 5 threads.
+  EXPECT_EQ(5, GetH264DecoderThreadCount(41, coded_size, kManyProcessors));
+  // Level 5.2 would need 35, more than the maximum.
+  EXPECT_EQ(kMaxH264DecoderThreads,
+            GetH264DecoderThreadCount(52, coded_size, kManyProcessors));
+}
+
+TEST(ShellH264DecoderThreadingTest, ThreadCountFromCodedSizeWithoutLevel) {
+  // 1080p is 120x68 macroblocks, 489600 a second at 60fps.
+  EXPECT_EQ(9, GetH264DecoderThreadCount(0, gfx::Size(1920, 1080),
+                                         kManyProcessors));
+  // 360p is 40x23 macroblocks, 55200 a second.
+  EXPECT_EQ(1, GetH264DecoderThreadCount(0, gfx::Size(640, 360),
+                                         kManyProcessors));
+}
+
+TEST(ShellH264DecoderThreadingTest, ThreadCountKeepsAProcessorFree) {
+  EXPECT_EQ(3, GetH264DecoderThreadCount(41, gfx::Size(1920, 1088), 4));
+  // There is always at least one decoding thread.
+  EXPECT_EQ(1, GetH264DecoderThreadCount(41, gfx::Size(1920, 1088), 1));
+}
+
+TEST(ShellH264DecoderThreadingTest, SliceThreadingForBaseline) {
+  EXPECT_TRUE(ShouldUseH264SliceThreading(66));
+  EXPECT_FALSE(ShouldUseH264SliceThreading(77));
+  EXPECT_FALSE(ShouldUseH264SliceThreading(100));
+  EXPECT_FALSE(ShouldUseH264SliceThreading(0));
+}
+
+}  // namespace media
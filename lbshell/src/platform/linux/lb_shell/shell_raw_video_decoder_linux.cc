@@ -13,11 +13,21 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <pthread.h>
+#include <time.h>
+
+#include <vector>
+
 #include "base/logging.h"
 #include "base/memory/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/sys_info.h"
 #include "lb_ffmpeg.h"
+#include "media/base/shell_media_statistics.h"
+#include "media/base/shell_video_frame_pool.h"
 #include "media/base/video_util.h"
 #include "media/filters/shell_video_decoder_impl.h"
+#include "shell_h264_decoder_threading.h"
 
 using media::VideoFrame;
 using media::VideoCodecProfile;
@@ -72,6 +82,20 @@ PixelFormat VideoFormatToPixelFormat(VideoFrame::Format video_format) {
   return PIX_FMT_NONE;
 }
 
+// Decoded frames whose planes are kept for reuse once the renderer is done
+// with them. Frames in use by the decoder threads and queued in the renderer
+// are recycled continuously, so this only needs to absorb bursts.
+const size_t kMaxFreeVideoFrames = 8;
+
+// Returns the CPU time used so far by the thread of |clock|, or 0 if it
+// can't be read.
+int64 GetThreadCPUTimeInMicroseconds(clockid_t clock) {
+  timespec now;
+  if (clock_gettime(clock, &now) != 0)
+    return 0;
+  return static_cast<int64>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
 // TODO(xiaomings) : Make this decoder handle decoder errors. Now it assumes
 // that the input stream is always correct.
 class ShellRawVideoDecoderLinux : public media::ShellRawVideoDecoder {
@@ -86,20 +110,39 @@ class ShellRawVideoDecoderLinux : public media::ShellRawVideoDecoder {
   virtual bool UpdateConfig(const VideoDecoderConfig& config) OVERRIDE;
 
  private:
+  // Opens the codec for config_, with threading chosen for the given H.264
+  // profile_idc and level_idc, either of which may be 0 if not known.
+  bool OpenCodec(int profile_idc, int level_idc);
   void ReleaseResource();
   static int GetVideoBuffer(AVCodecContext* codec_context, AVFrame* frame);
   static void ReleaseVideoBuffer(AVCodecContext*, AVFrame* frame);
-
+  // Remembers the calling codec thread, so that its CPU time
+  // is counted by GetWorkerThreadsCPUTime().
+  void AddWorkerThread();
+  // Returns the CPU time used so far by the codec's frame threads.
+  int64 GetWorkerThreadsCPUTime();
+
+  VideoDecoderConfig config_;
+  scoped_refptr<media::ShellVideoFramePool> frame_pool_;
   AVCodecContext* codec_context_;
   AVFrame* av_frame_;
   gfx::Size natural_size_;
 
+  // With frame threading, frames are decoded on the codec's own threads,
+  // which call GetVideoBuffer() as they start on a frame.  Their CPU time
+  // is added to the time of the thread calling Decode().
+  base::Lock worker_threads_lock_;
+  std::vector<pthread_t> worker_threads_;
+  int64 last_worker_threads_time_us_;
+
   DISALLOW_COPY_AND_ASSIGN(ShellRawVideoDecoderLinux);
 };
 
 ShellRawVideoDecoderLinux::ShellRawVideoDecoderLinux()
-    : codec_context_(NULL),
-      av_frame_(NULL) {
+    : frame_pool_(new media::ShellVideoFramePool(kMaxFreeVideoFrames)),
+      codec_context_(NULL),
+      av_frame_(NULL),
+      last_worker_threads_time_us_(0) {
   LB::EnsureFfmpegInitialized();
 }
 
@@ -112,6 +155,21 @@ ShellRawVideoDecoderLinux::DecodeStatus ShellRawVideoDecoderLinux::Decode(
     scoped_refptr<VideoFrame>* frame) {
   DCHECK(buffer);
   DCHECK(!frame->get());
+
+  // The config carries neither the real profile nor the level, so the codec
+  // is opened with the first buffer, sized from the SPS in its prepend when
+  // there is one, or from the coded size when there isn't.
+  if (!codec_context_) {
+    if (buffer->IsEndOfStream())
+      return NEED_MORE_DATA;
+    int profile_idc = 0;
+    int level_idc = 0;
+    media::FindH264ProfileAndLevel(buffer->GetData(), buffer->GetDataSize(),
+                                   &profile_idc, &level_idc);
+    if (!OpenCodec(profile_idc, level_idc))
+      return FATAL_ERROR;
+  }
+
   AVPacket packet;
   av_init_packet(&packet);
   avcodec_get_frame_defaults(av_frame_);
@@ -120,10 +178,19 @@ ShellRawVideoDecoderLinux::DecodeStatus ShellRawVideoDecoderLinux::Decode(
   packet.pts = buffer->GetTimestamp().InMilliseconds();
 
   int frame_decoded = 0;
+  int64 start_time_us =
+      GetThreadCPUTimeInMicroseconds(CLOCK_THREAD_CPUTIME_ID);
   int result = avcodec_decode_video2(codec_context_,
                                      av_frame_,
                                      &frame_decoded,
                                      &packet);
+  int64 decode_time_us =
+      GetThreadCPUTimeInMicroseconds(CLOCK_THREAD_CPUTIME_ID) - start_time_us;
+  int64 worker_threads_time_us = GetWorkerThreadsCPUTime();
+  decode_time_us += worker_threads_time_us - last_worker_threads_time_us_;
+  last_worker_threads_time_us_ = worker_threads_time_us;
+  UPDATE_MEDIA_STATISTICS(STAT_TYPE_VIDEO_DECODE_THREAD_TIME,
+                          base::TimeDelta::FromMicroseconds(decode_time_us));
   if (frame_decoded == 0)
     return NEED_MORE_DATA;
 
@@ -152,7 +219,8 @@ ShellRawVideoDecoderLinux::DecodeStatus ShellRawVideoDecoderLinux::Decode(
 }
 
 bool ShellRawVideoDecoderLinux::Flush() {
-  avcodec_flush_buffers(codec_context_);
+  if (codec_context_)
+    avcodec_flush_buffers(codec_context_);
 
   return true;
 }
@@ -160,31 +228,59 @@ bool ShellRawVideoDecoderLinux::Flush() {
 bool ShellRawVideoDecoderLinux::UpdateConfig(const VideoDecoderConfig& config) {
   ReleaseResource();
 
+  // planes of the old resolution are of no further use
+  if (config.format() != config_.format() ||
+      config.coded_size() != config_.coded_size()) {
+    frame_pool_->Drain();
+  }
+  config_.CopyFrom(config);
   natural_size_ = config.natural_size();
 
+  // The codec is opened by the first Decode(), see there.
+  if (!avcodec_find_decoder(CODEC_ID_H264)) {
+    DLOG(ERROR) << "No H.264 decoder available";
+    return false;
+  }
+  return true;
+}
+
+bool ShellRawVideoDecoderLinux::OpenCodec(int profile_idc, int level_idc) {
+  DCHECK(!codec_context_);
+
   codec_context_ = avcodec_alloc_context3(NULL);
   DCHECK(codec_context_);
   codec_context_->codec_type = AVMEDIA_TYPE_VIDEO;
   codec_context_->codec_id = CODEC_ID_H264;
-  codec_context_->profile = VideoCodecProfileToProfileID(config.profile());
-  codec_context_->coded_width = config.coded_size().width();
-  codec_context_->coded_height = config.coded_size().height();
-  codec_context_->pix_fmt = VideoFormatToPixelFormat(config.format());
+  codec_context_->profile = VideoCodecProfileToProfileID(config_.profile());
+  codec_context_->coded_width = config_.coded_size().width();
+  codec_context_->coded_height = config_.coded_size().height();
+  codec_context_->pix_fmt = VideoFormatToPixelFormat(config_.format());
+
+  int thread_count = media::GetH264DecoderThreadCount(
+      level_idc, config_.coded_size(), base::SysInfo::NumberOfProcessors());
+  UPDATE_MEDIA_STATISTICS(STAT_TYPE_VIDEO_DECODER_THREADS, thread_count);
 
   codec_context_->error_concealment = FF_EC_GUESS_MVS | FF_EC_DEBLOCK;
-  codec_context_->thread_count = 2;
+  codec_context_->thread_count = thread_count;
+  codec_context_->thread_type =
+      media::ShouldUseH264SliceThreading(profile_idc) ? FF_THREAD_SLICE :
+                                                        FF_THREAD_FRAME;
+  // GetVideoBuffer() and ReleaseVideoBuffer() may be called on the decoding
+  // threads, which lets frame threads start on new frames without waiting
+  // for the thread calling Decode().
+  codec_context_->thread_safe_callbacks = 1;
   codec_context_->opaque = this;
   codec_context_->flags |= CODEC_FLAG_EMU_EDGE;
   codec_context_->get_buffer = GetVideoBuffer;
   codec_context_->release_buffer = ReleaseVideoBuffer;
 
-  if (config.extra_data()) {
-    codec_context_->extradata_size = config.extra_data_size();
+  if (config_.extra_data()) {
+    codec_context_->extradata_size = config_.extra_data_size();
     codec_context_->extradata = reinterpret_cast<uint8_t*>(
-        av_malloc(config.extra_data_size() + FF_INPUT_BUFFER_PADDING_SIZE));
-    memcpy(codec_context_->extradata, config.extra_data(),
-           config.extra_data_size());
-    memset(codec_context_->extradata + config.extra_data_size(), '\0',
+        av_malloc(config_.extra_data_size() + FF_INPUT_BUFFER_PADDING_SIZE));
+    memcpy(codec_context_->extradata, config_.extra_data(),
+           config_.extra_data_size());
+    memset(codec_context_->extradata + config_.extra_data_size(), '\0',
            FF_INPUT_BUFFER_PADDING_SIZE);
   } else {
     codec_context_->extradata = NULL;
@@ -197,6 +293,7 @@ bool ShellRawVideoDecoderLinux::UpdateConfig(const VideoDecoderConfig& config) {
   DCHECK_GE(rv, 0);
   if (rv < 0) {
     DLOG(ERROR) << "Unable to open codec, result = " << rv;
+    ReleaseResource();
     return false;
   }
 
@@ -213,6 +310,12 @@ void ShellRawVideoDecoderLinux::ReleaseResource() {
     av_free(codec_context_);
     codec_context_ = NULL;
   }
+  // The codec threads are joined by avcodec_close().
+  {
+    base::AutoLock auto_lock(worker_threads_lock_);
+    worker_threads_.clear();
+  }
+  last_worker_threads_time_us_ = 0;
   if (av_frame_) {
     av_free(av_frame_);
     av_frame_ = NULL;
@@ -232,14 +335,16 @@ int ShellRawVideoDecoderLinux::GetVideoBuffer(AVCodecContext* codec_context,
   if ((ret = av_image_check_size(size.width(), size.height(), 0, NULL)) < 0)
     return ret;
 
+  ShellRawVideoDecoderLinux* vd = static_cast<ShellRawVideoDecoderLinux*>(
+      codec_context->opaque);
+  if (codec_context->active_thread_type & FF_THREAD_FRAME)
+    vd->AddWorkerThread();
   gfx::Size natural_size;
   if (codec_context->sample_aspect_ratio.num > 0) {
     natural_size = media::GetNaturalSize(
         size, codec_context->sample_aspect_ratio.num,
         codec_context->sample_aspect_ratio.den);
   } else {
-    ShellRawVideoDecoderLinux* vd = static_cast<ShellRawVideoDecoderLinux*>(
-        codec_context->opaque);
     natural_size = vd->natural_size_;
   }
 
@@ -247,8 +352,8 @@ int ShellRawVideoDecoderLinux::GetVideoBuffer(AVCodecContext* codec_context,
     return AVERROR(EINVAL);
 
   scoped_refptr<VideoFrame> video_frame =
-      VideoFrame::CreateFrame(format, size, gfx::Rect(size), natural_size,
-                              media::kNoTimestamp());
+      vd->frame_pool_->CreateFrame(format, size, gfx::Rect(size),
+                                   natural_size, media::kNoTimestamp());
 
   for (int i = 0; i < 3; i++) {
     frame->base[i] = video_frame->data(i);
@@ -279,6 +384,27 @@ void ShellRawVideoDecoderLinux::ReleaseVideoBuffer(AVCodecContext*,
   frame->opaque = NULL;
 }
 
+void ShellRawVideoDecoderLinux::AddWorkerThread() {
+  pthread_t self = pthread_self();
+  base::AutoLock auto_lock(worker_threads_lock_);
+  for (size_t i = 0; i < worker_threads_.size(); ++i) {
+    if (pthread_equal(worker_threads_[i], self))
+      return;
+  }
+  worker_threads_.push_back(self);
+}
+
+int64 ShellRawVideoDecoderLinux::GetWorkerThreadsCPUTime() {
+  base::AutoLock auto_lock(worker_threads_lock_);
+  int64 total_time_us = 0;
+  for (size_t i = 0; i < worker_threads_.size(); ++i) {
+    clockid_t clock;
+    if (pthread_getcpuclockid(worker_threads_[i], &clock) == 0)
+      total_time_us += GetThreadCPUTimeInMicroseconds(clock);
+  }
+  return total_time_us;
+}
+
 }  // namespace
 
 namespace media {
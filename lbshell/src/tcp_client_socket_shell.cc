@@ -16,6 +16,7 @@
 #include "net/socket/tcp_client_socket.h"
 #include "tcp_client_socket_shell.h"
 
+#include "base/format_macros.h"
 #include "base/logging.h"
 #include "base/message_loop.h"
 #include "base/message_pump_shell.h"
@@ -32,6 +33,7 @@
 #include "net/base/network_change_notifier.h"
 #include "net/socket/socket_net_log_params.h"
 
+#include <algorithm>
 #include <string>
 
 #include <sys/types.h>
@@ -50,11 +52,26 @@
 
 namespace net {
 
+const int TCPClientSocketShell::kMaxAutotunedReceiveBufferSize;
+
 namespace {
 
 const int kInvalidSocket = -1;
 const int kTCPKeepAliveSeconds = 45;
 
+#if defined(__LB_WIIU__)
+// The receive buffer is pinned in SetupSocket(), which leaves it to us to grow
+// it on fast connections.  Elsewhere the stack sizes it by itself, and setting
+// it would only turn that off.
+const bool kAutotuneReceiveBuffer = true;
+#else
+const bool kAutotuneReceiveBuffer = false;
+#endif
+// Throughput is measured over at least this long, and over at least
+// kReceiveSampleRoundTrips round trips, to average out bursts.
+const int kReceiveSampleMilliseconds = 200;
+const int kReceiveSampleRoundTrips = 4;
+
 #if defined(__LB_PS4__)
 const int kDefaultMsgFlags = MSG_NOSIGNAL | MSG_DONTWAIT;
 #else
@@ -236,7 +253,9 @@ TCPClientSocketShell::TCPClientSocketShell(const AddressList& addresses,
       waiting_read_(false),
       waiting_write_(false),
       writer_(new WriteDelegate(this)),
-      num_bytes_read_(0) {
+      num_bytes_read_(0),
+      receive_buffer_size_(kReceiveBufferSize),
+      receive_sample_bytes_(0) {
   net_log_.BeginEvent(NetLog::TYPE_SOCKET_ALIVE,
                       source.ToEventParametersCallback());
 }
@@ -431,6 +450,10 @@ void TCPClientSocketShell::DoDisconnect() {
   waiting_read_ = false;
   waiting_write_ = false;
 
+  receive_buffer_size_ = kReceiveBufferSize;
+  receive_sample_start_ = base::TimeTicks();
+  receive_sample_bytes_ = 0;
+
   previously_disconnected_ = true;
 }
 
@@ -544,8 +567,10 @@ int TCPClientSocketShell::Read(IOBuffer* buf, int buf_len,
     base::StatsCounter read_bytes("tcp.read_bytes");
     read_bytes.Add(nread);
     num_bytes_read_ += nread;
-    if (nread > 0)
+    if (nread > 0) {
       use_history_.set_was_used_to_convey_data();
+      UpdateReceiveBufferSize(nread);
+    }
     net_log_.AddByteTransferEvent(
       NetLog::TYPE_SOCKET_BYTES_RECEIVED, nread, buf->data());
     return nread;
@@ -573,8 +598,10 @@ void TCPClientSocketShell::DidCompleteRead() {
     base::StatsCounter read_bytes("tcp.read_bytes");
     read_bytes.Add(nread);
     num_bytes_read_ += nread;
-    if (nread > 0)
+    if (nread > 0) {
       use_history_.set_was_used_to_convey_data();
+      UpdateReceiveBufferSize(nread);
+    }
     net_log_.AddByteTransferEvent(NetLog::TYPE_SOCKET_BYTES_SENT, result,
       read_buf_->data());
   } else {
@@ -589,6 +616,71 @@ void TCPClientSocketShell::DidCompleteRead() {
   }
 }
 
+void TCPClientSocketShell::UpdateReceiveBufferSize(int bytes_read) {
+  if (!kAutotuneReceiveBuffer ||
+      receive_buffer_size_ >= kMaxAutotunedReceiveBufferSize) {
+    return;
+  }
+
+  base::TimeTicks now = base::TimeTicks::Now();
+  if (receive_sample_start_.is_null())
+    receive_sample_start_ = now;
+  receive_sample_bytes_ += bytes_read;
+
+  base::TimeDelta elapsed = now - receive_sample_start_;
+  if (elapsed < base::TimeDelta::FromMilliseconds(kReceiveSampleMilliseconds))
+    return;
+  base::TimeDelta rtt = GetRoundTripTime();
+  int size = GetAutotunedReceiveBufferSize(
+      receive_buffer_size_, receive_sample_bytes_, elapsed, rtt);
+  if (size == 0)
+    return;
+
+  receive_sample_start_ = now;
+  receive_sample_bytes_ = 0;
+  if (size == receive_buffer_size_)
+    return;
+
+  DVLOG(1) << base::StringPrintf(
+      "Growing receive buffer of fd %d to %d bytes (rtt %" PRId64 " us)",
+      socket_, size, rtt.InMicroseconds());
+  if (SetTCPReceiveBufferSize(socket_, size))
+    receive_buffer_size_ = size;
+}
+
+// static
+int TCPClientSocketShell::GetAutotunedReceiveBufferSize(
+    int buffer_size, int64 sample_bytes, base::TimeDelta elapsed,
+    base::TimeDelta rtt) {
+  if (rtt <= base::TimeDelta() || elapsed < rtt * kReceiveSampleRoundTrips)
+    return 0;
+
+  // The sender can't have more than a buffer's worth in flight, so a buffer
+  // smaller than twice the bandwidth-delay product caps the throughput.  When
+  // it does, the measured product is about the buffer size itself, and the
+  // buffer keeps doubling until the link is the limit instead.
+  int64 bdp = sample_bytes * rtt.InMicroseconds() / elapsed.InMicroseconds();
+  if (bdp * 2 <= buffer_size || buffer_size >= kMaxAutotunedReceiveBufferSize)
+    return buffer_size;
+
+  return static_cast<int>(std::min<int64>(
+      std::max<int64>(bdp * 2, buffer_size * 2),
+      kMaxAutotunedReceiveBufferSize));
+}
+
+base::TimeDelta TCPClientSocketShell::GetRoundTripTime() const {
+#if defined(TCP_INFO)
+  struct tcp_info info;
+  socklen_t info_len = sizeof(info);
+  if (getsockopt(socket_, IPPROTO_TCP, TCP_INFO, CAST_OPTVAL(&info),
+                 &info_len) == 0 && info.tcpi_rtt > 0) {
+    return base::TimeDelta::FromMicroseconds(info.tcpi_rtt);
+  }
+#endif
+  // The handshake took about one round trip.
+  return connect_time_micros_;
+}
+
 void TCPClientSocketShell::DoReadCallback(int rv) {
   DCHECK_NE(rv, ERR_IO_PENDING);
 
@@ -672,7 +764,10 @@ void TCPClientSocketShell::DoWriteCallback(int rv) {
 }
 
 bool TCPClientSocketShell::SetReceiveBufferSize(int32 size) {
-  return SetTCPReceiveBufferSize(socket_, size);
+  if (!SetTCPReceiveBufferSize(socket_, size))
+    return false;
+  receive_buffer_size_ = size;
+  return true;
 }
 
 bool TCPClientSocketShell::SetSendBufferSize(int32 size) {
@@ -20,6 +20,7 @@
 #include "base/memory/scoped_ptr.h"
 #include "base/message_loop.h"
 #include "base/threading/non_thread_safe.h"
+#include "base/time.h"
 #include "object_watcher_shell.h"
 #include "net/base/address_list.h"
 #include "net/base/completion_callback.h"
@@ -34,6 +35,18 @@ namespace net {
 class TCPClientSocketShell : public StreamSocket, base::NonThreadSafe {
  public:
   static const int kReceiveBufferSize = kNetworkReceiveBufferSize;
+  // The receive buffer is never grown beyond this.
+  static const int kMaxAutotunedReceiveBufferSize = 256 * 1024;
+
+  // Returns the receive buffer size called for by reading |sample_bytes| in
+  // |elapsed| on a connection with a round trip time of |rtt|, through a
+  // receive buffer of |buffer_size|.  Returns 0 when the sample spans too
+  // few round trips to tell, and |buffer_size| when it needn't grow.
+  static int GetAutotunedReceiveBufferSize(int buffer_size,
+                                           int64 sample_bytes,
+                                           base::TimeDelta elapsed,
+                                           base::TimeDelta rtt);
+
   // The IP address(es) and port number to connect to.  The TCP socket will try
   // each IP address in the list until it succeeds in establishing a
   // connection.
@@ -120,6 +133,13 @@ class TCPClientSocketShell : public StreamSocket, base::NonThreadSafe {
   void DidCompleteWrite();
   void DidCompleteConnect();
 
+  // Adds |bytes_read| to the throughput measurement, and grows the receive
+  // buffer when it turns out to be what limits the throughput.
+  void UpdateReceiveBufferSize(int bytes_read);
+  // Returns the smoothed round trip time of the connection, or the connect
+  // time where the stack doesn't report it.
+  base::TimeDelta GetRoundTripTime() const;
+
   // current state of the connect state machine
   ConnectState next_connect_state_;
   // The OS error that CONNECT_STATE_CONNECT last completed with.
@@ -179,6 +199,12 @@ class TCPClientSocketShell : public StreamSocket, base::NonThreadSafe {
   base::TimeDelta connect_time_micros_;
   int64 num_bytes_read_;
 
+  // The current receive buffer size, and the reads since the throughput
+  // was last measured.
+  int receive_buffer_size_;
+  base::TimeTicks receive_sample_start_;
+  int64 receive_sample_bytes_;
+
   DISALLOW_COPY_AND_ASSIGN(TCPClientSocketShell);
 };
 
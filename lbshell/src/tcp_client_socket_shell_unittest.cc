@@ -0,0 +1,78 @@
+/*
+ * Copyright 2014 Google Inc. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tcp_client_socket_shell.h"
+
+#include "base/time.h"
+#include "external/chromium/testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+using net::TCPClientSocketShell;
+
+const int kBufferSize = 16 * 1024;
+
+int GetSize(int buffer_size, int64 bytes_per_second, int rtt_ms) {
+  // A one second sample, long enough for any of the round trip times used.
+  return TCPClientSocketShell::GetAutotunedReceiveBufferSize(
+      buffer_size, bytes_per_second, base::TimeDelta::FromSeconds(1),
+      base::TimeDelta::FromMilliseconds(rtt_ms));
+}
+
+}  // namespace
+
+TEST(TCPClientSocketShellTest, AutotuneWaitsForEnoughRoundTrips) {
+  // Four round trips of 50ms take 200ms.
+  EXPECT_EQ(0, TCPClientSocketShell::GetAutotunedReceiveBufferSize(
+      kBufferSize, 1024 * 1024, base::TimeDelta::FromMilliseconds(199),
+      base::TimeDelta::FromMilliseconds(50)));
+  EXPECT_EQ(kBufferSize, TCPClientSocketShell::GetAutotunedReceiveBufferSize(
+      kBufferSize, 1024, base::TimeDelta::FromMilliseconds(200),
+      base::TimeDelta::FromMilliseconds(50)));
+  // Without a round trip time there is nothing to go by.
+  EXPECT_EQ(0, TCPClientSocketShell::GetAutotunedReceiveBufferSize(
+      kBufferSize, 1024 * 1024, base::TimeDelta::FromSeconds(1),
+      base::TimeDelta()));
+}
+
+TEST(TCPClientSocketShellTest, AutotuneKeepsBufferOnSlowLinks) {
+  // 100KB/s over 50ms is a product of 5KB, well within the buffer.
+  EXPECT_EQ(kBufferSize, GetSize(kBufferSize, 100 * 1000, 50));
+  // Exactly twice the product still fits.
+  EXPECT_EQ(kBufferSize, GetSize(kBufferSize, kBufferSize / 2 * 20, 50));
+}
+
+TEST(TCPClientSocketShellTest, AutotuneDoublesBufferThatLimitsThroughput) {
+  // A full buffer every round trip is all the sender can do, so the
+  // measured product is the buffer itself.
+  EXPECT_EQ(2 * kBufferSize, GetSize(kBufferSize, kBufferSize * 20, 50));
+  // A product a little over half the buffer still doubles it.
+  EXPECT_EQ(2 * kBufferSize,
+            GetSize(kBufferSize, (kBufferSize / 2 + 1024) * 20, 50));
+}
+
+TEST(TCPClientSocketShellTest, AutotuneGrowsToTwiceTheProduct) {
+  // 2MB/s over 20ms is a product of 40000 bytes.
+  EXPECT_EQ(80000, GetSize(kBufferSize, 2 * 1000 * 1000, 20));
+}
+
+TEST(TCPClientSocketShellTest, AutotuneStopsAtTheMaximum) {
+  const int max_size = TCPClientSocketShell::kMaxAutotunedReceiveBufferSize;
+  // 10MB/s over 50ms calls for about 1MB.
+  EXPECT_EQ(max_size, GetSize(kBufferSize, 10 * 1000 * 1000, 50));
+  EXPECT_EQ(max_size, GetSize(max_size, 10 * 1000 * 1000, 50));
+  EXPECT_EQ(max_size, GetSize(max_size / 2 + 1, 10 * 1000 * 1000, 50));
+}